@@ -437,6 +437,8 @@ static void do_log(int log_level, const char *msg, va_list args, void *param)
 bool OBSApp::InitGlobalConfigDefaults()
 {
 	config_set_default_uint(globalConfig, "General", "MaxLogs", 10);
+	config_set_default_uint(globalConfig, "General",
+				"SourceMemoryBudgetMB", 0);
 	config_set_default_int(globalConfig, "General", "InfoIncrement", -1);
 	config_set_default_string(globalConfig, "General", "ProcessPriority",
 				  "Normal");
@@ -1602,7 +1604,17 @@ static bool StartupOBS(const char *locale, profiler_name_store_t *store)
 	if (GetConfigPath(path, sizeof(path), "obs-studio/plugin_config") <= 0)
 		return false;
 
-	return obs_startup(locale, path, store);
+	if (!obs_startup(locale, path, store))
+		return false;
+
+	if (GetConfigPath(path, sizeof(path), "obs-studio/effect_cache") > 0)
+		obs_set_effect_cache_path(path);
+
+	uint64_t budget_mb = config_get_uint(App()->GlobalConfig(), "General",
+					     "SourceMemoryBudgetMB");
+	obs_set_source_memory_budget(budget_mb * 1024 * 1024);
+
+	return true;
 }
 
 inline void OBSApp::ResetHotkeyState(bool inFocus)
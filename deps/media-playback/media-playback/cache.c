@@ -1,5 +1,7 @@
 #include <media-io/audio-io.h>
 #include <util/platform.h>
+#include <util/dstr.h>
+#include <sys/stat.h>
 
 #include "media-playback.h"
 #include "cache.h"
@@ -16,8 +18,313 @@ static bool mp_cache_reset(mp_cache_t *c);
 
 static int64_t base_sys_ts = 0;
 
-#define v_eof(c) (c->cur_v_idx == c->video_frames.num)
-#define a_eof(c) (c->cur_a_idx == c->audio_segments.num)
+/* ------------------------------------------------------------------------- */
+/* Shared decoded media
+ *
+ * Fully decoded files are shared between all caches that decode the same file
+ * with the same options, so a loop used by several sources is only decoded and
+ * stored once.  Entries no longer in use are kept for reuse until the memory
+ * budget is exceeded, at which point the least recently used ones are freed. */
+
+#define DEFAULT_MEMORY_BUDGET ((size_t)1024 * 1024 * 1024)
+
+struct mp_cache_entry {
+	char *key;
+	long refs;
+	bool linked;
+
+	os_event_t *ready_event;
+	bool ready;
+	bool failed;
+	bool cancelled;
+
+	bool has_video;
+	bool has_audio;
+	int64_t media_duration;
+	int64_t start_time;
+
+	DARRAY(struct obs_source_frame) video_frames;
+	DARRAY(struct obs_source_audio) audio_segments;
+	int64_t final_v_duration;
+	int64_t final_a_duration;
+	size_t mem_size;
+
+	struct mp_cache_entry *prev;
+	struct mp_cache_entry *next;
+};
+
+static pthread_mutex_t entries_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct mp_cache_entry *first_entry = NULL; /* most recently used */
+static struct mp_cache_entry *last_entry = NULL;
+static size_t entries_mem_size = 0;
+static size_t memory_budget = DEFAULT_MEMORY_BUDGET;
+
+static void make_entry_key(struct dstr *key, const struct mp_media_info *info)
+{
+	struct stat st = {0};
+
+	/* a file that was replaced gets a new entry instead of the frames of
+	 * the old one */
+	if (!info->path || os_stat(info->path, &st) != 0)
+		memset(&st, 0, sizeof(st));
+
+	dstr_printf(key, "%s|%lld|%lld|%s|%s|%d|%d|%d|%d",
+		    info->path ? info->path : "", (long long)st.st_size,
+		    (long long)st.st_mtime, info->format ? info->format : "",
+		    info->ffmpeg_options ? info->ffmpeg_options : "",
+		    info->speed, (int)info->force_range,
+		    (int)info->is_linear_alpha, (int)info->hardware_decoding);
+}
+
+static void entry_free(struct mp_cache_entry *e)
+{
+	for (size_t i = 0; i < e->video_frames.num; i++)
+		obs_source_frame_free(&e->video_frames.array[i]);
+	for (size_t i = 0; i < e->audio_segments.num; i++)
+		bfree((void *)e->audio_segments.array[i].data[0]);
+
+	da_free(e->video_frames);
+	da_free(e->audio_segments);
+	os_event_destroy(e->ready_event);
+	bfree(e->key);
+	bfree(e);
+}
+
+static void entry_unlink(struct mp_cache_entry *e)
+{
+	if (!e->linked)
+		return;
+
+	if (e->prev)
+		e->prev->next = e->next;
+	else
+		first_entry = e->next;
+	if (e->next)
+		e->next->prev = e->prev;
+	else
+		last_entry = e->prev;
+
+	e->prev = e->next = NULL;
+	e->linked = false;
+	entries_mem_size -= e->mem_size;
+}
+
+static void entry_link_front(struct mp_cache_entry *e)
+{
+	e->prev = NULL;
+	e->next = first_entry;
+	if (first_entry)
+		first_entry->prev = e;
+	else
+		last_entry = e;
+
+	first_entry = e;
+	e->linked = true;
+	entries_mem_size += e->mem_size;
+}
+
+static struct mp_cache_entry *entry_find(const char *key)
+{
+	for (struct mp_cache_entry *e = first_entry; e; e = e->next) {
+		if (strcmp(e->key, key) == 0)
+			return e;
+	}
+
+	return NULL;
+}
+
+/* unlinks unused entries until the memory budget is met, returning them as a
+ * list to be freed once entries_mutex is released */
+static struct mp_cache_entry *entries_evict(void)
+{
+	struct mp_cache_entry *evicted = NULL;
+	struct mp_cache_entry *e = last_entry;
+
+	while (e && entries_mem_size > memory_budget) {
+		struct mp_cache_entry *prev = e->prev;
+
+		if (e->ready && e->refs == 0) {
+			entry_unlink(e);
+			e->next = evicted;
+			evicted = e;
+		}
+
+		e = prev;
+	}
+
+	return evicted;
+}
+
+static void entries_free_list(struct mp_cache_entry *e)
+{
+	while (e) {
+		struct mp_cache_entry *next = e->next;
+		entry_free(e);
+		e = next;
+	}
+}
+
+static struct mp_cache_entry *entry_acquire(const char *key)
+{
+	struct mp_cache_entry *e;
+
+	pthread_mutex_lock(&entries_mutex);
+	e = entry_find(key);
+	if (e) {
+		e->refs++;
+		entry_unlink(e);
+		entry_link_front(e);
+	}
+	pthread_mutex_unlock(&entries_mutex);
+
+	return e;
+}
+
+/* inserts a new entry, or returns an existing one if another cache of the same
+ * file got there first, in which case the new entry is freed */
+static struct mp_cache_entry *entry_insert(struct mp_cache_entry *new_entry,
+					   bool *inserted)
+{
+	struct mp_cache_entry *e;
+
+	pthread_mutex_lock(&entries_mutex);
+	e = entry_find(new_entry->key);
+	if (e) {
+		e->refs++;
+	} else {
+		e = new_entry;
+		e->refs = 1;
+		entry_link_front(e);
+	}
+	pthread_mutex_unlock(&entries_mutex);
+
+	*inserted = e == new_entry;
+	if (!*inserted)
+		entry_free(new_entry);
+	return e;
+}
+
+static void entry_release(struct mp_cache_entry *e)
+{
+	struct mp_cache_entry *evicted;
+	bool destroy;
+
+	pthread_mutex_lock(&entries_mutex);
+	destroy = --e->refs == 0 && !e->linked;
+	evicted = entries_evict();
+	pthread_mutex_unlock(&entries_mutex);
+
+	entries_free_list(evicted);
+	if (destroy)
+		entry_free(e);
+}
+
+static size_t frame_mem_size(const struct obs_source_frame *frame)
+{
+	size_t size = 0;
+
+	for (size_t i = 0; i < MAX_AV_PLANES && frame->data[i]; i++) {
+		uint32_t height = frame->height;
+
+		/* approximate, only used for the memory budget */
+		if (i > 0 && i < 3) {
+			switch (frame->format) {
+			case VIDEO_FORMAT_I420:
+			case VIDEO_FORMAT_NV12:
+			case VIDEO_FORMAT_I40A:
+			case VIDEO_FORMAT_I010:
+			case VIDEO_FORMAT_P010:
+				height = (height + 1) / 2;
+				break;
+			default:
+				break;
+			}
+		}
+
+		size += (size_t)frame->linesize[i] * height;
+	}
+
+	return size;
+}
+
+/* makes a decoded entry available to every cache waiting on it, or removes it
+ * so the next cache of this file tries again */
+static void entry_publish(struct mp_cache_entry *e, bool success)
+{
+	struct mp_cache_entry *evicted = NULL;
+	size_t size = 0;
+
+	for (size_t i = 0; i < e->video_frames.num; i++)
+		size += frame_mem_size(&e->video_frames.array[i]);
+	for (size_t i = 0; i < e->audio_segments.num; i++) {
+		struct obs_source_audio *a = &e->audio_segments.array[i];
+		size += get_total_audio_size(a->format, a->speakers,
+					     a->frames);
+	}
+
+	pthread_mutex_lock(&entries_mutex);
+	if (success) {
+		e->mem_size = size;
+		entries_mem_size += size;
+		e->ready = true;
+		evicted = entries_evict();
+	} else {
+		e->failed = true;
+		entry_unlink(e);
+	}
+	pthread_mutex_unlock(&entries_mutex);
+
+	entries_free_list(evicted);
+	os_event_signal(e->ready_event);
+}
+
+/* the cache decoding the entry was freed before it finished, the caches
+ * waiting on it decode the file themselves */
+static void entry_cancel(struct mp_cache_entry *e)
+{
+	e->cancelled = true;
+	entry_publish(e, false);
+}
+
+void mp_cache_set_memory_budget(size_t bytes)
+{
+	struct mp_cache_entry *evicted;
+
+	pthread_mutex_lock(&entries_mutex);
+	memory_budget = bytes;
+	evicted = entries_evict();
+	pthread_mutex_unlock(&entries_mutex);
+
+	entries_free_list(evicted);
+}
+
+void mp_cache_free_unused(void)
+{
+	struct mp_cache_entry *evicted = NULL;
+	struct mp_cache_entry *e;
+
+	pthread_mutex_lock(&entries_mutex);
+	e = first_entry;
+	while (e) {
+		struct mp_cache_entry *next = e->next;
+
+		if (e->ready && e->refs == 0) {
+			entry_unlink(e);
+			e->next = evicted;
+			evicted = e;
+		}
+
+		e = next;
+	}
+	pthread_mutex_unlock(&entries_mutex);
+
+	entries_free_list(evicted);
+}
+
+/* ------------------------------------------------------------------------- */
+
+#define v_eof(c) (c->cur_v_idx == c->entry->video_frames.num)
+#define a_eof(c) (c->cur_a_idx == c->entry->audio_segments.num)
 
 static inline int64_t mp_cache_get_next_min_pts(mp_cache_t *c)
 {
@@ -95,6 +402,17 @@ static bool mp_cache_eof(mp_cache_t *c)
 	return true;
 }
 
+static bool mp_cache_killed(mp_cache_t *c)
+{
+	bool kill;
+
+	pthread_mutex_lock(&c->mutex);
+	kill = c->kill;
+	pthread_mutex_unlock(&c->mutex);
+
+	return kill;
+}
+
 bool mp_cache_decode(mp_cache_t *c)
 {
 	mp_media_t *m = &c->m;
@@ -105,6 +423,9 @@ bool mp_cache_decode(mp_cache_t *c)
 	mp_media_reset(m);
 
 	while (!mp_media_eof(m)) {
+		if (mp_cache_killed(c))
+			goto fail;
+
 		if (m->has_video)
 			mp_media_next_video(m, false);
 		if (m->has_audio)
@@ -116,15 +437,67 @@ bool mp_cache_decode(mp_cache_t *c)
 
 	success = true;
 
-	c->start_time = c->m.fmt->start_time;
-	if (c->start_time == AV_NOPTS_VALUE)
-		c->start_time = 0;
+	c->entry->start_time = c->m.fmt->start_time;
+	if (c->entry->start_time == AV_NOPTS_VALUE)
+		c->entry->start_time = 0;
 
 fail:
 	mp_media_free(m);
 	return success;
 }
 
+static bool mp_cache_open_entry(mp_cache_t *c, const struct mp_media_info *info,
+				const char *key);
+
+static bool mp_cache_take_over(mp_cache_t *c)
+{
+	struct mp_cache_entry *e = c->entry;
+	char *key = bstrdup(e->key);
+	bool success;
+
+	/* another waiting cache may have taken over already */
+	c->entry = entry_acquire(key);
+	entry_release(e);
+
+	success = c->entry || mp_cache_open_entry(c, &c->info, key);
+	bfree(key);
+	return success;
+}
+
+static bool mp_cache_wait_for_entry(mp_cache_t *c)
+{
+	for (;;) {
+		struct mp_cache_entry *e = c->entry;
+
+		if (c->decode) {
+			bool success = mp_cache_decode(c);
+
+			c->decode = false;
+			if (!success && mp_cache_killed(c))
+				entry_cancel(e);
+			else
+				entry_publish(e, success);
+
+			if (!success)
+				return false;
+			break;
+		}
+
+		while (os_event_timedwait(e->ready_event, 100) == ETIMEDOUT) {
+			if (mp_cache_killed(c))
+				return false;
+		}
+
+		if (!e->failed)
+			break;
+		if (!e->cancelled || !mp_cache_take_over(c))
+			return false;
+	}
+
+	c->start_time = c->entry->start_time;
+	return true;
+}
+
 static void seek_to(mp_cache_t *c, int64_t pos)
 {
 	size_t new_v_idx = 0;
@@ -138,8 +511,8 @@ static void seek_to(mp_cache_t *c, int64_t pos)
 	if (c->has_video) {
 		struct obs_source_frame *v;
 
-		for (size_t i = 0; i < c->video_frames.num; i++) {
-			v = &c->video_frames.array[i];
+		for (size_t i = 0; i < c->entry->video_frames.num; i++) {
+			v = &c->entry->video_frames.array[i];
 			new_v_idx = i;
 			if ((int64_t)v->timestamp >= pos) {
 				break;
@@ -147,19 +520,19 @@ static void seek_to(mp_cache_t *c, int64_t pos)
 		}
 
 		size_t next_idx = new_v_idx + 1;
-		if (next_idx == c->video_frames.num) {
-			c->next_v_ts =
-				(int64_t)v->timestamp + c->final_v_duration;
+		if (next_idx == c->entry->video_frames.num) {
+			c->next_v_ts = (int64_t)v->timestamp +
+				       c->entry->final_v_duration;
 		} else {
 			struct obs_source_frame *next =
-				&c->video_frames.array[next_idx];
+				&c->entry->video_frames.array[next_idx];
 			c->next_v_ts = (int64_t)next->timestamp;
 		}
 	}
 	if (c->has_audio) {
 		struct obs_source_audio *a;
-		for (size_t i = 0; i < c->audio_segments.num; i++) {
-			a = &c->audio_segments.array[i];
+		for (size_t i = 0; i < c->entry->audio_segments.num; i++) {
+			a = &c->entry->audio_segments.array[i];
 			new_a_idx = i;
 			if ((int64_t)a->timestamp >= pos) {
 				break;
@@ -167,12 +540,12 @@ static void seek_to(mp_cache_t *c, int64_t pos)
 		}
 
 		size_t next_idx = new_a_idx + 1;
-		if (next_idx == c->audio_segments.num) {
-			c->next_a_ts =
-				(int64_t)a->timestamp + c->final_a_duration;
+		if (next_idx == c->entry->audio_segments.num) {
+			c->next_a_ts = (int64_t)a->timestamp +
+				       c->entry->final_a_duration;
 		} else {
 			struct obs_source_audio *next =
-				&c->audio_segments.array[next_idx];
+				&c->entry->audio_segments.array[next_idx];
 			c->next_a_ts = (int64_t)next->timestamp;
 		}
 	}
@@ -199,12 +572,12 @@ static inline bool mp_media_can_play_audio(mp_cache_t *c)
 static inline void calc_next_v_ts(mp_cache_t *c, struct obs_source_frame *frame)
 {
 	int64_t offset;
-	if (c->next_v_idx < c->video_frames.num) {
+	if (c->next_v_idx < c->entry->video_frames.num) {
 		struct obs_source_frame *next =
-			&c->video_frames.array[c->next_v_idx];
+			&c->entry->video_frames.array[c->next_v_idx];
 		offset = (int64_t)(next->timestamp - frame->timestamp);
 	} else {
-		offset = c->final_v_duration;
+		offset = c->entry->final_v_duration;
 	}
 
 	c->next_v_ts += offset;
@@ -213,12 +586,12 @@ static inline void calc_next_v_ts(mp_cache_t *c, struct obs_source_frame *frame)
 static inline void calc_next_a_ts(mp_cache_t *c, struct obs_source_audio *audio)
 {
 	int64_t offset;
-	if (c->next_a_idx < c->audio_segments.num) {
+	if (c->next_a_idx < c->entry->audio_segments.num) {
 		struct obs_source_audio *next =
-			&c->audio_segments.array[c->next_a_idx];
+			&c->entry->audio_segments.array[c->next_a_idx];
 		offset = (int64_t)(next->timestamp - audio->timestamp);
 	} else {
-		offset = c->final_a_duration;
+		offset = c->entry->final_a_duration;
 	}
 
 	c->next_a_ts += offset;
@@ -227,13 +600,14 @@ static inline void calc_next_a_ts(mp_cache_t *c, struct obs_source_audio *audio)
 static void mp_cache_next_video(mp_cache_t *c, bool preload)
 {
 	/* eof check */
-	if (c->next_v_idx == c->video_frames.num) {
+	if (c->next_v_idx == c->entry->video_frames.num) {
 		if (mp_media_can_play_video(c))
 			c->cur_v_idx = c->next_v_idx;
 		return;
 	}
 
-	struct obs_source_frame *frame = &c->video_frames.array[c->next_v_idx];
+	struct obs_source_frame *frame =
+		&c->entry->video_frames.array[c->next_v_idx];
 	struct obs_source_frame dup = *frame;
 
 	dup.timestamp = c->base_ts + dup.timestamp - c->start_ts +
@@ -262,7 +636,7 @@ static void mp_cache_next_video(mp_cache_t *c, bool preload)
 static void mp_cache_next_audio(mp_cache_t *c)
 {
 	/* eof check */
-	if (c->next_a_idx == c->audio_segments.num) {
+	if (c->next_a_idx == c->entry->audio_segments.num) {
 		if (mp_media_can_play_audio(c))
 			c->cur_a_idx = c->next_a_idx;
 		return;
@@ -272,7 +646,7 @@ static void mp_cache_next_audio(mp_cache_t *c)
 		return;
 
 	struct obs_source_audio *audio =
-		&c->audio_segments.array[c->next_a_idx];
+		&c->entry->audio_segments.array[c->next_a_idx];
 	struct obs_source_audio dup = *audio;
 
 	dup.timestamp = c->base_ts + dup.timestamp - c->start_ts +
@@ -308,14 +682,15 @@ static bool mp_cache_reset(mp_cache_t *c)
 	pthread_mutex_unlock(&c->mutex);
 
 	if (c->has_video) {
-		size_t next_idx = c->video_frames.num > 1 ? 1 : 0;
+		size_t next_idx = c->entry->video_frames.num > 1 ? 1 : 0;
 		c->cur_v_idx = c->next_v_idx = 0;
-		c->next_v_ts = c->video_frames.array[next_idx].timestamp;
+		c->next_v_ts = c->entry->video_frames.array[next_idx].timestamp;
 	}
 	if (c->has_audio) {
-		size_t next_idx = c->audio_segments.num > 1 ? 1 : 0;
+		size_t next_idx = c->entry->audio_segments.num > 1 ? 1 : 0;
 		c->cur_a_idx = c->next_a_idx = 0;
-		c->next_a_ts = c->audio_segments.array[next_idx].timestamp;
+		c->next_a_ts =
+			c->entry->audio_segments.array[next_idx].timestamp;
 	}
 
 	if (active) {
@@ -365,7 +740,7 @@ static inline bool mp_cache_thread(mp_cache_t *c)
 {
 	os_set_thread_name("mp_cache_thread");
 
-	if (!mp_cache_decode(c)) {
+	if (!mp_cache_wait_for_entry(c)) {
 		return false;
 	}
 
@@ -430,7 +805,8 @@ static inline bool mp_cache_thread(mp_cache_t *c)
 			continue;
 
 		if (preload_frame)
-			c->v_preload_cb(c->opaque, &c->video_frames.array[0]);
+			c->v_preload_cb(c->opaque,
+					&c->entry->video_frames.array[0]);
 
 		/* frames are ready */
 		if (is_active && !timeout) {
@@ -472,9 +848,9 @@ static void fill_video(void *data, struct obs_source_frame *frame)
 
 	dup.timestamp = frame->timestamp;
 
-	c->final_v_duration = c->m.v.last_duration;
+	c->entry->final_v_duration = c->m.v.last_duration;
 
-	da_push_back(c->video_frames, &dup);
+	da_push_back(c->entry->video_frames, &dup);
 }
 
 static void fill_audio(void *data, struct obs_source_audio *audio)
@@ -502,9 +878,9 @@ static void fill_audio(void *data, struct obs_source_audio *audio)
 		memcpy((uint8_t *)dup.data[0], audio->data[0], size);
 	}
 
-	c->final_a_duration = c->m.a.last_duration;
+	c->entry->final_a_duration = c->m.a.last_duration;
 
-	da_push_back(c->audio_segments, &dup);
+	da_push_back(c->entry->audio_segments, &dup);
 }
 
 static inline bool mp_cache_init_internal(mp_cache_t *c,
@@ -521,6 +897,14 @@ static inline bool mp_cache_init_internal(mp_cache_t *c,
 
 	c->path = info->path ? bstrdup(info->path) : NULL;
 	c->format_name = info->format ? bstrdup(info->format) : NULL;
+	c->index_cache_dir = info->index_cache_dir
+				     ? bstrdup(info->index_cache_dir)
+				     : NULL;
+
+	c->info = *info;
+	c->info.path = c->path;
+	c->info.format = c->format_name;
+	c->info.index_cache_dir = c->index_cache_dir;
 
 	if (pthread_create(&c->thread, NULL, mp_cache_thread_start, c) != 0) {
 		blog(LOG_WARNING, "MP: Could not create media thread");
@@ -531,9 +915,12 @@ static inline bool mp_cache_init_internal(mp_cache_t *c,
 	return true;
 }
 
-bool mp_cache_init(mp_cache_t *c, const struct mp_media_info *info)
+static bool mp_cache_open_entry(mp_cache_t *c, const struct mp_media_info *info,
+				const char *key)
 {
 	struct mp_media_info info2 = *info;
+	struct mp_cache_entry *e;
+	bool inserted;
 
 	info2.opaque = c;
 	info2.v_cb = fill_video;
@@ -544,11 +931,43 @@ bool mp_cache_init(mp_cache_t *c, const struct mp_media_info *info)
 	info2.full_decode = true;
 
 	mp_media_t *m = &c->m;
-	if (!mp_media_init(m, &info2)) {
-		mp_cache_free(c);
+	if (!mp_media_init(m, &info2))
+		return false;
+	if (!mp_media_init2(m))
+		return false;
+
+	e = bzalloc(sizeof(*e));
+	e->key = bstrdup(key);
+	e->has_video = m->has_video;
+	e->has_audio = m->has_audio;
+	e->media_duration = m->fmt->duration;
+
+	if (os_event_init(&e->ready_event, OS_EVENT_TYPE_MANUAL) != 0) {
+		blog(LOG_WARNING, "MP: Failed to init event");
+		entry_free(e);
 		return false;
 	}
-	if (!mp_media_init2(m)) {
+
+	c->entry = entry_insert(e, &inserted);
+	c->decode = inserted;
+
+	/* another cache is already decoding this file */
+	if (!inserted)
+		mp_media_free(m);
+	return true;
+}
+
+bool mp_cache_init(mp_cache_t *c, const struct mp_media_info *info)
+{
+	struct dstr key = {0};
+	bool success;
+
+	make_entry_key(&key, info);
+	c->entry = entry_acquire(key.array);
+	success = c->entry || mp_cache_open_entry(c, info, key.array);
+	dstr_free(&key);
+
+	if (!success) {
 		mp_cache_free(c);
 		return false;
 	}
@@ -563,10 +982,10 @@ bool mp_cache_init(mp_cache_t *c, const struct mp_media_info *info)
 	c->v_preload_cb = info->v_preload_cb;
 	c->request_preload = info->request_preload;
 	c->speed = info->speed;
-	c->media_duration = m->fmt->duration;
+	c->media_duration = c->entry->media_duration;
 
-	c->has_video = m->has_video;
-	c->has_audio = m->has_audio;
+	c->has_video = c->entry->has_video;
+	c->has_audio = c->entry->has_audio;
 
 	if (!base_sys_ts)
 		base_sys_ts = (int64_t)os_gettime_ns();
@@ -602,19 +1021,15 @@ void mp_cache_free(mp_cache_t *c)
 	if (c->m.fmt)
 		mp_media_free(&c->m);
 
-	for (size_t i = 0; i < c->video_frames.num; i++) {
-		struct obs_source_frame *f = &c->video_frames.array[i];
-		obs_source_frame_free(f);
-	}
-	for (size_t i = 0; i < c->audio_segments.num; i++) {
-		struct obs_source_audio *a = &c->audio_segments.array[i];
-		bfree((void *)a->data[0]);
-	}
-	da_free(c->video_frames);
-	da_free(c->audio_segments);
+	/* never finished decoding, so nothing else would signal it */
+	if (c->entry && c->decode)
+		entry_cancel(c->entry);
+	if (c->entry)
+		entry_release(c->entry);
 
 	bfree(c->path);
 	bfree(c->format_name);
+	bfree(c->index_cache_dir);
 	pthread_mutex_destroy(&c->mutex);
 	os_sem_destroy(c->sem);
 	memset(c, 0, sizeof(*c));
@@ -689,7 +1104,8 @@ void mp_cache_seek(mp_cache_t *c, int64_t pos)
 
 int64_t mp_cache_get_frames(mp_cache_t *c)
 {
-	return c->video_frames.num;
+	struct mp_cache_entry *e = c->entry;
+	return e && e->ready ? (int64_t)e->video_frames.num : 0;
 }
 
 int64_t mp_cache_get_duration(mp_cache_t *c)
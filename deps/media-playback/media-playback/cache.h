@@ -4,8 +4,11 @@
 #include <util/darray.h>
 #include <obs.h>
 
+#include "media-playback.h"
 #include "media.h"
 
+struct mp_cache_entry;
+
 struct mp_cache {
 	mp_video_cb v_preload_cb;
 	mp_video_cb v_seek_cb;
@@ -20,6 +23,7 @@ struct mp_cache {
 	char *path;
 	char *format_name;
 	char *ffmpeg_options;
+	char *index_cache_dir;
 	int buffering;
 	int speed;
 
@@ -35,8 +39,12 @@ struct mp_cache {
 	bool thread_valid;
 	pthread_t thread;
 
-	DARRAY(struct obs_source_frame) video_frames;
-	DARRAY(struct obs_source_audio) audio_segments;
+	/* decoded frames, shared with every cache of the same file */
+	struct mp_cache_entry *entry;
+	bool decode;
+
+	/* to decode the file if the cache decoding it is freed first */
+	struct mp_media_info info;
 
 	size_t cur_v_idx;
 	size_t cur_a_idx;
@@ -45,9 +53,6 @@ struct mp_cache {
 	int64_t next_v_ts;
 	int64_t next_a_ts;
 
-	int64_t final_v_duration;
-	int64_t final_a_duration;
-
 	int64_t play_sys_ts;
 	int64_t next_pts_ns;
 	uint64_t next_ns;
@@ -79,3 +84,6 @@ extern int64_t mp_cache_get_current_time(mp_cache_t *c);
 extern void mp_cache_seek(mp_cache_t *c, int64_t pos);
 extern int64_t mp_cache_get_frames(mp_cache_t *c);
 extern int64_t mp_cache_get_duration(mp_cache_t *c);
+
+extern void mp_cache_set_memory_budget(size_t bytes);
+extern void mp_cache_free_unused(void);
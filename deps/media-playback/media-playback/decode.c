@@ -167,6 +167,7 @@ bool mp_decode_init(mp_media_t *m, enum AVMediaType type, bool hw)
 	memset(d, 0, sizeof(*d));
 	d->m = m;
 	d->audio = type == AVMEDIA_TYPE_AUDIO;
+	pthread_mutex_init(&d->queue_mutex, NULL);
 
 	ret = av_find_best_stream(m->fmt, type, -1, -1, NULL, 0);
 	if (ret < 0)
@@ -242,6 +243,16 @@ bool mp_decode_init(mp_media_t *m, enum AVMediaType type, bool hw)
 }
 
 extern void mp_media_free_packet(mp_media_t *m, AVPacket *pkt);
+extern void mp_media_packet_consumed(mp_media_t *m);
+
+static void free_queued_frames(struct mp_decode *d)
+{
+	while (d->frames.size) {
+		struct mp_decode_frame frame;
+		circlebuf_pop_front(&d->frames, &frame, sizeof(frame));
+		av_frame_free(&frame.frame);
+	}
+}
 
 void mp_decode_clear_packets(struct mp_decode *d)
 {
@@ -259,12 +270,18 @@ void mp_decode_clear_packets(struct mp_decode *d)
 
 void mp_decode_free(struct mp_decode *d)
 {
+	mp_decode_stop_thread(d);
 	mp_decode_clear_packets(d);
 	circlebuf_free(&d->packets);
+	circlebuf_free(&d->frames);
+	pthread_mutex_destroy(&d->queue_mutex);
 
 	av_packet_free(&d->pkt);
 	av_packet_free(&d->orig_pkt);
 
+	if (d->out_frame)
+		av_frame_free(&d->out_frame);
+
 	if (d->hw_frame) {
 		av_frame_unref(d->hw_frame);
 		av_free(d->hw_frame);
@@ -289,7 +306,15 @@ void mp_decode_free(struct mp_decode *d)
 
 void mp_decode_push_packet(struct mp_decode *decode, AVPacket *packet)
 {
+	if (!decode->threaded) {
+		circlebuf_push_back(&decode->packets, &packet, sizeof(packet));
+		return;
+	}
+
+	pthread_mutex_lock(&decode->queue_mutex);
 	circlebuf_push_back(&decode->packets, &packet, sizeof(packet));
+	pthread_mutex_unlock(&decode->queue_mutex);
+	os_sem_post(decode->packets_ready);
 }
 
 static inline int64_t get_estimated_duration(struct mp_decode *d,
@@ -301,10 +326,10 @@ static inline int64_t get_estimated_duration(struct mp_decode *d,
 				    (AVRational){1, 1000000000});
 	} else {
 		if (last_pts)
-			return d->frame_pts - last_pts;
+			return d->dec.frame_pts - last_pts;
 
-		if (d->last_duration)
-			return d->last_duration;
+		if (d->dec.last_duration)
+			return d->dec.last_duration;
 
 		return av_rescale_q(d->decoder->time_base.num,
 				    d->decoder->time_base,
@@ -349,7 +374,7 @@ static int decode_packet(struct mp_decode *d, int *got_frame)
 #ifdef USE_NEW_HARDWARE_CODEC_METHOD
 	if (*got_frame && d->hw) {
 		if (d->hw_frame->format != d->hw_format) {
-			d->frame = d->hw_frame;
+			d->dec.frame = d->hw_frame;
 			return ret;
 		}
 
@@ -367,44 +392,87 @@ static int decode_packet(struct mp_decode *d, int *got_frame)
 	}
 #endif
 
-	d->frame = d->sw_frame;
+	d->dec.frame = d->sw_frame;
 	return ret;
 }
 
-bool mp_decode_next(struct mp_decode *d)
+enum pop_result {
+	POP_NONE,
+	POP_PACKET,
+	POP_EOF,
+};
+
+/* takes the next packet off the queue.  when threaded, waits for the demux
+ * thread to provide one, or for the end of the input */
+static enum pop_result pop_packet(struct mp_decode *d, bool eof)
+{
+	AVPacket *pkt = NULL;
+
+	if (!d->threaded) {
+		if (!d->packets.size)
+			return eof ? POP_EOF : POP_NONE;
+
+		circlebuf_pop_front(&d->packets, &pkt, sizeof(pkt));
+
+	} else {
+		for (;;) {
+			bool stop;
+
+			pthread_mutex_lock(&d->queue_mutex);
+			stop = d->stop;
+			eof = d->input_eof;
+			if (!stop && d->packets.size)
+				circlebuf_pop_front(&d->packets, &pkt,
+						    sizeof(pkt));
+			pthread_mutex_unlock(&d->queue_mutex);
+
+			if (stop)
+				return POP_NONE;
+			if (pkt)
+				break;
+			if (eof)
+				return POP_EOF;
+
+			os_sem_wait(d->packets_ready);
+		}
+
+		mp_media_packet_consumed(d->m);
+	}
+
+	mp_media_free_packet(d->m, d->orig_pkt);
+	d->orig_pkt = pkt;
+	av_packet_ref(d->pkt, d->orig_pkt);
+	d->packet_pending = true;
+	return POP_PACKET;
+}
+
+static void decode_next(struct mp_decode *d, bool eof)
 {
-	bool eof = d->m->eof;
 	int got_frame;
 	int ret;
 
-	d->frame_ready = false;
+	d->dec.frame_ready = false;
 
-	if (!eof && !d->packets.size)
-		return true;
+	if (!d->threaded && !eof && !d->packets.size)
+		return;
 
-	while (!d->frame_ready) {
+	while (!d->dec.frame_ready) {
 		if (!d->packet_pending) {
-			if (!d->packets.size) {
-				if (eof) {
-					d->pkt->data = NULL;
-					d->pkt->size = 0;
-				} else {
-					return true;
-				}
-			} else {
-				mp_media_free_packet(d->m, d->orig_pkt);
-				circlebuf_pop_front(&d->packets, &d->orig_pkt,
-						    sizeof(d->orig_pkt));
-				av_packet_ref(d->pkt, d->orig_pkt);
-				d->packet_pending = true;
+			enum pop_result result = pop_packet(d, eof);
+			if (result == POP_NONE)
+				return;
+
+			if (result == POP_EOF) {
+				d->pkt->data = NULL;
+				d->pkt->size = 0;
 			}
 		}
 
 		ret = decode_packet(d, &got_frame);
 
 		if (!got_frame && ret == 0) {
-			d->eof = true;
-			return true;
+			d->dec.eof = true;
+			return;
 		}
 		if (ret < 0) {
 #ifdef DETAILED_DEBUG_INFO
@@ -417,10 +485,10 @@ bool mp_decode_next(struct mp_decode *d)
 				av_packet_unref(d->pkt);
 				d->packet_pending = false;
 			}
-			return true;
+			return;
 		}
 
-		d->frame_ready = !!got_frame;
+		d->dec.frame_ready = !!got_frame;
 
 		if (d->packet_pending) {
 			if (d->pkt->size) {
@@ -436,13 +504,13 @@ bool mp_decode_next(struct mp_decode *d)
 		}
 	}
 
-	if (d->frame_ready) {
-		int64_t last_pts = d->frame_pts;
+	if (d->dec.frame_ready) {
+		int64_t last_pts = d->dec.frame_pts;
 
 		if (d->in_frame->best_effort_timestamp == AV_NOPTS_VALUE)
-			d->frame_pts = d->next_pts;
+			d->dec.frame_pts = d->dec.next_pts;
 		else
-			d->frame_pts =
+			d->dec.frame_pts =
 				av_rescale_q(d->in_frame->best_effort_timestamp,
 					     d->stream->time_base,
 					     (AVRational){1, 1000000000});
@@ -458,18 +526,29 @@ bool mp_decode_next(struct mp_decode *d)
 						(AVRational){1, 1000000000});
 
 		if (d->m->speed != 100) {
-			d->frame_pts = av_rescale_q(
-				d->frame_pts, (AVRational){1, d->m->speed},
+			d->dec.frame_pts = av_rescale_q(
+				d->dec.frame_pts, (AVRational){1, d->m->speed},
 				(AVRational){1, 100});
 			duration = av_rescale_q(duration,
 						(AVRational){1, d->m->speed},
 						(AVRational){1, 100});
 		}
 
-		d->last_duration = duration;
-		d->next_pts = d->frame_pts + duration;
+		d->dec.last_duration = duration;
+		d->dec.next_pts = d->dec.frame_pts + duration;
 	}
+}
 
+bool mp_decode_next(struct mp_decode *d)
+{
+	decode_next(d, d->m->eof);
+
+	d->frame = d->dec.frame;
+	d->frame_pts = d->dec.frame_pts;
+	d->next_pts = d->dec.next_pts;
+	d->last_duration = d->dec.last_duration;
+	d->frame_ready = d->dec.frame_ready;
+	d->eof = d->dec.eof;
 	return true;
 }
 
@@ -477,8 +556,197 @@ void mp_decode_flush(struct mp_decode *d)
 {
 	avcodec_flush_buffers(d->decoder);
 	mp_decode_clear_packets(d);
+	memset(&d->dec, 0, sizeof(d->dec));
 	d->eof = false;
 	d->frame_pts = 0;
 	d->frame_ready = false;
 	d->next_pts = 0;
 }
+
+/* ------------------------------------------------------------------------- */
+/* threaded decoding                                                         */
+
+#define MAX_QUEUED_VIDEO_FRAMES 4
+#define MAX_QUEUED_AUDIO_FRAMES 16
+
+static inline bool stopping(struct mp_decode *d)
+{
+	bool stop;
+
+	pthread_mutex_lock(&d->queue_mutex);
+	stop = d->stop;
+	pthread_mutex_unlock(&d->queue_mutex);
+	return stop;
+}
+
+static void *mp_decode_thread(void *opaque)
+{
+	struct mp_decode *d = opaque;
+
+	os_set_thread_name(d->audio ? "mp_decode_audio" : "mp_decode_video");
+
+	for (;;) {
+		struct mp_decode_frame out = {0};
+
+		/* wait for room in the frame queue */
+		if (os_sem_wait(d->frames_free) < 0 || stopping(d))
+			break;
+
+		while (!out.frame_ready && !out.eof) {
+			decode_next(d, false);
+			if (stopping(d))
+				return NULL;
+
+			if (d->dec.frame_ready) {
+				/* the decoder reuses its own frames, so take
+				 * the references instead of copying */
+				out = d->dec;
+				out.frame = av_frame_alloc();
+				av_frame_move_ref(out.frame, d->dec.frame);
+
+			} else if (d->dec.eof) {
+				out.eof = true;
+			}
+		}
+
+		pthread_mutex_lock(&d->queue_mutex);
+		circlebuf_push_back(&d->frames, &out, sizeof(out));
+		pthread_mutex_unlock(&d->queue_mutex);
+		os_sem_post(d->frames_ready);
+
+		if (out.eof)
+			break;
+	}
+
+	return NULL;
+}
+
+bool mp_decode_start_thread(struct mp_decode *d)
+{
+	long max_frames = d->audio ? MAX_QUEUED_AUDIO_FRAMES
+				   : MAX_QUEUED_VIDEO_FRAMES;
+
+	if (d->thread_valid)
+		return true;
+
+	if (!d->out_frame) {
+		d->out_frame = av_frame_alloc();
+		if (!d->out_frame)
+			return false;
+	}
+
+	if (os_sem_init(&d->packets_ready, 0) != 0)
+		goto fail;
+	if (os_sem_init(&d->frames_free, max_frames) != 0)
+		goto fail;
+	if (os_sem_init(&d->frames_ready, 0) != 0)
+		goto fail;
+
+	d->stop = false;
+	d->input_eof = false;
+	d->threaded = true;
+
+	if (pthread_create(&d->thread, NULL, mp_decode_thread, d) != 0)
+		goto fail;
+
+	d->thread_valid = true;
+	return true;
+
+fail:
+	blog(LOG_WARNING, "MP: Failed to start %s decode thread",
+	     d->audio ? "audio" : "video");
+	d->threaded = false;
+	os_sem_destroy(d->packets_ready);
+	os_sem_destroy(d->frames_free);
+	os_sem_destroy(d->frames_ready);
+	d->packets_ready = NULL;
+	d->frames_free = NULL;
+	d->frames_ready = NULL;
+	return false;
+}
+
+void mp_decode_stop_thread(struct mp_decode *d)
+{
+	if (!d->thread_valid)
+		return;
+
+	pthread_mutex_lock(&d->queue_mutex);
+	d->stop = true;
+	pthread_mutex_unlock(&d->queue_mutex);
+
+	os_sem_post(d->packets_ready);
+	os_sem_post(d->frames_free);
+	pthread_join(d->thread, NULL);
+	d->thread_valid = false;
+	d->threaded = false;
+
+	free_queued_frames(d);
+
+	os_sem_destroy(d->packets_ready);
+	os_sem_destroy(d->frames_free);
+	os_sem_destroy(d->frames_ready);
+	d->packets_ready = NULL;
+	d->frames_free = NULL;
+	d->frames_ready = NULL;
+}
+
+void mp_decode_set_input_eof(struct mp_decode *d)
+{
+	pthread_mutex_lock(&d->queue_mutex);
+	d->input_eof = true;
+	pthread_mutex_unlock(&d->queue_mutex);
+	os_sem_post(d->packets_ready);
+}
+
+/* waits until the decode thread has the next frame, or has reached the end
+ * of the stream */
+bool mp_decode_wait_frame(struct mp_decode *d)
+{
+	struct mp_decode_frame in;
+
+	if (d->frame_ready || d->eof)
+		return true;
+	if (os_sem_wait(d->frames_ready) < 0)
+		return false;
+
+	pthread_mutex_lock(&d->queue_mutex);
+	circlebuf_pop_front(&d->frames, &in, sizeof(in));
+	pthread_mutex_unlock(&d->queue_mutex);
+	os_sem_post(d->frames_free);
+
+	if (in.eof) {
+		d->eof = true;
+		return true;
+	}
+
+	av_frame_unref(d->out_frame);
+	av_frame_move_ref(d->out_frame, in.frame);
+	av_frame_free(&in.frame);
+
+	d->frame = d->out_frame;
+	d->frame_pts = in.frame_pts;
+	d->next_pts = in.next_pts;
+	d->last_duration = in.last_duration;
+	d->frame_ready = true;
+	return true;
+}
+
+size_t mp_decode_queued_frames(struct mp_decode *d)
+{
+	size_t count;
+
+	pthread_mutex_lock(&d->queue_mutex);
+	count = d->frames.size / sizeof(struct mp_decode_frame);
+	pthread_mutex_unlock(&d->queue_mutex);
+	return count;
+}
+
+size_t mp_decode_queued_packets(struct mp_decode *d)
+{
+	size_t count;
+
+	pthread_mutex_lock(&d->queue_mutex);
+	count = d->packets.size / sizeof(AVPacket *);
+	pthread_mutex_unlock(&d->queue_mutex);
+	return count;
+}
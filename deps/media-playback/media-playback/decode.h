@@ -48,6 +48,16 @@ extern "C" {
 
 struct mp_media;
 
+/* a decoded frame and its timing */
+struct mp_decode_frame {
+	AVFrame *frame;
+	int64_t frame_pts;
+	int64_t next_pts;
+	int64_t last_duration;
+	bool frame_ready;
+	bool eof;
+};
+
 struct mp_decode {
 	struct mp_media *m;
 	AVStream *stream;
@@ -75,6 +85,25 @@ struct mp_decode {
 	AVPacket *pkt;
 	bool packet_pending;
 	struct circlebuf packets;
+
+	/* state of the decoder itself.  the fields above describe the frame
+	 * handed to the media, which is the same frame unless the decoder
+	 * runs on its own thread */
+	struct mp_decode_frame dec;
+
+	/* threaded decoding: packets are pushed by the demux thread, and
+	 * decoded frames are queued for the media thread */
+	bool threaded;
+	bool thread_valid;
+	pthread_t thread;
+	pthread_mutex_t queue_mutex;
+	os_sem_t *packets_ready;
+	os_sem_t *frames_free;
+	os_sem_t *frames_ready;
+	struct circlebuf frames; /* struct mp_decode_frame */
+	AVFrame *out_frame;
+	bool input_eof;
+	bool stop;
 };
 
 extern bool mp_decode_init(struct mp_media *media, enum AVMediaType type,
@@ -87,6 +116,13 @@ extern void mp_decode_push_packet(struct mp_decode *decode, AVPacket *pkt);
 extern bool mp_decode_next(struct mp_decode *decode);
 extern void mp_decode_flush(struct mp_decode *decode);
 
+extern bool mp_decode_start_thread(struct mp_decode *decode);
+extern void mp_decode_stop_thread(struct mp_decode *decode);
+extern void mp_decode_set_input_eof(struct mp_decode *decode);
+extern bool mp_decode_wait_frame(struct mp_decode *decode);
+extern size_t mp_decode_queued_frames(struct mp_decode *decode);
+extern size_t mp_decode_queued_packets(struct mp_decode *decode);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,466 @@
+#include <util/file-serializer.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+
+#include "index.h"
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#pragma warning(disable : 4204)
+#endif
+
+#include <libavformat/avformat.h>
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#define INDEX_MAGIC "MPINDEX1"
+#define PREFETCH_CHUNK_SIZE (1024 * 1024)
+#define MAX_PREFETCH_SIZE (64 * 1024 * 1024)
+
+/* ------------------------------------------------------------------------- */
+/* on-disk cache                                                             */
+
+static uint64_t hash_path(const char *path)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	while (*path) {
+		hash ^= (uint8_t)*(path++);
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static void get_cache_file(struct mp_index *index, struct dstr *file)
+{
+	dstr_printf(file, "%s/%016" PRIx64 ".idx", index->cache_dir,
+		    hash_path(index->path));
+}
+
+static bool get_file_info(const char *path, uint64_t *size, uint64_t *mtime)
+{
+	struct stat st;
+
+	if (os_stat(path, &st) != 0)
+		return false;
+
+	*size = (uint64_t)st.st_size;
+	*mtime = (uint64_t)st.st_mtime;
+	return true;
+}
+
+static bool s_rl64(struct serializer *s, uint64_t *val)
+{
+	uint8_t data[8];
+
+	if (s_read(s, data, sizeof(data)) != sizeof(data))
+		return false;
+
+	*val = 0;
+	for (size_t i = sizeof(data); i > 0; i--)
+		*val = (*val << 8) | data[i - 1];
+	return true;
+}
+
+/* the cache is only used if it was made for the same file, at the same size
+ * and modification time, and for the same stream */
+static bool mp_index_load(struct mp_index *index, uint64_t size,
+			  uint64_t mtime)
+{
+	struct serializer s;
+	struct dstr file = {0};
+	char magic[sizeof(INDEX_MAGIC) - 1];
+	uint64_t val[4];
+	char *path = NULL;
+	bool success = false;
+
+	get_cache_file(index, &file);
+	if (!file_input_serializer_init(&s, file.array)) {
+		dstr_free(&file);
+		return false;
+	}
+
+	if (s_read(&s, magic, sizeof(magic)) != sizeof(magic) ||
+	    memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0)
+		goto fail;
+
+	for (size_t i = 0; i < 4; i++) {
+		if (!s_rl64(&s, &val[i]))
+			goto fail;
+	}
+
+	if (val[0] != size || val[1] != mtime ||
+	    val[2] != (uint64_t)index->stream_index ||
+	    val[3] != strlen(index->path))
+		goto fail;
+
+	path = bzalloc((size_t)val[3] + 1);
+	if (s_read(&s, path, (size_t)val[3]) != val[3] ||
+	    strcmp(path, index->path) != 0)
+		goto fail;
+
+	if (!s_rl64(&s, &val[0]))
+		goto fail;
+
+	for (uint64_t i = 0; i < val[0]; i++) {
+		struct mp_index_entry entry;
+
+		if (!s_rl64(&s, (uint64_t *)&entry.ts) ||
+		    !s_rl64(&s, (uint64_t *)&entry.pos))
+			goto fail;
+
+		da_push_back(index->entries, &entry);
+	}
+
+	success = true;
+
+fail:
+	if (!success)
+		da_free(index->entries);
+
+	bfree(path);
+	file_input_serializer_free(&s);
+	dstr_free(&file);
+	return success;
+}
+
+static void mp_index_save(struct mp_index *index, uint64_t size,
+			  uint64_t mtime)
+{
+	struct serializer s;
+	struct dstr file = {0};
+	size_t path_len = strlen(index->path);
+
+	if (os_mkdirs(index->cache_dir) == MKDIR_ERROR) {
+		blog(LOG_WARNING, "MP: Failed to create index cache dir '%s'",
+		     index->cache_dir);
+		return;
+	}
+
+	get_cache_file(index, &file);
+	if (!file_output_serializer_init_safe(&s, file.array, "tmp")) {
+		blog(LOG_WARNING, "MP: Failed to write index cache '%s'",
+		     file.array);
+		dstr_free(&file);
+		return;
+	}
+
+	s_write(&s, INDEX_MAGIC, sizeof(INDEX_MAGIC) - 1);
+	s_wl64(&s, size);
+	s_wl64(&s, mtime);
+	s_wl64(&s, (uint64_t)index->stream_index);
+	s_wl64(&s, (uint64_t)path_len);
+	s_write(&s, index->path, path_len);
+	s_wl64(&s, (uint64_t)index->entries.num);
+
+	for (size_t i = 0; i < index->entries.num; i++) {
+		s_wl64(&s, (uint64_t)index->entries.array[i].ts);
+		s_wl64(&s, (uint64_t)index->entries.array[i].pos);
+	}
+
+	file_output_serializer_free(&s);
+	dstr_free(&file);
+}
+
+/* ------------------------------------------------------------------------- */
+/* index thread                                                              */
+
+static int cmp_entries(const void *a, const void *b)
+{
+	const struct mp_index_entry *ea = a;
+	const struct mp_index_entry *eb = b;
+
+	return ea->ts < eb->ts ? -1 : (ea->ts > eb->ts ? 1 : 0);
+}
+
+/* reads every packet of the indexed stream on a separate demuxer, so the
+ * playback position isn't affected */
+static bool mp_index_build(struct mp_index *index)
+{
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(59, 0, 100)
+	AVInputFormat *format = NULL;
+#else
+	const AVInputFormat *format = NULL;
+#endif
+	AVFormatContext *fmt = NULL;
+	AVPacket *pkt = NULL;
+	int ret;
+
+	if (index->format_name && *index->format_name)
+		format = av_find_input_format(index->format_name);
+
+	ret = avformat_open_input(&fmt, index->path, format, NULL);
+	if (ret < 0 || index->stream_index >= (int)fmt->nb_streams)
+		goto fail;
+
+	for (unsigned int i = 0; i < fmt->nb_streams; i++) {
+		if ((int)i != index->stream_index)
+			fmt->streams[i]->discard = AVDISCARD_ALL;
+	}
+
+	pkt = av_packet_alloc();
+
+	while ((ret = av_read_frame(fmt, pkt)) >= 0) {
+		if (os_atomic_load_bool(&index->stop)) {
+			av_packet_unref(pkt);
+			goto fail;
+		}
+
+		int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+		if (pkt->stream_index == index->stream_index &&
+		    (pkt->flags & AV_PKT_FLAG_KEY) && ts != AV_NOPTS_VALUE) {
+			struct mp_index_entry *entry =
+				da_push_back_new(index->entries);
+			entry->ts = ts;
+			entry->pos = pkt->pos;
+		}
+
+		av_packet_unref(pkt);
+	}
+
+	if (ret != AVERROR_EOF || !index->entries.num)
+		goto fail;
+
+	qsort(index->entries.array, index->entries.num,
+	      sizeof(struct mp_index_entry), cmp_entries);
+
+	av_packet_free(&pkt);
+	avformat_close_input(&fmt);
+	return true;
+
+fail:
+	da_free(index->entries);
+	av_packet_free(&pkt);
+	avformat_close_input(&fmt);
+	return false;
+}
+
+/* reads the range in to the system's file cache, so that seeking around the
+ * current position while paused doesn't have to wait on the disk */
+static void mp_index_prefetch_range(struct mp_index *index, int64_t start,
+				    int64_t end)
+{
+	FILE *file = os_fopen(index->path, "rb");
+	uint8_t *buf;
+
+	if (!file)
+		return;
+	if (os_fseeki64(file, start, SEEK_SET) != 0) {
+		fclose(file);
+		return;
+	}
+
+	buf = bmalloc(PREFETCH_CHUNK_SIZE);
+
+	while (start < end && !os_atomic_load_bool(&index->stop)) {
+		size_t size = PREFETCH_CHUNK_SIZE;
+		if ((int64_t)size > end - start)
+			size = (size_t)(end - start);
+
+		size = fread(buf, 1, size, file);
+		if (!size)
+			break;
+
+		start += (int64_t)size;
+	}
+
+	bfree(buf);
+	fclose(file);
+}
+
+static void *mp_index_thread(void *opaque)
+{
+	struct mp_index *index = opaque;
+	uint64_t size = 0;
+	uint64_t mtime = 0;
+	bool have_info;
+	bool success;
+	uint64_t start_time;
+
+	os_set_thread_name("mp_index_thread");
+
+	start_time = os_gettime_ns();
+	have_info = get_file_info(index->path, &size, &mtime);
+	success = have_info && index->cache_dir &&
+		  mp_index_load(index, size, mtime);
+
+	if (success) {
+		blog(LOG_DEBUG, "MP: Loaded keyframe index of '%s' from cache",
+		     index->path);
+
+	} else if (mp_index_build(index)) {
+		blog(LOG_INFO,
+		     "MP: Indexed %zu keyframes of '%s' in %" PRIu64 " ms",
+		     index->entries.num, index->path,
+		     (os_gettime_ns() - start_time) / 1000000);
+
+		if (have_info && index->cache_dir)
+			mp_index_save(index, size, mtime);
+		success = true;
+	}
+
+	if (!success)
+		return NULL;
+
+	pthread_mutex_lock(&index->mutex);
+	index->ready = true;
+	pthread_mutex_unlock(&index->mutex);
+
+	for (;;) {
+		int64_t start;
+		int64_t end;
+
+		if (os_sem_wait(index->sem) < 0 ||
+		    os_atomic_load_bool(&index->stop))
+			break;
+
+		pthread_mutex_lock(&index->mutex);
+		start = index->prefetch_start;
+		end = index->prefetch_end;
+		index->prefetch_start = -1;
+		index->prefetch_end = -1;
+		pthread_mutex_unlock(&index->mutex);
+
+		if (start >= 0 && end > start)
+			mp_index_prefetch_range(index, start, end);
+	}
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void mp_index_init(struct mp_index *index, const char *path,
+		   const char *format_name, const char *cache_dir,
+		   int stream_index)
+{
+	memset(index, 0, sizeof(*index));
+	pthread_mutex_init(&index->mutex, NULL);
+	index->path = bstrdup(path);
+	index->format_name = format_name ? bstrdup(format_name) : NULL;
+	index->cache_dir = cache_dir ? bstrdup(cache_dir) : NULL;
+	index->stream_index = stream_index;
+	index->prefetch_start = -1;
+	index->prefetch_end = -1;
+}
+
+void mp_index_free(struct mp_index *index)
+{
+	if (index->thread_valid) {
+		os_atomic_set_bool(&index->stop, true);
+		os_sem_post(index->sem);
+		pthread_join(index->thread, NULL);
+	}
+
+	os_sem_destroy(index->sem);
+	pthread_mutex_destroy(&index->mutex);
+	da_free(index->entries);
+	bfree(index->path);
+	bfree(index->format_name);
+	bfree(index->cache_dir);
+	memset(index, 0, sizeof(*index));
+}
+
+/* starts building (or loading) the index, if it hasn't been already */
+void mp_index_start(struct mp_index *index)
+{
+	if (!index->path || index->thread_valid)
+		return;
+
+	if (os_sem_init(&index->sem, 0) != 0)
+		return;
+
+	if (pthread_create(&index->thread, NULL, mp_index_thread, index) != 0) {
+		blog(LOG_WARNING, "MP: Failed to create index thread");
+		os_sem_destroy(index->sem);
+		index->sem = NULL;
+		bfree(index->path);
+		index->path = NULL;
+		return;
+	}
+
+	index->thread_valid = true;
+}
+
+static size_t find_entry(struct mp_index *index, int64_t ts)
+{
+	size_t lo = 0;
+	size_t hi = index->entries.num;
+
+	/* last entry at or before ts, or the first entry */
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (index->entries.array[mid].ts <= ts)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* finds the keyframe to seek to for ts, in the stream's time base.  returns
+ * false while the index isn't ready yet */
+bool mp_index_find(struct mp_index *index, int64_t ts,
+		   struct mp_index_entry *entry)
+{
+	bool ready;
+
+	if (!index->thread_valid)
+		return false;
+
+	pthread_mutex_lock(&index->mutex);
+	ready = index->ready;
+	pthread_mutex_unlock(&index->mutex);
+
+	if (!ready)
+		return false;
+
+	*entry = index->entries.array[find_entry(index, ts)];
+	return true;
+}
+
+/* reads the keyframe intervals around ts ahead of time, which is where the
+ * next seek is likely to go when scrubbing */
+void mp_index_prefetch(struct mp_index *index, int64_t ts)
+{
+	struct mp_index_entry *entries = index->entries.array;
+	size_t num = index->entries.num;
+	int64_t start;
+	int64_t end;
+	size_t idx;
+	bool ready;
+
+	if (!index->thread_valid)
+		return;
+
+	pthread_mutex_lock(&index->mutex);
+	ready = index->ready;
+	pthread_mutex_unlock(&index->mutex);
+
+	if (!ready)
+		return;
+
+	idx = find_entry(index, ts);
+	start = entries[idx > 0 ? idx - 1 : 0].pos;
+	end = idx + 2 < num ? entries[idx + 2].pos
+			    : entries[idx].pos + MAX_PREFETCH_SIZE;
+
+	if (start < 0 || end <= start)
+		return;
+	if (end - start > MAX_PREFETCH_SIZE)
+		end = start + MAX_PREFETCH_SIZE;
+
+	pthread_mutex_lock(&index->mutex);
+	index->prefetch_start = start;
+	index->prefetch_end = end;
+	pthread_mutex_unlock(&index->mutex);
+
+	os_sem_post(index->sem);
+}
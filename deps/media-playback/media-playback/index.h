@@ -0,0 +1,51 @@
+#pragma once
+
+#include <util/threading.h>
+#include <util/darray.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct mp_index_entry {
+	int64_t ts;  /* stream time base */
+	int64_t pos; /* byte offset in the file, -1 if unknown */
+};
+
+/* keyframe index of a local file, used to seek straight to the keyframe
+ * before a position.  the index is built on its own thread the first time
+ * the file is seeked, and stored in cache_dir so it can be reused the next
+ * time the file is opened */
+struct mp_index {
+	char *path;
+	char *format_name;
+	char *cache_dir;
+	int stream_index;
+
+	pthread_t thread;
+	bool thread_valid;
+	os_sem_t *sem;
+
+	pthread_mutex_t mutex;
+	DARRAY(struct mp_index_entry) entries;
+	bool ready;
+	bool stop;
+
+	/* byte range to read ahead while paused, -1 if none */
+	int64_t prefetch_start;
+	int64_t prefetch_end;
+};
+
+extern void mp_index_init(struct mp_index *index, const char *path,
+			  const char *format_name, const char *cache_dir,
+			  int stream_index);
+extern void mp_index_free(struct mp_index *index);
+
+extern void mp_index_start(struct mp_index *index);
+extern bool mp_index_find(struct mp_index *index, int64_t ts,
+			  struct mp_index_entry *entry);
+extern void mp_index_prefetch(struct mp_index *index, int64_t ts);
+
+#ifdef __cplusplus
+}
+#endif
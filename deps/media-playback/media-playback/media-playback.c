@@ -13,10 +13,17 @@ struct media_playback {
 media_playback_t *media_playback_create(const struct mp_media_info *info)
 {
 	media_playback_t *mp = bzalloc(sizeof(*mp));
-	mp->is_cached = info->is_local_file && info->full_decode;
+	struct mp_media_info media_info = *info;
+
+	/* the compressed cache keeps packets instead of decoded frames in
+	 * memory, and decodes them during playback like any other file */
+	if (info->is_local_file && info->compressed_cache)
+		media_info.full_decode = false;
+
+	mp->is_cached = info->is_local_file && media_info.full_decode;
 
 	if ((mp->is_cached && !mp_cache_init(&mp->cache, info)) ||
-	    (!mp->is_cached && !mp_media_init(&mp->media, info))) {
+	    (!mp->is_cached && !mp_media_init(&mp->media, &media_info))) {
 		bfree(mp);
 		return NULL;
 	}
@@ -142,3 +149,23 @@ bool media_playback_has_audio(media_playback_t *mp)
 	else
 		return mp->media.has_audio;
 }
+
+void media_playback_get_stats(media_playback_t *mp,
+			      struct media_playback_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	/* fully decoded files have nothing left to read ahead */
+	if (mp && !mp->is_cached)
+		mp_media_get_stats(&mp->media, stats);
+}
+
+void media_playback_set_cache_budget(size_t bytes)
+{
+	mp_cache_set_memory_budget(bytes);
+}
+
+void media_playback_free_unused_cache(void)
+{
+	mp_cache_free_unused();
+}
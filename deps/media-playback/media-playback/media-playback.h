@@ -30,6 +30,20 @@ struct mp_media_info {
 	bool reconnecting;
 	bool request_preload;
 	bool full_decode;
+	bool compressed_cache;
+
+	/* where keyframe indexes are kept.  local files are only indexed for
+	 * seeking when this is set */
+	const char *index_cache_dir;
+};
+
+/* read-ahead state of the decode pipeline that local files are played
+ * with */
+struct media_playback_stats {
+	size_t video_frames_queued;
+	size_t audio_frames_queued;
+	size_t packets_queued;
+	bool pipelined;
 };
 
 extern media_playback_t *
@@ -47,3 +61,11 @@ extern int64_t media_playback_get_frames(media_playback_t *mp);
 extern int64_t media_playback_get_duration(media_playback_t *mp);
 extern bool media_playback_has_video(media_playback_t *mp);
 extern bool media_playback_has_audio(media_playback_t *mp);
+extern void media_playback_get_stats(media_playback_t *mp,
+				     struct media_playback_stats *stats);
+
+/* fully decoded local files are shared between all media playback instances
+ * that use the same file and options.  unused files are kept in memory until
+ * the budget is exceeded */
+extern void media_playback_set_cache_budget(size_t bytes);
+extern void media_playback_free_unused_cache(void);
@@ -169,25 +169,122 @@ static inline struct mp_decode *get_packet_decoder(mp_media_t *media,
 void mp_media_free_packet(struct mp_media *media, AVPacket *pkt)
 {
 	av_packet_unref(pkt);
+
+	pthread_mutex_lock(&media->packet_pool_mutex);
 	da_push_back(media->packet_pool, &pkt);
+	pthread_mutex_unlock(&media->packet_pool_mutex);
+}
+
+/* called by the decode threads whenever they take a packet, which may make
+ * room for the demux thread to read ahead further */
+void mp_media_packet_consumed(struct mp_media *media)
+{
+	os_sem_post(media->demux_space);
+}
+
+static void mp_media_free_cached_packets(mp_media_t *m)
+{
+	for (size_t i = 0; i < m->cached_packets.num; i++)
+		av_packet_free(&m->cached_packets.array[i]);
+	da_free(m->cached_packets);
+	da_free(m->keyframes);
+	m->cached_packet_idx = 0;
+	m->cached_size = 0;
+}
+
+/* demuxes the whole file in to memory, indexing the keyframes of the video
+ * stream (or the audio stream if there is no video) for seeking */
+static bool mp_media_load_packets(mp_media_t *m)
+{
+	AVStream *seek_stream = m->has_video ? m->v.stream : m->a.stream;
+	AVPacket *pkt = av_packet_alloc();
+	int ret;
+
+	while ((ret = av_read_frame(m->fmt, pkt)) >= 0) {
+		if (!pkt->size || !get_packet_decoder(m, pkt) ||
+		    (!pkt->buf && av_packet_make_refcounted(pkt) < 0)) {
+			av_packet_unref(pkt);
+			continue;
+		}
+
+		int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+		if (pkt->stream_index == seek_stream->index &&
+		    (pkt->flags & AV_PKT_FLAG_KEY) && ts != AV_NOPTS_VALUE) {
+			struct mp_keyframe *kf = da_push_back_new(m->keyframes);
+			kf->ts = av_rescale_q(ts, seek_stream->time_base,
+					      AV_TIME_BASE_Q);
+			kf->idx = m->cached_packets.num;
+		}
+
+		m->cached_size += pkt->size;
+		da_push_back(m->cached_packets, &pkt);
+		pkt = av_packet_alloc();
+	}
+
+	av_packet_free(&pkt);
+
+	if (ret != AVERROR_EOF) {
+		blog(LOG_WARNING,
+		     "MP: Failed to load '%s' in to memory, reading from "
+		     "file instead: %s",
+		     m->path, av_err2str(ret));
+		mp_media_free_cached_packets(m);
+		return false;
+	}
+
+	blog(LOG_INFO,
+	     "MP: Loaded %zu packets (%.1f MB, %zu keyframes) of '%s' in to "
+	     "memory",
+	     m->cached_packets.num, (double)m->cached_size / 1048576.0,
+	     m->keyframes.num, m->path);
+	return true;
+}
+
+static int mp_media_read_cached_packet(mp_media_t *m, AVPacket *pkt)
+{
+	if (m->cached_packet_idx == m->cached_packets.num)
+		return AVERROR_EOF;
+
+	return av_packet_ref(pkt,
+			     m->cached_packets.array[m->cached_packet_idx++]);
+}
+
+static size_t mp_media_find_cached_keyframe(mp_media_t *m, int64_t ts)
+{
+	size_t idx = 0;
+
+	for (size_t i = 0; i < m->keyframes.num; i++) {
+		if (m->keyframes.array[i].ts > ts)
+			break;
+		idx = m->keyframes.array[i].idx;
+	}
+
+	return idx;
 }
 
 static int mp_media_next_packet(mp_media_t *media)
 {
-	AVPacket *pkt;
+	AVPacket *pkt = NULL;
+
+	pthread_mutex_lock(&media->packet_pool_mutex);
 	AVPacket **const cached = da_end(media->packet_pool);
 	if (cached) {
 		pkt = *cached;
 		da_pop_back(media->packet_pool);
-	} else {
-		pkt = av_packet_alloc();
 	}
+	pthread_mutex_unlock(&media->packet_pool_mutex);
+
+	if (!pkt)
+		pkt = av_packet_alloc();
 
-	int ret = av_read_frame(media->fmt, pkt);
+	int ret = media->compressed_cache
+			  ? mp_media_read_cached_packet(media, pkt)
+			  : av_read_frame(media->fmt, pkt);
 	if (ret < 0) {
 		if (ret != AVERROR_EOF && ret != AVERROR_EXIT)
 			blog(LOG_WARNING, "MP: av_read_frame failed: %s (%d)",
 			     av_err2str(ret), ret);
+		mp_media_free_packet(media, pkt);
 		return ret;
 	}
 
@@ -201,6 +298,127 @@ static int mp_media_next_packet(mp_media_t *media)
 	return ret;
 }
 
+/* ------------------------------------------------------------------------- */
+/* decode pipeline                                                           */
+
+/* the demux thread stops reading ahead once this many packets are queued,
+ * unless one of the streams has run out of packets, as with interleaved
+ * files the next packet for that stream may be behind all the others */
+#define MAX_QUEUED_PACKETS 64
+
+static inline size_t mp_media_queued_packets(mp_media_t *m, bool *starving)
+{
+	size_t v = m->has_video ? mp_decode_queued_packets(&m->v) : 0;
+	size_t a = m->has_audio ? mp_decode_queued_packets(&m->a) : 0;
+
+	*starving = (m->has_video && !v) || (m->has_audio && !a);
+	return v + a;
+}
+
+static bool mp_media_wait_for_space(mp_media_t *m)
+{
+	for (;;) {
+		bool starving;
+		size_t queued;
+
+		if (os_atomic_load_bool(&m->demux_stop))
+			return false;
+
+		queued = mp_media_queued_packets(m, &starving);
+		if (starving || queued < MAX_QUEUED_PACKETS)
+			return true;
+
+		if (os_sem_wait(m->demux_space) < 0)
+			return false;
+	}
+}
+
+static void *mp_media_demux_thread(void *opaque)
+{
+	mp_media_t *m = opaque;
+
+	os_set_thread_name("mp_media_demux");
+
+	while (mp_media_wait_for_space(m)) {
+		int ret = mp_media_next_packet(m);
+		if (ret < 0) {
+			if (m->has_video)
+				mp_decode_set_input_eof(&m->v);
+			if (m->has_audio)
+				mp_decode_set_input_eof(&m->a);
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static void mp_media_stop_pipeline(mp_media_t *m)
+{
+	if (!m->pipeline_active)
+		return;
+
+	os_atomic_set_bool(&m->demux_stop, true);
+	os_sem_post(m->demux_space);
+	pthread_join(m->demux_thread, NULL);
+
+	mp_decode_stop_thread(&m->v);
+	mp_decode_stop_thread(&m->a);
+
+	os_sem_destroy(m->demux_space);
+	m->demux_space = NULL;
+	m->pipeline_active = false;
+}
+
+/* starts reading and decoding ahead from the current position.  if any of
+ * the threads can't be created, the file is played from the media thread
+ * alone as before */
+static void mp_media_start_pipeline(mp_media_t *m)
+{
+	if (!m->pipelined || m->pipeline_active)
+		return;
+
+	if (os_sem_init(&m->demux_space, 0) != 0)
+		goto fail;
+	if (m->has_video && !mp_decode_start_thread(&m->v))
+		goto fail;
+	if (m->has_audio && !mp_decode_start_thread(&m->a))
+		goto fail;
+
+	os_atomic_set_bool(&m->demux_stop, false);
+	if (pthread_create(&m->demux_thread, NULL, mp_media_demux_thread, m) !=
+	    0)
+		goto fail;
+
+	m->pipeline_active = true;
+	return;
+
+fail:
+	blog(LOG_WARNING, "MP: Failed to start decode pipeline for '%s', "
+			  "decoding on the media thread instead",
+	     m->path);
+	mp_decode_stop_thread(&m->v);
+	mp_decode_stop_thread(&m->a);
+	os_sem_destroy(m->demux_space);
+	m->demux_space = NULL;
+	m->pipelined = false;
+}
+
+void mp_media_get_stats(mp_media_t *m, struct media_playback_stats *stats)
+{
+	bool starving;
+
+	stats->pipelined = m->pipeline_active;
+	if (!stats->pipelined)
+		return;
+
+	if (m->has_video)
+		stats->video_frames_queued = mp_decode_queued_frames(&m->v);
+	if (m->has_audio)
+		stats->audio_frames_queued = mp_decode_queued_frames(&m->a);
+	stats->packets_queued = mp_media_queued_packets(m, &starving);
+}
+
 static inline bool mp_media_ready_to_start(mp_media_t *m)
 {
 	if (m->has_audio && !m->a.eof && !m->a.frame_ready)
@@ -275,10 +493,17 @@ static bool mp_media_init_scaling(mp_media_t *m)
 	return true;
 }
 
-bool mp_media_prepare_frames(mp_media_t *m)
+static bool mp_media_decode_frames(mp_media_t *m)
 {
 	bool actively_seeking = m->seek_next_ts && m->pause;
 
+	if (m->pipeline_active) {
+		if (m->has_video && !mp_decode_wait_frame(&m->v))
+			return false;
+		if (m->has_audio && !mp_decode_wait_frame(&m->a))
+			return false;
+	}
+
 	while (!mp_media_ready_to_start(m)) {
 		if (!m->eof) {
 			int ret = mp_media_next_packet(m);
@@ -299,6 +524,41 @@ bool mp_media_prepare_frames(mp_media_t *m)
 			return false;
 	}
 
+	return true;
+}
+
+/* drops the frames that end before the seek target, so a seek shows the
+ * frame at the requested time rather than the keyframe before it */
+static bool mp_media_skip_frames(mp_media_t *m)
+{
+	bool skipped = false;
+
+	if (m->has_video && m->v.frame_ready &&
+	    m->v.next_pts <= m->seek_target_ns) {
+		m->v.frame_ready = false;
+		skipped = true;
+	}
+	if (m->has_audio && m->a.frame_ready &&
+	    m->a.next_pts <= m->seek_target_ns) {
+		m->a.frame_ready = false;
+		skipped = true;
+	}
+
+	if (!skipped)
+		m->seek_target_ns = 0;
+	return skipped;
+}
+
+bool mp_media_prepare_frames(mp_media_t *m)
+{
+	if (!mp_media_decode_frames(m))
+		return false;
+
+	while (m->seek_target_ns && mp_media_skip_frames(m)) {
+		if (!mp_media_decode_frames(m))
+			return false;
+	}
+
 	if (m->has_video && m->v.frame_ready && !m->swscale) {
 		m->scale_format = closest_format(m->v.frame->format);
 		if (m->scale_format != m->v.frame->format) {
@@ -534,6 +794,36 @@ static void mp_media_calc_next_ns(mp_media_t *m)
 	m->next_pts_ns = min_next_ns;
 }
 
+/* seeks straight to the indexed keyframe before pos on the video stream,
+ * instead of leaving it to the demuxer, which may land well before it on
+ * files without an index of their own */
+static bool mp_media_seek_indexed(mp_media_t *m, int64_t pos)
+{
+	struct mp_index_entry entry;
+	AVStream *stream = m->v.stream;
+	int ret;
+
+	if (!m->has_video)
+		return false;
+
+	/* the index is only built once the file is seeked by the user */
+	if (m->seek_next_ts)
+		mp_index_start(&m->index);
+
+	if (!mp_index_find(&m->index,
+			   av_rescale_q(pos, AV_TIME_BASE_Q, stream->time_base),
+			   &entry))
+		return false;
+
+	ret = av_seek_frame(m->fmt, stream->index, entry.ts,
+			    AVSEEK_FLAG_BACKWARD);
+	if (ret < 0 && entry.pos >= 0 &&
+	    !(m->fmt->iformat->flags & AVFMT_NO_BYTE_SEEK))
+		ret = av_seek_frame(m->fmt, -1, entry.pos, AVSEEK_FLAG_BYTE);
+
+	return ret >= 0;
+}
+
 static void seek_to(mp_media_t *m, int64_t pos)
 {
 	AVStream *stream = m->fmt->streams[0];
@@ -550,7 +840,11 @@ static void seek_to(mp_media_t *m, int64_t pos)
 						     stream->time_base)
 				      : seek_pos;
 
-	if (m->is_local_file) {
+	mp_media_stop_pipeline(m);
+
+	if (m->is_local_file && m->compressed_cache) {
+		m->cached_packet_idx = mp_media_find_cached_keyframe(m, pos);
+	} else if (m->is_local_file && !mp_media_seek_indexed(m, pos)) {
 		int ret = av_seek_frame(m->fmt, 0, seek_target, seek_flags);
 		if (ret < 0) {
 			blog(LOG_WARNING, "MP: Failed to seek: %s",
@@ -558,14 +852,33 @@ static void seek_to(mp_media_t *m, int64_t pos)
 		}
 	}
 
+	m->seek_target_ns = m->seek_next_ts && m->is_local_file
+				    ? av_rescale(pos, 1000 * 100, m->speed)
+				    : 0;
+
+	if (m->pipelined) {
+		if (m->has_video)
+			mp_decode_flush(&m->v);
+		if (m->has_audio)
+			mp_decode_flush(&m->a);
+
+		mp_media_start_pipeline(m);
+	}
+
 	if (m->has_video && m->is_local_file) {
-		mp_decode_flush(&m->v);
+		if (!m->pipeline_active)
+			mp_decode_flush(&m->v);
 		if (m->seek_next_ts && m->pause && m->v_preload_cb &&
 		    mp_media_prepare_frames(m))
 			mp_media_next_video(m, true);
 	}
-	if (m->has_audio && m->is_local_file)
+	if (m->has_audio && m->is_local_file && !m->pipeline_active)
 		mp_decode_flush(&m->a);
+
+	if (m->seek_next_ts && m->pause && m->has_video)
+		mp_index_prefetch(&m->index,
+				  av_rescale_q(pos, AV_TIME_BASE_Q,
+					       m->v.stream->time_base));
 }
 
 bool mp_media_reset(mp_media_t *m)
@@ -775,6 +1088,12 @@ static inline bool mp_media_thread(mp_media_t *m)
 	if (!mp_media_init2(m)) {
 		return false;
 	}
+	if (m->compressed_cache && !mp_media_load_packets(m))
+		m->compressed_cache = false;
+	if (m->is_local_file && m->has_video && !m->compressed_cache &&
+	    m->index_cache_dir)
+		mp_index_init(&m->index, m->path, m->format_name,
+			      m->index_cache_dir, m->v.stream->index);
 	if (!mp_media_reset(m)) {
 		return false;
 	}
@@ -881,6 +1200,10 @@ static inline bool mp_media_init_internal(mp_media_t *m,
 		blog(LOG_WARNING, "MP: Failed to init mutex");
 		return false;
 	}
+	if (pthread_mutex_init(&m->packet_pool_mutex, NULL) != 0) {
+		blog(LOG_WARNING, "MP: Failed to init mutex");
+		return false;
+	}
 	if (os_sem_init(&m->sem, 0) != 0) {
 		blog(LOG_WARNING, "MP: Failed to init semaphore");
 		return false;
@@ -906,6 +1229,7 @@ bool mp_media_init(mp_media_t *media, const struct mp_media_info *info)
 {
 	memset(media, 0, sizeof(*media));
 	pthread_mutex_init_value(&media->mutex);
+	pthread_mutex_init_value(&media->packet_pool_mutex);
 	media->opaque = info->opaque;
 	media->v_cb = info->v_cb;
 	media->a_cb = info->a_cb;
@@ -919,6 +1243,11 @@ bool mp_media_init(mp_media_t *media, const struct mp_media_info *info)
 	media->speed = info->speed;
 	media->request_preload = info->request_preload;
 	media->is_local_file = info->is_local_file;
+	media->compressed_cache = info->is_local_file && info->compressed_cache;
+	media->index_cache_dir = info->index_cache_dir
+					 ? bstrdup(info->index_cache_dir)
+					 : NULL;
+	media->pipelined = info->is_local_file;
 	da_init(media->packet_pool);
 
 	if (!info->is_local_file || media->speed < 1 || media->speed > 200)
@@ -965,20 +1294,26 @@ void mp_media_free(mp_media_t *media)
 
 	mp_media_stop(media);
 	mp_kill_thread(media);
+	mp_media_stop_pipeline(media);
+	mp_index_free(&media->index);
 	mp_decode_free(&media->v);
 	mp_decode_free(&media->a);
 	for (size_t i = 0; i < media->packet_pool.num; i++)
 		av_packet_free(&media->packet_pool.array[i]);
 	da_free(media->packet_pool);
+	mp_media_free_cached_packets(media);
 	avformat_close_input(&media->fmt);
 	pthread_mutex_destroy(&media->mutex);
+	pthread_mutex_destroy(&media->packet_pool_mutex);
 	os_sem_destroy(media->sem);
 	sws_freeContext(media->swscale);
 	av_freep(&media->scale_pic[0]);
 	bfree(media->path);
 	bfree(media->format_name);
+	bfree(media->index_cache_dir);
 	memset(media, 0, sizeof(*media));
 	pthread_mutex_init_value(&media->mutex);
+	pthread_mutex_init_value(&media->packet_pool_mutex);
 }
 
 void mp_media_play(mp_media_t *m, bool loop, bool reconnecting)
@@ -18,6 +18,7 @@
 
 #include <obs.h>
 #include "decode.h"
+#include "index.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -38,6 +39,11 @@ extern "C" {
 #pragma warning(pop)
 #endif
 
+struct mp_keyframe {
+	int64_t ts; /* AV_TIME_BASE */
+	size_t idx;
+};
+
 struct mp_media {
 	AVFormatContext *fmt;
 
@@ -60,6 +66,7 @@ struct mp_media {
 	uint8_t *scale_pic[4];
 
 	DARRAY(AVPacket *) packet_pool;
+	pthread_mutex_t packet_pool_mutex;
 	struct mp_decode v;
 	struct mp_decode a;
 	bool request_preload;
@@ -84,6 +91,27 @@ struct mp_media {
 	int64_t base_ts;
 	bool full_decode;
 
+	/* with compressed_cache, all demuxed packets of a local file are kept
+	 * in memory and read from there instead of the file */
+	bool compressed_cache;
+	DARRAY(AVPacket *) cached_packets;
+	DARRAY(struct mp_keyframe) keyframes;
+	size_t cached_packet_idx;
+	size_t cached_size;
+
+	/* keyframe index used for seeking other local files */
+	struct mp_index index;
+	char *index_cache_dir;
+	int64_t seek_target_ns;
+
+	/* for local files, packets are read ahead on the demux thread and each
+	 * stream is decoded on its own thread */
+	bool pipelined;
+	bool pipeline_active;
+	bool demux_stop;
+	pthread_t demux_thread;
+	os_sem_t *demux_space;
+
 	uint64_t interrupt_poll_ts;
 
 	pthread_mutex_t mutex;
@@ -118,6 +146,8 @@ extern int64_t mp_media_get_current_time(mp_media_t *m);
 extern int64_t mp_media_get_frames(mp_media_t *m);
 extern int64_t mp_media_get_duration(mp_media_t *m);
 extern void mp_media_seek(mp_media_t *m, int64_t pos);
+extern void mp_media_get_stats(mp_media_t *m,
+			       struct media_playback_stats *stats);
 
 /* #define DETAILED_DEBUG_INFO */
 
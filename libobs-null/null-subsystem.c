@@ -0,0 +1,843 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <inttypes.h>
+#include <util/base.h>
+#include <util/bmem.h>
+#include <graphics/matrix3.h>
+
+#include "null-subsystem.h"
+
+const char *device_get_name(void)
+{
+	return "Null";
+}
+
+/* shaders are parsed but never translated, so the GL flavor of the effects
+ * is used, as that's what the headless setups this is meant for run */
+int device_get_type(void)
+{
+	return GS_DEVICE_OPENGL;
+}
+
+const char *device_preprocessor_name(void)
+{
+	return "_OPENGL";
+}
+
+int device_create(gs_device_t **p_device, uint32_t adapter)
+{
+	struct gs_device *device = bzalloc(sizeof(struct gs_device));
+
+	blog(LOG_INFO, "---------------------------------");
+	blog(LOG_INFO, "Initializing null graphics (no rendering)...");
+
+	device->cur_color_space = GS_CS_SRGB;
+	matrix4_identity(&device->cur_proj);
+
+	*p_device = device;
+	UNUSED_PARAMETER(adapter);
+	return GS_SUCCESS;
+}
+
+void device_destroy(gs_device_t *device)
+{
+	if (!device)
+		return;
+
+	blog(LOG_INFO, "Null graphics: %" PRIu64 " frames, %" PRIu64
+		       " draw calls",
+	     device->frames, device->draw_calls);
+
+	da_free(device->proj_stack);
+	bfree(device);
+}
+
+void device_enter_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_leave_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void *device_get_device_obj(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+	return NULL;
+}
+
+gs_swapchain_t *device_swapchain_create(gs_device_t *device,
+					const struct gs_init_data *info)
+{
+	struct gs_swap_chain *swap = bzalloc(sizeof(struct gs_swap_chain));
+	swap->device = device;
+	swap->info = *info;
+	return swap;
+}
+
+void gs_swapchain_destroy(gs_swapchain_t *swapchain)
+{
+	if (!swapchain)
+		return;
+
+	if (swapchain->device->cur_swap == swapchain)
+		device_load_swapchain(swapchain->device, NULL);
+
+	bfree(swapchain);
+}
+
+void device_resize(gs_device_t *device, uint32_t cx, uint32_t cy)
+{
+	if (!device->cur_swap)
+		return;
+
+	device->cur_swap->info.cx = cx;
+	device->cur_swap->info.cy = cy;
+}
+
+enum gs_color_space device_get_color_space(gs_device_t *device)
+{
+	return device->cur_color_space;
+}
+
+void device_update_color_space(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_get_size(const gs_device_t *device, uint32_t *cx, uint32_t *cy)
+{
+	if (device->cur_swap) {
+		*cx = device->cur_swap->info.cx;
+		*cy = device->cur_swap->info.cy;
+	} else {
+		*cx = 0;
+		*cy = 0;
+	}
+}
+
+uint32_t device_get_width(const gs_device_t *device)
+{
+	return device->cur_swap ? device->cur_swap->info.cx : 0;
+}
+
+uint32_t device_get_height(const gs_device_t *device)
+{
+	return device->cur_swap ? device->cur_swap->info.cy : 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+gs_zstencil_t *device_zstencil_create(gs_device_t *device, uint32_t width,
+				      uint32_t height,
+				      enum gs_zstencil_format format)
+{
+	struct gs_zstencil_buffer *zs =
+		bzalloc(sizeof(struct gs_zstencil_buffer));
+	zs->device = device;
+	zs->format = format;
+	zs->width = width;
+	zs->height = height;
+	return zs;
+}
+
+void gs_zstencil_destroy(gs_zstencil_t *zs)
+{
+	bfree(zs);
+}
+
+gs_samplerstate_t *
+device_samplerstate_create(gs_device_t *device,
+			   const struct gs_sampler_info *info)
+{
+	struct gs_sampler_state *ss = bzalloc(sizeof(struct gs_sampler_state));
+	ss->device = device;
+	ss->info = *info;
+	return ss;
+}
+
+void gs_samplerstate_destroy(gs_samplerstate_t *ss)
+{
+	if (!ss)
+		return;
+
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++) {
+		if (ss->device->cur_samplers[i] == ss)
+			ss->device->cur_samplers[i] = NULL;
+	}
+
+	bfree(ss);
+}
+
+gs_vertbuffer_t *device_vertexbuffer_create(gs_device_t *device,
+					    struct gs_vb_data *data,
+					    uint32_t flags)
+{
+	struct gs_vertex_buffer *vb = bzalloc(sizeof(struct gs_vertex_buffer));
+	vb->device = device;
+	vb->data = data;
+	vb->num = data->num;
+	vb->dynamic = (flags & GS_DYNAMIC) != 0;
+	return vb;
+}
+
+void gs_vertexbuffer_destroy(gs_vertbuffer_t *vb)
+{
+	if (!vb)
+		return;
+
+	if (vb->device->cur_vertex_buffer == vb)
+		vb->device->cur_vertex_buffer = NULL;
+
+	gs_vbdata_destroy(vb->data);
+	bfree(vb);
+}
+
+void gs_vertexbuffer_flush(gs_vertbuffer_t *vb)
+{
+	UNUSED_PARAMETER(vb);
+}
+
+void gs_vertexbuffer_flush_direct(gs_vertbuffer_t *vb,
+				  const struct gs_vb_data *data)
+{
+	UNUSED_PARAMETER(vb);
+	UNUSED_PARAMETER(data);
+}
+
+struct gs_vb_data *gs_vertexbuffer_get_data(const gs_vertbuffer_t *vb)
+{
+	return vb->data;
+}
+
+gs_indexbuffer_t *device_indexbuffer_create(gs_device_t *device,
+					    enum gs_index_type type,
+					    void *indices, size_t num,
+					    uint32_t flags)
+{
+	struct gs_index_buffer *ib = bzalloc(sizeof(struct gs_index_buffer));
+	ib->device = device;
+	ib->type = type;
+	ib->data = indices;
+	ib->num = num;
+	ib->width = type == GS_UNSIGNED_LONG ? 4 : 2;
+	ib->dynamic = (flags & GS_DYNAMIC) != 0;
+	return ib;
+}
+
+void gs_indexbuffer_destroy(gs_indexbuffer_t *ib)
+{
+	if (!ib)
+		return;
+
+	if (ib->device->cur_index_buffer == ib)
+		ib->device->cur_index_buffer = NULL;
+
+	bfree(ib->data);
+	bfree(ib);
+}
+
+void gs_indexbuffer_flush(gs_indexbuffer_t *ib)
+{
+	UNUSED_PARAMETER(ib);
+}
+
+void gs_indexbuffer_flush_direct(gs_indexbuffer_t *ib, const void *data)
+{
+	if (data != ib->data)
+		memcpy(ib->data, data, ib->num * ib->width);
+}
+
+void *gs_indexbuffer_get_data(const gs_indexbuffer_t *ib)
+{
+	return ib->data;
+}
+
+size_t gs_indexbuffer_get_num_indices(const gs_indexbuffer_t *ib)
+{
+	return ib->num;
+}
+
+enum gs_index_type gs_indexbuffer_get_type(const gs_indexbuffer_t *ib)
+{
+	return ib->type;
+}
+
+/* there is no GPU to time, so timer queries never have data */
+gs_timer_t *device_timer_create(gs_device_t *device)
+{
+	struct gs_timer *timer = bzalloc(sizeof(struct gs_timer));
+	timer->device = device;
+	return timer;
+}
+
+gs_timer_range_t *device_timer_range_create(gs_device_t *device)
+{
+	struct gs_timer_range *range = bzalloc(sizeof(struct gs_timer_range));
+	range->device = device;
+	return range;
+}
+
+void gs_timer_destroy(gs_timer_t *timer)
+{
+	bfree(timer);
+}
+
+void gs_timer_begin(gs_timer_t *timer)
+{
+	UNUSED_PARAMETER(timer);
+}
+
+void gs_timer_end(gs_timer_t *timer)
+{
+	UNUSED_PARAMETER(timer);
+}
+
+bool gs_timer_get_data(gs_timer_t *timer, uint64_t *ticks)
+{
+	UNUSED_PARAMETER(timer);
+	*ticks = 0;
+	return false;
+}
+
+void gs_timer_range_destroy(gs_timer_range_t *range)
+{
+	bfree(range);
+}
+
+void gs_timer_range_begin(gs_timer_range_t *range)
+{
+	UNUSED_PARAMETER(range);
+}
+
+void gs_timer_range_end(gs_timer_range_t *range)
+{
+	UNUSED_PARAMETER(range);
+}
+
+bool gs_timer_range_get_data(gs_timer_range_t *range, bool *disjoint,
+			     uint64_t *frequency)
+{
+	UNUSED_PARAMETER(range);
+	*disjoint = true;
+	*frequency = 0;
+	return false;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void device_load_vertexbuffer(gs_device_t *device, gs_vertbuffer_t *vb)
+{
+	device->cur_vertex_buffer = vb;
+}
+
+void device_load_indexbuffer(gs_device_t *device, gs_indexbuffer_t *ib)
+{
+	device->cur_index_buffer = ib;
+}
+
+void device_load_texture(gs_device_t *device, gs_texture_t *tex, int unit)
+{
+	if (unit >= 0 && unit < GS_MAX_TEXTURES)
+		device->cur_textures[unit] = tex;
+}
+
+void device_load_texture_srgb(gs_device_t *device, gs_texture_t *tex,
+			      int unit)
+{
+	device_load_texture(device, tex, unit);
+}
+
+void device_load_samplerstate(gs_device_t *device, gs_samplerstate_t *ss,
+			      int unit)
+{
+	if (unit >= 0 && unit < GS_MAX_TEXTURES)
+		device->cur_samplers[unit] = ss;
+}
+
+void device_load_vertexshader(gs_device_t *device, gs_shader_t *vertshader)
+{
+	device->cur_vertex_shader = vertshader;
+}
+
+void device_load_pixelshader(gs_device_t *device, gs_shader_t *pixelshader)
+{
+	device->cur_pixel_shader = pixelshader;
+}
+
+void device_load_default_samplerstate(gs_device_t *device, bool b_3d,
+				      int unit)
+{
+	UNUSED_PARAMETER(b_3d);
+	device_load_samplerstate(device, NULL, unit);
+}
+
+gs_shader_t *device_get_vertex_shader(const gs_device_t *device)
+{
+	return device->cur_vertex_shader;
+}
+
+gs_shader_t *device_get_pixel_shader(const gs_device_t *device)
+{
+	return device->cur_pixel_shader;
+}
+
+gs_texture_t *device_get_render_target(const gs_device_t *device)
+{
+	return device->cur_render_target;
+}
+
+gs_zstencil_t *device_get_zstencil_target(const gs_device_t *device)
+{
+	return device->cur_zstencil_buffer;
+}
+
+void device_set_render_target(gs_device_t *device, gs_texture_t *tex,
+			      gs_zstencil_t *zstencil)
+{
+	device_set_render_target_with_color_space(device, tex, zstencil,
+						  GS_CS_SRGB);
+}
+
+void device_set_render_target_with_color_space(gs_device_t *device,
+					       gs_texture_t *tex,
+					       gs_zstencil_t *zstencil,
+					       enum gs_color_space space)
+{
+	device->cur_render_target = tex;
+	device->cur_render_side = 0;
+	device->cur_zstencil_buffer = zstencil;
+	device->cur_color_space = space;
+}
+
+void device_set_cube_render_target(gs_device_t *device, gs_texture_t *cubetex,
+				   int side, gs_zstencil_t *zstencil)
+{
+	device->cur_render_target = cubetex;
+	device->cur_render_side = side;
+	device->cur_zstencil_buffer = zstencil;
+}
+
+void device_enable_framebuffer_srgb(gs_device_t *device, bool enable)
+{
+	device->framebuffer_srgb = enable;
+}
+
+bool device_framebuffer_srgb_enabled(gs_device_t *device)
+{
+	return device->framebuffer_srgb;
+}
+
+void device_begin_frame(gs_device_t *device)
+{
+	device->frames++;
+}
+
+void device_begin_scene(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		 uint32_t start_vert, uint32_t num_verts)
+{
+	UNUSED_PARAMETER(draw_mode);
+	UNUSED_PARAMETER(start_vert);
+	UNUSED_PARAMETER(num_verts);
+	device->draw_calls++;
+}
+
+void device_end_scene(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_load_swapchain(gs_device_t *device, gs_swapchain_t *swapchain)
+{
+	device->cur_swap = swapchain;
+}
+
+static inline uint8_t color_to_byte(float val)
+{
+	if (val <= 0.0f)
+		return 0;
+	if (val >= 1.0f)
+		return 255;
+	return (uint8_t)(val * 255.0f + 0.5f);
+}
+
+/* clears are the one write that is cheap to honor without rasterizing, and
+ * they keep the contents of render targets deterministic for readback */
+void device_clear(gs_device_t *device, uint32_t clear_flags,
+		  const struct vec4 *color, float depth, uint8_t stencil)
+{
+	struct gs_texture *tex = device->cur_render_target;
+	uint8_t *data;
+	size_t face_size;
+
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(stencil);
+
+	if (!(clear_flags & GS_CLEAR_COLOR) || !tex || !tex->data)
+		return;
+
+	face_size = (size_t)tex->linesize * tex->height;
+	data = tex->data;
+	if (tex->type == GS_TEXTURE_CUBE)
+		data += face_size * (size_t)device->cur_render_side;
+
+	if (tex->format == GS_RGBA || tex->format == GS_BGRA ||
+	    tex->format == GS_BGRX) {
+		uint8_t r = color_to_byte(color->x);
+		uint8_t g = color_to_byte(color->y);
+		uint8_t b = color_to_byte(color->z);
+		uint8_t a = color_to_byte(color->w);
+		uint8_t px[4];
+
+		if (tex->format == GS_RGBA) {
+			px[0] = r;
+			px[2] = b;
+		} else {
+			px[0] = b;
+			px[2] = r;
+		}
+		px[1] = g;
+		px[3] = a;
+
+		for (size_t i = 0; i < face_size; i += 4)
+			memcpy(data + i, px, 4);
+	} else {
+		memset(data, 0, face_size);
+	}
+}
+
+bool device_is_present_ready(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+	return true;
+}
+
+void device_present(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_flush(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_set_cull_mode(gs_device_t *device, enum gs_cull_mode mode)
+{
+	device->cur_cull_mode = mode;
+}
+
+enum gs_cull_mode device_get_cull_mode(const gs_device_t *device)
+{
+	return device->cur_cull_mode;
+}
+
+void device_enable_blending(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_depth_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_write(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_color(gs_device_t *device, bool red, bool green, bool blue,
+			 bool alpha)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(red);
+	UNUSED_PARAMETER(green);
+	UNUSED_PARAMETER(blue);
+	UNUSED_PARAMETER(alpha);
+}
+
+void device_blend_function(gs_device_t *device, enum gs_blend_type src,
+			   enum gs_blend_type dest)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(src);
+	UNUSED_PARAMETER(dest);
+}
+
+void device_blend_function_separate(gs_device_t *device,
+				    enum gs_blend_type src_c,
+				    enum gs_blend_type dest_c,
+				    enum gs_blend_type src_a,
+				    enum gs_blend_type dest_a)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(src_c);
+	UNUSED_PARAMETER(dest_c);
+	UNUSED_PARAMETER(src_a);
+	UNUSED_PARAMETER(dest_a);
+}
+
+void device_blend_op(gs_device_t *device, enum gs_blend_op_type op)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(op);
+}
+
+void device_depth_function(gs_device_t *device, enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_function(gs_device_t *device, enum gs_stencil_side side,
+			     enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_op(gs_device_t *device, enum gs_stencil_side side,
+		       enum gs_stencil_op_type fail,
+		       enum gs_stencil_op_type zfail,
+		       enum gs_stencil_op_type zpass)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(fail);
+	UNUSED_PARAMETER(zfail);
+	UNUSED_PARAMETER(zpass);
+}
+
+void device_set_viewport(gs_device_t *device, int x, int y, int width,
+			 int height)
+{
+	device->cur_viewport.x = x;
+	device->cur_viewport.y = y;
+	device->cur_viewport.cx = width;
+	device->cur_viewport.cy = height;
+}
+
+void device_get_viewport(const gs_device_t *device, struct gs_rect *rect)
+{
+	*rect = device->cur_viewport;
+}
+
+void device_set_scissor_rect(gs_device_t *device, const struct gs_rect *rect)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(rect);
+}
+
+void device_ortho(gs_device_t *device, float left, float right, float top,
+		  float bottom, float near, float far)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml = right - left;
+	float bmt = bottom - top;
+	float fmn = far - near;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x = 2.0f / rml;
+	dst->t.x = (left + right) / -rml;
+
+	dst->y.y = 2.0f / -bmt;
+	dst->t.y = (bottom + top) / bmt;
+
+	dst->z.z = -2.0f / fmn;
+	dst->t.z = (far + near) / -fmn;
+
+	dst->t.w = 1.0f;
+}
+
+void device_frustum(gs_device_t *device, float left, float right, float top,
+		    float bottom, float near, float far)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml = right - left;
+	float tmb = top - bottom;
+	float nmf = near - far;
+	float nearx2 = 2.0f * near;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x = nearx2 / rml;
+	dst->z.x = (left + right) / rml;
+
+	dst->y.y = nearx2 / tmb;
+	dst->z.y = (bottom + top) / tmb;
+
+	dst->z.z = (far + near) / nmf;
+	dst->t.z = 2.0f * (near * far) / nmf;
+
+	dst->z.w = -1.0f;
+}
+
+void device_projection_push(gs_device_t *device)
+{
+	da_push_back(device->proj_stack, &device->cur_proj);
+}
+
+void device_projection_pop(gs_device_t *device)
+{
+	struct matrix4 *end;
+	if (!device->proj_stack.num)
+		return;
+
+	end = da_end(device->proj_stack);
+	device->cur_proj = *end;
+	da_pop_back(device->proj_stack);
+}
+
+void device_debug_marker_begin(gs_device_t *device, const char *markername,
+			       const float color[4])
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(markername);
+	UNUSED_PARAMETER(color);
+}
+
+void device_debug_marker_end(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+bool device_is_monitor_hdr(gs_device_t *device, void *monitor)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(monitor);
+	return false;
+}
+
+bool device_shared_texture_available(void)
+{
+	return false;
+}
+
+/* ------------------------------------------------------------------------- */
+/* platform specific exports, none of which can be supported without a GPU   */
+
+#ifdef __APPLE__
+gs_texture_t *device_texture_create_from_iosurface(gs_device_t *device,
+						   void *iosurf)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(iosurf);
+	return NULL;
+}
+
+gs_texture_t *device_texture_open_shared(gs_device_t *device, uint32_t handle)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(handle);
+	return NULL;
+}
+
+bool gs_texture_rebind_iosurface(gs_texture_t *texture, void *iosurf)
+{
+	UNUSED_PARAMETER(texture);
+	UNUSED_PARAMETER(iosurf);
+	return false;
+}
+
+#elif _WIN32
+bool device_gdi_texture_available(void)
+{
+	return false;
+}
+
+#elif defined(__linux__) || defined(__FreeBSD__) || defined(__DragonFly__)
+gs_texture_t *device_texture_create_from_dmabuf(
+	gs_device_t *device, unsigned int width, unsigned int height,
+	uint32_t drm_format, enum gs_color_format color_format,
+	uint32_t n_planes, const int *fds, const uint32_t *strides,
+	const uint32_t *offsets, const uint64_t *modifiers)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+	UNUSED_PARAMETER(drm_format);
+	UNUSED_PARAMETER(color_format);
+	UNUSED_PARAMETER(n_planes);
+	UNUSED_PARAMETER(fds);
+	UNUSED_PARAMETER(strides);
+	UNUSED_PARAMETER(offsets);
+	UNUSED_PARAMETER(modifiers);
+	return NULL;
+}
+
+bool device_query_dmabuf_capabilities(gs_device_t *device,
+				      enum gs_dmabuf_flags *dmabuf_flags,
+				      uint32_t **drm_formats, size_t *n_formats)
+{
+	UNUSED_PARAMETER(device);
+	*dmabuf_flags = GS_DMABUF_FLAG_NONE;
+	*drm_formats = NULL;
+	*n_formats = 0;
+	return false;
+}
+
+bool device_query_dmabuf_modifiers_for_format(gs_device_t *device,
+					      uint32_t drm_format,
+					      uint64_t **modifiers,
+					      size_t *n_modifiers)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(drm_format);
+	*modifiers = NULL;
+	*n_modifiers = 0;
+	return false;
+}
+
+gs_texture_t *device_texture_create_from_pixmap(
+	gs_device_t *device, uint32_t width, uint32_t height,
+	enum gs_color_format color_format, uint32_t target, void *pixmap)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+	UNUSED_PARAMETER(color_format);
+	UNUSED_PARAMETER(target);
+	UNUSED_PARAMETER(pixmap);
+	return NULL;
+}
+#endif
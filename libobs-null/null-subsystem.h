@@ -0,0 +1,153 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/darray.h>
+#include <graphics/graphics.h>
+#include <graphics/device-exports.h>
+#include <graphics/matrix4.h>
+
+/*
+ * Null graphics subsystem
+ *
+ *   Implements the device exports in system memory without any GPU, so that
+ * libobs can run headless (benchmarks, CI).  Resources keep their contents
+ * in memory, and copies, staging and clears work on that memory, but draw
+ * calls don't rasterize anything.
+ */
+
+struct gs_texture {
+	gs_device_t *device;
+	enum gs_texture_type type;
+	enum gs_color_format format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t depth; /* volume slices, or cube faces */
+	uint32_t linesize;
+	bool is_dynamic;
+	bool is_render_target;
+	bool mapped;
+
+	uint8_t *data;
+	size_t size;
+};
+
+struct gs_stage_surface {
+	gs_device_t *device;
+	enum gs_color_format format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t linesize;
+
+	uint8_t *data;
+	size_t size;
+};
+
+struct gs_zstencil_buffer {
+	gs_device_t *device;
+	enum gs_zstencil_format format;
+	uint32_t width;
+	uint32_t height;
+};
+
+struct gs_sampler_state {
+	gs_device_t *device;
+	struct gs_sampler_info info;
+};
+
+struct gs_vertex_buffer {
+	gs_device_t *device;
+	struct gs_vb_data *data;
+	size_t num;
+	bool dynamic;
+};
+
+struct gs_index_buffer {
+	gs_device_t *device;
+	enum gs_index_type type;
+	void *data;
+	size_t num;
+	size_t width;
+	bool dynamic;
+};
+
+struct gs_timer {
+	gs_device_t *device;
+};
+
+struct gs_timer_range {
+	gs_device_t *device;
+};
+
+struct gs_swap_chain {
+	gs_device_t *device;
+	struct gs_init_data info;
+};
+
+struct gs_shader_param {
+	enum gs_shader_param_type type;
+
+	char *name;
+	gs_shader_t *shader;
+	gs_samplerstate_t *next_sampler;
+	int array_count;
+
+	struct gs_texture *texture;
+	bool srgb;
+
+	DARRAY(uint8_t) cur_value;
+	DARRAY(uint8_t) def_value;
+};
+
+struct gs_shader {
+	gs_device_t *device;
+	enum gs_shader_type type;
+
+	struct gs_shader_param *viewproj;
+	struct gs_shader_param *world;
+
+	DARRAY(struct gs_shader_param) params;
+};
+
+struct gs_device {
+	gs_texture_t *cur_render_target;
+	gs_zstencil_t *cur_zstencil_buffer;
+	int cur_render_side;
+	gs_texture_t *cur_textures[GS_MAX_TEXTURES];
+	gs_samplerstate_t *cur_samplers[GS_MAX_TEXTURES];
+	gs_vertbuffer_t *cur_vertex_buffer;
+	gs_indexbuffer_t *cur_index_buffer;
+	gs_shader_t *cur_vertex_shader;
+	gs_shader_t *cur_pixel_shader;
+	gs_swapchain_t *cur_swap;
+	enum gs_color_space cur_color_space;
+	bool framebuffer_srgb;
+
+	enum gs_cull_mode cur_cull_mode;
+	struct gs_rect cur_viewport;
+
+	struct matrix4 cur_proj;
+	DARRAY(struct matrix4) proj_stack;
+
+	uint64_t draw_calls;
+	uint64_t frames;
+};
+
+static inline uint32_t null_format_pixel_size(enum gs_color_format format)
+{
+	uint32_t bpp = gs_get_format_bpp(format);
+	return bpp >= 8 ? bpp / 8 : 1;
+}
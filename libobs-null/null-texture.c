@@ -0,0 +1,372 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <util/base.h>
+#include <util/bmem.h>
+
+#include "null-subsystem.h"
+
+static inline uint32_t get_linesize(enum gs_color_format format,
+				    uint32_t width)
+{
+	uint32_t bpp = gs_get_format_bpp(format);
+	uint32_t linesize = (width * bpp + 7) / 8;
+	return (linesize + 3) & 0xFFFFFFFC;
+}
+
+static struct gs_texture *texture_create(gs_device_t *device,
+					 enum gs_texture_type type,
+					 enum gs_color_format format,
+					 uint32_t width, uint32_t height,
+					 uint32_t depth, uint32_t flags)
+{
+	struct gs_texture *tex = bzalloc(sizeof(struct gs_texture));
+	tex->device = device;
+	tex->type = type;
+	tex->format = format;
+	tex->width = width;
+	tex->height = height;
+	tex->depth = depth;
+	tex->linesize = get_linesize(format, width);
+	tex->is_dynamic = (flags & GS_DYNAMIC) != 0;
+	tex->is_render_target = (flags & GS_RENDER_TARGET) != 0;
+	tex->size = (size_t)tex->linesize * height * depth;
+	tex->data = bzalloc(tex->size ? tex->size : 1);
+	return tex;
+}
+
+/* only the first mip level is stored, there is nothing to sample the others */
+static void texture_upload(struct gs_texture *tex, uint32_t slice,
+			   const uint8_t *src)
+{
+	uint32_t row_size = (tex->width * gs_get_format_bpp(tex->format) + 7) /
+			    8;
+	size_t face_size = (size_t)tex->linesize * tex->height;
+	uint8_t *dst = tex->data + face_size * slice;
+
+	if (!src)
+		return;
+
+	for (uint32_t y = 0; y < tex->height; y++) {
+		memcpy(dst, src, row_size);
+		dst += tex->linesize;
+		src += row_size;
+	}
+}
+
+gs_texture_t *device_texture_create(gs_device_t *device, uint32_t width,
+				    uint32_t height,
+				    enum gs_color_format color_format,
+				    uint32_t levels, const uint8_t **data,
+				    uint32_t flags)
+{
+	struct gs_texture *tex = texture_create(device, GS_TEXTURE_2D,
+						color_format, width, height, 1,
+						flags);
+	if (data)
+		texture_upload(tex, 0, data[0]);
+
+	UNUSED_PARAMETER(levels);
+	return tex;
+}
+
+gs_texture_t *device_cubetexture_create(gs_device_t *device, uint32_t size,
+					enum gs_color_format color_format,
+					uint32_t levels, const uint8_t **data,
+					uint32_t flags)
+{
+	uint32_t num_levels = levels ? levels : 1;
+	struct gs_texture *tex = texture_create(device, GS_TEXTURE_CUBE,
+						color_format, size, size, 6,
+						flags);
+	if (data) {
+		for (uint32_t i = 0; i < 6; i++)
+			texture_upload(tex, i, data[i * num_levels]);
+	}
+
+	return tex;
+}
+
+gs_texture_t *device_voltexture_create(gs_device_t *device, uint32_t width,
+				       uint32_t height, uint32_t depth,
+				       enum gs_color_format color_format,
+				       uint32_t levels,
+				       const uint8_t *const *data,
+				       uint32_t flags)
+{
+	struct gs_texture *tex = texture_create(device, GS_TEXTURE_3D,
+						color_format, width, height,
+						depth, flags);
+	if (data && data[0]) {
+		size_t face_size = (size_t)tex->linesize * height;
+		for (uint32_t i = 0; i < depth; i++)
+			texture_upload(tex, i, data[0] + face_size * i);
+	}
+
+	UNUSED_PARAMETER(levels);
+	return tex;
+}
+
+enum gs_texture_type device_get_texture_type(const gs_texture_t *texture)
+{
+	return texture->type;
+}
+
+static void texture_destroy(gs_texture_t *tex)
+{
+	gs_device_t *device;
+
+	if (!tex)
+		return;
+
+	device = tex->device;
+	if (device->cur_render_target == tex)
+		device->cur_render_target = NULL;
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++) {
+		if (device->cur_textures[i] == tex)
+			device->cur_textures[i] = NULL;
+	}
+
+	bfree(tex->data);
+	bfree(tex);
+}
+
+void gs_texture_destroy(gs_texture_t *tex)
+{
+	texture_destroy(tex);
+}
+
+uint32_t gs_texture_get_width(const gs_texture_t *tex)
+{
+	return tex->width;
+}
+
+uint32_t gs_texture_get_height(const gs_texture_t *tex)
+{
+	return tex->height;
+}
+
+enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex)
+{
+	return tex->format;
+}
+
+bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
+{
+	if (tex->type != GS_TEXTURE_2D || !tex->is_dynamic) {
+		blog(LOG_ERROR, "gs_texture_map (null): texture is not a "
+				"dynamic 2D texture");
+		return false;
+	}
+
+	tex->mapped = true;
+	*ptr = tex->data;
+	*linesize = tex->linesize;
+	return true;
+}
+
+void gs_texture_unmap(gs_texture_t *tex)
+{
+	tex->mapped = false;
+}
+
+void *gs_texture_get_obj(gs_texture_t *tex)
+{
+	return tex->data;
+}
+
+void gs_cubetexture_destroy(gs_texture_t *cubetex)
+{
+	texture_destroy(cubetex);
+}
+
+uint32_t gs_cubetexture_get_size(const gs_texture_t *cubetex)
+{
+	return cubetex->width;
+}
+
+enum gs_color_format
+gs_cubetexture_get_color_format(const gs_texture_t *cubetex)
+{
+	return cubetex->format;
+}
+
+void gs_voltexture_destroy(gs_texture_t *voltex)
+{
+	texture_destroy(voltex);
+}
+
+uint32_t gs_voltexture_get_width(const gs_texture_t *voltex)
+{
+	return voltex->width;
+}
+
+uint32_t gs_voltexture_get_height(const gs_texture_t *voltex)
+{
+	return voltex->height;
+}
+
+uint32_t gs_voltexture_get_depth(const gs_texture_t *voltex)
+{
+	return voltex->depth;
+}
+
+enum gs_color_format gs_voltexture_get_color_format(const gs_texture_t *voltex)
+{
+	return voltex->format;
+}
+
+/* ------------------------------------------------------------------------- */
+
+gs_stagesurf_t *device_stagesurface_create(gs_device_t *device, uint32_t width,
+					   uint32_t height,
+					   enum gs_color_format color_format)
+{
+	struct gs_stage_surface *surf =
+		bzalloc(sizeof(struct gs_stage_surface));
+	surf->device = device;
+	surf->format = color_format;
+	surf->width = width;
+	surf->height = height;
+	surf->linesize = get_linesize(color_format, width);
+	surf->size = (size_t)surf->linesize * height;
+	surf->data = bzalloc(surf->size ? surf->size : 1);
+	return surf;
+}
+
+void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf)
+{
+	if (!stagesurf)
+		return;
+
+	bfree(stagesurf->data);
+	bfree(stagesurf);
+}
+
+uint32_t gs_stagesurface_get_width(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->width;
+}
+
+uint32_t gs_stagesurface_get_height(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->height;
+}
+
+enum gs_color_format
+gs_stagesurface_get_color_format(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->format;
+}
+
+bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
+			 uint32_t *linesize)
+{
+	*data = stagesurf->data;
+	*linesize = stagesurf->linesize;
+	return true;
+}
+
+void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
+{
+	UNUSED_PARAMETER(stagesurf);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void copy_rows(uint8_t *dst, uint32_t dst_linesize, const uint8_t *src,
+		      uint32_t src_linesize, uint32_t row_size, uint32_t rows)
+{
+	if (dst_linesize == src_linesize && row_size == src_linesize) {
+		memcpy(dst, src, (size_t)row_size * rows);
+		return;
+	}
+
+	for (uint32_t y = 0; y < rows; y++) {
+		memcpy(dst, src, row_size);
+		dst += dst_linesize;
+		src += src_linesize;
+	}
+}
+
+void device_copy_texture_region(gs_device_t *device, gs_texture_t *dst,
+				uint32_t dst_x, uint32_t dst_y,
+				gs_texture_t *src, uint32_t src_x,
+				uint32_t src_y, uint32_t src_w, uint32_t src_h)
+{
+	uint32_t pixel_size;
+	uint32_t w, h;
+
+	UNUSED_PARAMETER(device);
+
+	if (!dst || !src) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+				"NULL texture");
+		return;
+	}
+	if (dst->type != GS_TEXTURE_2D || src->type != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+				"only 2D textures can be copied");
+		return;
+	}
+	if (dst->format != src->format) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+				"source and destination formats do not match");
+		return;
+	}
+
+	w = src_w ? src_w : src->width - src_x;
+	h = src_h ? src_h : src->height - src_y;
+
+	if (dst_x + w > dst->width || dst_y + h > dst->height ||
+	    src_x + w > src->width || src_y + h > src->height) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+				"region out of bounds");
+		return;
+	}
+
+	pixel_size = null_format_pixel_size(src->format);
+	copy_rows(dst->data + dst_y * dst->linesize + dst_x * pixel_size,
+		  dst->linesize,
+		  src->data + src_y * src->linesize + src_x * pixel_size,
+		  src->linesize, w * pixel_size, h);
+}
+
+void device_copy_texture(gs_device_t *device, gs_texture_t *dst,
+			 gs_texture_t *src)
+{
+	device_copy_texture_region(device, dst, 0, 0, src, 0, 0, 0, 0);
+}
+
+void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
+			  gs_texture_t *src)
+{
+	UNUSED_PARAMETER(device);
+
+	if (!dst || !src) {
+		blog(LOG_ERROR, "device_stage_texture (null): NULL surface");
+		return;
+	}
+	if (src->type != GS_TEXTURE_2D || dst->format != src->format ||
+	    dst->width != src->width || dst->height != src->height) {
+		blog(LOG_ERROR, "device_stage_texture (null): "
+				"source and destination do not match");
+		return;
+	}
+
+	copy_rows(dst->data, dst->linesize, src->data, src->linesize,
+		  (src->width * gs_get_format_bpp(src->format) + 7) / 8,
+		  src->height);
+}
@@ -62,6 +62,7 @@ target_sources(
           obs-source.h
           obs-source-deinterlace.c
           obs-source-transition.c
+          obs-source-upload.c
           obs-ui.h
           obs-video.c
           obs-video-gpu-encode.c
@@ -109,6 +110,8 @@ target_sources(
           graphics/device-exports.h
           graphics/effect.c
           graphics/effect.h
+          graphics/effect-cache.c
+          graphics/effect-cache.h
           graphics/effect-parser.c
           graphics/effect-parser.h
           graphics/half.h
@@ -145,6 +148,8 @@ target_sources(
           media-io/audio-math.h
           media-io/audio-resampler.h
           media-io/audio-resampler-ffmpeg.c
+          media-io/audio-resampler-sinc.c
+          media-io/audio-resampler-sinc.h
           media-io/format-conversion.c
           media-io/format-conversion.h
           media-io/frame-rate.h
@@ -0,0 +1,573 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <inttypes.h>
+
+#include "../util/bmem.h"
+#include "../util/dstr.h"
+#include "../util/platform.h"
+#include "../util/array-serializer.h"
+#include "../util/file-serializer.h"
+#include "graphics-internal.h"
+#include "effect-cache.h"
+#include "effect.h"
+
+/* bump whenever the effect parser changes the code it generates */
+#define EFFECT_CACHE_VERSION 1
+#define EFFECT_CACHE_MAGIC 0x4358464F /* "OFXC" */
+
+/* sanity limits for counts read from cache files */
+#define MAX_ENTRIES 4096
+
+/* string length written for NULL strings (e.g. unnamed passes) */
+#define NULL_STR 0xFFFFFFFF
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+extern void gs_effect_actually_destroy(gs_effect_t *effect);
+extern const char *gs_preprocessor_name(void);
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+static inline uint64_t hash_str(const char *str)
+{
+	return fnv1a(FNV_OFFSET, str, strlen(str));
+}
+
+static inline const char *backend_name(void)
+{
+	const char *name = gs_preprocessor_name();
+	return name ? name : "";
+}
+
+static inline const char *device_name(void)
+{
+	const char *name = gs_get_device_name();
+	return name ? name : "";
+}
+
+static void get_entry_path(struct dstr *path, const char *cache_dir,
+			   const char *file)
+{
+	const char *backend = backend_name();
+	uint64_t key = fnv1a(hash_str(file), backend, strlen(backend));
+
+	dstr_copy(path, cache_dir);
+	if (path->len && dstr_end(path) != '/' && dstr_end(path) != '\\')
+		dstr_cat_ch(path, '/');
+	dstr_catf(path, "%016" PRIx64 ".fxcache", key);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void write_data(struct serializer *s, const void *data, size_t size)
+{
+	s_wl32(s, (uint32_t)size);
+	s_write(s, data, size);
+}
+
+static inline void write_str(struct serializer *s, const char *str)
+{
+	if (str)
+		write_data(s, str, strlen(str));
+	else
+		s_wl32(s, NULL_STR);
+}
+
+static inline void write_source(struct serializer *s, const char *str)
+{
+	size_t len = strlen(str);
+
+	s_wl64(s, fnv1a(FNV_OFFSET, str, len));
+	s_wl64(s, len);
+}
+
+static bool write_includes(struct serializer *s,
+			   const struct effect_parser *ep)
+{
+	const struct cf_preprocessor *pp = &ep->cfp.pp;
+
+	s_wl32(s, (uint32_t)pp->dependencies.num);
+
+	for (size_t i = 0; i < pp->dependencies.num; i++) {
+		const char *file = pp->dependencies.array[i].file;
+		char *data = os_quick_read_utf8_file(file);
+
+		/* can't validate the entry later without the include */
+		if (!data)
+			return false;
+
+		write_str(s, file);
+		write_source(s, data);
+		bfree(data);
+	}
+
+	return true;
+}
+
+static void write_param(struct serializer *s,
+			const struct gs_effect_param *param)
+{
+	write_str(s, param->name);
+	s_wl32(s, (uint32_t)param->type);
+	write_data(s, param->default_val.array, param->default_val.num);
+}
+
+static void write_params(struct serializer *s, const gs_effect_t *effect)
+{
+	s_wl32(s, (uint32_t)effect->params.num);
+
+	for (size_t i = 0; i < effect->params.num; i++) {
+		const struct gs_effect_param *param = effect->params.array + i;
+
+		write_param(s, param);
+
+		s_wl32(s, (uint32_t)param->annotations.num);
+		for (size_t j = 0; j < param->annotations.num; j++)
+			write_param(s, param->annotations.array + j);
+	}
+}
+
+static void write_shader(struct serializer *s,
+			 const struct ep_shader_output *out)
+{
+	write_str(s, out->code);
+
+	s_wl32(s, (uint32_t)out->used_params.num);
+	for (size_t i = 0; i < out->used_params.num; i++)
+		write_str(s, out->used_params.array[i].array);
+}
+
+static bool write_techniques(struct serializer *s,
+			     const struct effect_parser *ep)
+{
+	const gs_effect_t *effect = ep->effect;
+	size_t shader_idx = 0;
+
+	s_wl32(s, (uint32_t)effect->techniques.num);
+
+	for (size_t i = 0; i < effect->techniques.num; i++) {
+		const struct gs_effect_technique *tech =
+			effect->techniques.array + i;
+
+		write_str(s, tech->name);
+		s_wl32(s, (uint32_t)tech->passes.num);
+
+		for (size_t j = 0; j < tech->passes.num; j++) {
+			const struct ep_shader_output *out;
+
+			/* vertex and pixel shader of the pass */
+			if (shader_idx + 2 > ep->shader_output.num)
+				return false;
+
+			out = ep->shader_output.array + shader_idx;
+			write_str(s, tech->passes.array[j].name);
+			write_shader(s, out);
+			write_shader(s, out + 1);
+			shader_idx += 2;
+		}
+	}
+
+	return shader_idx == ep->shader_output.num;
+}
+
+void effect_cache_store(const char *cache_dir, const char *file,
+			const char *effect_string,
+			const struct effect_parser *ep)
+{
+	struct array_output_data data;
+	struct serializer s;
+	struct serializer file_s;
+	struct dstr path = {0};
+
+	array_output_serializer_init(&s, &data);
+
+	s_wl32(&s, EFFECT_CACHE_MAGIC);
+	s_wl32(&s, EFFECT_CACHE_VERSION);
+	write_str(&s, backend_name());
+	write_str(&s, device_name());
+	write_str(&s, file);
+	write_source(&s, effect_string);
+
+	if (!write_includes(&s, ep))
+		goto exit;
+
+	write_params(&s, ep->effect);
+
+	if (!write_techniques(&s, ep))
+		goto exit;
+
+	os_mkdirs(cache_dir);
+	get_entry_path(&path, cache_dir, file);
+
+	if (!file_output_serializer_init_safe(&file_s, path.array, "tmp")) {
+		blog(LOG_DEBUG, "effect_cache_store: Could not write '%s'",
+		     path.array);
+		goto exit;
+	}
+
+	s_write(&file_s, data.bytes.array, data.bytes.num);
+	file_output_serializer_free(&file_s);
+
+exit:
+	dstr_free(&path);
+	array_output_serializer_free(&data);
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct cache_reader {
+	const uint8_t *data;
+	size_t size;
+	size_t pos;
+	bool error;
+};
+
+static bool read_data(struct cache_reader *r, void *out, size_t size)
+{
+	if (r->error || size > r->size - r->pos) {
+		r->error = true;
+		return false;
+	}
+
+	memcpy(out, r->data + r->pos, size);
+	r->pos += size;
+	return true;
+}
+
+static uint32_t read_u32(struct cache_reader *r)
+{
+	uint8_t b[4];
+
+	if (!read_data(r, b, sizeof(b)))
+		return 0;
+
+	return (uint32_t)b[0] | ((uint32_t)b[1] << 8) |
+	       ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static uint64_t read_u64(struct cache_reader *r)
+{
+	uint64_t lo = read_u32(r);
+	uint64_t hi = read_u32(r);
+	return lo | (hi << 32);
+}
+
+static inline uint32_t read_count(struct cache_reader *r)
+{
+	uint32_t count = read_u32(r);
+
+	if (count > MAX_ENTRIES) {
+		r->error = true;
+		return 0;
+	}
+
+	return count;
+}
+
+static char *read_str(struct cache_reader *r)
+{
+	uint32_t len = read_u32(r);
+	char *str;
+
+	if (len == NULL_STR)
+		return NULL;
+	if (r->error || len > r->size - r->pos) {
+		r->error = true;
+		return NULL;
+	}
+
+	str = bmalloc(len + 1);
+	memcpy(str, r->data + r->pos, len);
+	str[len] = 0;
+	r->pos += len;
+	return str;
+}
+
+static bool read_str_matches(struct cache_reader *r, const char *expected)
+{
+	uint32_t len = read_u32(r);
+	const char *str = (const char *)r->data + r->pos;
+
+	if (r->error || len > r->size - r->pos) {
+		r->error = true;
+		return false;
+	}
+
+	r->pos += len;
+	return strlen(expected) == len && memcmp(str, expected, len) == 0;
+}
+
+static void read_bytes(struct cache_reader *r, struct darray *bytes)
+{
+	uint32_t len = read_u32(r);
+
+	if (r->error || len > r->size - r->pos) {
+		r->error = true;
+		return;
+	}
+
+	darray_resize(sizeof(uint8_t), bytes, len);
+	if (len)
+		memcpy(bytes->array, r->data + r->pos, len);
+	r->pos += len;
+}
+
+static inline bool source_matches(struct cache_reader *r, const char *str)
+{
+	size_t len = strlen(str);
+	uint64_t hash = read_u64(r);
+	uint64_t size = read_u64(r);
+
+	return !r->error && size == len &&
+	       hash == fnv1a(FNV_OFFSET, str, len);
+}
+
+static bool includes_match(struct cache_reader *r)
+{
+	uint32_t count = read_count(r);
+
+	for (uint32_t i = 0; i < count; i++) {
+		char *file = read_str(r);
+		char *data = file ? os_quick_read_utf8_file(file) : NULL;
+		bool match = data && source_matches(r, data);
+
+		bfree(file);
+		bfree(data);
+
+		if (!match)
+			return false;
+	}
+
+	return !r->error;
+}
+
+static bool read_param(struct cache_reader *r, gs_effect_t *effect,
+		       struct gs_effect_param *param,
+		       enum effect_section section)
+{
+	param->name = read_str(r);
+	param->section = section;
+	param->effect = effect;
+	param->type = (enum gs_shader_param_type)read_u32(r);
+	read_bytes(r, &param->default_val.da);
+
+	return !r->error && param->name;
+}
+
+static bool read_params(struct cache_reader *r, gs_effect_t *effect)
+{
+	uint32_t count = read_count(r);
+
+	da_resize(effect->params, count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		struct gs_effect_param *param = effect->params.array + i;
+		uint32_t num_annotations;
+
+		if (!read_param(r, effect, param, EFFECT_PARAM))
+			return false;
+
+		if (strcmp(param->name, "ViewProj") == 0)
+			effect->view_proj = param;
+		else if (strcmp(param->name, "World") == 0)
+			effect->world = param;
+
+		num_annotations = read_count(r);
+		da_resize(param->annotations, num_annotations);
+
+		for (uint32_t j = 0; j < num_annotations; j++) {
+			if (!read_param(r, effect, param->annotations.array + j,
+					EFFECT_ANNOTATION))
+				return false;
+		}
+	}
+
+	return !r->error;
+}
+
+static bool read_shader(struct cache_reader *r, const char *file,
+			gs_effect_t *effect, struct gs_effect_technique *tech,
+			struct gs_effect_pass *pass, size_t pass_idx,
+			enum gs_shader_type type)
+{
+	struct darray *pass_params;
+	struct dstr location = {0};
+	gs_shader_t *shader;
+	uint32_t num_params;
+	char *code;
+
+	code = read_str(r);
+	num_params = read_count(r);
+	if (r->error) {
+		bfree(code);
+		return false;
+	}
+
+	/* same location the effect parser uses, for error messages */
+	dstr_printf(&location, "%s (%s shader, technique %s, pass %u)", file,
+		    type == GS_SHADER_VERTEX ? "Vertex" : "Pixel", tech->name,
+		    (unsigned)pass_idx);
+
+	if (type == GS_SHADER_VERTEX) {
+		shader = gs_vertexshader_create(code, location.array, NULL);
+		pass->vertshader = shader;
+		pass_params = &pass->vertshader_params.da;
+	} else {
+		shader = gs_pixelshader_create(code, location.array, NULL);
+		pass->pixelshader = shader;
+		pass_params = &pass->pixelshader_params.da;
+	}
+
+	dstr_free(&location);
+	bfree(code);
+
+	if (!shader)
+		return false;
+
+	darray_resize(sizeof(struct pass_shaderparam), pass_params,
+		      num_params);
+
+	for (uint32_t i = 0; i < num_params; i++) {
+		struct pass_shaderparam *param = darray_item(
+			sizeof(struct pass_shaderparam), pass_params, i);
+		char *name = read_str(r);
+
+		if (!name)
+			return false;
+
+		param->eparam = gs_effect_get_param_by_name(effect, name);
+		param->sparam = gs_shader_get_param_by_name(shader, name);
+		bfree(name);
+
+		if (!param->sparam)
+			return false;
+	}
+
+	return !r->error;
+}
+
+static bool read_techniques(struct cache_reader *r, const char *file,
+			    gs_effect_t *effect)
+{
+	uint32_t count = read_count(r);
+
+	da_resize(effect->techniques, count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		struct gs_effect_technique *tech = effect->techniques.array + i;
+		uint32_t num_passes;
+
+		tech->name = read_str(r);
+		tech->section = EFFECT_TECHNIQUE;
+		tech->effect = effect;
+
+		num_passes = read_count(r);
+		if (r->error)
+			return false;
+
+		da_resize(tech->passes, num_passes);
+
+		for (uint32_t j = 0; j < num_passes; j++) {
+			struct gs_effect_pass *pass = tech->passes.array + j;
+
+			pass->name = read_str(r);
+			pass->section = EFFECT_PASS;
+
+			if (!read_shader(r, file, effect, tech, pass, j,
+					 GS_SHADER_VERTEX) ||
+			    !read_shader(r, file, effect, tech, pass, j,
+					 GS_SHADER_PIXEL))
+				return false;
+		}
+	}
+
+	return !r->error;
+}
+
+static uint8_t *read_entry(const char *path, size_t *size)
+{
+	FILE *file = os_fopen(path, "rb");
+	uint8_t *data = NULL;
+	int64_t file_size;
+
+	if (!file)
+		return NULL;
+
+	file_size = os_fgetsize(file);
+	if (file_size > 0 && (uint64_t)file_size < SIZE_MAX) {
+		data = bmalloc((size_t)file_size);
+		*size = fread(data, 1, (size_t)file_size, file);
+
+		if (*size != (size_t)file_size) {
+			bfree(data);
+			data = NULL;
+		}
+	}
+
+	fclose(file);
+	return data;
+}
+
+gs_effect_t *effect_cache_load(const char *cache_dir, const char *file,
+			       const char *effect_string)
+{
+	struct cache_reader r = {0};
+	struct dstr path = {0};
+	gs_effect_t *effect = NULL;
+	uint8_t *data;
+
+	get_entry_path(&path, cache_dir, file);
+	data = read_entry(path.array, &r.size);
+	dstr_free(&path);
+
+	if (!data)
+		return NULL;
+
+	r.data = data;
+
+	if (read_u32(&r) != EFFECT_CACHE_MAGIC ||
+	    read_u32(&r) != EFFECT_CACHE_VERSION ||
+	    !read_str_matches(&r, backend_name()) ||
+	    !read_str_matches(&r, device_name()) ||
+	    !read_str_matches(&r, file) ||
+	    !source_matches(&r, effect_string) || !includes_match(&r))
+		goto exit;
+
+	effect = bzalloc(sizeof(struct gs_effect));
+	effect->graphics = gs_get_context();
+	effect->effect_path = bstrdup(file);
+
+	if (!read_params(&r, effect) || !read_techniques(&r, file, effect) ||
+	    r.pos != r.size) {
+		gs_effect_actually_destroy(effect);
+		effect = NULL;
+	}
+
+exit:
+	bfree(data);
+	return effect;
+}
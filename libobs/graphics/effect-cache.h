@@ -0,0 +1,37 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "effect-parser.h"
+
+/*
+ * Effect cache
+ *
+ *   Stores what the effect parser generates for an effect file (parameters,
+ * techniques and the generated code of each pass shader) in a cache
+ * directory, so the next load can skip lexing and parsing.  Entries are keyed
+ * by the effect path and graphics backend, and are only used when the hashes
+ * of the effect file and all of its includes still match.
+ */
+
+/* returns NULL on a cache miss or an invalid entry */
+extern gs_effect_t *effect_cache_load(const char *cache_dir, const char *file,
+				      const char *effect_string);
+
+/* the parser must have been run with keep_shader_output set */
+extern void effect_cache_store(const char *cache_dir, const char *file,
+			       const char *effect_string,
+			       const struct effect_parser *ep);
@@ -67,6 +67,8 @@ void ep_free(struct effect_parser *ep)
 		ep_sampler_free(ep->samplers.array + i);
 	for (i = 0; i < ep->techniques.num; i++)
 		ep_technique_free(ep->techniques.array + i);
+	for (i = 0; i < ep->shader_output.num; i++)
+		ep_shader_output_free(ep->shader_output.array + i);
 
 	ep->cur_pass = NULL;
 	cf_parser_free(&ep->cfp);
@@ -75,6 +77,7 @@ void ep_free(struct effect_parser *ep)
 	da_free(ep->funcs);
 	da_free(ep->samplers);
 	da_free(ep->techniques);
+	da_free(ep->shader_output);
 }
 
 static inline struct ep_func *ep_getfunc(struct effect_parser *ep,
@@ -1992,6 +1995,15 @@ static inline bool ep_compile_pass_shader(struct effect_parser *ep,
 	else
 		success = false;
 
+	if (ep->keep_shader_output) {
+		struct ep_shader_output *out =
+			da_push_back_new(ep->shader_output);
+		out->code = shader_str.array;
+		out->used_params.da = used_params;
+		dstr_init(&shader_str);
+		darray_init(&used_params);
+	}
+
 	dstr_free(&location);
 	dstr_array_free(used_params.array, used_params.num);
 	darray_free(&used_params);
@@ -254,6 +254,22 @@ static inline void ep_func_free(struct ep_func *epf)
 	da_free(epf->sampler_deps);
 }
 
+/* ------------------------------------------------------------------------- */
+/* generated shader code, kept for the effect cache when requested */
+
+struct ep_shader_output {
+	char *code;
+	DARRAY(struct dstr) used_params;
+};
+
+static inline void ep_shader_output_free(struct ep_shader_output *out)
+{
+	bfree(out->code);
+	for (size_t i = 0; i < out->used_params.num; i++)
+		dstr_free(out->used_params.array + i);
+	da_free(out->used_params);
+}
+
 /* ------------------------------------------------------------------------- */
 
 struct effect_parser {
@@ -270,6 +286,10 @@ struct effect_parser {
 	DARRAY(struct cf_token) tokens;
 	struct gs_effect_pass *cur_pass;
 
+	/* vertex then pixel shader of each pass, in technique order */
+	bool keep_shader_output;
+	DARRAY(struct ep_shader_output) shader_output;
+
 	struct cf_parser cfp;
 };
 
@@ -282,8 +302,10 @@ static inline void ep_init(struct effect_parser *ep)
 	da_init(ep->techniques);
 	da_init(ep->files);
 	da_init(ep->tokens);
+	da_init(ep->shader_output);
 
 	ep->cur_pass = NULL;
+	ep->keep_shader_output = false;
 	cf_parser_init(&ep->cfp);
 }
 
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include "../util/uthash.h"
 #include "effect-parser.h"
 #include "graphics.h"
 
@@ -162,6 +163,7 @@ struct gs_effect {
 	graphics_t *graphics;
 
 	struct gs_effect *next;
+	UT_hash_handle hh;
 
 	size_t loop_pass;
 	bool looping;
@@ -371,6 +371,27 @@ struct gs_exports {
 #endif
 };
 
+/* render targets of texrenders, reused by size and format */
+struct gs_render_target {
+	gs_texture_t *tex;
+	gs_zstencil_t *zs;
+	uint32_t cx, cy;
+	enum gs_color_format format;
+	enum gs_zstencil_format zsformat;
+	uint64_t size;
+	uint64_t idle_frame;
+};
+
+struct gs_texrender_pool {
+	DARRAY(struct gs_render_target) targets;
+	struct gs_texture_render *first_leased;
+	uint64_t frame;
+	struct gs_texrender_pool_stats stats;
+};
+
+extern void texrender_pool_begin_frame(graphics_t *graphics);
+extern void texrender_pool_free(graphics_t *graphics);
+
 struct blend_state {
 	bool enabled;
 	enum gs_blend_type src_c;
@@ -405,6 +426,11 @@ struct graphics_subsystem {
 
 	pthread_mutex_t effect_mutex;
 	struct gs_effect *first_effect;
+	struct gs_effect *effects_by_path;
+	char *effect_cache_path;
+	struct gs_effect_load_stats effect_stats;
+
+	struct gs_texrender_pool texrender_pool;
 
 	pthread_mutex_t mutex;
 	volatile long ref;
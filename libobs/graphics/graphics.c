@@ -20,12 +20,14 @@
 #include "../util/base.h"
 #include "../util/bmem.h"
 #include "../util/platform.h"
+#include "../util/profiler.h"
 #include "graphics-internal.h"
 #include "vec2.h"
 #include "vec3.h"
 #include "quat.h"
 #include "axisang.h"
 #include "effect-parser.h"
+#include "effect-cache.h"
 #include "effect.h"
 
 #ifdef near
@@ -233,6 +235,9 @@ void gs_destroy(graphics_t *graphics)
 		thread_graphics = graphics;
 		graphics->exports.device_enter_context(graphics->device);
 
+		HASH_CLEAR(hh, graphics->effects_by_path);
+		texrender_pool_free(graphics);
+
 		while (effect) {
 			struct gs_effect *next = effect->next;
 			gs_effect_actually_destroy(effect);
@@ -250,6 +255,7 @@ void gs_destroy(graphics_t *graphics)
 
 	pthread_mutex_destroy(&graphics->mutex);
 	pthread_mutex_destroy(&graphics->effect_mutex);
+	bfree(graphics->effect_cache_path);
 	da_free(graphics->matrix_stack);
 	da_free(graphics->viewport_stack);
 	da_free(graphics->blend_state_stack);
@@ -795,21 +801,99 @@ gs_effect_t *gs_get_effect(void)
 
 static inline struct gs_effect *find_cached_effect(const char *filename)
 {
-	struct gs_effect *effect = thread_graphics->first_effect;
+	struct gs_effect *effect;
 
-	while (effect) {
-		if (strcmp(effect->effect_path, filename) == 0)
-			break;
-		effect = effect->next;
+	pthread_mutex_lock(&thread_graphics->effect_mutex);
+	HASH_FIND_STR(thread_graphics->effects_by_path, filename, effect);
+	if (effect)
+		thread_graphics->effect_stats.reused++;
+	pthread_mutex_unlock(&thread_graphics->effect_mutex);
+
+	return effect;
+}
+
+static void register_effect(struct gs_effect *effect)
+{
+	struct gs_effect *existing;
+
+	if (!effect->effect_path)
+		return;
+
+	pthread_mutex_lock(&thread_graphics->effect_mutex);
+
+	effect->cached = true;
+	effect->next = thread_graphics->first_effect;
+	thread_graphics->first_effect = effect;
+
+	/* if two threads loaded the same file, the first one stays indexed,
+	 * the other is still kept alive on the list */
+	HASH_FIND_STR(thread_graphics->effects_by_path, effect->effect_path,
+		      existing);
+	if (!existing)
+		HASH_ADD_KEYPTR(hh, thread_graphics->effects_by_path,
+				effect->effect_path,
+				strlen(effect->effect_path), effect);
+
+	pthread_mutex_unlock(&thread_graphics->effect_mutex);
+}
+
+static gs_effect_t *effect_create(const char *effect_string,
+				  const char *filename, char **error_string,
+				  const char *cache_dir)
+{
+	struct gs_effect *effect = bzalloc(sizeof(struct gs_effect));
+	struct effect_parser parser;
+	bool success;
+
+	effect->graphics = thread_graphics;
+	effect->effect_path = bstrdup(filename);
+
+	ep_init(&parser);
+	parser.keep_shader_output = !!cache_dir;
+
+	success = ep_parse(&parser, effect, effect_string, filename);
+	if (!success) {
+		if (error_string)
+			*error_string =
+				error_data_buildstring(&parser.cfp.error_list);
+		gs_effect_destroy(effect);
+		effect = NULL;
 	}
 
+	if (effect) {
+		if (cache_dir)
+			effect_cache_store(cache_dir, filename, effect_string,
+					   &parser);
+
+		register_effect(effect);
+	}
+
+	ep_free(&parser);
 	return effect;
 }
 
+static char *get_effect_cache_path(void)
+{
+	char *path;
+
+	pthread_mutex_lock(&thread_graphics->effect_mutex);
+	path = bstrdup(thread_graphics->effect_cache_path);
+	pthread_mutex_unlock(&thread_graphics->effect_mutex);
+
+	return path;
+}
+
+static const char *effect_load_name = "gs_effect_create_from_file";
+static const char *effect_parse_name = "parse";
+static const char *effect_cache_name = "load from effect cache";
+
 gs_effect_t *gs_effect_create_from_file(const char *file, char **error_string)
 {
 	char *file_string;
+	char *cache_dir;
 	gs_effect_t *effect = NULL;
+	uint64_t start;
+	bool cache_hit = false;
 
 	if (!gs_valid_p("gs_effect_create_from_file", file))
 		return NULL;
@@ -818,15 +902,55 @@ gs_effect_t *gs_effect_create_from_file(const char *file, char **error_string)
 	if (effect)
 		return effect;
 
+	profile_start(effect_load_name);
+	start = os_gettime_ns();
+
 	file_string = os_quick_read_utf8_file(file);
 	if (!file_string) {
 		blog(LOG_ERROR, "Could not load effect file '%s'", file);
+		profile_end(effect_load_name);
 		return NULL;
 	}
 
-	effect = gs_effect_create(file_string, file, error_string);
+	cache_dir = get_effect_cache_path();
+
+	if (cache_dir) {
+		profile_start(effect_cache_name);
+		effect = effect_cache_load(cache_dir, file, file_string);
+		profile_end(effect_cache_name);
+
+		if (effect) {
+			register_effect(effect);
+			cache_hit = true;
+		}
+	}
+
+	if (!effect) {
+		profile_start(effect_parse_name);
+		effect = effect_create(file_string, file, error_string,
+				       cache_dir);
+		profile_end(effect_parse_name);
+	}
+
+	bfree(cache_dir);
 	bfree(file_string);
 
+	if (effect) {
+		struct gs_effect_load_stats *stats =
+			&thread_graphics->effect_stats;
+		uint64_t elapsed = os_gettime_ns() - start;
+
+		pthread_mutex_lock(&thread_graphics->effect_mutex);
+		stats->loaded++;
+		stats->load_time_ns += elapsed;
+		if (cache_hit) {
+			stats->cache_hits++;
+			stats->cache_time_ns += elapsed;
+		}
+		pthread_mutex_unlock(&thread_graphics->effect_mutex);
+	}
+
+	profile_end(effect_load_name);
 	return effect;
 }
 
@@ -836,37 +960,32 @@ gs_effect_t *gs_effect_create(const char *effect_string, const char *filename,
 	if (!gs_valid_p("gs_effect_create", effect_string))
 		return NULL;
 
-	struct gs_effect *effect = bzalloc(sizeof(struct gs_effect));
-	struct effect_parser parser;
-	bool success;
+	return effect_create(effect_string, filename, error_string, NULL);
+}
 
-	effect->graphics = thread_graphics;
-	effect->effect_path = bstrdup(filename);
+void gs_set_effect_cache_path(const char *path)
+{
+	graphics_t *graphics = thread_graphics;
 
-	ep_init(&parser);
-	success = ep_parse(&parser, effect, effect_string, filename);
-	if (!success) {
-		if (error_string)
-			*error_string =
-				error_data_buildstring(&parser.cfp.error_list);
-		gs_effect_destroy(effect);
-		effect = NULL;
-	}
+	if (!gs_valid("gs_set_effect_cache_path"))
+		return;
 
-	if (effect) {
-		pthread_mutex_lock(&thread_graphics->effect_mutex);
+	pthread_mutex_lock(&graphics->effect_mutex);
+	bfree(graphics->effect_cache_path);
+	graphics->effect_cache_path = (path && *path) ? bstrdup(path) : NULL;
+	pthread_mutex_unlock(&graphics->effect_mutex);
+}
 
-		if (effect->effect_path) {
-			effect->cached = true;
-			effect->next = thread_graphics->first_effect;
-			thread_graphics->first_effect = effect;
-		}
+void gs_effect_get_load_stats(struct gs_effect_load_stats *stats)
+{
+	graphics_t *graphics = thread_graphics;
 
-		pthread_mutex_unlock(&thread_graphics->effect_mutex);
-	}
+	if (!gs_valid_p("gs_effect_get_load_stats", stats))
+		return;
 
-	ep_free(&parser);
-	return effect;
+	pthread_mutex_lock(&graphics->effect_mutex);
+	*stats = graphics->effect_stats;
+	pthread_mutex_unlock(&graphics->effect_mutex);
 }
 
 gs_shader_t *gs_vertexshader_create_from_file(const char *file,
@@ -1886,6 +2005,7 @@ void gs_begin_frame(void)
 	if (!gs_valid("gs_begin_frame"))
 		return;
 
+	texrender_pool_begin_frame(graphics);
 	graphics->exports.device_begin_frame(graphics->device);
 }
 
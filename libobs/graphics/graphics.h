@@ -465,6 +465,16 @@ EXPORT void gs_effect_set_color(gs_eparam_t *param, uint32_t argb);
 
 EXPORT gs_texrender_t *gs_texrender_create(enum gs_color_format format,
 					   enum gs_zstencil_format zsformat);
+/**
+ * Creates a texture render helper whose render target is leased from the
+ * render target pool: if the texrender is not begun during a frame, its
+ * target is given back to the pool on the next frame, and the contents are
+ * lost.  Only use this for texrenders that are re-rendered every frame they
+ * are used.
+ */
+EXPORT gs_texrender_t *
+gs_texrender_create_leased(enum gs_color_format format,
+			   enum gs_zstencil_format zsformat);
 EXPORT void gs_texrender_destroy(gs_texrender_t *texrender);
 EXPORT bool gs_texrender_begin(gs_texrender_t *texrender, uint32_t cx,
 			       uint32_t cy);
@@ -477,6 +487,17 @@ EXPORT gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender);
 EXPORT enum gs_color_format
 gs_texrender_get_format(const gs_texrender_t *texrender);
 
+struct gs_texrender_pool_stats {
+	uint32_t used;          /* render targets held by texrenders */
+	uint32_t pooled;        /* idle render targets kept for reuse */
+	uint64_t used_bytes;
+	uint64_t pooled_bytes;
+	uint64_t created;       /* render targets created */
+	uint64_t reused;        /* render targets taken from the pool */
+};
+
+EXPORT void gs_texrender_pool_get_stats(struct gs_texrender_pool_stats *stats);
+
 /* ---------------------------------------------------
  * graphics subsystem
  * --------------------------------------------------- */
@@ -575,6 +596,18 @@ EXPORT gs_effect_t *gs_effect_create_from_file(const char *file,
 EXPORT gs_effect_t *gs_effect_create(const char *effect_string,
 				     const char *filename, char **error_string);
 
+struct gs_effect_load_stats {
+	uint32_t loaded;           /* effects loaded from file */
+	uint32_t cache_hits;       /* loaded from the effect cache */
+	uint32_t reused;           /* lookups of an already loaded file */
+	uint64_t load_time_ns;     /* total time spent loading files */
+	uint64_t cache_time_ns;    /* part of it spent on cache hits */
+};
+
+/** Sets the directory used to cache parsed effect files, NULL disables it */
+EXPORT void gs_set_effect_cache_path(const char *path);
+EXPORT void gs_effect_get_load_stats(struct gs_effect_load_stats *stats);
+
 EXPORT gs_shader_t *gs_vertexshader_create_from_file(const char *file,
 						     char **error_string);
 EXPORT gs_shader_t *gs_pixelshader_create_from_file(const char *file,
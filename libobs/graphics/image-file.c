@@ -19,11 +19,100 @@
 #include "../util/base.h"
 #include "../util/platform.h"
 #include "../util/dstr.h"
+#include "../util/threading.h"
+#include "../util/uthash.h"
 #include "vec4.h"
 
 #define blog(level, format, ...) \
 	blog(level, "%s: " format, __FUNCTION__, __VA_ARGS__)
 
+/* animated gifs that decode to more than this are streamed instead of being
+ * fully cached */
+#define GIF_DEFAULT_CACHE_BUDGET (128ULL * 1024ULL * 1024ULL)
+#define GIF_RING_FRAMES 4
+#define GIF_MAX_CHECKPOINTS 16
+
+static uint64_t gif_cache_budget = GIF_DEFAULT_CACHE_BUDGET;
+
+/*
+ * Streamed animated gifs
+ *
+ *   A decoder thread with its own libnsgif state decodes frames ahead of
+ * playback into a small ring, the first entry of which is the frame being
+ * shown.  Frames are composited onto the previous one, so jumping backwards
+ * would mean decoding from the start again; composited copies of evenly
+ * spaced frames are kept as checkpoints to restart decoding from instead.
+ */
+struct gs_gif_stream {
+	/* the gif data of the image, see get_gif_stream */
+	const uint8_t *key;
+	UT_hash_handle hh;
+
+	gif_animation gif;
+	enum gs_image_alpha_mode alpha_mode;
+	size_t frame_size;
+	int frame_count;
+
+	pthread_t thread;
+	bool thread_created;
+	pthread_mutex_t mutex;
+	os_sem_t *sem;
+	volatile bool stop;
+
+	uint8_t *ring_data;
+	int ring_frames[GIF_RING_FRAMES];
+	size_t ring_size;
+	size_t ring_start;
+	size_t ring_count;
+	int next_frame;
+	int seek_frame;
+
+	/* only used by the thread playing the image */
+	int shown_frame;
+
+	/* only used by the decoder thread */
+	uint8_t *checkpoint_data;
+	bool checkpoint_valid[GIF_MAX_CHECKPOINTS];
+	size_t num_checkpoints;
+	int checkpoint_interval;
+};
+
+/* streams are kept out of gs_image_file, since its layout is part of the
+ * gs_image_file2/3/4 structs plugins embed.  they're keyed by the gif data,
+ * which stays the same when the image struct is copied */
+static pthread_mutex_t gif_streams_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct gs_gif_stream *gif_streams = NULL;
+
+static struct gs_gif_stream *get_gif_stream(const gs_image_file_t *image)
+{
+	struct gs_gif_stream *stream = NULL;
+
+	if (!image->is_animated_gif || !image->gif_data)
+		return NULL;
+
+	pthread_mutex_lock(&gif_streams_mutex);
+	HASH_FIND_PTR(gif_streams, &image->gif_data, stream);
+	pthread_mutex_unlock(&gif_streams_mutex);
+
+	return stream;
+}
+
+static struct gs_gif_stream *take_gif_stream(const gs_image_file_t *image)
+{
+	struct gs_gif_stream *stream = NULL;
+
+	if (!image->gif_data)
+		return NULL;
+
+	pthread_mutex_lock(&gif_streams_mutex);
+	HASH_FIND_PTR(gif_streams, &image->gif_data, stream);
+	if (stream)
+		HASH_DELETE(hh, gif_streams, stream);
+	pthread_mutex_unlock(&gif_streams_mutex);
+
+	return stream;
+}
+
 static void *bi_def_bitmap_create(int width, int height)
 {
 	return bmalloc((size_t)4 * width * height);
@@ -72,10 +161,295 @@ static inline void *alloc_mem(gs_image_file_t *image, uint64_t *mem_usage,
 	return bzalloc(size);
 }
 
+/* premultiplies into a copy, libnsgif composites the next frame onto the
+ * straight alpha frame image */
+static inline void copy_frame(uint8_t *dst, const uint8_t *src, size_t area,
+			      enum gs_image_alpha_mode alpha_mode)
+{
+	if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY_SRGB)
+		gs_premultiply_xyza_srgb_loop_restrict(dst, src, area);
+	else if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY)
+		gs_premultiply_xyza_loop_restrict(dst, src, area);
+	else
+		memcpy(dst, src, area * 4);
+}
+
+static void cache_frame(gs_image_file_t *image, int frame,
+			enum gs_image_alpha_mode alpha_mode)
+{
+	const size_t area = (size_t)image->gif.width * image->gif.height;
+	uint8_t *dst = image->animation_frame_data + frame * area * 4;
+
+	copy_frame(dst, image->gif.frame_image, area, alpha_mode);
+	image->animation_frame_cache[frame] = dst;
+	image->last_decoded_frame = frame;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline uint8_t *ring_slot(struct gs_gif_stream *stream, size_t idx)
+{
+	return stream->ring_data + idx * stream->frame_size;
+}
+
+static inline uint8_t *checkpoint(struct gs_gif_stream *stream, size_t idx)
+{
+	return stream->checkpoint_data + idx * stream->frame_size;
+}
+
+/* decodes up to the frame before the requested one, from the last decoded
+ * frame or the closest checkpoint if that is closer */
+static void gif_stream_seek(struct gs_gif_stream *stream, int frame)
+{
+	int start = -1;
+
+	if (stream->gif.decoded_frame < frame)
+		start = stream->gif.decoded_frame;
+
+	if (stream->checkpoint_interval && frame > 0) {
+		size_t idx = (size_t)((frame - 1) / stream->checkpoint_interval);
+
+		if (idx > stream->num_checkpoints)
+			idx = stream->num_checkpoints;
+		while (idx > 0 && !stream->checkpoint_valid[idx - 1])
+			idx--;
+
+		int cp_frame = (int)idx * stream->checkpoint_interval;
+		if (idx > 0 && cp_frame > start) {
+			memcpy(stream->gif.frame_image,
+			       checkpoint(stream, idx - 1), stream->frame_size);
+			stream->gif.decoded_frame = cp_frame;
+			start = cp_frame;
+		}
+	}
+
+	for (int i = start + 1; i < frame; i++)
+		gif_decode_frame(&stream->gif, (unsigned int)i);
+}
+
+static void gif_stream_store_checkpoint(struct gs_gif_stream *stream,
+					int frame)
+{
+	size_t idx;
+
+	if (!stream->checkpoint_interval || !frame ||
+	    frame % stream->checkpoint_interval != 0)
+		return;
+
+	idx = (size_t)(frame / stream->checkpoint_interval) - 1;
+	if (idx >= stream->num_checkpoints || stream->checkpoint_valid[idx])
+		return;
+
+	memcpy(checkpoint(stream, idx), stream->gif.frame_image,
+	       stream->frame_size);
+	stream->checkpoint_valid[idx] = true;
+}
+
+static bool gif_stream_decode_next(struct gs_gif_stream *stream)
+{
+	size_t idx;
+	int frame;
+	int seek;
+
+	pthread_mutex_lock(&stream->mutex);
+	seek = stream->seek_frame;
+	if (seek >= 0) {
+		stream->ring_count = 0;
+		stream->next_frame = seek;
+		stream->seek_frame = -1;
+	}
+
+	if (stream->ring_count == stream->ring_size ||
+	    os_atomic_load_bool(&stream->stop)) {
+		pthread_mutex_unlock(&stream->mutex);
+		return false;
+	}
+
+	frame = stream->next_frame;
+	idx = (stream->ring_start + stream->ring_count) % stream->ring_size;
+	pthread_mutex_unlock(&stream->mutex);
+
+	if (seek >= 0)
+		gif_stream_seek(stream, seek);
+
+	gif_decode_frame(&stream->gif, (unsigned int)frame);
+	gif_stream_store_checkpoint(stream, frame);
+
+	copy_frame(ring_slot(stream, idx), stream->gif.frame_image,
+		   stream->frame_size / 4, stream->alpha_mode);
+
+	/* a seek requested in the meantime discards the frame */
+	pthread_mutex_lock(&stream->mutex);
+	if (stream->seek_frame < 0) {
+		stream->ring_frames[idx] = frame;
+		stream->ring_count++;
+		stream->next_frame = (frame + 1) % stream->frame_count;
+	}
+	pthread_mutex_unlock(&stream->mutex);
+	return true;
+}
+
+static void *gif_stream_thread(void *param)
+{
+	struct gs_gif_stream *stream = param;
+
+	os_set_thread_name("gif decode-ahead");
+
+	while (os_sem_wait(stream->sem) == 0) {
+		if (os_atomic_load_bool(&stream->stop))
+			break;
+
+		while (gif_stream_decode_next(stream))
+			;
+	}
+
+	return NULL;
+}
+
+/* returns the frame if it has been decoded, dropping the frames before it.
+ * seeks if the frame is not coming up next */
+static uint8_t *gif_stream_get_frame(struct gs_gif_stream *stream, int frame)
+{
+	uint8_t *data = NULL;
+	bool wake = false;
+
+	pthread_mutex_lock(&stream->mutex);
+
+	if (stream->seek_frame < 0) {
+		while (stream->ring_count) {
+			size_t idx = stream->ring_start;
+
+			if (stream->ring_frames[idx] == frame) {
+				data = ring_slot(stream, idx);
+				break;
+			}
+
+			stream->ring_start = (idx + 1) % stream->ring_size;
+			stream->ring_count--;
+			wake = true;
+		}
+
+		if (!data) {
+			int ahead = (frame - stream->next_frame +
+				     stream->frame_count) %
+				    stream->frame_count;
+
+			if (ahead >= (int)stream->ring_size) {
+				stream->seek_frame = frame;
+				wake = true;
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&stream->mutex);
+
+	if (wake)
+		os_sem_post(stream->sem);
+	return data;
+}
+
+static void gif_stream_destroy(struct gs_gif_stream *stream)
+{
+	if (!stream)
+		return;
+
+	if (stream->thread_created) {
+		os_atomic_set_bool(&stream->stop, true);
+		os_sem_post(stream->sem);
+		pthread_join(stream->thread, NULL);
+	}
+
+	gif_finalise(&stream->gif);
+	os_sem_destroy(stream->sem);
+	pthread_mutex_destroy(&stream->mutex);
+	bfree(stream->ring_data);
+	bfree(stream->checkpoint_data);
+	bfree(stream);
+}
+
+static struct gs_gif_stream *
+gif_stream_create(gs_image_file_t *image, size_t size, uint64_t *mem_usage,
+		  enum gs_image_alpha_mode alpha_mode)
+{
+	struct gs_gif_stream *stream = bzalloc(sizeof(*stream));
+	uint64_t budget = gif_cache_budget;
+	uint64_t frame_size;
+	gif_result result;
+
+	pthread_mutex_init_value(&stream->mutex);
+	gif_create(&stream->gif, &image->bitmap_callbacks);
+
+	do {
+		result = gif_initialise(&stream->gif, size, image->gif_data);
+		if (result < 0)
+			goto fail;
+	} while (result != GIF_OK);
+
+	frame_size = (uint64_t)image->gif.width * image->gif.height * 4;
+
+	stream->alpha_mode = alpha_mode;
+	stream->frame_size = (size_t)frame_size;
+	stream->frame_count = (int)image->gif.frame_count;
+	stream->seek_frame = -1;
+
+	stream->ring_size = (size_t)(budget / frame_size);
+	if (stream->ring_size > GIF_RING_FRAMES)
+		stream->ring_size = GIF_RING_FRAMES;
+	if (stream->ring_size < 2)
+		stream->ring_size = 2;
+
+	/* checkpoints take whatever is left of the budget */
+	budget -= budget > frame_size * stream->ring_size
+			  ? frame_size * stream->ring_size
+			  : budget;
+	stream->num_checkpoints = (size_t)(budget / frame_size);
+	if (stream->num_checkpoints > GIF_MAX_CHECKPOINTS)
+		stream->num_checkpoints = GIF_MAX_CHECKPOINTS;
+	if (stream->num_checkpoints >= (size_t)stream->frame_count)
+		stream->num_checkpoints = (size_t)stream->frame_count - 1;
+	if (stream->num_checkpoints)
+		stream->checkpoint_interval =
+			stream->frame_count /
+			(int)(stream->num_checkpoints + 1);
+
+	stream->ring_data = alloc_mem(image, mem_usage,
+				      stream->ring_size * stream->frame_size);
+	if (stream->num_checkpoints)
+		stream->checkpoint_data = alloc_mem(
+			image, mem_usage,
+			stream->num_checkpoints * stream->frame_size);
+	if (mem_usage)
+		*mem_usage += stream->frame_size;
+
+	if (pthread_mutex_init(&stream->mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&stream->sem, 0) != 0)
+		goto fail;
+	if (pthread_create(&stream->thread, NULL, gif_stream_thread, stream) !=
+	    0)
+		goto fail;
+
+	stream->thread_created = true;
+	os_sem_post(stream->sem);
+
+	stream->key = image->gif_data;
+	pthread_mutex_lock(&gif_streams_mutex);
+	HASH_ADD_PTR(gif_streams, key, stream);
+	pthread_mutex_unlock(&gif_streams_mutex);
+	return stream;
+
+fail:
+	gif_stream_destroy(stream);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
 static bool init_animated_gif(gs_image_file_t *image, const char *path,
 			      uint64_t *mem_usage,
 			      enum gs_image_alpha_mode alpha_mode)
 {
+	struct gs_gif_stream *stream = NULL;
 	bool is_animated_gif = true;
 	gif_result result;
 	uint64_t max_size;
@@ -136,41 +510,50 @@ static bool init_animated_gif(gs_image_file_t *image, const char *path,
 
 	image->is_animated_gif = (image->gif.frame_count > 1 && result >= 0);
 	if (image->is_animated_gif) {
-		gif_decode_frame(&image->gif, 0);
+		image->cx = (uint32_t)image->gif.width;
+		image->cy = (uint32_t)image->gif.height;
+		image->format = GS_RGBA;
 
-		image->animation_frame_cache =
-			alloc_mem(image, mem_usage,
-				  image->gif.frame_count * sizeof(uint8_t *));
-		image->animation_frame_data = alloc_mem(
-			image, mem_usage, get_full_decoded_gif_size(image));
+		if (max_size > gif_cache_budget)
+			stream = gif_stream_create(image, size, mem_usage,
+						   alpha_mode);
 
-		for (unsigned int i = 0; i < image->gif.frame_count; i++) {
-			if (gif_decode_frame(&image->gif, i) != GIF_OK)
-				blog(LOG_WARNING,
-				     "Couldn't decode frame %u "
-				     "of '%s'",
-				     i, path);
-		}
+		if (stream) {
+			/* the initial texture, the stream decodes the rest */
+			const size_t area = (size_t)image->cx * image->cy;
 
-		gif_decode_frame(&image->gif, 0);
+			gif_decode_frame(&image->gif, 0);
 
-		image->cx = (uint32_t)image->gif.width;
-		image->cy = (uint32_t)image->gif.height;
-		image->format = GS_RGBA;
+			if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY_SRGB)
+				gs_premultiply_xyza_srgb_loop(
+					image->gif.frame_image, area);
+			else if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY)
+				gs_premultiply_xyza_loop(image->gif.frame_image,
+							 area);
+		} else {
+			image->animation_frame_cache = alloc_mem(
+				image, mem_usage,
+				image->gif.frame_count * sizeof(uint8_t *));
+			image->animation_frame_data = alloc_mem(
+				image, mem_usage,
+				get_full_decoded_gif_size(image));
+
+			for (unsigned int i = 0; i < image->gif.frame_count;
+			     i++) {
+				if (gif_decode_frame(&image->gif, i) == GIF_OK)
+					cache_frame(image, (int)i, alpha_mode);
+				else
+					blog(LOG_WARNING,
+					     "Couldn't decode frame %u "
+					     "of '%s'",
+					     i, path);
+			}
+		}
 
 		if (mem_usage) {
 			*mem_usage += (size_t)4 * image->cx * image->cy;
 			*mem_usage += size;
 		}
-
-		if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY_SRGB) {
-			gs_premultiply_xyza_srgb_loop(image->gif.frame_image,
-						      (size_t)image->cx *
-							      image->cy);
-		} else if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY) {
-			gs_premultiply_xyza_loop(image->gif.frame_image,
-						 (size_t)image->cx * image->cy);
-		}
 	} else {
 		gif_finalise(&image->gif);
 		bfree(image->gif_data);
@@ -244,6 +627,7 @@ void gs_image_file_free(gs_image_file_t *image)
 
 	if (image->loaded) {
 		if (image->is_animated_gif) {
+			gif_stream_destroy(take_gif_stream(image));
 			gif_finalise(&image->gif);
 			bfree(image->animation_frame_cache);
 			bfree(image->animation_frame_data);
@@ -283,15 +667,26 @@ void gs_image_file4_init(gs_image_file4_t *if4, const char *file,
 	if4->image3.alpha_mode = alpha_mode;
 }
 
+void gs_image_file_set_gif_cache_budget(uint64_t bytes)
+{
+	gif_cache_budget = bytes;
+}
+
 void gs_image_file_init_texture(gs_image_file_t *image)
 {
 	if (!image->loaded)
 		return;
 
 	if (image->is_animated_gif) {
-		image->texture = gs_texture_create(
-			image->cx, image->cy, image->format, 1,
-			(const uint8_t **)&image->gif.frame_image, GS_DYNAMIC);
+		const uint8_t *data = image->gif.frame_image;
+
+		if (image->animation_frame_cache &&
+		    image->animation_frame_cache[image->cur_frame])
+			data = image->animation_frame_cache[image->cur_frame];
+
+		image->texture = gs_texture_create(image->cx, image->cy,
+						   image->format, 1, &data,
+						   GS_DYNAMIC);
 
 	} else {
 		image->texture = gs_texture_create(
@@ -338,7 +733,9 @@ static inline int calculate_new_frame(gs_image_file_t *image,
 static void decode_new_frame(gs_image_file_t *image, int new_frame,
 			     enum gs_image_alpha_mode alpha_mode)
 {
-	if (!image->animation_frame_cache[new_frame]) {
+	if (get_gif_stream(image)) {
+		/* picked up from the stream when the texture is updated */
+	} else if (!image->animation_frame_cache[new_frame]) {
 		int last_frame;
 
 		/* if looped, decode frame 0 */
@@ -353,26 +750,8 @@ static void decode_new_frame(gs_image_file_t *image, int new_frame,
 		}
 
 		/* decode actual desired frame */
-		if (gif_decode_frame(&image->gif, new_frame) == GIF_OK) {
-			const size_t area =
-				(size_t)image->gif.width * image->gif.height;
-			size_t pos = new_frame * area * 4;
-			image->animation_frame_cache[new_frame] =
-				image->animation_frame_data + pos;
-
-			if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY_SRGB) {
-				gs_premultiply_xyza_srgb_loop(
-					image->gif.frame_image, area);
-			} else if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY) {
-				gs_premultiply_xyza_loop(image->gif.frame_image,
-							 area);
-			}
-
-			memcpy(image->animation_frame_cache[new_frame],
-			       image->gif.frame_image, area * 4);
-
-			image->last_decoded_frame = new_frame;
-		}
+		if (gif_decode_frame(&image->gif, new_frame) == GIF_OK)
+			cache_frame(image, new_frame, alpha_mode);
 	}
 
 	image->cur_frame = new_frame;
@@ -382,6 +761,7 @@ static bool gs_image_file_tick_internal(gs_image_file_t *image,
 					uint64_t elapsed_time_ns,
 					enum gs_image_alpha_mode alpha_mode)
 {
+	struct gs_gif_stream *stream;
 	int loops;
 
 	if (!image->is_animated_gif || !image->loaded)
@@ -401,7 +781,9 @@ static bool gs_image_file_tick_internal(gs_image_file_t *image,
 		}
 	}
 
-	return false;
+	/* keeps retrying until the stream has decoded the frame */
+	stream = get_gif_stream(image);
+	return stream && stream->shown_frame != image->cur_frame;
 }
 
 bool gs_image_file_tick(gs_image_file_t *image, uint64_t elapsed_time_ns)
@@ -431,9 +813,23 @@ static void
 gs_image_file_update_texture_internal(gs_image_file_t *image,
 				      enum gs_image_alpha_mode alpha_mode)
 {
+	struct gs_gif_stream *stream;
+
 	if (!image->is_animated_gif || !image->loaded)
 		return;
 
+	stream = get_gif_stream(image);
+	if (stream) {
+		uint8_t *data = gif_stream_get_frame(stream, image->cur_frame);
+
+		if (data) {
+			gs_texture_set_image(image->texture, data,
+					     image->gif.width * 4, false);
+			stream->shown_frame = image->cur_frame;
+		}
+		return;
+	}
+
 	if (!image->animation_frame_cache[image->cur_frame])
 		decode_new_frame(image, image->cur_frame, alpha_mode);
 
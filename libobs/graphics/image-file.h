@@ -69,6 +69,8 @@ typedef struct gs_image_file4 gs_image_file4_t;
 EXPORT void gs_image_file_init(gs_image_file_t *image, const char *file);
 EXPORT void gs_image_file_free(gs_image_file_t *image);
 
+EXPORT void gs_image_file_set_gif_cache_budget(uint64_t bytes);
+
 EXPORT void gs_image_file_init_texture(gs_image_file_t *image);
 EXPORT bool gs_image_file_tick(gs_image_file_t *image,
 			       uint64_t elapsed_time_ns);
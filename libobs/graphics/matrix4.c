@@ -61,18 +61,37 @@ void matrix4_mul(struct matrix4 *dst, const struct matrix4 *m1,
 		 const struct matrix4 *m2)
 {
 	const struct vec4 *m1v = (const struct vec4 *)m1;
-	const float *m2f = (const float *)m2;
 	struct vec4 out[4];
-	int i, j;
+	int i;
+
+#ifdef NO_INTRINSICS
+	const float *m2f = (const float *)m2;
 
 	for (i = 0; i < 4; i++) {
-		for (j = 0; j < 4; j++) {
+		for (int j = 0; j < 4; j++) {
 			struct vec4 temp;
 			vec4_set(&temp, m2f[j], m2f[j + 4], m2f[j + 8],
 				 m2f[j + 12]);
 			out[i].ptr[j] = vec4_dot(&m1v[i], &temp);
 		}
 	}
+#else
+	/* each output row is a linear combination of the rows of m2, which
+	 * needs no transposing or horizontal adds */
+	for (i = 0; i < 4; i++) {
+		__m128 row = m1v[i].m;
+		__m128 r;
+
+		r = _mm_mul_ps(_mm_shuffle_ps(row, row, 0x00), m2->x.m);
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(row, row, 0x55),
+					     m2->y.m));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(row, row, 0xAA),
+					     m2->z.m));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(row, row, 0xFF),
+					     m2->t.m));
+		out[i].m = r;
+	}
+#endif
 
 	matrix4_copy(dst, (struct matrix4 *)out);
 }
@@ -128,28 +147,45 @@ float matrix4_determinant(const struct matrix4 *m)
 	return result;
 }
 
+/* m * translation only adds each row's w times the offset, so there is no
+ * need for a full multiply */
+static inline void translate_rows(struct matrix4 *dst, const struct matrix4 *m,
+				  float x, float y, float z)
+{
+	struct vec4 offset;
+	struct vec4 *dstv = (struct vec4 *)dst;
+	const struct vec4 *mv = (const struct vec4 *)m;
+
+	vec4_set(&offset, x, y, z, 0.0f);
+
+	for (int i = 0; i < 4; i++) {
+		struct vec4 add;
+		vec4_mulf(&add, &offset, mv[i].w);
+		vec4_add(&dstv[i], &mv[i], &add);
+	}
+}
+
 void matrix4_translate3v(struct matrix4 *dst, const struct matrix4 *m,
 			 const struct vec3 *v)
 {
-	struct matrix4 temp;
-	vec4_set(&temp.x, 1.0f, 0.0f, 0.0f, 0.0f);
-	vec4_set(&temp.y, 0.0f, 1.0f, 0.0f, 0.0f);
-	vec4_set(&temp.z, 0.0f, 0.0f, 1.0f, 0.0f);
-	vec4_from_vec3(&temp.t, v);
-
-	matrix4_mul(dst, m, &temp);
+	translate_rows(dst, m, v->x, v->y, v->z);
 }
 
 void matrix4_translate4v(struct matrix4 *dst, const struct matrix4 *m,
 			 const struct vec4 *v)
 {
-	struct matrix4 temp;
-	vec4_set(&temp.x, 1.0f, 0.0f, 0.0f, 0.0f);
-	vec4_set(&temp.y, 0.0f, 1.0f, 0.0f, 0.0f);
-	vec4_set(&temp.z, 0.0f, 0.0f, 1.0f, 0.0f);
-	vec4_copy(&temp.t, v);
+	if (v->w != 1.0f) {
+		struct matrix4 temp;
+		vec4_set(&temp.x, 1.0f, 0.0f, 0.0f, 0.0f);
+		vec4_set(&temp.y, 0.0f, 1.0f, 0.0f, 0.0f);
+		vec4_set(&temp.z, 0.0f, 0.0f, 1.0f, 0.0f);
+		vec4_copy(&temp.t, v);
+
+		matrix4_mul(dst, m, &temp);
+		return;
+	}
 
-	matrix4_mul(dst, m, &temp);
+	translate_rows(dst, m, v->x, v->y, v->z);
 }
 
 void matrix4_rotate(struct matrix4 *dst, const struct matrix4 *m,
@@ -171,24 +207,35 @@ void matrix4_rotate_aa(struct matrix4 *dst, const struct matrix4 *m,
 void matrix4_scale(struct matrix4 *dst, const struct matrix4 *m,
 		   const struct vec3 *v)
 {
-	struct matrix4 temp;
-	vec4_set(&temp.x, v->x, 0.0f, 0.0f, 0.0f);
-	vec4_set(&temp.y, 0.0f, v->y, 0.0f, 0.0f);
-	vec4_set(&temp.z, 0.0f, 0.0f, v->z, 0.0f);
-	vec4_set(&temp.t, 0.0f, 0.0f, 0.0f, 1.0f);
-	matrix4_mul(dst, m, &temp);
+	struct vec4 scale;
+	vec4_set(&scale, v->x, v->y, v->z, 1.0f);
+
+	vec4_mul(&dst->x, &m->x, &scale);
+	vec4_mul(&dst->y, &m->y, &scale);
+	vec4_mul(&dst->z, &m->z, &scale);
+	vec4_mul(&dst->t, &m->t, &scale);
 }
 
 void matrix4_translate3v_i(struct matrix4 *dst, const struct vec3 *v,
 			   const struct matrix4 *m)
 {
-	struct matrix4 temp;
-	vec4_set(&temp.x, 1.0f, 0.0f, 0.0f, 0.0f);
-	vec4_set(&temp.y, 0.0f, 1.0f, 0.0f, 0.0f);
-	vec4_set(&temp.z, 0.0f, 0.0f, 1.0f, 0.0f);
-	vec4_from_vec3(&temp.t, v);
-
-	matrix4_mul(dst, &temp, m);
+	struct vec4 t;
+	struct vec4 temp;
+
+	/* translation * m only changes the last row */
+	vec4_mulf(&t, &m->x, v->x);
+	vec4_mulf(&temp, &m->y, v->y);
+	vec4_add(&t, &t, &temp);
+	vec4_mulf(&temp, &m->z, v->z);
+	vec4_add(&t, &t, &temp);
+	vec4_add(&t, &t, &m->t);
+
+	if (dst != m) {
+		vec4_copy(&dst->x, &m->x);
+		vec4_copy(&dst->y, &m->y);
+		vec4_copy(&dst->z, &m->z);
+	}
+	vec4_copy(&dst->t, &t);
 }
 
 void matrix4_translate4v_i(struct matrix4 *dst, const struct vec4 *v,
@@ -222,12 +269,10 @@ void matrix4_rotate_aa_i(struct matrix4 *dst, const struct axisang *aa,
 void matrix4_scale_i(struct matrix4 *dst, const struct vec3 *v,
 		     const struct matrix4 *m)
 {
-	struct matrix4 temp;
-	vec4_set(&temp.x, v->x, 0.0f, 0.0f, 0.0f);
-	vec4_set(&temp.y, 0.0f, v->y, 0.0f, 0.0f);
-	vec4_set(&temp.z, 0.0f, 0.0f, v->z, 0.0f);
-	vec4_set(&temp.t, 0.0f, 0.0f, 0.0f, 1.0f);
-	matrix4_mul(dst, &temp, m);
+	vec4_mulf(&dst->x, &m->x, v->x);
+	vec4_mulf(&dst->y, &m->y, v->y);
+	vec4_mulf(&dst->z, &m->z, v->z);
+	vec4_copy(&dst->t, &m->t);
 }
 
 bool matrix4_inv(struct matrix4 *dst, const struct matrix4 *m)
@@ -18,10 +18,25 @@
 /*
  *   This is a set of helper functions to more easily render to textures
  * without having to duplicate too much code.
+ *
+ *   Render targets are shared between texrenders through a pool owned by the
+ * graphics context: a texrender that is destroyed or resized gives its target
+ * back to the pool, and a texrender needing a target of the same size and
+ * format takes it from there instead of creating a new one.  Leased
+ * texrenders also give their target back when they have not been used for a
+ * frame.  Idle targets are destroyed after a while, or when the pool holds
+ * too much memory.
  */
 
 #include <assert.h>
-#include "graphics.h"
+#include "graphics-internal.h"
+
+/* frames a leased texrender can go unused before its target is taken back */
+#define LEASE_IDLE_FRAMES 1
+
+/* frames an idle target stays in the pool, and the most memory kept in it */
+#define POOL_IDLE_FRAMES 300
+#define POOL_MAX_BYTES (256ULL * 1024 * 1024)
 
 struct gs_texture_render {
 	gs_texture_t *target, *prev_target;
@@ -34,41 +49,53 @@ struct gs_texture_render {
 	enum gs_zstencil_format zsformat;
 
 	bool rendered;
+
+	bool leased;
+	uint64_t last_frame;
+	struct gs_texture_render *next_leased;
+	struct gs_texture_render **prev_next_leased;
 };
 
-gs_texrender_t *gs_texrender_create(enum gs_color_format format,
-				    enum gs_zstencil_format zsformat)
+static uint64_t render_target_size(uint32_t cx, uint32_t cy,
+				   enum gs_color_format format,
+				   enum gs_zstencil_format zsformat)
 {
-	struct gs_texture_render *texrender;
-	texrender = bzalloc(sizeof(struct gs_texture_render));
-	texrender->format = format;
-	texrender->zsformat = zsformat;
+	uint32_t bpp = gs_get_format_bpp(format);
+
+	switch (zsformat) {
+	case GS_ZS_NONE:
+		break;
+	case GS_Z16:
+		bpp += 16;
+		break;
+	case GS_Z24_S8:
+	case GS_Z32F:
+		bpp += 32;
+		break;
+	case GS_Z32F_S8X24:
+		bpp += 64;
+		break;
+	}
 
-	return texrender;
+	return (uint64_t)cx * cy * bpp / 8;
 }
 
-void gs_texrender_destroy(gs_texrender_t *texrender)
+static inline uint64_t texrender_size(const gs_texrender_t *texrender)
 {
-	if (texrender) {
-		gs_texture_destroy(texrender->target);
-		gs_zstencil_destroy(texrender->zs);
-		bfree(texrender);
-	}
+	return render_target_size(texrender->cx, texrender->cy,
+				  texrender->format, texrender->zsformat);
 }
 
-static bool texrender_resetbuffer(gs_texrender_t *texrender, uint32_t cx,
-				  uint32_t cy)
+static void destroy_target(struct gs_render_target *target)
 {
-	if (!texrender)
-		return false;
-
-	gs_texture_destroy(texrender->target);
-	gs_zstencil_destroy(texrender->zs);
+	gs_texture_destroy(target->tex);
+	gs_zstencil_destroy(target->zs);
+}
 
-	texrender->target = NULL;
-	texrender->zs = NULL;
-	texrender->cx = cx;
-	texrender->cy = cy;
+static bool create_target(gs_texrender_t *texrender)
+{
+	uint32_t cx = texrender->cx;
+	uint32_t cy = texrender->cy;
 
 	texrender->target = gs_texture_create(cx, cy, texrender->format, 1,
 					      NULL, GS_RENDER_TARGET);
@@ -88,6 +115,154 @@ static bool texrender_resetbuffer(gs_texrender_t *texrender, uint32_t cx,
 	return true;
 }
 
+static bool take_pooled_target(struct gs_texrender_pool *pool,
+			       gs_texrender_t *texrender)
+{
+	/* most recently returned targets first */
+	for (size_t i = pool->targets.num; i > 0; i--) {
+		struct gs_render_target *target = &pool->targets.array[i - 1];
+
+		if (target->cx == texrender->cx &&
+		    target->cy == texrender->cy &&
+		    target->format == texrender->format &&
+		    target->zsformat == texrender->zsformat) {
+			texrender->target = target->tex;
+			texrender->zs = target->zs;
+
+			pool->stats.pooled--;
+			pool->stats.pooled_bytes -= target->size;
+			pool->stats.reused++;
+			da_erase(pool->targets, i - 1);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool acquire_target(gs_texrender_t *texrender)
+{
+	graphics_t *graphics = gs_get_context();
+	struct gs_texrender_pool *pool;
+
+	if (!graphics)
+		return create_target(texrender);
+
+	pool = &graphics->texrender_pool;
+
+	if (!take_pooled_target(pool, texrender)) {
+		if (!create_target(texrender))
+			return false;
+		pool->stats.created++;
+	}
+
+	pool->stats.used++;
+	pool->stats.used_bytes += texrender_size(texrender);
+
+	if (texrender->leased) {
+		texrender->last_frame = pool->frame;
+		texrender->next_leased = pool->first_leased;
+		texrender->prev_next_leased = &pool->first_leased;
+		if (pool->first_leased)
+			pool->first_leased->prev_next_leased =
+				&texrender->next_leased;
+		pool->first_leased = texrender;
+	}
+
+	return true;
+}
+
+static void release_target(gs_texrender_t *texrender)
+{
+	graphics_t *graphics = gs_get_context();
+	struct gs_render_target target = {
+		.tex = texrender->target,
+		.zs = texrender->zs,
+		.cx = texrender->cx,
+		.cy = texrender->cy,
+		.format = texrender->format,
+		.zsformat = texrender->zsformat,
+	};
+
+	if (!texrender->target)
+		return;
+
+	texrender->target = NULL;
+	texrender->zs = NULL;
+
+	if (texrender->prev_next_leased) {
+		*texrender->prev_next_leased = texrender->next_leased;
+		if (texrender->next_leased)
+			texrender->next_leased->prev_next_leased =
+				texrender->prev_next_leased;
+		texrender->next_leased = NULL;
+		texrender->prev_next_leased = NULL;
+	}
+
+	if (!graphics) {
+		destroy_target(&target);
+		return;
+	}
+
+	struct gs_texrender_pool *pool = &graphics->texrender_pool;
+
+	target.size = texrender_size(texrender);
+	target.idle_frame = pool->frame;
+
+	pool->stats.used--;
+	pool->stats.used_bytes -= target.size;
+	pool->stats.pooled++;
+	pool->stats.pooled_bytes += target.size;
+	da_push_back(pool->targets, &target);
+}
+
+static gs_texrender_t *texrender_create(enum gs_color_format format,
+					enum gs_zstencil_format zsformat,
+					bool leased)
+{
+	struct gs_texture_render *texrender;
+	texrender = bzalloc(sizeof(struct gs_texture_render));
+	texrender->format = format;
+	texrender->zsformat = zsformat;
+	texrender->leased = leased;
+
+	return texrender;
+}
+
+gs_texrender_t *gs_texrender_create(enum gs_color_format format,
+				    enum gs_zstencil_format zsformat)
+{
+	return texrender_create(format, zsformat, false);
+}
+
+gs_texrender_t *gs_texrender_create_leased(enum gs_color_format format,
+					   enum gs_zstencil_format zsformat)
+{
+	return texrender_create(format, zsformat, true);
+}
+
+void gs_texrender_destroy(gs_texrender_t *texrender)
+{
+	if (texrender) {
+		release_target(texrender);
+		bfree(texrender);
+	}
+}
+
+static bool texrender_resetbuffer(gs_texrender_t *texrender, uint32_t cx,
+				  uint32_t cy)
+{
+	if (!texrender)
+		return false;
+
+	release_target(texrender);
+
+	texrender->cx = cx;
+	texrender->cy = cy;
+
+	return acquire_target(texrender);
+}
+
 bool gs_texrender_begin(gs_texrender_t *texrender, uint32_t cx, uint32_t cy)
 {
 	return gs_texrender_begin_with_color_space(texrender, cx, cy,
@@ -97,7 +272,16 @@ bool gs_texrender_begin(gs_texrender_t *texrender, uint32_t cx, uint32_t cy)
 bool gs_texrender_begin_with_color_space(gs_texrender_t *texrender, uint32_t cx,
 					 uint32_t cy, enum gs_color_space space)
 {
-	if (!texrender || texrender->rendered)
+	if (!texrender)
+		return false;
+
+	if (texrender->leased) {
+		graphics_t *graphics = gs_get_context();
+		if (graphics)
+			texrender->last_frame = graphics->texrender_pool.frame;
+	}
+
+	if (texrender->rendered)
 		return false;
 
 	if (!cx || !cy)
@@ -157,3 +341,70 @@ enum gs_color_format gs_texrender_get_format(const gs_texrender_t *texrender)
 {
 	return texrender->format;
 }
+
+void gs_texrender_pool_get_stats(struct gs_texrender_pool_stats *stats)
+{
+	graphics_t *graphics = gs_get_context();
+
+	if (!graphics || !stats)
+		return;
+
+	*stats = graphics->texrender_pool.stats;
+}
+
+static void free_pooled_target(struct gs_texrender_pool *pool, size_t idx)
+{
+	struct gs_render_target *target = &pool->targets.array[idx];
+
+	pool->stats.pooled--;
+	pool->stats.pooled_bytes -= target->size;
+	destroy_target(target);
+	da_erase(pool->targets, idx);
+}
+
+/* called within the graphics context at the start of each frame */
+void texrender_pool_begin_frame(graphics_t *graphics)
+{
+	struct gs_texrender_pool *pool = &graphics->texrender_pool;
+	gs_texrender_t *texrender = pool->first_leased;
+
+	while (texrender) {
+		gs_texrender_t *next = texrender->next_leased;
+
+		if (pool->frame - texrender->last_frame >= LEASE_IDLE_FRAMES) {
+			release_target(texrender);
+			texrender->cx = 0;
+			texrender->cy = 0;
+			texrender->rendered = false;
+		}
+
+		texrender = next;
+	}
+
+	/* targets are in the order they were returned */
+	while (pool->targets.num &&
+	       (pool->stats.pooled_bytes > POOL_MAX_BYTES ||
+		pool->frame - pool->targets.array[0].idle_frame >=
+			POOL_IDLE_FRAMES))
+		free_pooled_target(pool, 0);
+
+	pool->frame++;
+}
+
+void texrender_pool_free(graphics_t *graphics)
+{
+	struct gs_texrender_pool *pool = &graphics->texrender_pool;
+
+	while (pool->targets.num)
+		free_pooled_target(pool, pool->targets.num - 1);
+	da_free(pool->targets);
+
+	/* texrenders still alive keep their targets */
+	while (pool->first_leased) {
+		gs_texrender_t *texrender = pool->first_leased;
+
+		pool->first_leased = texrender->next_leased;
+		texrender->next_leased = NULL;
+		texrender->prev_next_leased = NULL;
+	}
+}
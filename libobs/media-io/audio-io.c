@@ -75,6 +75,7 @@ struct audio_output {
 
 	audio_input_callback_t input_cb;
 	void *input_param;
+	uint32_t catch_up_ticks;
 	pthread_mutex_t input_mutex;
 	struct audio_mix mixes[MAX_AUDIO_MIXES];
 };
@@ -240,6 +241,11 @@ static void *audio_thread(void *param)
 		input_and_output(audio, audio_time, prev_time);
 		prev_time = audio_time;
 
+		while (audio->catch_up_ticks) {
+			audio->catch_up_ticks--;
+			input_and_output(audio, audio_time, audio_time);
+		}
+
 		profile_end(audio_thread_name);
 
 		profile_reenable_thread();
@@ -437,6 +443,12 @@ const struct audio_output_info *audio_output_get_info(const audio_t *audio)
 	return audio ? &audio->info : NULL;
 }
 
+void audio_output_catch_up(audio_t *audio, uint32_t ticks)
+{
+	if (audio)
+		audio->catch_up_ticks += ticks;
+}
+
 bool audio_output_active(const audio_t *audio)
 {
 	if (!audio)
@@ -85,6 +85,8 @@ struct audio_output_data {
 	float *data[MAX_AUDIO_CHANNELS];
 };
 
+/* start_ts == end_ts for ticks requested with audio_output_catch_up, which
+ * are mixed right after the current one without a new time window */
 typedef bool (*audio_input_callback_t)(void *param, uint64_t start_ts,
 				       uint64_t end_ts, uint64_t *new_ts,
 				       uint32_t active_mixers,
@@ -231,6 +233,10 @@ EXPORT void audio_output_disconnect(audio_t *video, size_t mix_idx,
 
 EXPORT bool audio_output_active(const audio_t *audio);
 
+/** Mixes additional ticks right after the current one, to reduce buffering.
+ * Can only be called from the input callback. */
+EXPORT void audio_output_catch_up(audio_t *audio, uint32_t ticks);
+
 EXPORT size_t audio_output_get_block_size(const audio_t *audio);
 EXPORT size_t audio_output_get_planes(const audio_t *audio);
 EXPORT size_t audio_output_get_channels(const audio_t *audio);
@@ -17,12 +17,15 @@
 
 #include "../util/bmem.h"
 #include "audio-resampler.h"
+#include "audio-resampler-sinc.h"
 #include "audio-io.h"
 #include <libavutil/avutil.h>
 #include <libavformat/avformat.h>
 #include <libswresample/swresample.h>
 
 struct audio_resampler {
+	struct sinc_resampler *sinc;
+
 	struct SwrContext *context;
 	bool opened;
 
@@ -97,12 +100,17 @@ static inline uint64_t convert_speaker_layout(enum speaker_layout layout)
 }
 #endif
 
-audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
-					  const struct resample_info *src)
+audio_resampler_t *audio_resampler_create2(const struct resample_info *dst,
+					   const struct resample_info *src,
+					   enum audio_resampler_quality quality)
 {
 	struct audio_resampler *rs = bzalloc(sizeof(struct audio_resampler));
 	int errcode;
 
+	rs->sinc = sinc_resampler_create(dst, src, quality);
+	if (rs->sinc)
+		return rs;
+
 	rs->opened = false;
 	rs->input_freq = src->samples_per_sec;
 	rs->input_format = convert_audio_format(src->format);
@@ -178,9 +186,17 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 	return rs;
 }
 
+audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
+					  const struct resample_info *src)
+{
+	return audio_resampler_create2(dst, src,
+				       AUDIO_RESAMPLER_QUALITY_MEDIUM);
+}
+
 void audio_resampler_destroy(audio_resampler_t *rs)
 {
 	if (rs) {
+		sinc_resampler_destroy(rs->sinc);
 		if (rs->context)
 			swr_free(&rs->context);
 		if (rs->output_buffer[0])
@@ -196,6 +212,9 @@ bool audio_resampler_resample(audio_resampler_t *rs, uint8_t *output[],
 {
 	if (!rs)
 		return false;
+	if (rs->sinc)
+		return sinc_resampler_resample(rs->sinc, output, out_frames,
+					       ts_offset, input, in_frames);
 
 	struct SwrContext *context = rs->context;
 	int ret;
@@ -0,0 +1,559 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+
+#include "../util/bmem.h"
+#include "../util/threading.h"
+#include "../util/sse-intrin.h"
+#include "audio-resampler-sinc.h"
+
+/* rate ratios that would need more phases than this (44100 -> 48000 needs
+ * 160) are left to swresample */
+#define MAX_PHASES 1024
+
+#define SINC_PI 3.14159265358979323846
+
+struct quality_preset {
+	size_t half_taps; /* kernel taps on each side when upsampling */
+	double beta;      /* kaiser window shape */
+	double rolloff;   /* cutoff, relative to the lower nyquist frequency */
+};
+
+static const struct quality_preset presets[] = {
+	[AUDIO_RESAMPLER_QUALITY_LOW] = {8, 6.0, 0.90},
+	[AUDIO_RESAMPLER_QUALITY_MEDIUM] = {16, 8.0, 0.94},
+	[AUDIO_RESAMPLER_QUALITY_HIGH] = {32, 10.0, 0.97},
+};
+
+/* ------------------------------------------------------------------------- */
+/* filter tables, shared by all resamplers with the same ratio and quality   */
+
+struct resample_filter {
+	struct resample_filter *next;
+	long refs;
+
+	uint32_t up;
+	uint32_t down;
+	enum audio_resampler_quality quality;
+
+	size_t half_len; /* input frames on each side of the kernel center */
+	size_t taps;     /* kernel length, padded to a multiple of 8 */
+	float *coeffs;   /* one kernel per phase */
+};
+
+static pthread_mutex_t filters_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct resample_filter *filters = NULL;
+
+static double bessel_i0(double x)
+{
+	double half_x = x * 0.5;
+	double term = 1.0;
+	double sum = 1.0;
+
+	for (int k = 1; k < 64; k++) {
+		term *= (half_x / k) * (half_x / k);
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+
+	return sum;
+}
+
+static inline double sinc(double x)
+{
+	return x == 0.0 ? 1.0 : sin(SINC_PI * x) / (SINC_PI * x);
+}
+
+/* Kaiser windowed sinc, normalized per phase so that every phase has unity
+ * gain at DC.  When downsampling, the kernel is stretched so the cutoff sits
+ * below the output nyquist frequency. */
+static void build_filter(struct resample_filter *filter)
+{
+	const struct quality_preset *preset = &presets[filter->quality];
+	double scale = filter->up < filter->down
+			       ? (double)filter->up / (double)filter->down
+			       : 1.0;
+	double cutoff = preset->rolloff * scale;
+	double i0_beta = bessel_i0(preset->beta);
+	size_t raw_taps;
+
+	filter->half_len = (size_t)ceil((double)preset->half_taps / scale);
+	raw_taps = filter->half_len * 2;
+	filter->taps = (raw_taps + 7) & ~(size_t)7;
+	filter->coeffs =
+		bzalloc(sizeof(float) * filter->taps * (size_t)filter->up);
+
+	for (uint32_t p = 0; p < filter->up; p++) {
+		float *kernel = filter->coeffs + filter->taps * p;
+		double frac = (double)p / (double)filter->up;
+		double sum = 0.0;
+
+		for (size_t k = 0; k < raw_taps; k++) {
+			double t = (double)k - (double)(filter->half_len - 1) -
+				   frac;
+			double x = t / (double)filter->half_len;
+			double w = 0.0;
+			double val;
+
+			if (x * x < 1.0)
+				w = bessel_i0(preset->beta *
+					      sqrt(1.0 - x * x)) /
+				    i0_beta;
+
+			val = cutoff * sinc(cutoff * t) * w;
+			kernel[k] = (float)val;
+			sum += val;
+		}
+
+		for (size_t k = 0; k < raw_taps; k++)
+			kernel[k] = (float)((double)kernel[k] / sum);
+	}
+}
+
+static struct resample_filter *
+get_filter(uint32_t up, uint32_t down, enum audio_resampler_quality quality)
+{
+	struct resample_filter *filter;
+
+	pthread_mutex_lock(&filters_mutex);
+
+	filter = filters;
+	while (filter) {
+		if (filter->up == up && filter->down == down &&
+		    filter->quality == quality)
+			break;
+		filter = filter->next;
+	}
+
+	if (filter) {
+		filter->refs++;
+	} else {
+		filter = bzalloc(sizeof(struct resample_filter));
+		filter->refs = 1;
+		filter->up = up;
+		filter->down = down;
+		filter->quality = quality;
+		build_filter(filter);
+
+		filter->next = filters;
+		filters = filter;
+	}
+
+	pthread_mutex_unlock(&filters_mutex);
+	return filter;
+}
+
+static void release_filter(struct resample_filter *filter)
+{
+	struct resample_filter **prev_next;
+
+	pthread_mutex_lock(&filters_mutex);
+
+	if (--filter->refs == 0) {
+		prev_next = &filters;
+		while (*prev_next != filter)
+			prev_next = &(*prev_next)->next;
+		*prev_next = filter->next;
+
+		bfree(filter->coeffs);
+		bfree(filter);
+	}
+
+	pthread_mutex_unlock(&filters_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct sinc_resampler {
+	struct resample_filter *filter; /* NULL if only converting the format */
+
+	uint32_t in_rate;
+	uint32_t channels;
+	enum audio_format in_format;
+	enum audio_format out_format;
+
+	/* pending input, converted to float planar */
+	float *in_buf[MAX_AUDIO_CHANNELS];
+	size_t in_frames;
+	size_t in_capacity;
+
+	/* position of the next output frame: in_buf[pos] is the first frame
+	 * under the kernel, phase / up the fractional offset */
+	size_t pos;
+	uint32_t phase;
+
+	float *out_buf[MAX_AUDIO_CHANNELS];
+	size_t out_capacity;
+
+	/* output for formats other than float planar */
+	uint8_t *out_data;
+	size_t out_data_size;
+};
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+	while (b) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static inline bool format_valid(enum audio_format format)
+{
+	return format != AUDIO_FORMAT_UNKNOWN;
+}
+
+static void ensure_input(struct sinc_resampler *rs, size_t frames)
+{
+	if (frames <= rs->in_capacity)
+		return;
+
+	rs->in_capacity = frames * 2;
+	for (uint32_t c = 0; c < rs->channels; c++)
+		rs->in_buf[c] = brealloc(rs->in_buf[c],
+					 rs->in_capacity * sizeof(float));
+}
+
+static void ensure_output(struct sinc_resampler *rs, size_t frames)
+{
+	if (frames <= rs->out_capacity)
+		return;
+
+	rs->out_capacity = frames * 2;
+	for (uint32_t c = 0; c < rs->channels; c++)
+		rs->out_buf[c] = brealloc(rs->out_buf[c],
+					  rs->out_capacity * sizeof(float));
+}
+
+struct sinc_resampler *
+sinc_resampler_create(const struct resample_info *dst,
+		      const struct resample_info *src,
+		      enum audio_resampler_quality quality)
+{
+	struct sinc_resampler *rs;
+	uint32_t div;
+	uint32_t up;
+	uint32_t down;
+
+	if (!format_valid(src->format) || !format_valid(dst->format))
+		return NULL;
+	if (src->speakers != dst->speakers ||
+	    src->speakers == SPEAKERS_UNKNOWN)
+		return NULL;
+	if (!src->samples_per_sec || !dst->samples_per_sec)
+		return NULL;
+	if ((size_t)quality >= sizeof(presets) / sizeof(presets[0]))
+		return NULL;
+
+	div = gcd(src->samples_per_sec, dst->samples_per_sec);
+	up = dst->samples_per_sec / div;
+	down = src->samples_per_sec / div;
+	if (up > MAX_PHASES)
+		return NULL;
+
+	rs = bzalloc(sizeof(struct sinc_resampler));
+	rs->in_rate = src->samples_per_sec;
+	rs->channels = get_audio_channels(src->speakers);
+	rs->in_format = src->format;
+	rs->out_format = dst->format;
+
+	if (up != down) {
+		rs->filter = get_filter(up, down, quality);
+
+		/* prime with silence so that the first output frame is
+		 * centered on the first input frame */
+		rs->in_frames = rs->filter->half_len - 1;
+		ensure_input(rs, rs->in_frames);
+		for (uint32_t c = 0; c < rs->channels; c++)
+			memset(rs->in_buf[c], 0, rs->in_frames * sizeof(float));
+	}
+
+	return rs;
+}
+
+void sinc_resampler_destroy(struct sinc_resampler *rs)
+{
+	if (!rs)
+		return;
+
+	if (rs->filter)
+		release_filter(rs->filter);
+
+	for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++) {
+		bfree(rs->in_buf[c]);
+		bfree(rs->out_buf[c]);
+	}
+
+	bfree(rs->out_data);
+	bfree(rs);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void convert_input(float *const dst[], size_t offset,
+			  enum audio_format format, uint32_t channels,
+			  const uint8_t *const input[], uint32_t frames)
+{
+	bool planar = is_audio_planar(format);
+	size_t stride = planar ? 1 : channels;
+
+	for (uint32_t c = 0; c < channels; c++) {
+		const uint8_t *plane = planar ? input[c] : input[0];
+		size_t first = planar ? 0 : c;
+		float *out = dst[c] + offset;
+
+		switch (format) {
+		case AUDIO_FORMAT_U8BIT:
+		case AUDIO_FORMAT_U8BIT_PLANAR: {
+			const uint8_t *in = plane + first;
+			for (uint32_t i = 0; i < frames; i++)
+				out[i] = ((float)in[i * stride] - 128.0f) *
+					 (1.0f / 128.0f);
+			break;
+		}
+		case AUDIO_FORMAT_16BIT:
+		case AUDIO_FORMAT_16BIT_PLANAR: {
+			const int16_t *in = (const int16_t *)plane + first;
+			for (uint32_t i = 0; i < frames; i++)
+				out[i] = (float)in[i * stride] *
+					 (1.0f / 32768.0f);
+			break;
+		}
+		case AUDIO_FORMAT_32BIT:
+		case AUDIO_FORMAT_32BIT_PLANAR: {
+			const int32_t *in = (const int32_t *)plane + first;
+			for (uint32_t i = 0; i < frames; i++)
+				out[i] = (float)((double)in[i * stride] *
+						 (1.0 / 2147483648.0));
+			break;
+		}
+		case AUDIO_FORMAT_FLOAT:
+		case AUDIO_FORMAT_FLOAT_PLANAR: {
+			const float *in = (const float *)plane + first;
+			if (planar) {
+				memcpy(out, in, frames * sizeof(float));
+				break;
+			}
+			for (uint32_t i = 0; i < frames; i++)
+				out[i] = in[i * stride];
+			break;
+		}
+		case AUDIO_FORMAT_UNKNOWN:
+			break;
+		}
+	}
+}
+
+static inline float clampf(float val, float min_val, float max_val)
+{
+	return val < min_val ? min_val : (val > max_val ? max_val : val);
+}
+
+static void convert_output(uint8_t *const dst[], enum audio_format format,
+			   uint32_t channels, float *const src[],
+			   uint32_t frames)
+{
+	bool planar = is_audio_planar(format);
+	size_t stride = planar ? 1 : channels;
+
+	for (uint32_t c = 0; c < channels; c++) {
+		uint8_t *plane = planar ? dst[c] : dst[0];
+		size_t first = planar ? 0 : c;
+		const float *in = src[c];
+
+		switch (format) {
+		case AUDIO_FORMAT_U8BIT:
+		case AUDIO_FORMAT_U8BIT_PLANAR: {
+			uint8_t *out = plane + first;
+			for (uint32_t i = 0; i < frames; i++)
+				out[i * stride] = (uint8_t)lrintf(clampf(
+					in[i] * 128.0f + 128.0f, 0.0f, 255.0f));
+			break;
+		}
+		case AUDIO_FORMAT_16BIT:
+		case AUDIO_FORMAT_16BIT_PLANAR: {
+			int16_t *out = (int16_t *)plane + first;
+			for (uint32_t i = 0; i < frames; i++)
+				out[i * stride] = (int16_t)lrintf(clampf(
+					in[i] * 32768.0f, -32768.0f, 32767.0f));
+			break;
+		}
+		case AUDIO_FORMAT_32BIT:
+		case AUDIO_FORMAT_32BIT_PLANAR: {
+			int32_t *out = (int32_t *)plane + first;
+			for (uint32_t i = 0; i < frames; i++) {
+				double val = (double)in[i] * 2147483648.0;
+				if (val > 2147483647.0)
+					val = 2147483647.0;
+				else if (val < -2147483648.0)
+					val = -2147483648.0;
+				out[i * stride] = (int32_t)llrint(val);
+			}
+			break;
+		}
+		case AUDIO_FORMAT_FLOAT:
+		case AUDIO_FORMAT_FLOAT_PLANAR: {
+			float *out = (float *)plane + first;
+			for (uint32_t i = 0; i < frames; i++)
+				out[i * stride] = in[i];
+			break;
+		}
+		case AUDIO_FORMAT_UNKNOWN:
+			break;
+		}
+	}
+}
+
+/* taps is always a multiple of 8 */
+static inline float dot_product(const float *samples, const float *kernel,
+				size_t taps)
+{
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+
+	for (size_t i = 0; i < taps; i += 8) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(samples + i),
+						   _mm_loadu_ps(kernel + i)));
+		sum1 = _mm_add_ps(sum1,
+				  _mm_mul_ps(_mm_loadu_ps(samples + i + 4),
+					     _mm_loadu_ps(kernel + i + 4)));
+	}
+
+	sum0 = _mm_add_ps(sum0, sum1);
+	sum0 = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+	sum0 = _mm_add_ss(sum0, _mm_shuffle_ps(sum0, sum0, 1));
+	return _mm_cvtss_f32(sum0);
+}
+
+static uint32_t run_filter(struct sinc_resampler *rs)
+{
+	const struct resample_filter *filter = rs->filter;
+	const size_t taps = filter->taps;
+	const uint32_t up = filter->up;
+	const size_t step = filter->down / up;
+	const uint32_t step_frac = filter->down % up;
+	size_t avail = rs->in_frames;
+	size_t pos = rs->pos;
+	uint32_t phase = rs->phase;
+	size_t frames = 0;
+
+	if (pos + taps > avail)
+		return 0;
+
+	ensure_output(rs, (avail - pos) * up / filter->down + 1);
+
+	for (uint32_t c = 0; c < rs->channels; c++) {
+		const float *in = rs->in_buf[c];
+		float *out = rs->out_buf[c];
+
+		pos = rs->pos;
+		phase = rs->phase;
+		frames = 0;
+
+		while (pos + taps <= avail) {
+			out[frames++] = dot_product(
+				in + pos, filter->coeffs + taps * phase, taps);
+
+			pos += step;
+			phase += step_frac;
+			if (phase >= up) {
+				phase -= up;
+				pos++;
+			}
+		}
+	}
+
+	/* drop the input that no further output frame needs */
+	if (pos > avail)
+		pos = avail;
+	for (uint32_t c = 0; c < rs->channels; c++)
+		memmove(rs->in_buf[c], rs->in_buf[c] + pos,
+			(avail - pos) * sizeof(float));
+
+	rs->in_frames = avail - pos;
+	rs->pos = 0;
+	rs->phase = phase;
+	return (uint32_t)frames;
+}
+
+static void output_frames(struct sinc_resampler *rs, uint8_t *output[],
+			  uint32_t frames)
+{
+	size_t block = get_audio_bytes_per_channel(rs->out_format);
+	size_t size = block * frames * rs->channels;
+
+	if (rs->out_format == AUDIO_FORMAT_FLOAT_PLANAR) {
+		for (uint32_t c = 0; c < rs->channels; c++)
+			output[c] = (uint8_t *)rs->out_buf[c];
+		return;
+	}
+
+	if (size > rs->out_data_size) {
+		bfree(rs->out_data);
+		rs->out_data = bmalloc(size);
+		rs->out_data_size = size;
+	}
+
+	if (is_audio_planar(rs->out_format)) {
+		for (uint32_t c = 0; c < rs->channels; c++)
+			output[c] = rs->out_data + block * frames * c;
+	} else {
+		output[0] = rs->out_data;
+	}
+
+	convert_output(output, rs->out_format, rs->channels, rs->out_buf,
+		       frames);
+}
+
+bool sinc_resampler_resample(struct sinc_resampler *rs, uint8_t *output[],
+			     uint32_t *out_frames, uint64_t *ts_offset,
+			     const uint8_t *const input[], uint32_t in_frames)
+{
+	uint32_t frames;
+
+	if (!rs->filter) {
+		ensure_output(rs, in_frames);
+		convert_input(rs->out_buf, 0, rs->in_format, rs->channels,
+			      input, in_frames);
+		frames = in_frames;
+		*ts_offset = 0;
+
+	} else {
+		const struct resample_filter *filter = rs->filter;
+
+		/* how far the next output frame lies behind the new input */
+		double delay = (double)rs->in_frames - (double)rs->pos -
+			       (double)(filter->half_len - 1) -
+			       (double)rs->phase / (double)filter->up;
+		*ts_offset = delay > 0.0 ? (uint64_t)(delay * 1000000000.0 /
+						      (double)rs->in_rate)
+					 : 0;
+
+		ensure_input(rs, rs->in_frames + in_frames);
+		convert_input(rs->in_buf, rs->in_frames, rs->in_format,
+			      rs->channels, input, in_frames);
+		rs->in_frames += in_frames;
+
+		frames = run_filter(rs);
+	}
+
+	output_frames(rs, output, frames);
+	*out_frames = frames;
+	return true;
+}
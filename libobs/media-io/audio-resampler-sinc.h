@@ -0,0 +1,41 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "audio-resampler.h"
+
+/*
+ * Polyphase sinc resampler
+ *
+ *   Used by audio_resampler_* for conversions that keep the speaker layout.
+ * Handles any sample format in and out, filter tables are shared between all
+ * resamplers with the same rate ratio and quality.
+ */
+
+struct sinc_resampler;
+
+/* returns NULL if the conversion is not supported, rather than failing */
+extern struct sinc_resampler *
+sinc_resampler_create(const struct resample_info *dst,
+		      const struct resample_info *src,
+		      enum audio_resampler_quality quality);
+extern void sinc_resampler_destroy(struct sinc_resampler *rs);
+
+extern bool sinc_resampler_resample(struct sinc_resampler *rs,
+				    uint8_t *output[], uint32_t *out_frames,
+				    uint64_t *ts_offset,
+				    const uint8_t *const input[],
+				    uint32_t in_frames);
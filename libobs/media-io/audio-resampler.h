@@ -33,6 +33,22 @@ struct resample_info {
 	enum speaker_layout speakers;
 };
 
+enum audio_resampler_quality {
+	AUDIO_RESAMPLER_QUALITY_LOW,
+	AUDIO_RESAMPLER_QUALITY_MEDIUM,
+	AUDIO_RESAMPLER_QUALITY_HIGH,
+};
+
+/**
+ * Creates a resampler.  Conversions that keep the same speaker layout use the
+ * built-in polyphase sinc resampler with the given quality, anything else
+ * (remixing, or unusual sample rate ratios) falls back to swresample.
+ * audio_resampler_create uses AUDIO_RESAMPLER_QUALITY_MEDIUM.
+ */
+EXPORT audio_resampler_t *
+audio_resampler_create2(const struct resample_info *dst,
+			const struct resample_info *src,
+			enum audio_resampler_quality quality);
 EXPORT audio_resampler_t *
 audio_resampler_create(const struct resample_info *dst,
 		       const struct resample_info *src);
@@ -19,7 +19,9 @@
 
 #include "../util/base.h"
 #include "../util/bmem.h"
+#include "../util/darray.h"
 #include "../util/platform.h"
+#include "../util/threading.h"
 
 #include <libavformat/avformat.h>
 #if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(59, 20, 100)
@@ -38,9 +40,18 @@
 #define FF_API_BUFFER_SIZE_T (LIBAVUTIL_VERSION_MAJOR < 57)
 #endif
 
+/* Read the input in large sequential blocks rather than ffmpeg's default
+ * 32 KiB, remuxing is almost entirely bound by I/O */
+#define REMUX_READ_BUFFER_SIZE (1024 * 1024)
+
 struct media_remux_job {
 	int64_t in_size;
+	FILE *in_file;
+	AVIOContext *in_pb;
 	AVFormatContext *ifmt_ctx, *ofmt_ctx;
+
+	/* per stream, true if no timestamp rescaling is needed */
+	bool *same_time_base;
 };
 
 static inline void init_size(media_remux_job_t job, const char *in_filename)
@@ -55,8 +66,66 @@ static inline void init_size(media_remux_job_t job, const char *in_filename)
 	job->in_size = st.st_size;
 }
 
+static int read_input(void *opaque, uint8_t *buf, int buf_size)
+{
+	media_remux_job_t job = opaque;
+	size_t size = fread(buf, 1, buf_size, job->in_file);
+
+	if (!size)
+		return feof(job->in_file) ? AVERROR_EOF : AVERROR(EIO);
+	return (int)size;
+}
+
+static int64_t seek_input(void *opaque, int64_t offset, int whence)
+{
+	media_remux_job_t job = opaque;
+
+	if (whence == AVSEEK_SIZE)
+		return job->in_size;
+
+	whence &= ~AVSEEK_FORCE;
+	if (os_fseeki64(job->in_file, offset, whence) != 0)
+		return AVERROR(EIO);
+	return os_ftelli64(job->in_file);
+}
+
+static inline bool init_input_io(media_remux_job_t job,
+				 const char *in_filename)
+{
+	job->in_file = os_fopen(in_filename, "rb");
+	if (!job->in_file)
+		return false;
+
+	/* the AVIOContext buffers the reads, stdio doesn't need to */
+	setvbuf(job->in_file, NULL, _IONBF, 0);
+
+	uint8_t *buf = av_malloc(REMUX_READ_BUFFER_SIZE);
+	if (!buf)
+		return false;
+
+	job->in_pb = avio_alloc_context(buf, REMUX_READ_BUFFER_SIZE, 0, job,
+					read_input, NULL, seek_input);
+	if (!job->in_pb) {
+		av_free(buf);
+		return false;
+	}
+
+	job->ifmt_ctx = avformat_alloc_context();
+	if (!job->ifmt_ctx)
+		return false;
+
+	job->ifmt_ctx->pb = job->in_pb;
+	return true;
+}
+
 static inline bool init_input(media_remux_job_t job, const char *in_filename)
 {
+	if (!init_input_io(job, in_filename)) {
+		blog(LOG_ERROR, "media_remux: Could not open input file '%s'",
+		     in_filename);
+		return false;
+	}
+
 	int ret = avformat_open_input(&job->ifmt_ctx, in_filename, NULL, NULL);
 	if (ret < 0) {
 		blog(LOG_ERROR, "media_remux: Could not open input file '%s'",
@@ -229,9 +298,27 @@ fail:
 	return false;
 }
 
+static inline void init_time_bases(media_remux_job_t job)
+{
+	unsigned num = job->ifmt_ctx->nb_streams;
+
+	job->same_time_base = bzalloc(num * sizeof(bool));
+
+	for (unsigned i = 0; i < num; i++) {
+		AVRational in = job->ifmt_ctx->streams[i]->time_base;
+		AVRational out = job->ofmt_ctx->streams[i]->time_base;
+		job->same_time_base[i] = av_cmp_q(in, out) == 0;
+	}
+}
+
 static inline void process_packet(AVPacket *pkt, AVStream *in_stream,
-				  AVStream *out_stream)
+				  AVStream *out_stream, bool same_time_base)
 {
+	if (same_time_base) {
+		pkt->pos = -1;
+		return;
+	}
+
 	pkt->pts = av_rescale_q_rnd(pkt->pts, in_stream->time_base,
 				    out_stream->time_base,
 				    AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX);
@@ -269,7 +356,8 @@ static inline int process_packets(media_remux_job_t job,
 		}
 
 		process_packet(&pkt, job->ifmt_ctx->streams[pkt.stream_index],
-			       job->ofmt_ctx->streams[pkt.stream_index]);
+			       job->ofmt_ctx->streams[pkt.stream_index],
+			       job->same_time_base[pkt.stream_index]);
 
 		ret = av_interleaved_write_frame(job->ofmt_ctx, &pkt);
 		av_packet_unref(&pkt);
@@ -306,6 +394,9 @@ bool media_remux_job_process(media_remux_job_t job,
 		return success;
 	}
 
+	/* the muxer may pick its own time bases when writing the header */
+	init_time_bases(job);
+
 	if (callback != NULL)
 		callback(data, 0.f);
 
@@ -332,10 +423,304 @@ void media_remux_job_destroy(media_remux_job_t job)
 
 	avformat_close_input(&job->ifmt_ctx);
 
+	if (job->in_pb) {
+		av_freep(&job->in_pb->buffer);
+		avio_context_free(&job->in_pb);
+	}
+	if (job->in_file)
+		fclose(job->in_file);
+
 	if (job->ofmt_ctx && !(job->ofmt_ctx->oformat->flags & AVFMT_NOFILE))
 		avio_close(job->ofmt_ctx->pb);
 
 	avformat_free_context(job->ofmt_ctx);
 
+	bfree(job->same_time_base);
 	bfree(job);
 }
+
+/* ------------------------------------------------------------------------- */
+/* batch remuxing                                                            */
+
+#define BATCH_MAX_DEFAULT_JOBS 4
+#define BATCH_PROGRESS_INTERVAL_MS 250
+
+struct remux_batch_entry {
+	char *in_filename;
+	char *out_filename;
+	int64_t in_size;
+	int64_t processed;
+	bool finished;
+	bool succeeded;
+};
+
+struct media_remux_batch {
+	DARRAY(struct remux_batch_entry) entries;
+	size_t max_jobs;
+
+	pthread_mutex_t mutex;
+	os_event_t *progress_event;
+	volatile long next_entry;
+	volatile bool cancel;
+};
+
+struct remux_batch_worker {
+	media_remux_batch_t batch;
+	struct remux_batch_entry *entry;
+};
+
+media_remux_batch_t media_remux_batch_create(size_t max_jobs)
+{
+	struct media_remux_batch *batch = bzalloc(sizeof(*batch));
+
+	if (!max_jobs) {
+		int cores = os_get_logical_cores();
+		max_jobs = cores > 1 ? (size_t)cores / 2 : 1;
+		if (max_jobs > BATCH_MAX_DEFAULT_JOBS)
+			max_jobs = BATCH_MAX_DEFAULT_JOBS;
+	}
+
+	batch->max_jobs = max_jobs;
+
+	pthread_mutex_init_value(&batch->mutex);
+	if (pthread_mutex_init(&batch->mutex, NULL) != 0)
+		goto fail;
+	if (os_event_init(&batch->progress_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+
+	return batch;
+
+fail:
+	media_remux_batch_destroy(batch);
+	return NULL;
+}
+
+bool media_remux_batch_add(media_remux_batch_t batch, const char *in_filename,
+			   const char *out_filename)
+{
+	if (!batch || !in_filename || !out_filename)
+		return false;
+	if (!os_file_exists(in_filename))
+		return false;
+	if (strcmp(in_filename, out_filename) == 0)
+		return false;
+
+	struct remux_batch_entry *entry = da_push_back_new(batch->entries);
+	entry->in_filename = bstrdup(in_filename);
+	entry->out_filename = bstrdup(out_filename);
+	return true;
+}
+
+static bool batch_job_progress(void *data, float percent)
+{
+	struct remux_batch_worker *worker = data;
+	media_remux_batch_t batch = worker->batch;
+	struct remux_batch_entry *entry = worker->entry;
+
+	pthread_mutex_lock(&batch->mutex);
+	entry->processed = (int64_t)((double)entry->in_size * percent / 100.0);
+	pthread_mutex_unlock(&batch->mutex);
+
+	return !os_atomic_load_bool(&batch->cancel);
+}
+
+static void batch_process_entry(media_remux_batch_t batch,
+				struct remux_batch_entry *entry)
+{
+	struct remux_batch_worker worker = {batch, entry};
+	media_remux_job_t job;
+	bool success = false;
+
+	if (media_remux_job_create(&job, entry->in_filename,
+				   entry->out_filename)) {
+		success = media_remux_job_process(job, batch_job_progress,
+						  &worker);
+		media_remux_job_destroy(job);
+	}
+
+	if (os_atomic_load_bool(&batch->cancel))
+		success = false;
+
+	if (!success)
+		blog(LOG_WARNING, "media_remux: Failed to remux '%s'",
+		     entry->in_filename);
+
+	pthread_mutex_lock(&batch->mutex);
+	entry->processed = entry->in_size;
+	entry->succeeded = success;
+	entry->finished = true;
+	pthread_mutex_unlock(&batch->mutex);
+
+	os_event_signal(batch->progress_event);
+}
+
+static void *batch_worker_thread(void *data)
+{
+	media_remux_batch_t batch = data;
+
+	os_set_thread_name("media_remux: batch worker");
+
+	for (;;) {
+		long idx = os_atomic_inc_long(&batch->next_entry) - 1;
+		if (idx < 0 || (size_t)idx >= batch->entries.num)
+			break;
+		if (os_atomic_load_bool(&batch->cancel))
+			break;
+
+		batch_process_entry(batch, &batch->entries.array[idx]);
+	}
+
+	return NULL;
+}
+
+static bool get_batch_progress(media_remux_batch_t batch,
+			       struct media_remux_batch_progress *progress,
+			       uint64_t start_time)
+{
+	bool finished = true;
+
+	memset(progress, 0, sizeof(*progress));
+	progress->jobs_total = batch->entries.num;
+
+	pthread_mutex_lock(&batch->mutex);
+	for (size_t i = 0; i < batch->entries.num; i++) {
+		struct remux_batch_entry *entry = &batch->entries.array[i];
+
+		progress->bytes_total += entry->in_size;
+		progress->bytes_processed += entry->processed;
+
+		if (entry->finished) {
+			progress->jobs_finished++;
+			if (!entry->succeeded)
+				progress->jobs_failed++;
+		} else {
+			finished = false;
+		}
+	}
+	pthread_mutex_unlock(&batch->mutex);
+
+	double seconds = (double)(os_gettime_ns() - start_time) / 1000000000.0;
+	if (seconds > 0.0)
+		progress->bytes_per_second =
+			(double)progress->bytes_processed / seconds;
+	if (progress->bytes_total)
+		progress->percent = (float)((double)progress->bytes_processed /
+					    (double)progress->bytes_total *
+					    100.0);
+	else if (finished)
+		progress->percent = 100.f;
+
+	return finished;
+}
+
+bool media_remux_batch_process(media_remux_batch_t batch,
+			       media_remux_batch_progress_callback callback,
+			       void *data)
+{
+	struct media_remux_batch_progress progress;
+	DARRAY(pthread_t) threads;
+	bool success = true;
+
+	if (!batch)
+		return false;
+
+	for (size_t i = 0; i < batch->entries.num; i++) {
+		struct remux_batch_entry *entry = &batch->entries.array[i];
+#ifdef _MSC_VER
+		struct _stat64 st = {0};
+		_stat64(entry->in_filename, &st);
+#else
+		struct stat st = {0};
+		stat(entry->in_filename, &st);
+#endif
+		entry->in_size = st.st_size;
+		entry->processed = 0;
+		entry->finished = false;
+		entry->succeeded = false;
+	}
+
+	batch->next_entry = 0;
+	os_atomic_set_bool(&batch->cancel, false);
+
+	size_t num_threads = batch->max_jobs;
+	if (num_threads > batch->entries.num)
+		num_threads = batch->entries.num;
+
+	da_init(threads);
+	for (size_t i = 0; i < num_threads; i++) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, batch_worker_thread, batch) ==
+		    0)
+			da_push_back(threads, &thread);
+	}
+
+	if (!threads.num && batch->entries.num) {
+		blog(LOG_ERROR, "media_remux: Failed to create batch threads");
+		return false;
+	}
+
+	uint64_t start_time = os_gettime_ns();
+
+	for (;;) {
+		bool finished = get_batch_progress(batch, &progress,
+						   start_time);
+
+		if (callback && !os_atomic_load_bool(&batch->cancel) &&
+		    !callback(data, &progress))
+			os_atomic_set_bool(&batch->cancel, true);
+
+		if (finished || !threads.num)
+			break;
+
+		os_event_timedwait(batch->progress_event,
+				   BATCH_PROGRESS_INTERVAL_MS);
+
+		/* jobs that haven't started yet won't finish when canceled */
+		if (os_atomic_load_bool(&batch->cancel))
+			break;
+	}
+
+	for (size_t i = 0; i < threads.num; i++)
+		pthread_join(threads.array[i], NULL);
+	da_free(threads);
+
+	get_batch_progress(batch, &progress, start_time);
+
+	blog(LOG_INFO,
+	     "media_remux: Remuxed %zu of %zu file(s), %.1f MB at "
+	     "%.1f MB/s",
+	     progress.jobs_finished - progress.jobs_failed, progress.jobs_total,
+	     (double)progress.bytes_processed / 1048576.0,
+	     progress.bytes_per_second / 1048576.0);
+
+	for (size_t i = 0; i < batch->entries.num; i++) {
+		if (!batch->entries.array[i].succeeded)
+			success = false;
+	}
+
+	return success;
+}
+
+bool media_remux_batch_job_succeeded(media_remux_batch_t batch, size_t idx)
+{
+	if (!batch || idx >= batch->entries.num)
+		return false;
+
+	return batch->entries.array[idx].succeeded;
+}
+
+void media_remux_batch_destroy(media_remux_batch_t batch)
+{
+	if (!batch)
+		return;
+
+	for (size_t i = 0; i < batch->entries.num; i++) {
+		bfree(batch->entries.array[i].in_filename);
+		bfree(batch->entries.array[i].out_filename);
+	}
+	da_free(batch->entries);
+
+	os_event_destroy(batch->progress_event);
+	pthread_mutex_destroy(&batch->mutex);
+	bfree(batch);
+}
@@ -24,6 +24,22 @@ typedef struct media_remux_job *media_remux_job_t;
 
 typedef bool(media_remux_progress_callback)(void *data, float percent);
 
+struct media_remux_batch;
+typedef struct media_remux_batch *media_remux_batch_t;
+
+struct media_remux_batch_progress {
+	size_t jobs_total;
+	size_t jobs_finished;
+	size_t jobs_failed;
+	int64_t bytes_total;
+	int64_t bytes_processed;
+	double bytes_per_second;
+	float percent;
+};
+
+typedef bool(media_remux_batch_progress_callback)(
+	void *data, const struct media_remux_batch_progress *progress);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -36,6 +52,20 @@ EXPORT bool media_remux_job_process(media_remux_job_t job,
 				    void *data);
 EXPORT void media_remux_job_destroy(media_remux_job_t job);
 
+/* Remuxes several files concurrently, at most max_jobs at a time (0 picks a
+ * default based on the number of cores).  Processing blocks until all jobs
+ * are finished or the callback returns false. */
+EXPORT media_remux_batch_t media_remux_batch_create(size_t max_jobs);
+EXPORT bool media_remux_batch_add(media_remux_batch_t batch,
+				  const char *in_filename,
+				  const char *out_filename);
+EXPORT bool media_remux_batch_process(media_remux_batch_t batch,
+				      media_remux_batch_progress_callback callback,
+				      void *data);
+EXPORT bool media_remux_batch_job_succeeded(media_remux_batch_t batch,
+					    size_t idx);
+EXPORT void media_remux_batch_destroy(media_remux_batch_t batch);
+
 #ifdef __cplusplus
 }
 #endif
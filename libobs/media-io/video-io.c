@@ -31,19 +31,21 @@
 
 extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
-#define MAX_CONVERT_BUFFERS 3
+#define MAX_CONVERT_BUFFERS 4
 #define MAX_CACHE_SIZE 16
 
 struct cached_frame_info {
 	struct video_data frame;
 	int skipped;
 	int count;
+	long holds;
 };
 
 struct video_input {
 	struct video_scale_info conversion;
 	video_scaler_t *scaler;
 	struct video_frame frame[MAX_CONVERT_BUFFERS];
+	long holds[MAX_CONVERT_BUFFERS];
 	int cur_frame;
 
 	void (*callback)(void *param, struct video_data *frame);
@@ -75,6 +77,11 @@ struct video_output {
 	size_t available_frames;
 	size_t first_added;
 	size_t last_added;
+
+	/* frames that were delivered but are still held by an input, starting
+	 * at first_held.  they only become available again once released */
+	size_t held_frames;
+	size_t first_held;
 	struct cached_frame_info cache[MAX_CACHE_SIZE];
 
 	volatile bool raw_active;
@@ -90,9 +97,17 @@ static inline bool scale_video_output(struct video_input *input,
 
 	if (input->scaler) {
 		struct video_frame *frame;
+		size_t tries = 0;
+
+		/* skip buffers an input is still holding on to */
+		do {
+			if (++input->cur_frame == MAX_CONVERT_BUFFERS)
+				input->cur_frame = 0;
+		} while (input->holds[input->cur_frame] &&
+			 ++tries < MAX_CONVERT_BUFFERS);
 
-		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
-			input->cur_frame = 0;
+		if (input->holds[input->cur_frame])
+			return false;
 
 		frame = &input->frame[input->cur_frame];
 
@@ -114,6 +129,21 @@ static inline bool scale_video_output(struct video_input *input,
 	return success;
 }
 
+/* returns delivered frames to the writer in the order they were added, so the
+ * free part of the cache stays contiguous */
+static inline void reclaim_frames(struct video_output *video)
+{
+	while (video->held_frames &&
+	       video->cache[video->first_held].holds == 0) {
+		if (++video->first_held == video->info.cache_size)
+			video->first_held = 0;
+		video->held_frames--;
+
+		if (++video->available_frames == video->info.cache_size)
+			video->last_added = video->first_added;
+	}
+}
+
 static inline bool video_output_cur_frame(struct video_output *video)
 {
 	struct cached_frame_info *frame_info;
@@ -138,6 +168,8 @@ static inline bool video_output_cur_frame(struct video_output *video)
 
 		if (scale_video_output(input, &frame))
 			input->callback(input->param, &frame);
+		else if (input->scaler)
+			os_atomic_inc_long(&video->skipped_frames);
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
@@ -154,8 +186,8 @@ static inline bool video_output_cur_frame(struct video_output *video)
 		if (++video->first_added == video->info.cache_size)
 			video->first_added = 0;
 
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
+		video->held_frames++;
+		reclaim_frames(video);
 	} else if (skipped) {
 		--frame_info->skipped;
 		os_atomic_inc_long(&video->skipped_frames);
@@ -487,7 +519,16 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 
 	pthread_mutex_lock(&video->data_mutex);
 
-	if (video->available_frames == 0) {
+	if (video->available_frames == 0 &&
+	    video->held_frames == video->info.cache_size) {
+		/* every frame is still held by an input, nothing to repeat */
+		for (int i = 0; i < count; i++) {
+			os_atomic_inc_long(&video->skipped_frames);
+			os_atomic_inc_long(&video->total_frames);
+		}
+		locked = false;
+
+	} else if (video->available_frames == 0) {
 		video->cache[video->last_added].count += count;
 		video->cache[video->last_added].skipped += count;
 		locked = false;
@@ -526,6 +567,64 @@ void video_output_unlock_frame(video_t *video)
 	pthread_mutex_unlock(&video->data_mutex);
 }
 
+static bool hold_frame(struct video_output *video, const uint8_t *data,
+		       long delta)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&video->data_mutex);
+
+	for (size_t i = 0; i < video->info.cache_size; i++) {
+		struct cached_frame_info *cfi = &video->cache[i];
+		if (cfi->frame.data[0] == data) {
+			cfi->holds += delta;
+			if (delta < 0)
+				reclaim_frames(video);
+			found = true;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&video->data_mutex);
+
+	if (found)
+		return true;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	for (size_t i = 0; !found && i < video->inputs.num; i++) {
+		struct video_input *input = video->inputs.array + i;
+
+		for (size_t j = 0; j < MAX_CONVERT_BUFFERS; j++) {
+			if (input->scaler && input->frame[j].data[0] == data) {
+				input->holds[j] += delta;
+				found = true;
+				break;
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	return found;
+}
+
+bool video_output_hold_frame(video_t *video, const struct video_data *frame)
+{
+	if (!video || !frame || !frame->data[0])
+		return false;
+
+	return hold_frame(video, frame->data[0], 1);
+}
+
+void video_output_release_frame(video_t *video, const struct video_data *frame)
+{
+	if (!video || !frame || !frame->data[0])
+		return;
+
+	hold_frame(video, frame->data[0], -1);
+}
+
 uint64_t video_output_get_frame_time(const video_t *video)
 {
 	return video ? video->frame_time : 0;
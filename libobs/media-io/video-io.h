@@ -314,6 +314,19 @@ video_output_get_info(const video_t *video);
 EXPORT bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 				    int count, uint64_t timestamp);
 EXPORT void video_output_unlock_frame(video_t *video);
+
+/**
+ * Keeps the buffers of a frame passed to a video_output_connect callback from
+ * being reused after the callback returns, so the frame can be consumed on
+ * another thread.  Must be called from within the callback, and every
+ * successful hold must be paired with video_output_release_frame.  Held
+ * frames are not available to the writer, so hold as few as possible.
+ */
+EXPORT bool video_output_hold_frame(video_t *video,
+				    const struct video_data *frame);
+EXPORT void video_output_release_frame(video_t *video,
+				       const struct video_data *frame);
+
 EXPORT uint64_t video_output_get_frame_time(const video_t *video);
 EXPORT void video_output_stop(video_t *video);
 EXPORT bool video_output_stopped(video_t *video);
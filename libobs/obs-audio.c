@@ -27,6 +27,11 @@ struct ts_info {
 #define DEBUG_AUDIO 0
 #define DEBUG_LAGGED_AUDIO 0
 
+/* dynamic buffering is reduced when the sources needed less than the current
+ * amount (plus a margin) for a whole window, by half of the excess at a time */
+#define BUFFERING_WINDOW_SEC 5
+#define BUFFERING_MARGIN_TICKS 1
+
 static void push_audio_tree(obs_source_t *parent, obs_source_t *source, void *p)
 {
 	struct obs_core_audio *audio = p;
@@ -297,6 +302,12 @@ static inline bool audio_buffering_maxed(struct obs_core_audio *audio)
 	return audio->total_buffering_ticks == audio->max_buffering_ticks;
 }
 
+static inline void reset_buffering_window(struct obs_core_audio *audio)
+{
+	audio->buffering_window_ticks = 0;
+	audio->buffering_window_peak = 0;
+}
+
 static void set_fixed_audio_buffering(struct obs_core_audio *audio,
 				      size_t sample_rate, struct ts_info *ts)
 {
@@ -312,6 +323,7 @@ static void set_fixed_audio_buffering(struct obs_core_audio *audio,
 
 	ticks = audio->max_buffering_ticks - audio->total_buffering_ticks;
 	audio->total_buffering_ticks += ticks;
+	reset_buffering_window(audio);
 
 	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 /
 		   sample_rate;
@@ -369,6 +381,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 	ticks = (int)((frames + AUDIO_OUTPUT_FRAMES - 1) / AUDIO_OUTPUT_FRAMES);
 
 	audio->total_buffering_ticks += ticks;
+	reset_buffering_window(audio);
 
 	if (audio->total_buffering_ticks >= audio->max_buffering_ticks) {
 		ticks -= audio->total_buffering_ticks -
@@ -492,6 +505,67 @@ static inline const char *calc_min_ts(struct obs_core_data *data,
 	return buffering_name;
 }
 
+/* how many ticks of buffering the source needs for its data to reach the
+ * newest tick, measured after its audio for the current tick was discarded */
+static int source_buffering_ticks(struct obs_source *source, size_t sample_rate,
+				  uint64_t end_ts)
+{
+	uint64_t data_end;
+	uint64_t frames;
+
+	if (source->info.audio_render || source->audio_pending ||
+	    !source->audio_ts)
+		return 0;
+
+	frames = source->audio_input_buf[0].size / sizeof(float);
+	data_end = source->audio_ts + audio_frames_to_ns(sample_rate, frames);
+	if (data_end >= end_ts)
+		return 0;
+
+	frames = ns_to_audio_frames(sample_rate, end_ts - data_end);
+	return (int)((frames + AUDIO_OUTPUT_FRAMES - 1) / AUDIO_OUTPUT_FRAMES);
+}
+
+static void reduce_audio_buffering(struct obs_core_audio *audio,
+				   size_t sample_rate, int needed_ticks)
+{
+	uint64_t window_ticks = BUFFERING_WINDOW_SEC * sample_rate /
+				AUDIO_OUTPUT_FRAMES;
+	size_t total_ms;
+	int excess;
+	int ticks;
+
+	if (audio->fixed_buffer || audio->buffering_wait_ticks)
+		return;
+
+	if (needed_ticks > audio->buffering_window_peak)
+		audio->buffering_window_peak = needed_ticks;
+	if (++audio->buffering_window_ticks < window_ticks)
+		return;
+
+	excess = audio->total_buffering_ticks - BUFFERING_MARGIN_TICKS -
+		 audio->buffering_window_peak;
+	reset_buffering_window(audio);
+
+	if (excess <= 0)
+		return;
+
+	/* the queued timestamps are mixed right away instead of one per
+	 * tick, so the output stays continuous and no audio is dropped */
+	ticks = (excess + 1) / 2;
+	audio->total_buffering_ticks -= ticks;
+	audio_output_catch_up(audio->audio, (uint32_t)ticks);
+
+	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 /
+		   sample_rate;
+
+	blog(LOG_INFO,
+	     "removing %d milliseconds of audio buffering, total "
+	     "audio buffering is now %d milliseconds",
+	     (int)(ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate),
+	     (int)total_ms);
+}
+
 static inline void release_audio_sources(struct obs_core_audio *audio)
 {
 	for (size_t i = 0; i < audio->render_order.num; i++)
@@ -515,6 +589,8 @@ static inline void execute_audio_tasks(void)
 	}
 }
 
+static const char *audio_callback_name = "audio_callback";
+
 bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 		    uint64_t *out_ts, uint32_t mixers,
 		    struct audio_output_data *mixes)
@@ -525,13 +601,20 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	size_t sample_rate = audio_output_get_sample_rate(audio->audio);
 	size_t channels = audio_output_get_channels(audio->audio);
 	struct ts_info ts = {start_ts_in, end_ts_in};
+	bool catch_up = start_ts_in == end_ts_in;
+	int needed_ticks = 0;
 	size_t audio_size;
 	uint64_t min_ts;
 
+	profile_start(audio_callback_name);
+
 	da_resize(audio->render_order, 0);
 	da_resize(audio->root_nodes, 0);
 
-	circlebuf_push_back(&audio->buffered_timestamps, &ts, sizeof(ts));
+	/* catch up ticks mix the next queued timestamp without adding one */
+	if (!catch_up)
+		circlebuf_push_back(&audio->buffered_timestamps, &ts,
+				    sizeof(ts));
 	circlebuf_peek_front(&audio->buffered_timestamps, &ts, sizeof(ts));
 	min_ts = ts.start;
 
@@ -647,15 +730,24 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 	source = data->first_audio_source;
 	while (source) {
+		int ticks;
+
 		pthread_mutex_lock(&source->audio_buf_mutex);
 		discard_audio(audio, source, channels, sample_rate, &ts);
+		ticks = source_buffering_ticks(source, sample_rate, end_ts_in);
 		pthread_mutex_unlock(&source->audio_buf_mutex);
 
+		if (ticks > needed_ticks)
+			needed_ticks = ticks;
+
 		source = (struct obs_source *)source->next_audio_source;
 	}
 
 	pthread_mutex_unlock(&data->audio_sources_mutex);
 
+	if (!catch_up)
+		reduce_audio_buffering(audio, sample_rate, needed_ticks);
+
 	/* ------------------------------------------------ */
 	/* release audio sources */
 	release_audio_sources(audio);
@@ -666,11 +758,14 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 	if (audio->buffering_wait_ticks) {
 		audio->buffering_wait_ticks--;
+		profile_end(audio_callback_name);
 		return false;
 	}
 
 	execute_audio_tasks();
 
+	profile_end(audio_callback_name);
+
 	UNUSED_PARAMETER(param);
 	return true;
 }
@@ -50,6 +50,7 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 	pthread_mutex_init_value(&encoder->callbacks_mutex);
 	pthread_mutex_init_value(&encoder->outputs_mutex);
 	pthread_mutex_init_value(&encoder->pause.mutex);
+	pthread_mutex_init_value(&encoder->frame_queue_mutex);
 
 	if (!obs_context_data_init(&encoder->context, OBS_OBJ_TYPE_ENCODER,
 				   settings, name, NULL, hotkey_data, false))
@@ -62,6 +63,8 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 		return false;
 	if (pthread_mutex_init(&encoder->pause.mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&encoder->frame_queue_mutex, NULL) != 0)
+		return false;
 
 	if (encoder->orig_info.get_defaults) {
 		encoder->orig_info.get_defaults(encoder->context.settings);
@@ -138,6 +141,11 @@ obs_encoder_t *obs_audio_encoder_create(const char *id, const char *name,
 
 static void receive_video(void *param, struct video_data *frame);
 static void receive_audio(void *param, size_t mix_idx, struct audio_data *data);
+static void start_frame_queue(struct obs_encoder *encoder);
+static struct encoder_frame_queue *
+drain_frame_queue(struct obs_encoder *encoder);
+static void stop_frame_queue(struct obs_encoder *encoder,
+			     struct encoder_frame_queue *joined);
 
 static inline void get_audio_info(const struct obs_encoder *encoder,
 				  struct audio_convert_info *info)
@@ -199,6 +207,7 @@ static void add_connection(struct obs_encoder *encoder)
 		if (gpu_encode_available(encoder)) {
 			start_gpu_encode(encoder);
 		} else {
+			start_frame_queue(encoder);
 			start_raw_video(encoder->media, &info, receive_video,
 					encoder);
 		}
@@ -216,7 +225,13 @@ static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 		if (gpu_encode_available(encoder)) {
 			stop_gpu_encode(encoder);
 		} else {
+			/* the queued frames may point to scaled buffers of the
+			 * video input, so they have to be encoded and released
+			 * before disconnecting frees those buffers */
+			struct encoder_frame_queue *queue =
+				drain_frame_queue(encoder);
 			stop_raw_video(encoder->media, receive_video, encoder);
+			stop_frame_queue(encoder, queue);
 		}
 	}
 
@@ -264,6 +279,7 @@ static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
 		pthread_mutex_destroy(&encoder->callbacks_mutex);
 		pthread_mutex_destroy(&encoder->outputs_mutex);
 		pthread_mutex_destroy(&encoder->pause.mutex);
+		pthread_mutex_destroy(&encoder->frame_queue_mutex);
 		obs_context_data_free(&encoder->context);
 		if (encoder->owns_info_id)
 			bfree((void *)encoder->info.id);
@@ -528,6 +544,14 @@ void obs_encoder_shutdown(obs_encoder_t *encoder)
 	pthread_mutex_unlock(&encoder->init_mutex);
 }
 
+static struct encoder_dispatch *
+encoder_dispatch_create(struct obs_encoder *encoder,
+			const struct encoder_callback *cb);
+static void encoder_dispatch_stop(struct encoder_dispatch *dispatch,
+				  bool drain);
+static void log_dispatch_dropped(struct obs_encoder *encoder,
+				 struct encoder_dispatch *dispatch);
+
 static inline size_t
 get_callback_idx(const struct obs_encoder *encoder,
 		 void (*new_packet)(void *param, struct encoder_packet *packet),
@@ -569,8 +593,11 @@ static inline void obs_encoder_start_internal(
 	first = (encoder->callbacks.num == 0);
 
 	size_t idx = get_callback_idx(encoder, new_packet, param);
-	if (idx == DARRAY_INVALID)
-		da_push_back(encoder->callbacks, &cb);
+	if (idx == DARRAY_INVALID) {
+		cb.dispatch = encoder_dispatch_create(encoder, &cb);
+		if (cb.dispatch)
+			da_push_back(encoder->callbacks, &cb);
+	}
 
 	pthread_mutex_unlock(&encoder->callbacks_mutex);
 
@@ -601,7 +628,7 @@ void obs_encoder_start(obs_encoder_t *encoder,
 static inline bool obs_encoder_stop_internal(
 	obs_encoder_t *encoder,
 	void (*new_packet)(void *param, struct encoder_packet *packet),
-	void *param)
+	void *param, struct encoder_dispatch **dispatch)
 {
 	bool last = false;
 	size_t idx;
@@ -610,8 +637,10 @@ static inline bool obs_encoder_stop_internal(
 
 	idx = get_callback_idx(encoder, new_packet, param);
 	if (idx != DARRAY_INVALID) {
+		*dispatch = encoder->callbacks.array[idx].dispatch;
 		da_erase(encoder->callbacks, idx);
 		last = (encoder->callbacks.num == 0);
+		log_dispatch_dropped(encoder, *dispatch);
 	}
 
 	pthread_mutex_unlock(&encoder->callbacks_mutex);
@@ -635,6 +664,7 @@ void obs_encoder_stop(obs_encoder_t *encoder,
 					 struct encoder_packet *packet),
 		      void *param)
 {
+	struct encoder_dispatch *dispatch = NULL;
 	bool destroyed;
 
 	if (!obs_encoder_valid(encoder, "obs_encoder_stop"))
@@ -643,9 +673,17 @@ void obs_encoder_stop(obs_encoder_t *encoder,
 		return;
 
 	pthread_mutex_lock(&encoder->init_mutex);
-	destroyed = obs_encoder_stop_internal(encoder, new_packet, param);
+	destroyed = obs_encoder_stop_internal(encoder, new_packet, param,
+					      &dispatch);
 	if (!destroyed)
 		pthread_mutex_unlock(&encoder->init_mutex);
+
+	/* deliver packets already queued for this callback before returning,
+	 * same as if they had been sent directly.  the callback may need
+	 * init_mutex to handle them, so this is done after unlocking; the
+	 * dispatch thread doesn't use the encoder itself */
+	if (dispatch)
+		encoder_dispatch_stop(dispatch, true);
 }
 
 const char *obs_encoder_get_codec(const obs_encoder_t *encoder)
@@ -899,54 +937,237 @@ static inline bool get_sei(const struct obs_encoder *encoder, uint8_t **sei,
 	return false;
 }
 
-static void send_first_video_packet(struct obs_encoder *encoder,
-				    struct encoder_callback *cb,
-				    struct encoder_packet *packet)
+/* built on the encoder thread, where the encoder data is valid, so that
+ * dispatch threads never have to touch the encoder */
+static bool get_first_video_packet(struct obs_encoder *encoder,
+				   struct encoder_packet *packet,
+				   struct encoder_packet *first_packet)
 {
-	struct encoder_packet first_packet;
+	struct encoder_packet combined;
 	DARRAY(uint8_t) data;
 	uint8_t *sei;
 	size_t size;
 
 	/* always wait for first keyframe */
 	if (!packet->keyframe)
-		return;
-
-	da_init(data);
+		return false;
 
 	if (!get_sei(encoder, &sei, &size) || !sei || !size) {
-		cb->new_packet(cb->param, packet);
-		cb->sent_first_packet = true;
-		return;
+		obs_encoder_packet_ref(first_packet, packet);
+		return true;
 	}
 
+	da_init(data);
 	da_push_back_array(data, sei, size);
 	da_push_back_array(data, packet->data, packet->size);
 
-	first_packet = *packet;
-	first_packet.data = data.array;
-	first_packet.size = data.num;
-
-	cb->new_packet(cb->param, &first_packet);
-	cb->sent_first_packet = true;
-
+	/* callbacks may reference the packet, so it has to be an instance
+	 * like every other packet */
+	combined = *packet;
+	combined.data = data.array;
+	combined.size = data.num;
+	obs_encoder_packet_create_instance(first_packet, &combined);
 	da_free(data);
+	return true;
 }
 
 static const char *send_packet_name = "send_packet";
-static inline void send_packet(struct obs_encoder *encoder,
-			       struct encoder_callback *cb,
+static inline void send_packet(struct encoder_callback *cb,
 			       struct encoder_packet *packet)
 {
 	profile_start(send_packet_name);
-	/* include SEI in first video packet */
-	if (encoder->info.type == OBS_ENCODER_VIDEO && !cb->sent_first_packet)
-		send_first_video_packet(encoder, cb, packet);
-	else
-		cb->new_packet(cb->param, packet);
+	cb->new_packet(cb->param, packet);
 	profile_end(send_packet_name);
 }
 
+/* ------------------------------------------------------------------------- */
+/* Each callback gets its own dispatch thread and packet queue.  The encoder
+ * only has to reference the shared packet instance once per callback, so an
+ * output that stalls (for example a recording on a slow disk) only delays
+ * its own packets instead of every other output of the encoder. */
+
+/* an output that stops consuming packets altogether would otherwise keep
+ * every packet of the encoder alive, so past these limits its packets are
+ * dropped */
+#define DISPATCH_MAX_PACKETS 4096
+#define DISPATCH_MAX_BYTES (128 * 1024 * 1024)
+
+struct encoder_dispatch {
+	struct encoder_callback cb;
+
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	os_sem_t *sem;
+	struct circlebuf packets; /* struct encoder_packet */
+	size_t packets_size;
+	bool stop;
+	bool drain;
+	bool detached;
+
+	/* only used by the encoder thread, under callbacks_mutex */
+	bool dropping;
+	uint64_t dropped;
+};
+
+static void encoder_dispatch_free(struct encoder_dispatch *dispatch)
+{
+	struct encoder_packet packet;
+
+	while (dispatch->packets.size) {
+		circlebuf_pop_front(&dispatch->packets, &packet,
+				    sizeof(packet));
+		obs_encoder_packet_release(&packet);
+	}
+
+	circlebuf_free(&dispatch->packets);
+	os_sem_destroy(dispatch->sem);
+	pthread_mutex_destroy(&dispatch->mutex);
+	bfree(dispatch);
+}
+
+static void *encoder_dispatch_thread(void *data)
+{
+	struct encoder_dispatch *dispatch = data;
+	struct encoder_packet packet;
+	bool detached;
+
+	os_set_thread_name("encoder-dispatch");
+
+	for (;;) {
+		os_sem_wait(dispatch->sem);
+
+		pthread_mutex_lock(&dispatch->mutex);
+		bool stop = dispatch->stop;
+		bool has_packet = dispatch->packets.size &&
+				  (!stop || dispatch->drain);
+		if (has_packet) {
+			circlebuf_pop_front(&dispatch->packets, &packet,
+					    sizeof(packet));
+			dispatch->packets_size -= packet.size;
+		}
+		pthread_mutex_unlock(&dispatch->mutex);
+
+		if (!has_packet) {
+			if (stop)
+				break;
+			continue;
+		}
+
+		send_packet(&dispatch->cb, &packet);
+		obs_encoder_packet_release(&packet);
+	}
+
+	pthread_mutex_lock(&dispatch->mutex);
+	detached = dispatch->detached;
+	pthread_mutex_unlock(&dispatch->mutex);
+
+	if (detached)
+		encoder_dispatch_free(dispatch);
+	return NULL;
+}
+
+static struct encoder_dispatch *
+encoder_dispatch_create(struct obs_encoder *encoder,
+			const struct encoder_callback *cb)
+{
+	struct encoder_dispatch *dispatch = bzalloc(sizeof(*dispatch));
+
+	dispatch->cb = *cb;
+
+	pthread_mutex_init_value(&dispatch->mutex);
+	if (pthread_mutex_init(&dispatch->mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&dispatch->sem, 0) != 0)
+		goto fail;
+	if (pthread_create(&dispatch->thread, NULL, encoder_dispatch_thread,
+			   dispatch) != 0)
+		goto fail;
+
+	return dispatch;
+
+fail:
+	blog(LOG_ERROR, "Failed to create dispatch thread for encoder '%s'",
+	     encoder->context.name);
+	encoder_dispatch_free(dispatch);
+	return NULL;
+}
+
+static void log_dispatch_dropped(struct obs_encoder *encoder,
+				 struct encoder_dispatch *dispatch)
+{
+	if (!dispatch->dropped)
+		return;
+
+	blog(LOG_WARNING,
+	     "Encoder '%s': an output fell behind, dropped %" PRIu64
+	     " packets",
+	     encoder->context.name, dispatch->dropped);
+	dispatch->dropped = 0;
+}
+
+/* called with callbacks_mutex locked */
+static void encoder_dispatch_push(struct obs_encoder *encoder,
+				  struct encoder_dispatch *dispatch,
+				  struct encoder_packet *packet)
+{
+	struct encoder_packet ref;
+	bool full;
+
+	pthread_mutex_lock(&dispatch->mutex);
+	full = dispatch->packets.size / sizeof(ref) >= DISPATCH_MAX_PACKETS ||
+	       dispatch->packets_size + packet->size > DISPATCH_MAX_BYTES;
+
+	/* video only resumes on a keyframe, so the output never gets
+	 * packets that depend on dropped ones */
+	if (dispatch->dropping && packet->type == OBS_ENCODER_VIDEO &&
+	    !packet->keyframe)
+		full = true;
+
+	if (!full) {
+		obs_encoder_packet_ref(&ref, packet);
+		circlebuf_push_back(&dispatch->packets, &ref, sizeof(ref));
+		dispatch->packets_size += ref.size;
+	}
+	pthread_mutex_unlock(&dispatch->mutex);
+
+	if (full) {
+		dispatch->dropping = true;
+		dispatch->dropped++;
+		encoder->dispatch_dropped++;
+		return;
+	}
+
+	if (dispatch->dropping) {
+		log_dispatch_dropped(encoder, dispatch);
+		dispatch->dropping = false;
+	}
+
+	os_sem_post(dispatch->sem);
+}
+
+static void encoder_dispatch_stop(struct encoder_dispatch *dispatch,
+				  bool drain)
+{
+	/* if a callback stops itself, its thread cleans up once the
+	 * callback returns */
+	bool self = pthread_equal(pthread_self(), dispatch->thread);
+
+	pthread_mutex_lock(&dispatch->mutex);
+	dispatch->stop = true;
+	dispatch->drain = drain && !self;
+	dispatch->detached = self;
+	pthread_mutex_unlock(&dispatch->mutex);
+
+	os_sem_post(dispatch->sem);
+
+	if (self) {
+		pthread_detach(dispatch->thread);
+	} else {
+		pthread_join(dispatch->thread, NULL);
+		encoder_dispatch_free(dispatch);
+	}
+}
+
 void full_stop(struct obs_encoder *encoder)
 {
 	if (encoder) {
@@ -962,9 +1183,16 @@ void full_stop(struct obs_encoder *encoder)
 		pthread_mutex_unlock(&encoder->outputs_mutex);
 
 		pthread_mutex_lock(&encoder->callbacks_mutex);
-		da_free(encoder->callbacks);
+		DARRAY(struct encoder_callback) callbacks;
+		da_init(callbacks);
+		da_move(callbacks, encoder->callbacks);
 		pthread_mutex_unlock(&encoder->callbacks_mutex);
 
+		for (size_t i = 0; i < callbacks.num; i++)
+			encoder_dispatch_stop(callbacks.array[i].dispatch,
+					      false);
+		da_free(callbacks);
+
 		remove_connection(encoder, false);
 		encoder->initialized = false;
 	}
@@ -996,15 +1224,39 @@ void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 		pkt->sys_dts_usec += encoder->pause.ts_offset / 1000;
 		pthread_mutex_unlock(&encoder->pause.mutex);
 
+		/* the packet data is only valid until the next encode call,
+		 * so copy it once and share it between all callbacks */
+		struct encoder_packet shared;
+		obs_encoder_packet_create_instance(&shared, pkt);
+
 		pthread_mutex_lock(&encoder->callbacks_mutex);
 
 		for (size_t i = encoder->callbacks.num; i > 0; i--) {
 			struct encoder_callback *cb;
 			cb = encoder->callbacks.array + (i - 1);
-			send_packet(encoder, cb, pkt);
+
+			/* include SEI in first video packet */
+			if (encoder->info.type == OBS_ENCODER_VIDEO &&
+			    !cb->sent_first_packet) {
+				struct encoder_packet first_packet;
+
+				if (!get_first_video_packet(encoder, &shared,
+							    &first_packet))
+					continue;
+
+				encoder_dispatch_push(encoder, cb->dispatch,
+						      &first_packet);
+				obs_encoder_packet_release(&first_packet);
+				cb->sent_first_packet = true;
+			} else {
+				encoder_dispatch_push(encoder, cb->dispatch,
+						      &shared);
+			}
 		}
 
 		pthread_mutex_unlock(&encoder->callbacks_mutex);
+
+		obs_encoder_packet_release(&shared);
 	}
 }
 
@@ -1072,6 +1324,362 @@ bool video_pause_check(struct pause_data *pause, uint64_t timestamp)
 	return ignore_frame;
 }
 
+/* ------------------------------------------------------------------------- */
+/* Raw video frame queue
+ *
+ * Raw video frames are held in the video output's cache and encoded on a
+ * thread of the encoder instead of the video output thread, so a slow encoder
+ * drops its own frames rather than delaying every other consumer of the video
+ * output. */
+
+#define ENCODER_FRAME_QUEUE_SIZE 2
+
+struct queued_frame {
+	struct video_data frame;
+	int64_t pts;
+	uint64_t queued_ns;
+};
+
+struct encoder_frame_queue {
+	struct obs_encoder *encoder;
+	video_t *video;
+
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	os_sem_t *sem;
+	struct circlebuf frames; /* struct queued_frame */
+	struct queued_frame cur;
+	bool has_cur;
+	bool closing;
+	bool stop;
+	bool detached;
+
+	struct obs_encoder_queue_stats stats;
+	uint64_t total_latency_ns;
+};
+
+static inline size_t frame_queue_depth(const struct encoder_frame_queue *queue)
+{
+	return queue->frames.size / sizeof(struct queued_frame);
+}
+
+static void get_frame_queue_stats(struct encoder_frame_queue *queue,
+				  struct obs_encoder_queue_stats *stats)
+{
+	pthread_mutex_lock(&queue->mutex);
+	*stats = queue->stats;
+	stats->queue_depth = (uint32_t)frame_queue_depth(queue);
+	if (stats->frames_encoded)
+		stats->avg_queue_latency_ns =
+			queue->total_latency_ns / stats->frames_encoded;
+	pthread_mutex_unlock(&queue->mutex);
+}
+
+static void encoder_frame_queue_free(struct encoder_frame_queue *queue)
+{
+	struct queued_frame qf;
+
+	while (queue->frames.size) {
+		circlebuf_pop_front(&queue->frames, &qf, sizeof(qf));
+		video_output_release_frame(queue->video, &qf.frame);
+	}
+
+	circlebuf_free(&queue->frames);
+	os_sem_destroy(queue->sem);
+	pthread_mutex_destroy(&queue->mutex);
+	bfree(queue);
+}
+
+static void encode_queued_frame(struct encoder_frame_queue *queue,
+				struct queued_frame *qf)
+{
+	struct encoder_frame enc_frame = {0};
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		enc_frame.data[i] = qf->frame.data[i];
+		enc_frame.linesize[i] = qf->frame.linesize[i];
+	}
+
+	enc_frame.frames = 1;
+	enc_frame.pts = qf->pts;
+
+	if (do_encode(queue->encoder, &enc_frame)) {
+		pthread_mutex_lock(&queue->mutex);
+		queue->stats.frames_encoded++;
+		pthread_mutex_unlock(&queue->mutex);
+	}
+}
+
+static void *encoder_frame_queue_thread(void *data)
+{
+	struct encoder_frame_queue *queue = data;
+	struct queued_frame qf;
+	bool detached;
+
+	os_set_thread_name("encoder-video");
+
+	for (;;) {
+		os_sem_wait(queue->sem);
+
+		/* once closing, the frames still queued are encoded before
+		 * the thread exits */
+		pthread_mutex_lock(&queue->mutex);
+		bool has_frame = !queue->stop && queue->frames.size;
+		bool done = queue->stop || (queue->closing && !has_frame);
+		if (has_frame) {
+			circlebuf_pop_front(&queue->frames, &qf, sizeof(qf));
+			queue->cur = qf;
+			queue->has_cur = true;
+
+			uint64_t latency = os_gettime_ns() - qf.queued_ns;
+			queue->total_latency_ns += latency;
+			if (latency > queue->stats.max_queue_latency_ns)
+				queue->stats.max_queue_latency_ns = latency;
+		}
+		pthread_mutex_unlock(&queue->mutex);
+
+		if (!has_frame) {
+			if (done)
+				break;
+			continue;
+		}
+
+		encode_queued_frame(queue, &qf);
+
+		/* an encode error may have already released the frame */
+		pthread_mutex_lock(&queue->mutex);
+		bool release = queue->has_cur;
+		queue->has_cur = false;
+		pthread_mutex_unlock(&queue->mutex);
+
+		if (release)
+			video_output_release_frame(queue->video, &qf.frame);
+
+		profile_reenable_thread();
+	}
+
+	pthread_mutex_lock(&queue->mutex);
+	detached = queue->detached;
+	pthread_mutex_unlock(&queue->mutex);
+
+	if (detached)
+		encoder_frame_queue_free(queue);
+	return NULL;
+}
+
+static struct encoder_frame_queue *
+encoder_frame_queue_create(struct obs_encoder *encoder)
+{
+	struct encoder_frame_queue *queue = bzalloc(sizeof(*queue));
+
+	queue->encoder = encoder;
+	queue->video = encoder->media;
+	queue->stats.queue_capacity = ENCODER_FRAME_QUEUE_SIZE;
+
+	pthread_mutex_init_value(&queue->mutex);
+	if (pthread_mutex_init(&queue->mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&queue->sem, 0) != 0)
+		goto fail;
+	if (pthread_create(&queue->thread, NULL, encoder_frame_queue_thread,
+			   queue) != 0)
+		goto fail;
+
+	return queue;
+
+fail:
+	blog(LOG_WARNING,
+	     "Failed to create video queue for encoder '%s', "
+	     "encoding on the video thread instead",
+	     encoder->context.name);
+	encoder_frame_queue_free(queue);
+	return NULL;
+}
+
+static void encoder_frame_queue_push(struct encoder_frame_queue *queue,
+				     struct video_data *frame, int64_t pts)
+{
+	struct queued_frame qf = {
+		.frame = *frame,
+		.pts = pts,
+		.queued_ns = os_gettime_ns(),
+	};
+	bool closing;
+	bool full;
+
+	/* only the video output thread pushes, so the queue can't fill up
+	 * between this check and the push below.  frames received after the
+	 * queue started closing come after the stop and are ignored */
+	pthread_mutex_lock(&queue->mutex);
+	closing = queue->closing;
+	full = frame_queue_depth(queue) >= ENCODER_FRAME_QUEUE_SIZE;
+	if (full && !closing)
+		queue->stats.dropped_queue_full++;
+	pthread_mutex_unlock(&queue->mutex);
+
+	if (closing || full)
+		return;
+
+	bool held = video_output_hold_frame(queue->video, frame);
+	bool queued = false;
+
+	pthread_mutex_lock(&queue->mutex);
+	if (held && !queue->closing) {
+		circlebuf_push_back(&queue->frames, &qf, sizeof(qf));
+		queue->stats.frames_queued++;
+		queued = true;
+	} else if (!held) {
+		queue->stats.dropped_no_buffer++;
+	}
+	pthread_mutex_unlock(&queue->mutex);
+
+	if (queued)
+		os_sem_post(queue->sem);
+	else if (held)
+		video_output_release_frame(queue->video, frame);
+}
+
+/* releases the frames held by the queue without encoding them */
+static void encoder_frame_queue_discard(struct encoder_frame_queue *queue)
+{
+	struct queued_frame qf;
+	bool release;
+
+	pthread_mutex_lock(&queue->mutex);
+	qf = queue->cur;
+	release = queue->has_cur;
+	queue->has_cur = false;
+	pthread_mutex_unlock(&queue->mutex);
+
+	if (release)
+		video_output_release_frame(queue->video, &qf.frame);
+
+	for (;;) {
+		pthread_mutex_lock(&queue->mutex);
+		release = queue->frames.size != 0;
+		if (release) {
+			circlebuf_pop_front(&queue->frames, &qf, sizeof(qf));
+			queue->stats.dropped_stopped++;
+		}
+		pthread_mutex_unlock(&queue->mutex);
+
+		if (!release)
+			break;
+		video_output_release_frame(queue->video, &qf.frame);
+	}
+}
+
+/* returns true if the thread was joined and the queue has to be freed */
+static bool encoder_frame_queue_close(struct encoder_frame_queue *queue)
+{
+	/* encode errors stop the encoder from the queue thread itself.  the
+	 * encoder failed, so the queued frames are dropped instead, and the
+	 * thread cleans up once the current frame is done */
+	bool self = pthread_equal(pthread_self(), queue->thread);
+	bool owner;
+
+	pthread_mutex_lock(&queue->mutex);
+	owner = !queue->closing;
+	queue->closing = true;
+	if (self) {
+		queue->stop = true;
+		queue->detached = owner;
+	}
+	pthread_mutex_unlock(&queue->mutex);
+
+	os_sem_post(queue->sem);
+
+	if (self)
+		encoder_frame_queue_discard(queue);
+	if (!owner)
+		return false;
+
+	if (self) {
+		pthread_detach(queue->thread);
+		return false;
+	}
+
+	pthread_join(queue->thread, NULL);
+	return true;
+}
+
+static void start_frame_queue(struct obs_encoder *encoder)
+{
+	struct encoder_frame_queue *queue = encoder_frame_queue_create(encoder);
+
+	pthread_mutex_lock(&encoder->frame_queue_mutex);
+	encoder->frame_queue = queue;
+	pthread_mutex_unlock(&encoder->frame_queue_mutex);
+}
+
+/* stops accepting frames and waits for the queued ones to be encoded.  the
+ * queue stays attached to the encoder until stop_frame_queue, so
+ * receive_video can't fall back to encoding on the video thread while the
+ * queue thread is still encoding */
+static struct encoder_frame_queue *
+drain_frame_queue(struct obs_encoder *encoder)
+{
+	struct encoder_frame_queue *queue;
+	bool joined = false;
+
+	pthread_mutex_lock(&encoder->frame_queue_mutex);
+	queue = encoder->frame_queue;
+	pthread_mutex_unlock(&encoder->frame_queue_mutex);
+
+	if (queue)
+		joined = encoder_frame_queue_close(queue);
+
+	return joined ? queue : NULL;
+}
+
+/* called once the video input is disconnected, so nothing pushes anymore */
+static void stop_frame_queue(struct obs_encoder *encoder,
+			     struct encoder_frame_queue *joined)
+{
+	pthread_mutex_lock(&encoder->frame_queue_mutex);
+	if (encoder->frame_queue) {
+		get_frame_queue_stats(encoder->frame_queue,
+				      &encoder->queue_stats);
+		encoder->frame_queue = NULL;
+	}
+	pthread_mutex_unlock(&encoder->frame_queue_mutex);
+
+	if (joined)
+		encoder_frame_queue_free(joined);
+}
+
+uint64_t obs_encoder_get_dropped_packets(obs_encoder_t *encoder)
+{
+	uint64_t dropped;
+
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_dropped_packets"))
+		return 0;
+
+	pthread_mutex_lock(&encoder->callbacks_mutex);
+	dropped = encoder->dispatch_dropped;
+	pthread_mutex_unlock(&encoder->callbacks_mutex);
+
+	return dropped;
+}
+
+bool obs_encoder_get_queue_stats(obs_encoder_t *encoder,
+				 struct obs_encoder_queue_stats *stats)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_queue_stats"))
+		return false;
+	if (!stats || encoder->info.type != OBS_ENCODER_VIDEO)
+		return false;
+
+	pthread_mutex_lock(&encoder->frame_queue_mutex);
+	if (encoder->frame_queue)
+		get_frame_queue_stats(encoder->frame_queue, stats);
+	else
+		*stats = encoder->queue_stats;
+	pthread_mutex_unlock(&encoder->frame_queue_mutex);
+
+	return true;
+}
+
 static const char *receive_video_name = "receive_video";
 static void receive_video(void *param, struct video_data *frame)
 {
@@ -1091,6 +1699,18 @@ static void receive_video(void *param, struct video_data *frame)
 	if (video_pause_check(&encoder->pause, frame->timestamp))
 		goto wait_for_audio;
 
+	if (!encoder->start_ts)
+		encoder->start_ts = frame->timestamp;
+
+	if (encoder->frame_queue) {
+		/* frames dropped by the queue keep their place in the
+		 * timeline, so pts advances for every frame received */
+		encoder_frame_queue_push(encoder->frame_queue, frame,
+					 encoder->cur_pts);
+		encoder->cur_pts += encoder->timebase_num;
+		goto wait_for_audio;
+	}
+
 	memset(&enc_frame, 0, sizeof(struct encoder_frame));
 
 	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
@@ -1098,9 +1718,6 @@ static void receive_video(void *param, struct video_data *frame)
 		enc_frame.linesize[i] = frame->linesize[i];
 	}
 
-	if (!encoder->start_ts)
-		encoder->start_ts = frame->timestamp;
-
 	enc_frame.frames = 1;
 	enc_frame.pts = encoder->cur_pts;
 
@@ -315,6 +315,21 @@ extern struct obs_core_video_mix *
 obs_create_video_mix(struct obs_video_info *ovi);
 extern void obs_free_video_mix(struct obs_core_video_mix *video);
 
+/* worker threads for the video_tick callbacks of sources flagged with
+ * OBS_SOURCE_PARALLEL_TICK, owned by the graphics thread */
+struct obs_tick_pool {
+	pthread_t *threads;
+	size_t num_threads;
+	os_sem_t *start_sem;
+	os_sem_t *done_sem;
+	volatile bool stop;
+	bool failed;
+
+	DARRAY(struct obs_source *) sources;
+	volatile long next;
+	float seconds;
+};
+
 struct obs_core_video {
 	graphics_t *graphics;
 	gs_effect_t *default_effect;
@@ -360,6 +375,8 @@ struct obs_core_video {
 	pthread_mutex_t mixes_mutex;
 	DARRAY(struct obs_core_video_mix *) mixes;
 	struct obs_core_video_mix *main_mix;
+
+	struct obs_tick_pool tick_pool;
 };
 
 struct audio_monitor;
@@ -377,6 +394,11 @@ struct obs_core_audio {
 	int max_buffering_ticks;
 	bool fixed_buffer;
 
+	/* most ticks of buffering the sources needed in the current window,
+	 * used to reduce buffering again after a spike */
+	uint64_t buffering_window_ticks;
+	int buffering_window_peak;
+
 	pthread_mutex_t monitoring_mutex;
 	DARRAY(struct audio_monitor *) monitors;
 	char *monitoring_device_name;
@@ -419,6 +441,16 @@ struct obs_core_data {
 	volatile bool valid;
 
 	DARRAY(char *) protocols;
+
+	/* segment prefixes of active disk delay buffers, so that the sweep of
+	 * stale segments doesn't remove files that are still in use */
+	pthread_mutex_t delay_disks_mutex;
+	DARRAY(char *) delay_disk_prefixes;
+
+	/* caches of sources that are not showing get evicted over budget */
+	uint64_t source_memory_budget;
+	uint64_t source_memory_usage;
+	uint64_t last_memory_check;
 };
 
 /* user hotkeys */
@@ -475,6 +507,7 @@ struct obs_core {
 
 	char *locale;
 	char *module_config_path;
+	char *effect_cache_path;
 	bool name_store_owned;
 	profiler_name_store_t *name_store;
 
@@ -650,6 +683,34 @@ struct async_frame {
 	bool used;
 };
 
+#define ASYNC_UPLOAD_SLOTS 3
+
+enum async_upload_state {
+	ASYNC_UPLOAD_UNMAPPED,
+	ASYNC_UPLOAD_FREE,
+	ASYNC_UPLOAD_WRITING,
+	ASYNC_UPLOAD_READY,
+};
+
+/* set of dynamic textures matching the async textures of a source, kept
+ * mapped by the graphics thread so the thread outputting frames can write
+ * into them directly */
+struct async_upload {
+	gs_texture_t *tex[MAX_AV_PLANES];
+	uint8_t *data[MAX_AV_PLANES];
+	uint32_t linesize[MAX_AV_PLANES];
+	uint32_t rows[MAX_AV_PLANES];
+	struct obs_source_frame *frame;
+	enum async_upload_state state;
+
+	/* frames the textures were created for */
+	uint32_t width;
+	uint32_t height;
+	enum video_format format;
+	bool full_range;
+	uint8_t trc;
+};
+
 enum audio_action_type {
 	AUDIO_ACTION_VOL,
 	AUDIO_ACTION_MUTE,
@@ -715,6 +776,7 @@ struct obs_source {
 
 	bool active;
 	bool showing;
+	uint64_t last_shown_time;
 
 	/* used to temporarily disable sources if needed */
 	bool enabled;
@@ -745,6 +807,9 @@ struct obs_source {
 	uint64_t audio_ts;
 	struct circlebuf audio_input_buf[MAX_AUDIO_CHANNELS];
 	size_t last_audio_input_buf_size;
+	size_t audio_input_capacity;
+	uint64_t audio_dropped_frames;
+	bool audio_overflowing;
 	DARRAY(struct audio_action) audio_actions;
 	float *audio_output_buf[MAX_AUDIO_MIXES][MAX_AUDIO_CHANNELS];
 	float *audio_mix_buf[MAX_AUDIO_CHANNELS];
@@ -795,6 +860,11 @@ struct obs_source {
 	uint32_t async_convert_width[MAX_AV_PLANES];
 	uint32_t async_convert_height[MAX_AV_PLANES];
 
+	/* async video upload staging, see obs-source-upload.c */
+	struct async_upload *async_uploads[ASYNC_UPLOAD_SLOTS];
+	DARRAY(struct async_upload *) async_upload_orphans;
+	bool async_upload_failed;
+
 	pthread_mutex_t caption_cb_mutex;
 	DARRAY(struct caption_cb_info) caption_cb_list;
 
@@ -985,6 +1055,11 @@ extern void obs_source_set_texcoords_centered(obs_source_t *source,
 extern void obs_source_activate(obs_source_t *source, enum view_type type);
 extern void obs_source_deactivate(obs_source_t *source, enum view_type type);
 extern void obs_source_video_tick(obs_source_t *source, float seconds);
+extern void obs_source_video_tick_state(obs_source_t *source, float seconds);
+extern bool obs_source_needs_video_tick(const obs_source_t *source);
+extern bool obs_source_parallel_video_tick(const obs_source_t *source);
+extern void obs_evict_source_caches(uint64_t sys_time);
+extern void obs_source_reserve_audio_input(obs_source_t *source);
 extern float obs_source_get_target_volume(obs_source_t *source,
 					  obs_source_t *target);
 
@@ -1008,6 +1083,15 @@ extern bool set_async_texture_size(struct obs_source *source,
 extern void remove_async_frame(obs_source_t *source,
 			       struct obs_source_frame *frame);
 
+extern void async_upload_write(obs_source_t *source,
+			       struct obs_source_frame *frame);
+extern void async_upload_release_frame(obs_source_t *source,
+				       struct obs_source_frame *frame);
+extern bool async_upload_take(obs_source_t *source,
+			      struct obs_source_frame *frame);
+extern void async_upload_update(obs_source_t *source);
+extern void async_upload_free(obs_source_t *source);
+
 extern void set_deinterlace_texture_size(obs_source_t *source);
 extern void deinterlace_process_last_frame(obs_source_t *source,
 					   uint64_t sys_time);
@@ -1027,8 +1111,14 @@ struct delay_data {
 	enum delay_msg msg;
 	uint64_t ts;
 	struct encoder_packet packet;
+
+	/* sequence number of the packet if it was spilled to disk, in which
+	 * case packet.data is NULL until it's read back */
+	uint64_t disk_seq;
 };
 
+struct delay_disk;
+
 typedef void (*encoded_callback_t)(void *data, struct encoder_packet *packet);
 
 struct obs_weak_output {
@@ -1140,6 +1230,8 @@ struct obs_output {
 	volatile long delay_restart_refs;
 	volatile bool delay_active;
 	volatile bool delay_capturing;
+	char *delay_disk_path;
+	struct delay_disk *delay_disk;
 
 	char *last_error_message;
 
@@ -1157,6 +1249,7 @@ static inline void do_output_signal(struct obs_output *output,
 
 extern void process_delay(void *data, struct encoder_packet *packet);
 extern void obs_output_cleanup_delay(obs_output_t *output);
+extern void obs_output_init_delay_disk(obs_output_t *output);
 extern bool obs_output_delay_start(obs_output_t *output);
 extern void obs_output_delay_stop(obs_output_t *output);
 extern bool obs_output_actual_start(obs_output_t *output);
@@ -1181,10 +1274,13 @@ struct obs_weak_encoder {
 	struct obs_encoder *encoder;
 };
 
+struct encoder_dispatch;
+
 struct encoder_callback {
 	bool sent_first_packet;
 	void (*new_packet)(void *param, struct encoder_packet *packet);
 	void *param;
+	struct encoder_dispatch *dispatch;
 };
 
 struct obs_encoder {
@@ -1245,11 +1341,21 @@ struct obs_encoder {
 	pthread_mutex_t callbacks_mutex;
 	DARRAY(struct encoder_callback) callbacks;
 
+	/* packets dropped because a callback's dispatch queue was full,
+	 * guarded by callbacks_mutex */
+	uint64_t dispatch_dropped;
+
 	struct pause_data pause;
 
 	const char *profile_encoder_encode_name;
 	char *last_error_message;
 
+	/* raw video frames waiting to be encoded on the encoder's own thread.
+	 * queue_stats keeps the statistics of the last queue once it stops */
+	pthread_mutex_t frame_queue_mutex;
+	struct encoder_frame_queue *frame_queue;
+	struct obs_encoder_queue_stats queue_stats;
+
 	/* reconfigure encoder at next possible opportunity */
 	bool reconfigure_requested;
 };
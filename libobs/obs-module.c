@@ -392,11 +392,30 @@ void obs_module_failure_info_free(struct obs_module_failure_info *mfi)
 	}
 }
 
+static void log_effect_load_stats(void)
+{
+	struct gs_effect_load_stats stats = {0};
+
+	if (!obs->video.graphics)
+		return;
+
+	obs_enter_graphics();
+	gs_effect_get_load_stats(&stats);
+	obs_leave_graphics();
+
+	blog(LOG_INFO,
+	     "Effects: %u loaded (%u from cache, %u reused) in %.2f ms",
+	     stats.loaded, stats.cache_hits, stats.reused,
+	     (double)stats.load_time_ns / 1000000.0);
+}
+
 void obs_post_load_modules(void)
 {
 	for (obs_module_t *mod = obs->first_module; !!mod; mod = mod->next)
 		if (mod->post_load)
 			mod->post_load();
+
+	log_effect_load_stats();
 }
 
 static inline void make_data_dir(struct dstr *parsed_data_dir,
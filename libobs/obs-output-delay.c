@@ -18,6 +18,437 @@
 #include <inttypes.h>
 #include "obs-internal.h"
 
+/* ------------------------------------------------------------------------- */
+/* disk storage for delayed packets                                          */
+
+#define DELAY_SEGMENT_SIZE (64ULL * 1024 * 1024)
+#define DELAY_WRITE_BUFFER_SIZE (1024 * 1024)
+#define DELAY_NO_SEGMENT UINT32_MAX
+
+/* packets waiting for the writer thread */
+struct delay_write {
+	uint64_t seq;
+	struct encoder_packet packet;
+};
+
+/* packets that have been written and flushed */
+struct delay_location {
+	uint64_t seq;
+	uint32_t segment;
+	uint64_t offset;
+};
+
+struct delay_disk {
+	struct dstr prefix;
+
+	pthread_t thread;
+	bool thread_created;
+	pthread_mutex_t mutex;
+	os_sem_t *sem;
+	volatile bool stop;
+	volatile bool write_error;
+
+	struct circlebuf writes;
+	struct circlebuf locations;
+	uint64_t next_seq;
+
+	/* only used by the writer thread */
+	FILE *write_file;
+	uint32_t write_segment;
+	uint64_t write_pos;
+
+	/* only used by the thread popping delayed packets */
+	FILE *read_file;
+	uint32_t read_segment;
+};
+
+static void get_segment_path(struct delay_disk *disk, uint32_t segment,
+			     struct dstr *path)
+{
+	dstr_printf(path, "%s%" PRIu32 ".bin", disk->prefix.array, segment);
+}
+
+static void remove_segment(struct delay_disk *disk, uint32_t segment)
+{
+	struct dstr path = {0};
+	get_segment_path(disk, segment, &path);
+	os_unlink(path.array);
+	dstr_free(&path);
+}
+
+static FILE *open_segment(struct delay_disk *disk, uint32_t segment,
+			  const char *mode)
+{
+	struct dstr path = {0};
+	FILE *file;
+
+	get_segment_path(disk, segment, &path);
+	file = os_fopen(path.array, mode);
+	if (!file)
+		blog(LOG_WARNING, "Failed to open delay segment '%s'",
+		     path.array);
+	dstr_free(&path);
+	return file;
+}
+
+/* segment files of delays that are still running, anything else matching
+ * delay-*.bin was left behind by a crash */
+static bool is_live_segment(const char *path)
+{
+	struct obs_core_data *data = &obs->data;
+
+	for (size_t i = 0; i < data->delay_disk_prefixes.num; i++) {
+		const char *prefix = data->delay_disk_prefixes.array[i];
+		if (strncmp(path, prefix, strlen(prefix)) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+static void remove_stale_segments(const char *dir)
+{
+	struct dstr pattern = {0};
+	os_glob_t *glob;
+
+	dstr_copy(&pattern, dir);
+	dstr_replace(&pattern, "\\", "/");
+	if (dstr_end(&pattern) != '/')
+		dstr_cat_ch(&pattern, '/');
+	dstr_cat(&pattern, "delay-*.bin");
+
+	pthread_mutex_lock(&obs->data.delay_disks_mutex);
+
+	if (os_glob(pattern.array, 0, &glob) == 0) {
+		for (size_t i = 0; i < glob->gl_pathc; i++) {
+			const char *path = glob->gl_pathv[i].path;
+
+			if (glob->gl_pathv[i].directory || is_live_segment(path))
+				continue;
+
+			blog(LOG_INFO, "Removing stale delay segment '%s'",
+			     path);
+			os_unlink(path);
+		}
+
+		os_globfree(glob);
+	}
+
+	pthread_mutex_unlock(&obs->data.delay_disks_mutex);
+	dstr_free(&pattern);
+}
+
+static bool delay_disk_write_packet(struct delay_disk *disk,
+				    struct encoder_packet *packet)
+{
+	if (disk->write_pos &&
+	    disk->write_pos + packet->size > DELAY_SEGMENT_SIZE) {
+		fclose(disk->write_file);
+
+		disk->write_segment++;
+		disk->write_pos = 0;
+		disk->write_file =
+			open_segment(disk, disk->write_segment, "wb");
+		if (!disk->write_file)
+			return false;
+
+		setvbuf(disk->write_file, NULL, _IOFBF,
+			DELAY_WRITE_BUFFER_SIZE);
+	}
+
+	/* flushed so the packet can be read back through another handle */
+	return fwrite(packet->data, 1, packet->size, disk->write_file) ==
+		       packet->size &&
+	       fflush(disk->write_file) == 0;
+}
+
+/* writes packets in order.  the packet stays in the queue while it's being
+ * written, so that it can still be read from memory until it's on disk */
+static void *delay_disk_thread(void *param)
+{
+	struct delay_disk *disk = param;
+
+	os_set_thread_name("output delay disk writer");
+
+	while (os_sem_wait(disk->sem) == 0) {
+		struct delay_location loc;
+		struct delay_write write;
+
+		if (os_atomic_load_bool(&disk->stop))
+			break;
+
+		pthread_mutex_lock(&disk->mutex);
+		if (!disk->writes.size) {
+			pthread_mutex_unlock(&disk->mutex);
+			continue;
+		}
+		circlebuf_peek_front(&disk->writes, &write, sizeof(write));
+		pthread_mutex_unlock(&disk->mutex);
+
+		if (!delay_disk_write_packet(disk, &write.packet)) {
+			blog(LOG_WARNING, "Failed to write delay segment, "
+					  "keeping delayed packets in memory "
+					  "from now on");
+			os_atomic_set_bool(&disk->write_error, true);
+			break;
+		}
+
+		/* the packet may have started a new segment */
+		loc.seq = write.seq;
+		loc.segment = disk->write_segment;
+		loc.offset = disk->write_pos;
+		disk->write_pos += write.packet.size;
+
+		pthread_mutex_lock(&disk->mutex);
+		circlebuf_pop_front(&disk->writes, NULL, sizeof(write));
+		circlebuf_push_back(&disk->locations, &loc, sizeof(loc));
+		pthread_mutex_unlock(&disk->mutex);
+
+		obs_encoder_packet_release(&write.packet);
+	}
+
+	return NULL;
+}
+
+static void delay_disk_destroy(struct delay_disk *disk)
+{
+	if (!disk)
+		return;
+
+	if (disk->thread_created) {
+		os_atomic_set_bool(&disk->stop, true);
+		os_sem_post(disk->sem);
+		pthread_join(disk->thread, NULL);
+	}
+
+	while (disk->writes.size) {
+		struct delay_write write;
+		circlebuf_pop_front(&disk->writes, &write, sizeof(write));
+		obs_encoder_packet_release(&write.packet);
+	}
+
+	if (disk->read_file)
+		fclose(disk->read_file);
+	if (disk->write_file)
+		fclose(disk->write_file);
+
+	/* any remaining segments are no longer needed */
+	uint32_t first = disk->read_segment != DELAY_NO_SEGMENT
+				 ? disk->read_segment
+				 : 0;
+	for (uint32_t i = first; i <= disk->write_segment; i++)
+		remove_segment(disk, i);
+
+	if (disk->prefix.array) {
+		struct obs_core_data *data = &obs->data;
+
+		pthread_mutex_lock(&data->delay_disks_mutex);
+		for (size_t i = 0; i < data->delay_disk_prefixes.num; i++) {
+			char *prefix = data->delay_disk_prefixes.array[i];
+
+			if (strcmp(prefix, disk->prefix.array) == 0) {
+				da_erase(data->delay_disk_prefixes, i);
+				bfree(prefix);
+				break;
+			}
+		}
+		pthread_mutex_unlock(&data->delay_disks_mutex);
+	}
+
+	circlebuf_free(&disk->writes);
+	circlebuf_free(&disk->locations);
+	os_sem_destroy(disk->sem);
+	pthread_mutex_destroy(&disk->mutex);
+	dstr_free(&disk->prefix);
+	bfree(disk);
+}
+
+static struct delay_disk *delay_disk_create(const char *dir)
+{
+	struct delay_disk *disk = bzalloc(sizeof(*disk));
+	char *uuid = os_generate_uuid();
+	char *prefix;
+
+	pthread_mutex_init_value(&disk->mutex);
+	disk->read_segment = DELAY_NO_SEGMENT;
+
+	os_mkdirs(dir);
+
+	dstr_copy(&disk->prefix, dir);
+	dstr_replace(&disk->prefix, "\\", "/");
+	if (dstr_end(&disk->prefix) != '/')
+		dstr_cat_ch(&disk->prefix, '/');
+	dstr_catf(&disk->prefix, "delay-%s-", uuid);
+	bfree(uuid);
+
+	/* registered before any file exists, so a sweep can't remove it */
+	prefix = bstrdup(disk->prefix.array);
+	pthread_mutex_lock(&obs->data.delay_disks_mutex);
+	da_push_back(obs->data.delay_disk_prefixes, &prefix);
+	pthread_mutex_unlock(&obs->data.delay_disks_mutex);
+
+	disk->write_file = open_segment(disk, 0, "wb");
+	if (!disk->write_file)
+		goto fail;
+
+	setvbuf(disk->write_file, NULL, _IOFBF, DELAY_WRITE_BUFFER_SIZE);
+
+	if (pthread_mutex_init(&disk->mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&disk->sem, 0) != 0)
+		goto fail;
+	if (pthread_create(&disk->thread, NULL, delay_disk_thread, disk) != 0)
+		goto fail;
+
+	disk->thread_created = true;
+	return disk;
+
+fail:
+	delay_disk_destroy(disk);
+	return NULL;
+}
+
+/* hands the packet to the writer thread, returns the sequence number it can
+ * be read back with */
+static bool delay_disk_queue(struct delay_disk *disk, struct delay_data *dd,
+			     struct encoder_packet *packet)
+{
+	struct delay_write write;
+
+	if (os_atomic_load_bool(&disk->write_error))
+		return false;
+
+	pthread_mutex_lock(&disk->mutex);
+	write.seq = disk->next_seq++;
+	obs_encoder_packet_ref(&write.packet, packet);
+	circlebuf_push_back(&disk->writes, &write, sizeof(write));
+	pthread_mutex_unlock(&disk->mutex);
+
+	os_sem_post(disk->sem);
+
+	dd->disk_seq = write.seq;
+	return true;
+}
+
+/* queued packets have consecutive sequence numbers */
+static bool find_write(struct delay_disk *disk, uint64_t seq,
+		       struct delay_write *write)
+{
+	struct circlebuf *cb = &disk->writes;
+	uint8_t *dst = (uint8_t *)write;
+	size_t size = sizeof(*write);
+	size_t offset, first;
+
+	if (!cb->size)
+		return false;
+
+	circlebuf_peek_front(cb, write, size);
+	if (seq < write->seq || seq - write->seq >= cb->size / size)
+		return false;
+
+	offset = cb->start_pos + (size_t)(seq - write->seq) * size;
+	if (offset >= cb->capacity)
+		offset -= cb->capacity;
+
+	first = cb->capacity - offset;
+	if (first > size)
+		first = size;
+
+	memcpy(dst, (uint8_t *)cb->data + offset, first);
+	memcpy(dst + first, cb->data, size - first);
+	return true;
+}
+
+static bool delay_disk_read(struct delay_disk *disk, struct delay_data *dd)
+{
+	struct encoder_packet *packet = &dd->packet;
+	struct delay_location loc = {0};
+	struct delay_write write;
+
+	pthread_mutex_lock(&disk->mutex);
+
+	while (disk->locations.size) {
+		circlebuf_peek_front(&disk->locations, &loc, sizeof(loc));
+		if (loc.seq >= dd->disk_seq)
+			break;
+		circlebuf_pop_front(&disk->locations, NULL, sizeof(loc));
+	}
+
+	/* not written yet, still in memory */
+	if (!disk->locations.size || loc.seq != dd->disk_seq) {
+		bool found = find_write(disk, dd->disk_seq, &write);
+		if (found)
+			obs_encoder_packet_ref(packet, &write.packet);
+
+		/* the writer thread stopped, nothing else will drop it */
+		if (found && os_atomic_load_bool(&disk->write_error)) {
+			circlebuf_pop_front(&disk->writes, NULL, sizeof(write));
+			obs_encoder_packet_release(&write.packet);
+		}
+
+		pthread_mutex_unlock(&disk->mutex);
+		return found;
+	}
+
+	circlebuf_pop_front(&disk->locations, NULL, sizeof(loc));
+	pthread_mutex_unlock(&disk->mutex);
+
+	/* segments are read in order, so older ones can be removed */
+	if (disk->read_segment != loc.segment) {
+		if (disk->read_file) {
+			fclose(disk->read_file);
+			disk->read_file = NULL;
+		}
+		if (disk->read_segment != DELAY_NO_SEGMENT) {
+			for (uint32_t i = disk->read_segment; i < loc.segment;
+			     i++)
+				remove_segment(disk, i);
+		}
+
+		disk->read_segment = loc.segment;
+		disk->read_file = open_segment(disk, loc.segment, "rb");
+	}
+
+	if (!disk->read_file)
+		return false;
+
+	/* same layout as obs_encoder_packet_create_instance */
+	long *p_refs = bmalloc(packet->size + sizeof(long));
+	packet->data = (void *)(p_refs + 1);
+	*p_refs = 1;
+
+	if (os_fseeki64(disk->read_file, (int64_t)loc.offset, SEEK_SET) != 0 ||
+	    fread(packet->data, 1, packet->size, disk->read_file) !=
+		    packet->size) {
+		blog(LOG_WARNING, "Failed to read delayed packet from disk");
+		obs_encoder_packet_release(packet);
+		return false;
+	}
+
+	return true;
+}
+
+void obs_output_init_delay_disk(obs_output_t *output)
+{
+	delay_disk_destroy(output->delay_disk);
+	output->delay_disk = NULL;
+
+	if ((output->delay_cur_flags & OBS_OUTPUT_DELAY_DISK) == 0)
+		return;
+
+	if (!output->delay_disk_path || !*output->delay_disk_path) {
+		blog(LOG_WARNING,
+		     "Output '%s': No delay disk path set, keeping "
+		     "delayed packets in memory",
+		     output->context.name);
+		return;
+	}
+
+	output->delay_disk = delay_disk_create(output->delay_disk_path);
+}
+
+/* ------------------------------------------------------------------------- */
+
 static inline bool delay_active(const struct obs_output *output)
 {
 	return os_atomic_load_bool(&output->delay_active);
@@ -31,13 +462,21 @@ static inline bool delay_capturing(const struct obs_output *output)
 static inline void push_packet(struct obs_output *output,
 			       struct encoder_packet *packet, uint64_t t)
 {
-	struct delay_data dd;
+	struct delay_data dd = {0};
 
 	dd.msg = DELAY_MSG_PACKET;
 	dd.ts = t;
-	obs_encoder_packet_create_instance(&dd.packet, packet);
 
 	pthread_mutex_lock(&output->delay_mutex);
+
+	if (output->delay_disk && packet->size &&
+	    delay_disk_queue(output->delay_disk, &dd, packet)) {
+		dd.packet = *packet;
+		dd.packet.data = NULL;
+	} else {
+		obs_encoder_packet_ref(&dd.packet, packet);
+	}
+
 	circlebuf_push_back(&output->delay_data, &dd, sizeof(dd));
 	pthread_mutex_unlock(&output->delay_mutex);
 }
@@ -67,11 +506,14 @@ void obs_output_cleanup_delay(obs_output_t *output)
 
 	while (output->delay_data.size) {
 		circlebuf_pop_front(&output->delay_data, &dd, sizeof(dd));
-		if (dd.msg == DELAY_MSG_PACKET) {
+		if (dd.msg == DELAY_MSG_PACKET && dd.packet.data) {
 			obs_encoder_packet_release(&dd.packet);
 		}
 	}
 
+	delay_disk_destroy(output->delay_disk);
+	output->delay_disk = NULL;
+
 	output->active_delay_ns = 0;
 	os_atomic_set_long(&output->delay_restart_refs, 0);
 }
@@ -103,11 +545,16 @@ static inline bool pop_packet(struct obs_output *output, uint64_t t)
 		}
 	}
 
+	/* packets spilled to disk are only read back once they're due */
+	bool lost = popped && dd.msg == DELAY_MSG_PACKET && !dd.packet.data &&
+		    dd.packet.size &&
+		    !delay_disk_read(output->delay_disk, &dd);
+
 	pthread_mutex_unlock(&output->delay_mutex);
 
 	/* ------------------------------------------------ */
 
-	if (popped)
+	if (popped && !lost)
 		process_delay_data(output, &dd);
 
 	return popped;
@@ -199,6 +646,18 @@ void obs_output_set_delay(obs_output_t *output, uint32_t delay_sec,
 	output->delay_flags = flags;
 }
 
+void obs_output_set_delay_disk_path(obs_output_t *output, const char *path)
+{
+	if (!obs_output_valid(output, "obs_output_set_delay_disk_path"))
+		return;
+
+	bfree(output->delay_disk_path);
+	output->delay_disk_path = path ? bstrdup(path) : NULL;
+
+	if (path && *path)
+		remove_stale_segments(path);
+}
+
 uint32_t obs_output_get_delay(const obs_output_t *output)
 {
 	return obs_output_valid(output, "obs_output_set_delay")
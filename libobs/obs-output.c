@@ -231,7 +231,10 @@ void obs_output_destroy(obs_output_t *output)
 		pthread_mutex_destroy(&output->delay_mutex);
 		os_event_destroy(output->reconnect_stop_event);
 		obs_context_data_free(&output->context);
+		if (output->delay_disk)
+			obs_output_cleanup_delay(output);
 		circlebuf_free(&output->delay_data);
+		bfree(output->delay_disk_path);
 		circlebuf_free(&output->caption_data);
 		if (output->owns_info_id)
 			bfree((void *)output->info.id);
@@ -1723,15 +1726,12 @@ static void discard_unused_audio_packets(struct obs_output *output,
 		discard_to_idx(output, idx);
 }
 
-static void interleave_packets(void *data, struct encoder_packet *packet)
+static void do_interleave_packets(struct obs_output *output,
+				  struct encoder_packet *packet)
 {
-	struct obs_output *output = data;
 	struct encoder_packet out;
 	bool was_started;
 
-	if (!active(output))
-		return;
-
 	if (packet->type == OBS_ENCODER_AUDIO)
 		packet->track_idx = get_track_index(output, packet);
 
@@ -1753,7 +1753,7 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	if (output->active_delay_ns)
 		out = *packet;
 	else
-		obs_encoder_packet_create_instance(&out, packet);
+		obs_encoder_packet_ref(&out, packet);
 
 	if (was_started)
 		apply_interleaved_packet_offset(output, &out);
@@ -1781,10 +1781,28 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	pthread_mutex_unlock(&output->interleaved_mutex);
 }
 
+static const char *interleave_packets_name = "interleave_packets";
+
+static void interleave_packets(void *data, struct encoder_packet *packet)
+{
+	struct obs_output *output = data;
+
+	if (!active(output))
+		return;
+
+	profile_start(interleave_packets_name);
+	do_interleave_packets(output, packet);
+	profile_end(interleave_packets_name);
+}
+
 static void default_encoded_callback(void *param, struct encoder_packet *packet)
 {
 	struct obs_output *output = param;
 
+	/* each encoder delivers its packets on its own dispatch thread, so
+	 * serialize them the same way interleaved packets are */
+	pthread_mutex_lock(&output->interleaved_mutex);
+
 	if (data_active(output)) {
 		if (packet->type == OBS_ENCODER_AUDIO)
 			packet->track_idx = get_track_index(output, packet);
@@ -1795,6 +1813,8 @@ static void default_encoded_callback(void *param, struct encoder_packet *packet)
 			output->total_frames++;
 	}
 
+	pthread_mutex_unlock(&output->interleaved_mutex);
+
 	if (output->active_delay_ns)
 		obs_encoder_packet_release(packet);
 }
@@ -1974,13 +1994,16 @@ static void hook_data_capture(struct obs_output *output, bool encoded,
 			output->delay_cur_flags = output->delay_flags;
 			output->delay_callback = encoded_callback;
 			encoded_callback = process_delay;
+			obs_output_init_delay_disk(output);
 			os_atomic_set_bool(&output->delay_active, true);
 
 			blog(LOG_INFO,
 			     "Output '%s': %" PRIu32 " second delay "
-			     "active, preserve on disconnect is %s",
+			     "active, preserve on disconnect is %s, "
+			     "stored %s",
 			     output->context.name, output->delay_sec,
-			     preserve_active(output) ? "on" : "off");
+			     preserve_active(output) ? "on" : "off",
+			     output->delay_disk ? "on disk" : "in memory");
 		}
 
 		if (has_audio)
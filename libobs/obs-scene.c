@@ -175,6 +175,8 @@ static void *scene_create(obs_data_t *settings, struct obs_source *source)
 		goto fail;
 	}
 
+	scene->items_dirty = true;
+
 	UNUSED_PARAMETER(settings);
 	return scene;
 
@@ -243,6 +245,11 @@ static void scene_destroy(void *data)
 
 	remove_all_items(scene);
 
+	HASH_CLEAR(hh_id, scene->items_by_id);
+	HASH_CLEAR(hh_name, scene->items_by_name);
+	HASH_CLEAR(hh_source, scene->items_by_source);
+	da_free(scene->item_order);
+
 	pthread_mutex_destroy(&scene->video_mutex);
 	pthread_mutex_destroy(&scene->audio_mutex);
 	bfree(scene);
@@ -312,8 +319,115 @@ static void scene_enum_all_sources(void *data,
 	scene_enum_sources(data, enum_callback, param, false);
 }
 
+/* clears the indexes right away rather than at the next rebuild, because the
+ * hash tables must not outlive the items in them once they've been detached
+ * (and possibly freed) */
+static void invalidate_item_index(struct obs_scene *scene)
+{
+	if (!scene)
+		return;
+
+	video_lock(scene);
+	HASH_CLEAR(hh_id, scene->items_by_id);
+	HASH_CLEAR(hh_name, scene->items_by_name);
+	HASH_CLEAR(hh_source, scene->items_by_source);
+	os_atomic_set_bool(&scene->items_dirty, true);
+	video_unlock(scene);
+}
+
+/* the id changes with the video mutex held, otherwise the index could be
+ * rebuilt with the old id between invalidating it and the change */
+static void set_item_id(struct obs_scene_item *item, int64_t id)
+{
+	struct obs_scene *scene = item->parent;
+
+	if (!scene) {
+		item->id = id;
+		return;
+	}
+
+	video_lock(scene);
+	item->id = id;
+	invalidate_item_index(scene);
+	video_unlock(scene);
+}
+
+static inline uint32_t item_name_hash(const char *name)
+{
+	uint32_t hash;
+	HASH_VALUE(name, strlen(name), hash);
+	return hash;
+}
+
+/* items sharing a name hash (the same source added more than once, or a
+ * collision) are chained in order through next_same_name, so lookups still
+ * return the first matching item like the linear scans used to */
+static void index_item_name(struct obs_scene *scene,
+			    struct obs_scene_item *item)
+{
+	struct obs_scene_item *first;
+
+	item->name_hash = item_name_hash(item->source->context.name);
+	item->next_same_name = NULL;
+
+	HASH_FIND(hh_name, scene->items_by_name, &item->name_hash,
+		  sizeof(item->name_hash), first);
+	if (!first) {
+		HASH_ADD(hh_name, scene->items_by_name, name_hash,
+			 sizeof(item->name_hash), item);
+		return;
+	}
+
+	while (first->next_same_name)
+		first = first->next_same_name;
+	first->next_same_name = item;
+}
+
+static void rebuild_item_index(struct obs_scene *scene)
+{
+	struct obs_scene_item *item = scene->first_item;
+	struct obs_scene_item *found;
+
+	HASH_CLEAR(hh_id, scene->items_by_id);
+	HASH_CLEAR(hh_name, scene->items_by_name);
+	HASH_CLEAR(hh_source, scene->items_by_source);
+	da_resize(scene->item_order, 0);
+
+	os_atomic_set_bool(&scene->items_dirty, false);
+
+	while (item) {
+		item->order_idx = scene->item_order.num;
+		da_push_back(scene->item_order, &item);
+
+		HASH_FIND(hh_id, scene->items_by_id, &item->id,
+			  sizeof(item->id), found);
+		if (!found)
+			HASH_ADD(hh_id, scene->items_by_id, id,
+				 sizeof(item->id), item);
+
+		HASH_FIND(hh_source, scene->items_by_source, &item->source,
+			  sizeof(item->source), found);
+		if (!found)
+			HASH_ADD(hh_source, scene->items_by_source, source,
+				 sizeof(item->source), item);
+
+		index_item_name(scene, item);
+
+		item = item->next;
+	}
+}
+
+/* must be called with the video mutex held */
+static inline void update_item_index(struct obs_scene *scene)
+{
+	if (os_atomic_load_bool(&scene->items_dirty))
+		rebuild_item_index(scene);
+}
+
 static inline void detach_sceneitem(struct obs_scene_item *item)
 {
+	invalidate_item_index(item->parent);
+
 	if (item->prev)
 		item->prev->next = item->next;
 	else
@@ -329,6 +443,8 @@ static inline void attach_sceneitem(struct obs_scene *parent,
 				    struct obs_scene_item *item,
 				    struct obs_scene_item *prev)
 {
+	invalidate_item_index(parent);
+
 	item->prev = prev;
 	item->parent = parent;
 
@@ -422,23 +538,37 @@ static inline uint32_t calc_cy(const struct obs_scene_item *item,
 	return (crop_cy > height) ? 2 : (height - crop_cy);
 }
 
-static void update_item_transform(struct obs_scene_item *item, bool update_tex)
+/* equivalent to scale * translate(-origin) * rotate(rot) * translate(pos),
+ * but built directly since item transforms are always 2D */
+static void build_item_matrix(struct matrix4 *dst, const struct vec2 *scale,
+			      const struct vec2 *origin, float rot_cos,
+			      float rot_sin, const struct vec2 *pos)
+{
+	vec4_set(&dst->x, scale->x * rot_cos, scale->x * rot_sin, 0.0f, 0.0f);
+	vec4_set(&dst->y, -scale->y * rot_sin, scale->y * rot_cos, 0.0f, 0.0f);
+	vec4_set(&dst->z, 0.0f, 0.0f, 1.0f, 0.0f);
+	vec4_set(&dst->t, origin->y * rot_sin - origin->x * rot_cos + pos->x,
+		 -origin->x * rot_sin - origin->y * rot_cos + pos->y, 0.0f,
+		 1.0f);
+}
+
+static void update_item_transform_size(struct obs_scene_item *item,
+				       uint32_t width, uint32_t height,
+				       bool update_tex)
 {
-	uint32_t width;
-	uint32_t height;
 	uint32_t cx;
 	uint32_t cy;
 	struct vec2 base_origin;
 	struct vec2 origin;
 	struct vec2 scale;
+	float rot_cos;
+	float rot_sin;
 	struct calldata params;
 	uint8_t stack[128];
 
 	if (os_atomic_load_long(&item->defer_update) > 0)
 		return;
 
-	width = obs_source_get_width(item->source);
-	height = obs_source_get_height(item->source);
 	cx = calc_cx(item, width);
 	cy = calc_cy(item, height);
 	scale = item->scale;
@@ -462,15 +592,11 @@ static void update_item_transform(struct obs_scene_item *item, bool update_tex)
 
 	add_alignment(&origin, item->align, (int)cx, (int)cy);
 
-	matrix4_identity(&item->draw_transform);
-	matrix4_scale3f(&item->draw_transform, &item->draw_transform, scale.x,
-			scale.y, 1.0f);
-	matrix4_translate3f(&item->draw_transform, &item->draw_transform,
-			    -origin.x, -origin.y, 0.0f);
-	matrix4_rotate_aa4f(&item->draw_transform, &item->draw_transform, 0.0f,
-			    0.0f, 1.0f, RAD(item->rot));
-	matrix4_translate3f(&item->draw_transform, &item->draw_transform,
-			    item->pos.x, item->pos.y, 0.0f);
+	rot_cos = cosf(RAD(item->rot));
+	rot_sin = sinf(RAD(item->rot));
+
+	build_item_matrix(&item->draw_transform, &scale, &origin, rot_cos,
+			  rot_sin, &item->pos);
 
 	item->output_scale = scale;
 
@@ -487,15 +613,8 @@ static void update_item_transform(struct obs_scene_item *item, bool update_tex)
 
 	add_alignment(&base_origin, item->align, (int)scale.x, (int)scale.y);
 
-	matrix4_identity(&item->box_transform);
-	matrix4_scale3f(&item->box_transform, &item->box_transform, scale.x,
-			scale.y, 1.0f);
-	matrix4_translate3f(&item->box_transform, &item->box_transform,
-			    -base_origin.x, -base_origin.y, 0.0f);
-	matrix4_rotate_aa4f(&item->box_transform, &item->box_transform, 0.0f,
-			    0.0f, 1.0f, RAD(item->rot));
-	matrix4_translate3f(&item->box_transform, &item->box_transform,
-			    item->pos.x, item->pos.y, 0.0f);
+	build_item_matrix(&item->box_transform, &scale, &base_origin, rot_cos,
+			  rot_sin, &item->pos);
 
 	/* ----------------------- */
 
@@ -509,12 +628,12 @@ static void update_item_transform(struct obs_scene_item *item, bool update_tex)
 	os_atomic_set_bool(&item->update_transform, false);
 }
 
-static inline bool source_size_changed(struct obs_scene_item *item)
+static void update_item_transform(struct obs_scene_item *item, bool update_tex)
 {
 	uint32_t width = obs_source_get_width(item->source);
 	uint32_t height = obs_source_get_height(item->source);
 
-	return item->last_width != width || item->last_height != height;
+	update_item_transform_size(item, width, height, update_tex);
 }
 
 static inline bool crop_enabled(const struct obs_sceneitem_crop *crop)
@@ -738,7 +857,8 @@ static inline void render_item(struct obs_scene_item *item)
 	}
 
 	if (!item->item_render && use_texrender) {
-		item->item_render = gs_texrender_create(format, GS_ZS_NONE);
+		item->item_render =
+			gs_texrender_create_leased(format, GS_ZS_NONE);
 	}
 
 	if (item->item_render) {
@@ -881,10 +1001,15 @@ update_transforms_and_prune_sources(obs_scene_t *scene,
 			video_unlock(group_scene);
 		}
 
+		/* the size is only queried once per frame, each query locks
+		 * the filter mutex and goes through the source callbacks */
+		uint32_t width = obs_source_get_width(item->source);
+		uint32_t height = obs_source_get_height(item->source);
+
 		if (os_atomic_load_bool(&item->update_transform) ||
-		    source_size_changed(item)) {
+		    item->last_width != width || item->last_height != height) {
 
-			update_item_transform(item, true);
+			update_item_transform_size(item, width, height, true);
 			rebuild_group = true;
 		}
 
@@ -913,13 +1038,13 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 	gs_blend_state_push();
 	gs_reset_blend_state();
 
-	item = scene->first_item;
-	while (item) {
+	update_item_index(scene);
+
+	for (size_t i = 0; i < scene->item_order.num; i++) {
+		item = scene->item_order.array[i];
 		if (item->user_visible ||
 		    transition_active(item->hide_transition))
 			render_item(item);
-
-		item = item->next;
 	}
 
 	gs_blend_state_pop();
@@ -1003,7 +1128,7 @@ static void scene_load_item(struct obs_scene *scene, obs_data_t *item_data)
 				 OBS_ALIGN_TOP | OBS_ALIGN_LEFT);
 
 	if (obs_data_has_user_value(item_data, "id"))
-		item->id = obs_data_get_int(item_data, "id");
+		set_item_id(item, obs_data_get_int(item_data, "id"));
 
 	item->rot = (float)obs_data_get_double(item_data, "rot");
 	item->align = (uint32_t)obs_data_get_int(item_data, "align");
@@ -1815,23 +1940,35 @@ obs_scene_t *obs_group_from_source(const obs_source_t *source)
 	return source->context.data;
 }
 
-obs_sceneitem_t *obs_scene_find_source(obs_scene_t *scene, const char *name)
+/* must be called with the video mutex held */
+static struct obs_scene_item *find_item_by_name(struct obs_scene *scene,
+						const char *name)
 {
 	struct obs_scene_item *item;
+	uint32_t hash = item_name_hash(name);
 
-	if (!scene)
-		return NULL;
-
-	full_lock(scene);
+	update_item_index(scene);
 
-	item = scene->first_item;
+	HASH_FIND(hh_name, scene->items_by_name, &hash, sizeof(hash), item);
 	while (item) {
 		if (strcmp(item->source->context.name, name) == 0)
 			break;
 
-		item = item->next;
+		item = item->next_same_name;
 	}
 
+	return item;
+}
+
+obs_sceneitem_t *obs_scene_find_source(obs_scene_t *scene, const char *name)
+{
+	struct obs_scene_item *item;
+
+	if (!scene || !name)
+		return NULL;
+
+	full_lock(scene);
+	item = find_item_by_name(scene, name);
 	full_unlock(scene);
 
 	return item;
@@ -1842,27 +1979,29 @@ obs_sceneitem_t *obs_scene_find_source_recursive(obs_scene_t *scene,
 {
 	struct obs_scene_item *item;
 
-	if (!scene)
+	if (!scene || !name)
 		return NULL;
 
 	full_lock(scene);
 
-	item = scene->first_item;
-	while (item) {
-		if (strcmp(item->source->context.name, name) == 0)
-			break;
+	item = find_item_by_name(scene, name);
 
-		if (item->is_group) {
-			obs_scene_t *group = item->source->context.data;
-			obs_sceneitem_t *child =
-				obs_scene_find_source(group, name);
-			if (child) {
-				item = child;
-				break;
-			}
-		}
+	/* items are searched in order, so a group before the first direct
+	 * match can still contain the item that comes first */
+	size_t end = item ? item->order_idx : scene->item_order.num;
+	for (size_t i = 0; i < end; i++) {
+		struct obs_scene_item *group = scene->item_order.array[i];
+		struct obs_scene_item *child;
 
-		item = item->next;
+		if (!group->is_group)
+			continue;
+
+		child = obs_scene_find_source(group->source->context.data,
+					      name);
+		if (child) {
+			item = child;
+			break;
+		}
 	}
 
 	full_unlock(scene);
@@ -1892,9 +2031,21 @@ bool check_sceneitem_exists(obs_scene_t *scene, obs_sceneitem_t *item,
 obs_sceneitem_t *obs_scene_sceneitem_from_source(obs_scene_t *scene,
 						 obs_source_t *source)
 {
-	struct sceneitem_check check = {source, NULL};
-	obs_scene_enum_items(scene, check_sceneitem_exists, (void *)&check);
-	return check.item_out;
+	struct obs_scene_item *item;
+
+	if (!scene)
+		return NULL;
+
+	full_lock(scene);
+
+	update_item_index(scene);
+	HASH_FIND(hh_source, scene->items_by_source, &source, sizeof(source),
+		  item);
+	obs_sceneitem_addref(item);
+
+	full_unlock(scene);
+
+	return item;
 }
 
 obs_sceneitem_t *obs_scene_find_sceneitem_by_id(obs_scene_t *scene, int64_t id)
@@ -1906,13 +2057,8 @@ obs_sceneitem_t *obs_scene_find_sceneitem_by_id(obs_scene_t *scene, int64_t id)
 
 	full_lock(scene);
 
-	item = scene->first_item;
-	while (item) {
-		if (item->id == id)
-			break;
-
-		item = item->next;
-	}
+	update_item_index(scene);
+	HASH_FIND(hh_id, scene->items_by_id, &id, sizeof(id), item);
 
 	full_unlock(scene);
 
@@ -2058,8 +2204,14 @@ static void sceneitem_rename_hotkey(const obs_sceneitem_t *scene_item,
 static void sceneitem_renamed(void *param, calldata_t *data)
 {
 	obs_sceneitem_t *scene_item = param;
+	obs_scene_t *parent = scene_item->parent;
 	const char *name = calldata_string(data, "new_name");
 
+	/* only flagged: taking the scene lock from a signal could deadlock,
+	 * and a rename never frees an indexed item */
+	if (parent)
+		os_atomic_set_bool(&parent->items_dirty, true);
+
 	sceneitem_rename_hotkey(scene_item, name);
 }
 
@@ -2132,6 +2284,8 @@ static obs_sceneitem_t *obs_scene_add_internal(obs_scene_t *scene,
 
 	full_lock(scene);
 
+	invalidate_item_index(scene);
+
 	if (insert_after) {
 		obs_sceneitem_t *next = insert_after->next;
 		if (next)
@@ -2494,9 +2648,17 @@ bool obs_sceneitem_selected(const obs_sceneitem_t *item)
 			update_item_transform(item, false);                \
 	} while (false)
 
+/* setters skip unchanged values, so that callers setting the same transform
+ * every frame don't rebuild the matrices and signal item_transform for
+ * nothing */
+static inline bool vec2_equal(const struct vec2 *v1, const struct vec2 *v2)
+{
+	return v1->x == v2->x && v1->y == v2->y;
+}
+
 void obs_sceneitem_set_pos(obs_sceneitem_t *item, const struct vec2 *pos)
 {
-	if (item) {
+	if (item && !vec2_equal(&item->pos, pos)) {
 		vec2_copy(&item->pos, pos);
 		do_update_transform(item);
 	}
@@ -2504,7 +2666,7 @@ void obs_sceneitem_set_pos(obs_sceneitem_t *item, const struct vec2 *pos)
 
 void obs_sceneitem_set_rot(obs_sceneitem_t *item, float rot)
 {
-	if (item) {
+	if (item && item->rot != rot) {
 		item->rot = rot;
 		do_update_transform(item);
 	}
@@ -2512,7 +2674,7 @@ void obs_sceneitem_set_rot(obs_sceneitem_t *item, float rot)
 
 void obs_sceneitem_set_scale(obs_sceneitem_t *item, const struct vec2 *scale)
 {
-	if (item) {
+	if (item && !vec2_equal(&item->scale, scale)) {
 		vec2_copy(&item->scale, scale);
 		do_update_transform(item);
 	}
@@ -2520,7 +2682,7 @@ void obs_sceneitem_set_scale(obs_sceneitem_t *item, const struct vec2 *scale)
 
 void obs_sceneitem_set_alignment(obs_sceneitem_t *item, uint32_t alignment)
 {
-	if (item) {
+	if (item && item->align != alignment) {
 		item->align = alignment;
 		do_update_transform(item);
 	}
@@ -2599,15 +2761,12 @@ void obs_sceneitem_set_order(obs_sceneitem_t *item,
 int obs_sceneitem_get_order_position(obs_sceneitem_t *item)
 {
 	struct obs_scene *scene = item->parent;
-	struct obs_scene_item *next = scene->first_item;
+	int index;
 
 	full_lock(scene);
 
-	int index = 0;
-	while (next && next != item) {
-		next = next->next;
-		++index;
-	}
+	update_item_index(scene);
+	index = (int)item->order_idx;
 
 	full_unlock(scene);
 
@@ -2620,28 +2779,30 @@ void obs_sceneitem_set_order_position(obs_sceneitem_t *item, int position)
 		return;
 
 	struct obs_scene *scene = obs_scene_get_ref(item->parent);
-	struct obs_scene_item *next;
+	struct obs_scene_item *prev = NULL;
+	size_t others;
 
 	if (!scene)
 		return;
 
 	full_lock(scene);
 
-	detach_sceneitem(item);
-	next = scene->first_item;
+	update_item_index(scene);
+	others = scene->item_order.num - 1;
 
-	if (position == 0) {
-		attach_sceneitem(scene, item, NULL);
-	} else {
-		for (int i = position; i > 1; --i) {
-			if (next->next == NULL)
-				break;
-			next = next->next;
-		}
+	if (position != 0 && others) {
+		size_t idx = position > 1 ? (size_t)position - 1 : 0;
+		if (idx > others - 1)
+			idx = others - 1;
+		if (idx >= item->order_idx)
+			idx++;
 
-		attach_sceneitem(scene, item, next);
+		prev = scene->item_order.array[idx];
 	}
 
+	detach_sceneitem(item);
+	attach_sceneitem(scene, item, prev);
+
 	full_unlock(scene);
 
 	signal_reorder(item);
@@ -2651,7 +2812,7 @@ void obs_sceneitem_set_order_position(obs_sceneitem_t *item, int position)
 void obs_sceneitem_set_bounds_type(obs_sceneitem_t *item,
 				   enum obs_bounds_type type)
 {
-	if (item) {
+	if (item && item->bounds_type != type) {
 		item->bounds_type = type;
 		do_update_transform(item);
 	}
@@ -2660,7 +2821,7 @@ void obs_sceneitem_set_bounds_type(obs_sceneitem_t *item,
 void obs_sceneitem_set_bounds_alignment(obs_sceneitem_t *item,
 					uint32_t alignment)
 {
-	if (item) {
+	if (item && item->bounds_align != alignment) {
 		item->bounds_align = alignment;
 		do_update_transform(item);
 	}
@@ -2668,7 +2829,7 @@ void obs_sceneitem_set_bounds_alignment(obs_sceneitem_t *item,
 
 void obs_sceneitem_set_bounds(obs_sceneitem_t *item, const struct vec2 *bounds)
 {
-	if (item) {
+	if (item && !vec2_equal(&item->bounds, bounds)) {
 		item->bounds = *bounds;
 		do_update_transform(item);
 	}
@@ -2730,6 +2891,15 @@ void obs_sceneitem_set_info(obs_sceneitem_t *item,
 			    const struct obs_transform_info *info)
 {
 	if (item && info) {
+		if (vec2_equal(&item->pos, &info->pos) &&
+		    item->rot == info->rot &&
+		    vec2_equal(&item->scale, &info->scale) &&
+		    item->align == info->alignment &&
+		    item->bounds_type == info->bounds_type &&
+		    item->bounds_align == info->bounds_alignment &&
+		    vec2_equal(&item->bounds, &info->bounds))
+			return;
+
 		item->pos = info->pos;
 		item->rot = info->rot;
 		item->scale = info->scale;
@@ -2909,6 +3079,7 @@ bool obs_scene_reorder_items(obs_scene_t *scene,
 		return false;
 	}
 
+	invalidate_item_index(scene);
 	scene->first_item = item_order[0];
 
 	obs_sceneitem_t *prev = NULL;
@@ -3084,7 +3255,7 @@ int64_t obs_sceneitem_get_id(const obs_sceneitem_t *item)
 
 void obs_sceneitem_set_id(obs_sceneitem_t *item, int64_t id)
 {
-	item->id = id;
+	set_item_id(item, id);
 }
 
 obs_data_t *obs_sceneitem_get_private_settings(obs_sceneitem_t *item)
@@ -3308,6 +3479,7 @@ obs_sceneitem_t *obs_scene_insert_group(obs_scene_t *scene, const char *name,
 
 	full_lock(scene);
 	full_lock(sub_scene);
+	invalidate_item_index(sub_scene);
 	sub_scene->first_item = items[0];
 
 	for (size_t i = count; i > 0; i--) {
@@ -3621,7 +3793,12 @@ bool obs_scene_reorder_items2(obs_scene_t *scene,
 			obs_sceneitem_t *group =
 				get_sceneitem_parent_group(scene, info->item);
 			remove_group_transform(group, info->item);
+		} else {
+			invalidate_item_index(info->item->source->context.data);
 		}
+
+		/* items can move between the scene and its groups */
+		invalidate_item_index(info->item->parent);
 	}
 
 	scene->first_item = item_order[0].item;
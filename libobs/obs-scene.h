@@ -18,6 +18,8 @@
 #pragma once
 
 #include "obs.h"
+#include "util/darray.h"
+#include "util/uthash.h"
 #include "graphics/matrix4.h"
 
 /* how obs scene! */
@@ -89,6 +91,14 @@ struct obs_scene_item {
 	/* would do **prev_next, but not really great for reordering */
 	struct obs_scene_item *prev;
 	struct obs_scene_item *next;
+
+	/* lookup indexes of the parent scene, see rebuild_item_index */
+	size_t order_idx;
+	uint32_t name_hash;
+	struct obs_scene_item *next_same_name;
+	UT_hash_handle hh_id;
+	UT_hash_handle hh_name;
+	UT_hash_handle hh_source;
 };
 
 struct obs_scene {
@@ -104,4 +114,12 @@ struct obs_scene {
 	pthread_mutex_t video_mutex;
 	pthread_mutex_t audio_mutex;
 	struct obs_scene_item *first_item;
+
+	/* the item list stays the canonical order, these are rebuilt from it
+	 * under video_mutex the first time they're needed after a change */
+	volatile bool items_dirty;
+	struct obs_scene_item *items_by_id;
+	struct obs_scene_item *items_by_name;
+	struct obs_scene_item *items_by_source;
+	DARRAY(struct obs_scene_item *) item_order;
 };
@@ -0,0 +1,422 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "obs-internal.h"
+
+/*
+ * Async video upload staging
+ *
+ *   Normally the graphics thread uploads each async frame with
+ * gs_texture_set_image, which maps the texture, copies the whole frame and
+ * unmaps it again.  Instead, the graphics thread keeps a small ring of
+ * dynamic textures mapped (a pixel unpack buffer on OpenGL, a discard mapping
+ * on Direct3D 11), and the thread that outputs a frame copies it into one of
+ * them directly.  When the frame is rendered, the graphics thread only has to
+ * unmap those textures, which issues the copy to the GPU, and swap them with
+ * the async textures.
+ *
+ *   Slots move from UNMAPPED (owned by the graphics thread) to FREE once
+ * mapped, to WRITING while a frame is being copied and to READY once the
+ * frame is complete.  State changes happen under the async mutex.
+ */
+
+static bool has_async_filters(obs_source_t *source)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&source->filter_mutex);
+
+	for (size_t i = 0; i < source->filters.num; i++) {
+		if (source->filters.array[i]->info.filter_video) {
+			found = true;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return found;
+}
+
+static inline bool upload_matches_frame(const struct async_upload *upload,
+					const struct obs_source_frame *frame)
+{
+	return upload->width == frame->width &&
+	       upload->height == frame->height &&
+	       upload->format == frame->format &&
+	       upload->full_range == frame->full_range &&
+	       upload->trc == frame->trc;
+}
+
+static void copy_plane(uint8_t *dst, uint32_t dst_linesize, const uint8_t *src,
+		       uint32_t src_linesize, uint32_t height)
+{
+	if (dst_linesize == src_linesize) {
+		memcpy(dst, src, (size_t)dst_linesize * height);
+	} else {
+		uint32_t row_copy = (src_linesize < dst_linesize)
+					    ? src_linesize
+					    : dst_linesize;
+
+		for (uint32_t y = 0; y < height; y++)
+			memcpy(dst + (size_t)dst_linesize * y,
+			       src + (size_t)src_linesize * y, row_copy);
+	}
+}
+
+/* called by the thread outputting the frame, after it has been cached */
+void async_upload_write(obs_source_t *source, struct obs_source_frame *frame)
+{
+	struct async_upload *upload = NULL;
+
+	if (!source->async_uploads[0] || has_async_filters(source))
+		return;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	for (size_t i = 0; i < ASYNC_UPLOAD_SLOTS; i++) {
+		struct async_upload *slot = source->async_uploads[i];
+
+		if (slot && slot->state == ASYNC_UPLOAD_FREE &&
+		    upload_matches_frame(slot, frame)) {
+			upload = slot;
+			upload->state = ASYNC_UPLOAD_WRITING;
+			upload->frame = frame;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&source->async_mutex);
+
+	if (!upload)
+		return;
+
+	for (size_t c = 0; c < MAX_AV_PLANES; c++) {
+		if (upload->tex[c])
+			copy_plane(upload->data[c], upload->linesize[c],
+				   frame->data[c], frame->linesize[c],
+				   upload->rows[c]);
+	}
+
+	pthread_mutex_lock(&source->async_mutex);
+	upload->state = upload->frame ? ASYNC_UPLOAD_READY : ASYNC_UPLOAD_FREE;
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
+/* called with the async mutex held when a cached frame is no longer used, or
+ * with a NULL frame when the whole cache is cleared */
+void async_upload_release_frame(obs_source_t *source,
+				struct obs_source_frame *frame)
+{
+	for (size_t i = 0; i < ASYNC_UPLOAD_SLOTS; i++) {
+		struct async_upload *upload = source->async_uploads[i];
+
+		if (!upload || !upload->frame)
+			continue;
+		if (frame && upload->frame != frame)
+			continue;
+
+		upload->frame = NULL;
+		if (upload->state == ASYNC_UPLOAD_READY)
+			upload->state = ASYNC_UPLOAD_FREE;
+	}
+}
+
+static inline bool deinterlacing_enabled(const struct obs_source *source)
+{
+	return source->deinterlace_mode != OBS_DEINTERLACE_MODE_DISABLE;
+}
+
+/* the ring must have been created for the current async textures */
+static bool upload_matches_textures(obs_source_t *source,
+				    const struct async_upload *upload)
+{
+	if (upload->width != source->async_width ||
+	    upload->height != source->async_height ||
+	    upload->format != source->async_format ||
+	    upload->full_range != source->async_full_range ||
+	    upload->trc != source->async_trc)
+		return false;
+
+	for (size_t c = 0; c < MAX_AV_PLANES; c++) {
+		gs_texture_t *tex = source->async_textures[c];
+
+		if (!tex || !upload->tex[c]) {
+			if (tex != upload->tex[c])
+				return false;
+			continue;
+		}
+
+		if (gs_texture_get_width(tex) !=
+			    gs_texture_get_width(upload->tex[c]) ||
+		    gs_texture_get_height(tex) !=
+			    gs_texture_get_height(upload->tex[c]) ||
+		    gs_texture_get_color_format(tex) !=
+			    gs_texture_get_color_format(upload->tex[c]))
+			return false;
+	}
+
+	return true;
+}
+
+static inline bool async_upload_usable(obs_source_t *source)
+{
+	return !source->async_upload_failed && source->async_textures[0] &&
+	       !deinterlacing_enabled(source) && !has_async_filters(source);
+}
+
+static void unmap_upload(struct async_upload *upload)
+{
+	for (size_t c = 0; c < MAX_AV_PLANES; c++) {
+		if (upload->tex[c] && upload->data[c]) {
+			gs_texture_unmap(upload->tex[c]);
+			upload->data[c] = NULL;
+		}
+	}
+}
+
+static void destroy_upload(struct async_upload *upload)
+{
+	unmap_upload(upload);
+
+	for (size_t c = 0; c < MAX_AV_PLANES; c++)
+		gs_texture_destroy(upload->tex[c]);
+
+	bfree(upload);
+}
+
+static bool map_upload(struct async_upload *upload)
+{
+	for (size_t c = 0; c < MAX_AV_PLANES; c++) {
+		if (!upload->tex[c])
+			continue;
+
+		if (!gs_texture_map(upload->tex[c], &upload->data[c],
+				    &upload->linesize[c])) {
+			upload->data[c] = NULL;
+			unmap_upload(upload);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static struct async_upload *create_upload(obs_source_t *source)
+{
+	struct async_upload *upload = bzalloc(sizeof(*upload));
+
+	upload->width = source->async_width;
+	upload->height = source->async_height;
+	upload->format = source->async_format;
+	upload->full_range = source->async_full_range;
+	upload->trc = source->async_trc;
+
+	for (size_t c = 0; c < MAX_AV_PLANES; c++) {
+		gs_texture_t *tex = source->async_textures[c];
+
+		if (!tex)
+			continue;
+
+		upload->rows[c] = gs_texture_get_height(tex);
+		upload->tex[c] = gs_texture_create(
+			gs_texture_get_width(tex), upload->rows[c],
+			gs_texture_get_color_format(tex), 1, NULL, GS_DYNAMIC);
+
+		if (!upload->tex[c]) {
+			destroy_upload(upload);
+			return NULL;
+		}
+	}
+
+	return upload;
+}
+
+/* slots that are being written to are left to the writer and destroyed once
+ * it is done with them */
+static void destroy_ring(obs_source_t *source)
+{
+	struct async_upload *destroy[ASYNC_UPLOAD_SLOTS];
+	size_t count = 0;
+
+	if (!source->async_uploads[0])
+		return;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	for (size_t i = 0; i < ASYNC_UPLOAD_SLOTS; i++) {
+		struct async_upload *upload = source->async_uploads[i];
+
+		source->async_uploads[i] = NULL;
+		if (!upload)
+			continue;
+
+		if (upload->state == ASYNC_UPLOAD_WRITING)
+			da_push_back(source->async_upload_orphans, &upload);
+		else
+			destroy[count++] = upload;
+	}
+
+	pthread_mutex_unlock(&source->async_mutex);
+
+	for (size_t i = 0; i < count; i++)
+		destroy_upload(destroy[i]);
+}
+
+static void free_orphans(obs_source_t *source)
+{
+	struct async_upload *destroy[ASYNC_UPLOAD_SLOTS];
+	size_t count = 0;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	for (size_t i = source->async_upload_orphans.num; i > 0; i--) {
+		struct async_upload *upload =
+			source->async_upload_orphans.array[i - 1];
+
+		if (upload->state == ASYNC_UPLOAD_WRITING)
+			continue;
+
+		destroy[count++] = upload;
+		da_erase(source->async_upload_orphans, i - 1);
+
+		if (count == ASYNC_UPLOAD_SLOTS)
+			break;
+	}
+
+	pthread_mutex_unlock(&source->async_mutex);
+
+	for (size_t i = 0; i < count; i++)
+		destroy_upload(destroy[i]);
+}
+
+static bool create_ring(obs_source_t *source)
+{
+	struct async_upload *uploads[ASYNC_UPLOAD_SLOTS];
+
+	for (size_t i = 0; i < ASYNC_UPLOAD_SLOTS; i++) {
+		uploads[i] = create_upload(source);
+		if (!uploads[i]) {
+			while (i > 0)
+				destroy_upload(uploads[--i]);
+			return false;
+		}
+	}
+
+	pthread_mutex_lock(&source->async_mutex);
+	memcpy(source->async_uploads, uploads, sizeof(uploads));
+	pthread_mutex_unlock(&source->async_mutex);
+	return true;
+}
+
+/* called by the graphics thread with the frame about to be rendered.  if the
+ * frame was staged, its textures become the async textures, and only the
+ * conversion is left to do */
+bool async_upload_take(obs_source_t *source, struct obs_source_frame *frame)
+{
+	struct async_upload *upload = NULL;
+
+	if (!source->async_uploads[0] || !async_upload_usable(source) ||
+	    !upload_matches_textures(source, source->async_uploads[0]))
+		return false;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	for (size_t i = 0; i < ASYNC_UPLOAD_SLOTS; i++) {
+		struct async_upload *slot = source->async_uploads[i];
+
+		if (slot->state == ASYNC_UPLOAD_READY && slot->frame == frame) {
+			upload = slot;
+			upload->state = ASYNC_UPLOAD_UNMAPPED;
+			upload->frame = NULL;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&source->async_mutex);
+
+	if (!upload)
+		return false;
+
+	unmap_upload(upload);
+
+	for (size_t c = 0; c < MAX_AV_PLANES; c++) {
+		gs_texture_t *tex = source->async_textures[c];
+
+		source->async_textures[c] = upload->tex[c];
+		upload->tex[c] = tex;
+	}
+
+	return true;
+}
+
+/* called by the graphics thread after each rendered async frame, keeps the
+ * ring in line with the async textures and maps the slots given back */
+void async_upload_update(obs_source_t *source)
+{
+	if (source->async_upload_orphans.num)
+		free_orphans(source);
+
+	if (!async_upload_usable(source)) {
+		destroy_ring(source);
+		return;
+	}
+
+	if (source->async_uploads[0] &&
+	    !upload_matches_textures(source, source->async_uploads[0]))
+		destroy_ring(source);
+
+	if (!source->async_uploads[0] && !create_ring(source)) {
+		source->async_upload_failed = true;
+		return;
+	}
+
+	for (size_t i = 0; i < ASYNC_UPLOAD_SLOTS; i++) {
+		struct async_upload *upload = source->async_uploads[i];
+
+		/* only the graphics thread changes the state of unmapped
+		 * slots */
+		if (upload->state != ASYNC_UPLOAD_UNMAPPED)
+			continue;
+
+		if (!map_upload(upload)) {
+			blog(LOG_WARNING,
+			     "Could not map async upload textures of source "
+			     "'%s', uploading frames directly",
+			     source->context.name);
+			source->async_upload_failed = true;
+			destroy_ring(source);
+			return;
+		}
+
+		pthread_mutex_lock(&source->async_mutex);
+		upload->state = ASYNC_UPLOAD_FREE;
+		pthread_mutex_unlock(&source->async_mutex);
+	}
+}
+
+/* called within the graphics context when the source is destroyed */
+void async_upload_free(obs_source_t *source)
+{
+	for (size_t i = 0; i < ASYNC_UPLOAD_SLOTS; i++) {
+		if (source->async_uploads[i])
+			destroy_upload(source->async_uploads[i]);
+		source->async_uploads[i] = NULL;
+	}
+
+	for (size_t i = 0; i < source->async_upload_orphans.num; i++)
+		destroy_upload(source->async_upload_orphans.array[i]);
+	da_free(source->async_upload_orphans);
+}
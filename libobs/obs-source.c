@@ -211,6 +211,7 @@ static bool obs_source_init(struct obs_source *source)
 
 	if (is_audio_source(source) || is_composite_source(source))
 		allocate_audio_output_buffer(source);
+	obs_source_reserve_audio_input(source);
 	if (source->info.audio_mix)
 		allocate_audio_mix_buffer(source);
 
@@ -713,6 +714,7 @@ static void obs_source_destroy_defer(struct obs_source *source)
 		gs_texture_destroy(source->async_textures[c]);
 		gs_texture_destroy(source->async_prev_textures[c]);
 	}
+	async_upload_free(source);
 	if (source->filter_texrender)
 		gs_texrender_destroy(source->filter_texrender);
 	if (source->color_space_texrender)
@@ -1115,6 +1117,7 @@ static void deactivate_source(obs_source_t *source)
 
 static void show_source(obs_source_t *source)
 {
+	source->last_shown_time = os_gettime_ns();
 	if (source->context.data && source->info.show)
 		source->info.show(source->context.data);
 	obs_source_dosignal(source, "source_show", "show");
@@ -1122,6 +1125,7 @@ static void show_source(obs_source_t *source)
 
 static void hide_source(obs_source_t *source)
 {
+	source->last_shown_time = os_gettime_ns();
 	if (source->context.data && source->info.hide)
 		source->info.hide(source->context.data);
 	obs_source_dosignal(source, "source_hide", "hide");
@@ -1241,11 +1245,125 @@ static void async_tick(obs_source_t *source)
 	pthread_mutex_unlock(&source->async_mutex);
 }
 
-void obs_source_video_tick(obs_source_t *source, float seconds)
+/* most sources have nothing to do on a tick, this lets tick_sources skip
+ * them without taking a reference */
+bool obs_source_needs_video_tick(const obs_source_t *source)
+{
+	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
+		return true;
+	if ((source->info.output_flags & OBS_SOURCE_ASYNC) != 0)
+		return true;
+	if (source->context.data && source->info.video_tick)
+		return true;
+	if (source->filter_texrender)
+		return true;
+	if (os_atomic_load_long(&source->defer_update_count) > 0)
+		return true;
+	if (!!os_atomic_load_long(&source->show_refs) != source->showing)
+		return true;
+	return !!os_atomic_load_long(&source->activate_refs) != source->active;
+}
+
+bool obs_source_parallel_video_tick(const obs_source_t *source)
+{
+	return (source->info.output_flags & OBS_SOURCE_PARALLEL_TICK) != 0 &&
+	       source->context.data && source->info.video_tick;
+}
+
+#define MEMORY_CHECK_INTERVAL_NS 1000000000ULL
+
+struct evict_candidate {
+	obs_source_t *source;
+	uint64_t usage;
+};
+
+static int cmp_evict_candidates(const void *a, const void *b)
+{
+	const struct evict_candidate *ca = a;
+	const struct evict_candidate *cb = b;
+	uint64_t ta = ca->source->last_shown_time;
+	uint64_t tb = cb->source->last_shown_time;
+
+	return (ta > tb) - (ta < tb);
+}
+
+/* called from the graphics thread once sources have been ticked.  sums up the
+ * memory reported by sources, and when it is over budget, evicts the caches of
+ * the sources that have not been showing for the longest time */
+void obs_evict_source_caches(uint64_t sys_time)
+{
+	struct obs_core_data *data = &obs->data;
+	DARRAY(struct evict_candidate) candidates;
+	uint64_t budget = data->source_memory_budget;
+	uint64_t total = 0;
+	struct obs_source *source;
+
+	if (sys_time - data->last_memory_check < MEMORY_CHECK_INTERVAL_NS)
+		return;
+	data->last_memory_check = sys_time;
+
+	da_init(candidates);
+
+	pthread_mutex_lock(&data->sources_mutex);
+
+	source = data->sources;
+	while (source) {
+		void *context_data = source->context.data;
+
+		if (context_data && source->info.get_memory_usage) {
+			uint64_t usage =
+				source->info.get_memory_usage(context_data);
+			total += usage;
+
+			if (budget && usage && !source->showing &&
+			    source->info.evict) {
+				struct evict_candidate candidate = {
+					.source = obs_source_get_ref(source),
+					.usage = usage,
+				};
+
+				if (candidate.source)
+					da_push_back(candidates, &candidate);
+			}
+		}
+
+		source = (struct obs_source *)source->context.hh_uuid.next;
+	}
+
+	pthread_mutex_unlock(&data->sources_mutex);
+
+	if (total > budget && candidates.num) {
+		qsort(candidates.array, candidates.num,
+		      sizeof(struct evict_candidate), cmp_evict_candidates);
+
+		for (size_t i = 0; i < candidates.num && total > budget; i++) {
+			struct evict_candidate *candidate = &candidates.array[i];
+			obs_source_t *s = candidate->source;
+
+			blog(LOG_DEBUG,
+			     "Evicting caches of source '%s' (%" PRIu64
+			     " bytes)",
+			     s->context.name, candidate->usage);
+
+			s->info.evict(s->context.data);
+			total -= candidate->usage;
+		}
+	}
+
+	data->source_memory_usage = total;
+
+	for (size_t i = 0; i < candidates.num; i++)
+		obs_source_release(candidates.array[i].source);
+	da_free(candidates);
+}
+
+/* everything a tick does except calling the source's video_tick, which
+ * tick_sources may run on a worker thread afterwards */
+void obs_source_video_tick_state(obs_source_t *source, float seconds)
 {
 	bool now_showing, now_active;
 
-	if (!obs_source_valid(source, "obs_source_video_tick"))
+	if (!obs_source_valid(source, "obs_source_video_tick_state"))
 		return;
 
 	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
@@ -1309,13 +1427,21 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 		source->active = now_active;
 	}
 
-	if (source->context.data && source->info.video_tick)
-		source->info.video_tick(source->context.data, seconds);
-
 	source->async_rendered = false;
 	source->deinterlace_rendered = false;
 }
 
+void obs_source_video_tick(obs_source_t *source, float seconds)
+{
+	if (!obs_source_valid(source, "obs_source_video_tick"))
+		return;
+
+	obs_source_video_tick_state(source, seconds);
+
+	if (source->context.data && source->info.video_tick)
+		source->info.video_tick(source->context.data, seconds);
+}
+
 /* unless the value is 3+ hours worth of frames, this won't overflow */
 static inline uint64_t conv_frames_to_time(const size_t sample_rate,
 					   const size_t frames)
@@ -1335,6 +1461,10 @@ static inline size_t conv_time_to_frames(const size_t sample_rate,
 /* maximum buffer size */
 #define MAX_BUF_SIZE (1000 * AUDIO_OUTPUT_FRAMES * sizeof(float))
 
+/* extra room on top of the maximum audio buffering, for sources that deliver
+ * their audio in large bursts */
+#define AUDIO_INPUT_MARGIN_TICKS 24
+
 /* time threshold in nanoseconds to ensure audio timing is as seamless as
  * possible */
 #define TS_SMOOTHING_THRESHOLD 70000000ULL
@@ -1397,6 +1527,83 @@ static inline size_t get_buf_placement(audio_t *audio, uint64_t offset)
 	return (size_t)util_mul_div64(offset, sample_rate, 1000000000ULL);
 }
 
+static size_t get_audio_input_capacity(const obs_source_t *source)
+{
+	audio_t *audio = obs->audio.audio;
+	int64_t offset = source->sync_offset;
+	size_t frames;
+	size_t size;
+
+	frames = (size_t)(obs->audio.max_buffering_ticks +
+			  AUDIO_INPUT_MARGIN_TICKS) *
+		 AUDIO_OUTPUT_FRAMES;
+	frames += get_buf_placement(audio, offset < 0 ? (uint64_t)-offset
+						       : (uint64_t)offset);
+
+	size = frames * sizeof(float);
+	return size > MAX_BUF_SIZE ? MAX_BUF_SIZE : size;
+}
+
+/* The audio input buffers are allocated up front rather than grown as data
+ * comes in, so the thread outputting audio never has to allocate.  Called
+ * whenever the buffering or the sync offset changes. */
+void obs_source_reserve_audio_input(obs_source_t *source)
+{
+	audio_t *audio = obs->audio.audio;
+	size_t channels;
+	size_t capacity;
+
+	if (!audio || !is_audio_source(source))
+		return;
+
+	channels = audio_output_get_channels(audio);
+
+	pthread_mutex_lock(&source->audio_buf_mutex);
+
+	capacity = get_audio_input_capacity(source);
+	if (capacity < source->audio_input_capacity)
+		capacity = source->audio_input_capacity;
+
+	for (size_t i = 0; i < channels; i++)
+		circlebuf_reserve(&source->audio_input_buf[i], capacity);
+
+	source->audio_input_capacity = capacity;
+
+	pthread_mutex_unlock(&source->audio_buf_mutex);
+}
+
+/* audio that does not fit is dropped whole before anything gets written,
+ * buffered audio is left as it is */
+static void source_audio_overflow(obs_source_t *source,
+				  const struct audio_data *in)
+{
+	if (!source->audio_overflowing) {
+		blog(LOG_WARNING,
+		     "Source '%s' audio buffer is full (%lu bytes), "
+		     "dropping audio",
+		     source->context.name,
+		     (unsigned long)source->audio_input_capacity);
+		source->audio_overflowing = true;
+	}
+
+	source->audio_dropped_frames += in->frames;
+}
+
+static inline void source_audio_written(obs_source_t *source)
+{
+	if (source->audio_overflowing) {
+		blog(LOG_INFO,
+		     "Source '%s' audio buffer recovered, %" PRIu64
+		     " frames dropped in total",
+		     source->context.name, source->audio_dropped_frames);
+		source->audio_overflowing = false;
+	}
+
+	/* reset audio input buffer size to ensure that audio doesn't get
+	 * perpetually cut */
+	source->last_audio_input_buf_size = 0;
+}
+
 static void source_output_audio_place(obs_source_t *source,
 				      const struct audio_data *in)
 {
@@ -1420,9 +1627,11 @@ static void source_output_audio_place(obs_source_t *source,
 	     (unsigned long)buf_placement, source->audio_ts, in->timestamp);
 #endif
 
-	/* do not allow the circular buffers to become too big */
-	if ((buf_placement + size) > MAX_BUF_SIZE)
+	/* never grow the circular buffers past what was reserved */
+	if ((buf_placement + size) > source->audio_input_capacity) {
+		source_audio_overflow(source, in);
 		return;
+	}
 
 	for (size_t i = 0; i < channels; i++) {
 		circlebuf_place(&source->audio_input_buf[i], buf_placement,
@@ -1432,7 +1641,7 @@ static void source_output_audio_place(obs_source_t *source,
 					   (buf_placement + size));
 	}
 
-	source->last_audio_input_buf_size = 0;
+	source_audio_written(source);
 }
 
 static inline void source_output_audio_push_back(obs_source_t *source,
@@ -1442,17 +1651,18 @@ static inline void source_output_audio_push_back(obs_source_t *source,
 	size_t channels = audio_output_get_channels(audio);
 	size_t size = in->frames * sizeof(float);
 
-	/* do not allow the circular buffers to become too big */
-	if ((source->audio_input_buf[0].size + size) > MAX_BUF_SIZE)
+	/* never grow the circular buffers past what was reserved */
+	if ((source->audio_input_buf[0].size + size) >
+	    source->audio_input_capacity) {
+		source_audio_overflow(source, in);
 		return;
+	}
 
 	for (size_t i = 0; i < channels; i++)
 		circlebuf_push_back(&source->audio_input_buf[i], in->data[i],
 				    size);
 
-	/* reset audio input buffer size to ensure that audio doesn't get
-	 * perpetually cut */
-	source->last_audio_input_buf_size = 0;
+	source_audio_written(source);
 }
 
 static inline bool source_muted(obs_source_t *source, uint64_t os_time)
@@ -2285,13 +2495,14 @@ static inline void set_eparami(gs_effect_t *effect, const char *name, int val)
 static bool update_async_texrender(struct obs_source *source,
 				   const struct obs_source_frame *frame,
 				   gs_texture_t *tex[MAX_AV_PLANES],
-				   gs_texrender_t *texrender)
+				   gs_texrender_t *texrender, bool upload)
 {
 	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_CONVERT_FORMAT, "Convert Format");
 
 	gs_texrender_reset(texrender);
 
-	upload_raw_frame(tex, frame);
+	if (upload)
+		upload_raw_frame(tex, frame);
 
 	uint32_t cx = source->async_width;
 	uint32_t cy = source->async_height;
@@ -2402,10 +2613,11 @@ bool update_async_texture(struct obs_source *source,
 	return update_async_textures(source, frame, tex3, texrender);
 }
 
-bool update_async_textures(struct obs_source *source,
-			   const struct obs_source_frame *frame,
-			   gs_texture_t *tex[MAX_AV_PLANES],
-			   gs_texrender_t *texrender)
+/* with upload false, the frame data must already be in the textures */
+static bool convert_async_textures(struct obs_source *source,
+				   const struct obs_source_frame *frame,
+				   gs_texture_t *tex[MAX_AV_PLANES],
+				   gs_texrender_t *texrender, bool upload)
 {
 	enum convert_type type;
 
@@ -2414,18 +2626,28 @@ bool update_async_textures(struct obs_source *source,
 		(frame->flags & OBS_SOURCE_FRAME_LINEAR_ALPHA) != 0;
 
 	if (source->async_gpu_conversion && texrender)
-		return update_async_texrender(source, frame, tex, texrender);
+		return update_async_texrender(source, frame, tex, texrender,
+					      upload);
 
 	type = get_convert_type(frame->format, frame->full_range, frame->trc);
 	if (type == CONVERT_NONE) {
-		gs_texture_set_image(tex[0], frame->data[0], frame->linesize[0],
-				     false);
+		if (upload)
+			gs_texture_set_image(tex[0], frame->data[0],
+					     frame->linesize[0], false);
 		return true;
 	}
 
 	return false;
 }
 
+bool update_async_textures(struct obs_source *source,
+			   const struct obs_source_frame *frame,
+			   gs_texture_t *tex[MAX_AV_PLANES],
+			   gs_texrender_t *texrender)
+{
+	return convert_async_textures(source, frame, tex, texrender, true);
+}
+
 static inline void obs_source_draw_texture(struct obs_source *source,
 					   gs_effect_t *effect)
 {
@@ -2495,14 +2717,21 @@ static void obs_source_update_async_video(obs_source_t *source)
 			}
 
 			if (source->async_update_texture) {
-				update_async_textures(source, frame,
-						      source->async_textures,
-						      source->async_texrender);
+				/* staged frames only need to be converted */
+				const bool staged =
+					async_upload_take(source, frame);
+
+				convert_async_textures(source, frame,
+						       source->async_textures,
+						       source->async_texrender,
+						       !staged);
 				source->async_update_texture = false;
 			}
 
 			obs_source_release_frame(source, frame);
 		}
+
+		async_upload_update(source);
 	}
 }
 
@@ -2775,7 +3004,7 @@ static void source_render(obs_source_t *source, gs_effect_t *effect)
 
 		if (!source->color_space_texrender) {
 			source->color_space_texrender =
-				gs_texrender_create(format, GS_ZS_NONE);
+				gs_texrender_create_leased(format, GS_ZS_NONE);
 		}
 
 		gs_texrender_reset(source->color_space_texrender);
@@ -3463,6 +3692,7 @@ static inline void free_async_cache(struct obs_source *source)
 	da_resize(source->async_frames, 0);
 	source->cur_async_frame = NULL;
 	source->prev_async_frame = NULL;
+	async_upload_release_frame(source, NULL);
 }
 
 #define MAX_UNUSED_FRAME_DURATION 5
@@ -3540,6 +3770,7 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 	pthread_mutex_unlock(&source->async_mutex);
 
 	copy_frame_data(new_frame, frame);
+	async_upload_write(source, new_frame);
 
 	return new_frame;
 }
@@ -4106,8 +4337,10 @@ void obs_source_output_audio(obs_source_t *source,
 
 void remove_async_frame(obs_source_t *source, struct obs_source_frame *frame)
 {
-	if (frame)
+	if (frame) {
 		frame->prev_frame = false;
+		async_upload_release_frame(source, frame);
+	}
 
 	for (size_t i = 0; i < source->async_cache.num; i++) {
 		struct async_frame *f = &source->async_cache.array[i];
@@ -4466,7 +4699,7 @@ bool obs_source_process_filter_begin_with_color_space(
 
 	if (!filter->filter_texrender) {
 		filter->filter_texrender =
-			gs_texrender_create(format, GS_ZS_NONE);
+			gs_texrender_create_leased(format, GS_ZS_NONE);
 	}
 
 	if (gs_texrender_begin_with_color_space(filter->filter_texrender, cx,
@@ -4639,6 +4872,7 @@ void obs_source_set_sync_offset(obs_source_t *source, int64_t offset)
 				      &data);
 
 		source->sync_offset = calldata_int(&data, "offset");
+		obs_source_reserve_audio_input(source);
 	}
 }
 
@@ -4649,6 +4883,19 @@ int64_t obs_source_get_sync_offset(const obs_source_t *source)
 		       : 0;
 }
 
+uint64_t obs_source_get_audio_dropped_frames(obs_source_t *source)
+{
+	uint64_t frames;
+
+	if (!obs_source_valid(source, "obs_source_get_audio_dropped_frames"))
+		return 0;
+
+	pthread_mutex_lock(&source->audio_buf_mutex);
+	frames = source->audio_dropped_frames;
+	pthread_mutex_unlock(&source->audio_buf_mutex);
+	return frames;
+}
+
 struct source_enum_data {
 	obs_source_enum_proc_t enum_callback;
 	void *param;
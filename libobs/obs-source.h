@@ -203,6 +203,12 @@ enum obs_media_state {
  */
 #define OBS_SOURCE_CAP_DONT_SHOW_PROPERTIES (1 << 16)
 
+/**
+ * Source's video_tick does not use the graphics subsystem and may be called
+ * from a worker thread, concurrently with the video_tick of other sources
+ */
+#define OBS_SOURCE_PARALLEL_TICK (1 << 17)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -552,6 +558,27 @@ struct obs_source_info {
 	enum gs_color_space (*video_get_color_space)(
 		void *data, size_t count,
 		const enum gs_color_space *preferred_spaces);
+
+	/**
+	 * Gets the memory used by caches that the source can recreate, such
+	 * as decoded images.  Counted against the source memory budget (see
+	 * obs_set_source_memory_budget).  Called from the graphics thread.
+	 *
+	 * @param  data  Source data
+	 * @return       Memory used, in bytes
+	 */
+	uint64_t (*get_memory_usage)(void *data);
+
+	/**
+	 * Frees the caches counted by get_memory_usage.  Called from the
+	 * graphics thread, outside of the graphics context, for sources that
+	 * are not showing when the source memory budget is exceeded, least
+	 * recently shown first.  The source should recreate its caches when
+	 * it is shown again, preferably without blocking.
+	 *
+	 * @param  data  Source data
+	 */
+	void (*evict)(void *data);
 };
 
 EXPORT void obs_register_source_s(const struct obs_source_info *info,
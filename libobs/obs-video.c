@@ -29,9 +29,126 @@
 #include <windows.h>
 #endif
 
+/* below this many parallel ticks, waking the workers costs more than the
+ * ticks themselves */
+#define MIN_PARALLEL_TICKS 8
+#define MAX_TICK_THREADS 8
+
+static void run_tick_batch(struct obs_tick_pool *pool)
+{
+	long num = (long)pool->sources.num;
+	long i;
+
+	while ((i = os_atomic_inc_long(&pool->next) - 1) < num) {
+		struct obs_source *source = pool->sources.array[i];
+		source->info.video_tick(source->context.data, pool->seconds);
+	}
+}
+
+static void *tick_worker_thread(void *data)
+{
+	struct obs_tick_pool *pool = data;
+
+	os_set_thread_name("libobs: video tick worker");
+
+	for (;;) {
+		os_sem_wait(pool->start_sem);
+		if (os_atomic_load_bool(&pool->stop))
+			break;
+
+		run_tick_batch(pool);
+		os_sem_post(pool->done_sem);
+	}
+
+	return NULL;
+}
+
+static void tick_pool_free(struct obs_tick_pool *pool)
+{
+	os_atomic_set_bool(&pool->stop, true);
+
+	for (size_t i = 0; i < pool->num_threads; i++)
+		os_sem_post(pool->start_sem);
+	for (size_t i = 0; i < pool->num_threads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	os_sem_destroy(pool->start_sem);
+	os_sem_destroy(pool->done_sem);
+	bfree(pool->threads);
+	da_free(pool->sources);
+	memset(pool, 0, sizeof(*pool));
+}
+
+static bool tick_pool_init(struct obs_tick_pool *pool)
+{
+	int cores = os_get_logical_cores();
+	size_t num = cores > 2 ? (size_t)cores - 1 : 1;
+
+	if (pool->failed)
+		return false;
+	if (num > MAX_TICK_THREADS)
+		num = MAX_TICK_THREADS;
+
+	if (os_sem_init(&pool->start_sem, 0) != 0)
+		goto fail;
+	if (os_sem_init(&pool->done_sem, 0) != 0)
+		goto fail;
+
+	pool->threads = bzalloc(sizeof(pthread_t) * num);
+	for (size_t i = 0; i < num; i++) {
+		if (pthread_create(&pool->threads[i], NULL, tick_worker_thread,
+				   pool) != 0)
+			break;
+		pool->num_threads++;
+	}
+
+	if (!pool->num_threads)
+		goto fail;
+
+	blog(LOG_DEBUG, "Started %d video tick worker threads",
+	     (int)pool->num_threads);
+	return true;
+
+fail:
+	blog(LOG_WARNING, "Failed to start video tick worker threads, "
+			  "ticking all sources on the graphics thread");
+	tick_pool_free(pool);
+	pool->failed = true;
+	return false;
+}
+
+/* runs the video_tick callbacks queued by tick_sources, splitting them
+ * between the worker threads and this thread */
+static void tick_sources_parallel(struct obs_tick_pool *pool, float seconds)
+{
+	if (!pool->sources.num)
+		return;
+
+	pool->seconds = seconds;
+	os_atomic_set_long(&pool->next, 0);
+
+	if (pool->sources.num >= MIN_PARALLEL_TICKS &&
+	    (pool->threads || tick_pool_init(pool))) {
+		for (size_t i = 0; i < pool->num_threads; i++)
+			os_sem_post(pool->start_sem);
+
+		run_tick_batch(pool);
+
+		for (size_t i = 0; i < pool->num_threads; i++)
+			os_sem_wait(pool->done_sem);
+	} else {
+		run_tick_batch(pool);
+	}
+
+	for (size_t i = 0; i < pool->sources.num; i++)
+		obs_source_release(pool->sources.array[i]);
+	da_resize(pool->sources, 0);
+}
+
 static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 {
 	struct obs_core_data *data = &obs->data;
+	struct obs_tick_pool *pool = &obs->video.tick_pool;
 	struct obs_source *source;
 	uint64_t delta_time;
 	float seconds;
@@ -62,9 +179,14 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 
 	source = data->sources;
 	while (source) {
-		obs_source_t *s = obs_source_get_ref(source);
-
-		if (s) {
+		obs_source_t *s = obs_source_needs_video_tick(source)
+					  ? obs_source_get_ref(source)
+					  : NULL;
+
+		if (s && obs_source_parallel_video_tick(s)) {
+			obs_source_video_tick_state(s, seconds);
+			da_push_back(pool->sources, &s);
+		} else if (s) {
 			obs_source_video_tick(s, seconds);
 			obs_source_release(s);
 		}
@@ -74,6 +196,12 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 
 	pthread_mutex_unlock(&data->sources_mutex);
 
+	/* outside of sources_mutex, so that the callbacks can look up other
+	 * sources without deadlocking the workers */
+	tick_sources_parallel(pool, seconds);
+
+	obs_evict_source_caches(cur_time);
+
 	return cur_time;
 }
 
@@ -1226,6 +1354,8 @@ void *obs_graphics_thread(void *param)
 #endif
 		;
 
+	tick_pool_free(&obs->video.tick_pool);
+
 #ifdef _WIN32
 	uninit_winrt_state(&winrt);
 #endif
@@ -563,6 +563,7 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 	}
 
 	gs_enter_context(video->graphics);
+	gs_set_effect_cache_path(obs->effect_cache_path);
 
 	char *filename = obs_find_data_file("default.effect");
 	video->default_effect = gs_effect_create_from_file(filename, NULL);
@@ -981,6 +982,7 @@ static bool obs_init_data(void)
 
 	pthread_mutex_init_value(&obs->data.displays_mutex);
 	pthread_mutex_init_value(&obs->data.draw_callbacks_mutex);
+	pthread_mutex_init_value(&obs->data.delay_disks_mutex);
 
 	if (pthread_mutex_init_recursive(&data->sources_mutex) != 0)
 		goto fail;
@@ -996,6 +998,8 @@ static bool obs_init_data(void)
 		goto fail;
 	if (pthread_mutex_init_recursive(&obs->data.draw_callbacks_mutex) != 0)
 		goto fail;
+	if (pthread_mutex_init(&data->delay_disks_mutex, NULL) != 0)
+		goto fail;
 
 	if (!obs_view_init(&data->main_view))
 		goto fail;
@@ -1075,6 +1079,7 @@ static void obs_free_data(void)
 	pthread_mutex_destroy(&data->encoders_mutex);
 	pthread_mutex_destroy(&data->services_mutex);
 	pthread_mutex_destroy(&data->draw_callbacks_mutex);
+	pthread_mutex_destroy(&data->delay_disks_mutex);
 	da_free(data->draw_callbacks);
 	da_free(data->rendered_callbacks);
 	da_free(data->tick_callbacks);
@@ -1083,6 +1088,10 @@ static void obs_free_data(void)
 	for (size_t i = 0; i < data->protocols.num; i++)
 		bfree(data->protocols.array[i]);
 	da_free(data->protocols);
+
+	for (size_t i = 0; i < data->delay_disk_prefixes.num; i++)
+		bfree(data->delay_disk_prefixes.array[i]);
+	da_free(data->delay_disk_prefixes);
 }
 
 static const char *obs_signals[] = {
@@ -1441,6 +1450,7 @@ void obs_shutdown(void)
 		profiler_name_store_free(obs->name_store);
 
 	bfree(obs->module_config_path);
+	bfree(obs->effect_cache_path);
 	bfree(obs->locale);
 	bfree(obs);
 	obs = NULL;
@@ -1489,6 +1499,45 @@ const char *obs_get_locale(void)
 	return obs->locale;
 }
 
+void obs_set_effect_cache_path(const char *path)
+{
+	bfree(obs->effect_cache_path);
+	obs->effect_cache_path = path ? bstrdup(path) : NULL;
+
+	if (obs->video.graphics) {
+		obs_enter_graphics();
+		gs_set_effect_cache_path(path);
+		obs_leave_graphics();
+	}
+}
+
+bool obs_get_texrender_pool_stats(struct gs_texrender_pool_stats *stats)
+{
+	if (!obs || !obs->video.graphics || !stats)
+		return false;
+
+	obs_enter_graphics();
+	gs_texrender_pool_get_stats(stats);
+	obs_leave_graphics();
+	return true;
+}
+
+void obs_set_source_memory_budget(uint64_t bytes)
+{
+	if (obs)
+		obs->data.source_memory_budget = bytes;
+}
+
+uint64_t obs_get_source_memory_budget(void)
+{
+	return obs ? obs->data.source_memory_budget : 0;
+}
+
+uint64_t obs_get_source_memory_usage(void)
+{
+	return obs ? obs->data.source_memory_usage : 0;
+}
+
 #define OBS_SIZE_MIN 2
 #define OBS_SIZE_MAX (32 * 1024)
 
@@ -1574,6 +1623,22 @@ int obs_reset_video(struct obs_video_info *ovi)
 #define SEC_TO_MSEC 1000
 #endif
 
+static void reserve_audio_inputs(void)
+{
+	struct obs_core_data *data = &obs->data;
+	struct obs_source *source;
+
+	pthread_mutex_lock(&data->audio_sources_mutex);
+
+	source = data->first_audio_source;
+	while (source) {
+		obs_source_reserve_audio_input(source);
+		source = (struct obs_source *)source->next_audio_source;
+	}
+
+	pthread_mutex_unlock(&data->audio_sources_mutex);
+}
+
 bool obs_reset_audio2(const struct obs_audio_info2 *oai)
 {
 	struct obs_core_audio *audio = &obs->audio;
@@ -1615,9 +1680,13 @@ bool obs_reset_audio2(const struct obs_audio_info2 *oai)
 	     "\tmax buffering:   %d milliseconds\n"
 	     "\tbuffering type:  %s",
 	     (int)ai.samples_per_sec, (int)ai.speakers, max_buffering_ms,
-	     oai->fixed_buffering ? "fixed" : "dynamically increasing");
+	     oai->fixed_buffering ? "fixed" : "dynamic");
+
+	if (!obs_init_audio(&ai))
+		return false;
 
-	return obs_init_audio(&ai);
+	reserve_audio_inputs();
+	return true;
 }
 
 bool obs_reset_audio(const struct obs_audio_info *oai)
@@ -1675,6 +1744,19 @@ bool obs_get_audio_info(struct obs_audio_info *oai)
 	return true;
 }
 
+uint32_t obs_get_audio_buffering_ms(void)
+{
+	struct obs_core_audio *audio = &obs->audio;
+	uint32_t sample_rate;
+
+	if (!audio->audio)
+		return 0;
+
+	sample_rate = audio_output_get_sample_rate(audio->audio);
+	return (uint32_t)((uint64_t)audio->total_buffering_ticks *
+			  AUDIO_OUTPUT_FRAMES * SEC_TO_MSEC / sample_rate);
+}
+
 bool obs_enum_source_types(size_t idx, const char **id)
 {
 	if (idx >= obs->source_types.num)
@@ -385,6 +385,38 @@ EXPORT void obs_set_locale(const char *locale);
 /** @return the current locale */
 EXPORT const char *obs_get_locale(void);
 
+/**
+ * Sets the directory used to cache parsed effect files between runs, or NULL
+ * to disable the effect cache.  Applies to the current graphics context and
+ * to any graphics context created later on.
+ *
+ * @param  path  The effect cache directory
+ */
+EXPORT void obs_set_effect_cache_path(const char *path);
+
+/**
+ * Gets the number and memory use of the render targets held by texrenders
+ * and kept in the render target pool of the graphics context.
+ *
+ * @param  stats  Receives the statistics
+ * @return        false if the graphics context has not been initialized
+ */
+EXPORT bool obs_get_texrender_pool_stats(struct gs_texrender_pool_stats *stats);
+
+/**
+ * Sets how much memory the caches of sources (such as decoded images) may
+ * use before the caches of the sources that have not been showing for the
+ * longest time are evicted.  Sources reload evicted caches when they are
+ * shown again.  0 disables eviction, which is the default.
+ *
+ * @param  bytes  The memory budget, in bytes
+ */
+EXPORT void obs_set_source_memory_budget(uint64_t bytes);
+EXPORT uint64_t obs_get_source_memory_budget(void);
+
+/** @return the memory used by the caches of sources, updated every second */
+EXPORT uint64_t obs_get_source_memory_usage(void);
+
 /** Initialize the Windows-specific crash handler */
 
 #ifdef _WIN32
@@ -440,6 +472,9 @@ EXPORT void obs_set_video_levels(float sdr_white_level,
 /** Gets the current audio settings, returns false if no audio */
 EXPORT bool obs_get_audio_info(struct obs_audio_info *oai);
 
+/** Gets the audio latency currently added by audio buffering */
+EXPORT uint32_t obs_get_audio_buffering_ms(void);
+
 /**
  * Opens a plugin module directly from a specific path.
  *
@@ -1177,6 +1212,12 @@ EXPORT void obs_source_set_sync_offset(obs_source_t *source, int64_t offset);
 /** Gets the audio sync offset (in nanoseconds) for a source */
 EXPORT int64_t obs_source_get_sync_offset(const obs_source_t *source);
 
+/**
+ * Gets the number of audio frames dropped because the source's audio buffer
+ * was full
+ */
+EXPORT uint64_t obs_source_get_audio_dropped_frames(obs_source_t *source);
+
 /** Enumerates active child sources used by this source */
 EXPORT void obs_source_enum_active_sources(obs_source_t *source,
 					   obs_source_enum_proc_t enum_callback,
@@ -2038,6 +2079,13 @@ EXPORT void obs_output_stop(obs_output_t *output);
  */
 #define OBS_OUTPUT_DELAY_PRESERVE (1 << 0)
 
+/**
+ * Store delayed packets in segment files on disk rather than in memory, only
+ * keeping an index of the packets in memory.  Requires a directory to be set
+ * with obs_output_set_delay_disk_path.
+ */
+#define OBS_OUTPUT_DELAY_DISK (1 << 1)
+
 /**
  * Sets the current output delay, in seconds (if the output supports delay).
  *
@@ -2048,6 +2096,14 @@ EXPORT void obs_output_stop(obs_output_t *output);
 EXPORT void obs_output_set_delay(obs_output_t *output, uint32_t delay_sec,
 				 uint32_t flags);
 
+/**
+ * Sets the directory used for delay segment files when the delay is started
+ * with OBS_OUTPUT_DELAY_DISK.  Stale segment files left in the directory by
+ * a previous session are removed.
+ */
+EXPORT void obs_output_set_delay_disk_path(obs_output_t *output,
+					   const char *path);
+
 /** Gets the currently set delay value, in seconds. */
 EXPORT uint32_t obs_output_get_delay(const obs_output_t *output);
 
@@ -2463,6 +2519,38 @@ EXPORT void obs_encoder_set_last_error(obs_encoder_t *encoder,
 
 EXPORT uint64_t obs_encoder_get_pause_offset(const obs_encoder_t *encoder);
 
+/** Statistics of the input frame queue of a raw video encoder */
+struct obs_encoder_queue_stats {
+	uint32_t queue_depth;
+	uint32_t queue_capacity;
+
+	uint64_t frames_queued;
+	uint64_t frames_encoded;
+
+	/* frames dropped because the encoder could not keep up */
+	uint64_t dropped_queue_full;
+	/* frames dropped because the video output could not hold the frame */
+	uint64_t dropped_no_buffer;
+	/* frames still queued when an encode error stopped the encoder */
+	uint64_t dropped_stopped;
+
+	uint64_t avg_queue_latency_ns;
+	uint64_t max_queue_latency_ns;
+};
+
+/**
+ * Gets the input queue statistics of a raw video encoder.  If the encoder is
+ * not active, returns the statistics of the last time it was active.
+ */
+EXPORT bool obs_encoder_get_queue_stats(obs_encoder_t *encoder,
+					struct obs_encoder_queue_stats *stats);
+
+/**
+ * Gets the number of encoded packets dropped because an output did not keep
+ * up with the encoder and its packet queue was full.
+ */
+EXPORT uint64_t obs_encoder_get_dropped_packets(obs_encoder_t *encoder);
+
 /* ------------------------------------------------------------------------- */
 /* Stream Services */
 
@@ -44,3 +44,9 @@ void array_output_serializer_free(struct array_output_data *data)
 {
 	da_free(data->bytes);
 }
+
+void array_output_serializer_reset(struct array_output_data *data)
+{
+	/* keeps the allocation so the output can be reused */
+	data->bytes.num = 0;
+}
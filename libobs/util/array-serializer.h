@@ -26,3 +26,4 @@ struct array_output_data {
 EXPORT void array_output_serializer_init(struct serializer *s,
 					 struct array_output_data *data);
 EXPORT void array_output_serializer_free(struct array_output_data *data);
+EXPORT void array_output_serializer_reset(struct array_output_data *data);
@@ -118,45 +118,6 @@ char *cf_literal_to_str(const char *literal, size_t count)
 	return str;
 }
 
-static bool cf_is_token_break(struct base_token *start_token,
-			      const struct base_token *token)
-{
-	switch (start_token->type) {
-	case BASETOKEN_ALPHA:
-		if (token->type == BASETOKEN_OTHER ||
-		    token->type == BASETOKEN_WHITESPACE)
-			return true;
-		break;
-
-	case BASETOKEN_DIGIT:
-		if (token->type == BASETOKEN_WHITESPACE ||
-		    (token->type == BASETOKEN_OTHER &&
-		     *token->text.array != '.'))
-			return true;
-		break;
-
-	case BASETOKEN_WHITESPACE:
-		/* lump all non-newline whitespace together when possible */
-		if (is_space_or_tab(*start_token->text.array) &&
-		    is_space_or_tab(*token->text.array))
-			break;
-		return true;
-
-	case BASETOKEN_OTHER:
-		if (*start_token->text.array == '.' &&
-		    token->type == BASETOKEN_DIGIT) {
-			start_token->type = BASETOKEN_DIGIT;
-			break;
-		}
-		/* Falls through. */
-
-	case BASETOKEN_NONE:
-		return true;
-	}
-
-	return false;
-}
-
 static inline bool cf_is_splice(const char *array)
 {
 	return (*array == '\\' && is_newline(array[1]));
@@ -195,8 +156,11 @@ static bool cf_lexer_process_comment(struct cf_lexer *lex,
 	out_token->str.len = 1;
 
 	if (*offset == '/') {
-		while (*++offset && !is_newline(*offset))
+		while (*++offset && !is_newline(*offset)) {
 			cf_pass_any_splices(&offset);
+			if (!*offset)
+				break;
+		}
 
 	} else if (*offset == '*') {
 		bool was_star = false;
@@ -204,6 +168,8 @@ static bool cf_lexer_process_comment(struct cf_lexer *lex,
 
 		while (*++offset) {
 			cf_pass_any_splices(&offset);
+			if (!*offset)
+				break;
 
 			if (was_star && *offset == '/') {
 				offset++;
@@ -226,7 +192,7 @@ static bool cf_lexer_process_comment(struct cf_lexer *lex,
 static inline void cf_lexer_write_strref(struct cf_lexer *lex,
 					 const struct strref *ref)
 {
-	strncpy(lex->write_offset, ref->array, ref->len);
+	memcpy(lex->write_offset, ref->array, ref->len);
 	lex->write_offset[ref->len] = 0;
 	lex->write_offset += ref->len;
 }
@@ -278,6 +244,8 @@ static void cf_lexer_getstrtoken(struct cf_lexer *lex,
 
 	while (*offset) {
 		cf_pass_any_splices(&offset);
+		if (!*offset)
+			break;
 		if (*offset == delimiter) {
 			if (!escaped) {
 				*lex->write_offset++ = *offset;
@@ -321,85 +289,138 @@ static bool cf_lexer_process_string(struct cf_lexer *lex,
 	return false;
 }
 
-static inline enum cf_token_type
-cf_get_token_type(const struct cf_token *token,
-		  const struct base_token *start_token)
+static inline bool cf_is_name_char(char ch)
 {
-	switch (start_token->type) {
-	case BASETOKEN_ALPHA:
-		return CFTOKEN_NAME;
+	return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+	       (ch >= '0' && ch <= '9') || ch == '_';
+}
 
-	case BASETOKEN_DIGIT:
-		return CFTOKEN_NUM;
+static inline bool cf_is_num_char(char ch)
+{
+	return cf_is_name_char(ch) || ch == '.';
+}
 
-	case BASETOKEN_WHITESPACE:
-		if (is_newline(*token->str.array))
-			return CFTOKEN_NEWLINE;
-		else
-			return CFTOKEN_SPACETAB;
+static inline bool cf_is_digit(char ch)
+{
+	return ch >= '0' && ch <= '9';
+}
 
-	case BASETOKEN_NONE:
-	case BASETOKEN_OTHER:
-		break;
+/*
+ * Copies characters to the reformatted text for as long as they pass the
+ * check, skipping spliced lines in between.  Returns the end of the token in
+ * the source text, which includes any trailing splices.
+ */
+static inline const char *cf_lexer_write_run(struct cf_lexer *lex,
+					     struct cf_token *out_token,
+					     const char *offset,
+					     bool (*check)(char))
+{
+	for (;;) {
+		const char *run = offset;
+		size_t len;
+
+		while (check(*offset))
+			offset++;
+
+		len = (size_t)(offset - run);
+		memcpy(lex->write_offset, run, len);
+		lex->write_offset += len;
+		out_token->str.len += len;
+
+		if (!cf_is_splice(offset))
+			break;
+		cf_pass_any_splices(&offset);
 	}
 
-	return CFTOKEN_OTHER;
+	return offset;
+}
+
+static inline const char *cf_lexer_write_chars(struct cf_lexer *lex,
+					       struct cf_token *out_token,
+					       const char *offset, size_t len)
+{
+	memcpy(lex->write_offset, offset, len);
+	lex->write_offset += len;
+	out_token->str.len += len;
+	offset += len;
+
+	cf_pass_any_splices(&offset);
+	return offset;
 }
 
 static bool cf_lexer_nexttoken(struct cf_lexer *lex, struct cf_token *out_token)
 {
-	struct base_token token, start_token;
-	bool wrote_data = false;
+	const char *offset = lex->base_lexer.offset;
+	char ch;
 
-	base_token_clear(&token);
-	base_token_clear(&start_token);
 	cf_token_clear(out_token);
+	if (!offset)
+		return false;
+
+	/* ignore escaped newlines to merge spliced lines */
+	cf_pass_any_splices(&offset);
+	lex->base_lexer.offset = offset;
 
-	while (lexer_getbasetoken(&lex->base_lexer, &token, PARSE_WHITESPACE)) {
-		/* reclassify underscore as alpha for alnum tokens */
-		if (*token.text.array == '_')
-			token.type = BASETOKEN_ALPHA;
+	ch = *offset;
+	if (!ch)
+		return false;
 
-		/* ignore escaped newlines to merge spliced lines */
-		if (cf_is_splice(token.text.array)) {
-			lex->base_lexer.offset +=
-				newline_size(token.text.array + 1);
-			continue;
-		}
+	out_token->unmerged_str.array = offset;
+	out_token->str.array = lex->write_offset;
 
-		if (!wrote_data) {
-			out_token->unmerged_str.array = token.text.array;
-			out_token->str.array = lex->write_offset;
+	if (ch == '/' || ch == '"' || ch == '\'' || ch == '<') {
+		lex->base_lexer.offset = offset + 1;
 
-			/* if comment then output a space */
-			if (cf_lexer_process_comment(lex, out_token))
-				return true;
+		/* if comment then output a space */
+		if (cf_lexer_process_comment(lex, out_token))
+			return true;
 
-			/* process string tokens if any */
-			if (cf_lexer_process_string(lex, out_token))
-				return true;
+		/* process string tokens if any */
+		if (cf_lexer_process_string(lex, out_token))
+			return true;
+	}
 
-			base_token_copy(&start_token, &token);
-			wrote_data = true;
+	if (cf_is_name_char(ch) && !cf_is_digit(ch)) {
+		out_token->type = CFTOKEN_NAME;
+		offset = cf_lexer_write_run(lex, out_token, offset,
+					    cf_is_name_char);
+		out_token->name_hash =
+			cf_hash_name(out_token->str.array, out_token->str.len);
 
-		} else if (cf_is_token_break(&start_token, &token)) {
-			lex->base_lexer.offset -= token.text.len;
-			break;
-		}
+	} else if (cf_is_digit(ch)) {
+		out_token->type = CFTOKEN_NUM;
+		offset = cf_lexer_write_run(lex, out_token, offset,
+					    cf_is_num_char);
 
-		/* write token to CF lexer to account for splicing/comments */
-		cf_lexer_write_strref(lex, &token.text);
-		out_token->str.len += token.text.len;
-	}
+	} else if (is_space_or_tab(ch)) {
+		/* lump all non-newline whitespace together */
+		out_token->type = CFTOKEN_SPACETAB;
+		offset = cf_lexer_write_run(lex, out_token, offset,
+					    is_space_or_tab);
+
+	} else if (is_newline(ch)) {
+		size_t len = is_newline_pair(ch, offset[1]) ? 2 : 1;
+
+		out_token->type = CFTOKEN_NEWLINE;
+		offset = cf_lexer_write_chars(lex, out_token, offset, len);
 
-	if (wrote_data) {
-		out_token->unmerged_str.len =
-			(size_t)(lex->base_lexer.offset -
-				 out_token->unmerged_str.array);
-		out_token->type = cf_get_token_type(out_token, &start_token);
+	} else {
+		out_token->type = CFTOKEN_OTHER;
+		offset = cf_lexer_write_chars(lex, out_token, offset, 1);
+
+		/* numbers starting with a period (.5) */
+		if (ch == '.' && cf_is_digit(*offset)) {
+			out_token->type = CFTOKEN_NUM;
+			offset = cf_lexer_write_run(lex, out_token, offset,
+						    cf_is_num_char);
+		}
 	}
 
-	return wrote_data;
+	*lex->write_offset = 0;
+	out_token->unmerged_str.len =
+		(size_t)(offset - out_token->unmerged_str.array);
+	lex->base_lexer.offset = offset;
+	return true;
 }
 
 void cf_lexer_init(struct cf_lexer *lex)
@@ -506,7 +527,7 @@ static inline void macro_params_free(struct macro_params *params)
 }
 
 static inline struct macro_param *
-get_macro_param(const struct macro_params *params, const struct strref *name)
+get_macro_param(const struct macro_params *params, const struct cf_token *name)
 {
 	size_t i;
 	if (!params)
@@ -514,7 +535,8 @@ get_macro_param(const struct macro_params *params, const struct strref *name)
 
 	for (i = 0; i < params->params.num; i++) {
 		struct macro_param *param = params->params.array + i;
-		if (strref_cmp_strref(&param->name.str, name) == 0)
+		if (param->name.name_hash == name->name_hash &&
+		    strref_cmp_strref(&param->name.str, &name->str) == 0)
 			return param;
 	}
 
@@ -786,7 +808,8 @@ exit:
 #define INVALID_INDEX ((size_t)-1)
 
 static inline size_t cf_preprocess_get_def_idx(struct cf_preprocessor *pp,
-					       const struct strref *def_name)
+					       const struct strref *def_name,
+					       uint32_t hash)
 {
 	struct cf_def *array = pp->defines.array;
 	size_t i;
@@ -794,7 +817,8 @@ static inline size_t cf_preprocess_get_def_idx(struct cf_preprocessor *pp,
 	for (i = 0; i < pp->defines.num; i++) {
 		struct cf_def *cur_def = array + i;
 
-		if (strref_cmp_strref(&cur_def->name.str, def_name) == 0)
+		if (cur_def->name.name_hash == hash &&
+		    strref_cmp_strref(&cur_def->name.str, def_name) == 0)
 			return i;
 	}
 
@@ -802,9 +826,9 @@ static inline size_t cf_preprocess_get_def_idx(struct cf_preprocessor *pp,
 }
 
 static inline struct cf_def *
-cf_preprocess_get_def(struct cf_preprocessor *pp, const struct strref *def_name)
+cf_preprocess_get_def(struct cf_preprocessor *pp, const struct cf_token *name)
 {
-	size_t idx = cf_preprocess_get_def_idx(pp, def_name);
+	size_t idx = cf_preprocess_get_def_idx(pp, &name->str, name->name_hash);
 	if (idx == INVALID_INDEX)
 		return NULL;
 
@@ -889,9 +913,10 @@ exit:
 }
 
 static inline void cf_preprocess_remove_def_strref(struct cf_preprocessor *pp,
-						   const struct strref *ref)
+						   const struct strref *ref,
+						   uint32_t hash)
 {
-	size_t def_idx = cf_preprocess_get_def_idx(pp, ref);
+	size_t def_idx = cf_preprocess_get_def_idx(pp, ref, hash);
 	if (def_idx != INVALID_INDEX) {
 		struct cf_def *array = pp->defines.array;
 		cf_def_free(array + def_idx);
@@ -916,7 +941,8 @@ static void cf_preprocess_undef(struct cf_preprocessor *pp,
 		goto exit;
 	}
 
-	cf_preprocess_remove_def_strref(pp, &cur_token->str);
+	cf_preprocess_remove_def_strref(pp, &cur_token->str,
+					cur_token->name_hash);
 	cur_token++;
 
 exit:
@@ -961,7 +987,7 @@ static void cf_preprocess_ifdef(struct cf_preprocessor *pp, bool ifnot,
 		goto exit;
 	}
 
-	def = cf_preprocess_get_def(pp, &cur_token->str);
+	def = cf_preprocess_get_def(pp, cur_token);
 	is_true = (def == NULL) == ifnot;
 
 	if (!cf_preprocess_subblock(pp, !is_true, &cur_token))
@@ -979,31 +1005,78 @@ exit:
 	*p_cur_token = cur_token;
 }
 
+enum cf_directive {
+	CF_DIRECTIVE_NONE,
+	CF_DIRECTIVE_INCLUDE,
+	CF_DIRECTIVE_DEFINE,
+	CF_DIRECTIVE_UNDEF,
+	CF_DIRECTIVE_IFDEF,
+	CF_DIRECTIVE_IFNDEF,
+	CF_DIRECTIVE_ELSE,
+	CF_DIRECTIVE_ENDIF,
+};
+
+struct cf_directive_name {
+	const char *name;
+	enum cf_directive directive;
+};
+
+/* indexed by cf_directive_hash, which has no collisions for these names */
+static const struct cf_directive_name cf_directives[16] = {
+	[2] = {"endif", CF_DIRECTIVE_ENDIF},
+	[4] = {"ifndef", CF_DIRECTIVE_IFNDEF},
+	[5] = {"include", CF_DIRECTIVE_INCLUDE},
+	[6] = {"ifdef", CF_DIRECTIVE_IFDEF},
+	[10] = {"define", CF_DIRECTIVE_DEFINE},
+	[13] = {"else", CF_DIRECTIVE_ELSE},
+	[14] = {"undef", CF_DIRECTIVE_UNDEF},
+};
+
+static inline size_t cf_directive_hash(const struct strref *str)
+{
+	return ((size_t)str->array[1] ^ (size_t)str->array[3] ^ str->len) & 15;
+}
+
+static enum cf_directive cf_get_directive(const struct cf_token *token)
+{
+	const struct cf_directive_name *entry;
+
+	if (token->type != CFTOKEN_NAME || token->str.len < 4)
+		return CF_DIRECTIVE_NONE;
+
+	entry = &cf_directives[cf_directive_hash(&token->str)];
+	if (!entry->name || strref_cmp(&token->str, entry->name) != 0)
+		return CF_DIRECTIVE_NONE;
+
+	return entry->directive;
+}
+
 static bool cf_preprocessor(struct cf_preprocessor *pp, bool if_block,
 			    struct cf_token **p_cur_token)
 {
 	struct cf_token *cur_token = *p_cur_token;
+	enum cf_directive directive = cf_get_directive(cur_token);
 
-	if (strref_cmp(&cur_token->str, "include") == 0) {
+	if (directive == CF_DIRECTIVE_INCLUDE) {
 		cf_preprocess_include(pp, p_cur_token);
 
-	} else if (strref_cmp(&cur_token->str, "define") == 0) {
+	} else if (directive == CF_DIRECTIVE_DEFINE) {
 		cf_preprocess_define(pp, p_cur_token);
 
-	} else if (strref_cmp(&cur_token->str, "undef") == 0) {
+	} else if (directive == CF_DIRECTIVE_UNDEF) {
 		cf_preprocess_undef(pp, p_cur_token);
 
-	} else if (strref_cmp(&cur_token->str, "ifdef") == 0) {
+	} else if (directive == CF_DIRECTIVE_IFDEF) {
 		cf_preprocess_ifdef(pp, false, p_cur_token);
 
-	} else if (strref_cmp(&cur_token->str, "ifndef") == 0) {
+	} else if (directive == CF_DIRECTIVE_IFNDEF) {
 		cf_preprocess_ifdef(pp, true, p_cur_token);
 
 		/*} else if (strref_cmp(&cur_token->str, "if") == 0) {
 		TODO;*/
-	} else if (strref_cmp(&cur_token->str, "else") == 0 ||
+	} else if (directive == CF_DIRECTIVE_ELSE ||
 		   /*strref_cmp(&cur_token->str, "elif") == 0 ||*/
-		   strref_cmp(&cur_token->str, "endif") == 0) {
+		   directive == CF_DIRECTIVE_ENDIF) {
 		if (!if_block) {
 			struct dstr name;
 			dstr_init_copy_strref(&name, &cur_token->str);
@@ -1211,14 +1284,14 @@ static void cf_preprocess_addtoken(struct cf_preprocessor *pp,
 		struct cf_def *def;
 		struct macro_param *param;
 
-		param = get_macro_param(params, &cur_token->str);
+		param = get_macro_param(params, cur_token);
 		if (param) {
 			cf_preprocess_unwrap_param(pp, dst, &cur_token, base,
 						   param);
 			goto exit;
 		}
 
-		def = cf_preprocess_get_def(pp, &cur_token->str);
+		def = cf_preprocess_get_def(pp, cur_token);
 		if (def) {
 			cf_preprocess_unwrap_define(pp, dst, &cur_token, base,
 						    def, params);
@@ -1321,6 +1394,7 @@ bool cf_preprocess(struct cf_preprocessor *pp, struct cf_lexer *lex,
 
 	pp->ed = ed;
 	pp->lex = lex;
+	da_reserve(pp->tokens, lex->tokens.num);
 	cf_preprocess_tokens(pp, false, &token);
 	da_push_back(pp->tokens, token);
 
@@ -1329,7 +1403,12 @@ bool cf_preprocess(struct cf_preprocessor *pp, struct cf_lexer *lex,
 
 void cf_preprocessor_add_def(struct cf_preprocessor *pp, struct cf_def *def)
 {
-	struct cf_def *existing = cf_preprocess_get_def(pp, &def->name.str);
+	struct cf_def *existing;
+
+	/* defs can be created outside of the lexer */
+	def->name.name_hash =
+		cf_hash_name(def->name.str.array, def->name.str.len);
+	existing = cf_preprocess_get_def(pp, &def->name);
 
 	if (existing) {
 		struct dstr name;
@@ -1353,5 +1432,6 @@ void cf_preprocessor_remove_def(struct cf_preprocessor *pp,
 	struct strref ref;
 	ref.array = def_name;
 	ref.len = strlen(def_name);
-	cf_preprocess_remove_def_strref(pp, &ref);
+	cf_preprocess_remove_def_strref(pp, &ref,
+					cf_hash_name(ref.array, ref.len));
 }
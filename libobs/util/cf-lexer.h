@@ -49,8 +49,22 @@ struct cf_token {
 	struct strref str;
 	struct strref unmerged_str;
 	enum cf_token_type type;
+	uint32_t name_hash; /* hash of str for CFTOKEN_NAME tokens */
 };
 
+static inline uint32_t cf_hash_update(uint32_t hash, const char *str,
+				      size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		hash = (hash ^ (uint8_t)str[i]) * 16777619u;
+	return hash;
+}
+
+static inline uint32_t cf_hash_name(const char *str, size_t len)
+{
+	return cf_hash_update(2166136261u, str, len);
+}
+
 static inline void cf_token_clear(struct cf_token *t)
 {
 	memset(t, 0, sizeof(struct cf_token));
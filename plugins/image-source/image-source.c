@@ -1,7 +1,9 @@
 #include <obs-module.h>
 #include <graphics/image-file.h>
 #include <util/platform.h>
+#include <util/threading.h>
 #include <util/dstr.h>
+#include <util/task.h>
 #include <sys/stat.h>
 
 #define blog(log_level, format, ...)                    \
@@ -12,6 +14,18 @@
 #define info(format, ...) blog(LOG_INFO, format, ##__VA_ARGS__)
 #define warn(format, ...) blog(LOG_WARNING, format, ##__VA_ARGS__)
 
+/* decoded off the graphics thread, the texture is created once the load is
+ * installed by image_source_tick */
+struct image_load {
+	volatile long refs;
+	volatile bool ready;
+
+	char *file;
+	enum gs_image_alpha_mode alpha_mode;
+	time_t timestamp;
+	gs_image_file4_t if4;
+};
+
 struct image_source {
 	obs_source_t *source;
 
@@ -25,8 +39,23 @@ struct image_source {
 	bool restart_gif;
 
 	gs_image_file4_t if4;
+	struct image_load *load;
+
+	/* size of the last loaded image, kept while the image is unloaded or
+	 * evicted so that the layout does not change */
+	uint32_t cx;
+	uint32_t cy;
+
+	/* evicted over the source memory budget, reloaded when shown */
+	bool evicted;
 };
 
+#define MAX_DECODE_THREADS 4
+
+static os_task_queue_t *decode_queues[MAX_DECODE_THREADS] = {0};
+static size_t num_decode_queues = 0;
+static volatile long next_decode_queue = 0;
+
 static time_t get_modified_timestamp(const char *filename)
 {
 	struct stat stats;
@@ -41,39 +70,129 @@ static const char *image_source_get_name(void *unused)
 	return obs_module_text("ImageInput");
 }
 
-static void image_source_load(struct image_source *context)
+static void image_load_release(struct image_load *load)
 {
-	char *file = context->file;
+	if (!load || os_atomic_dec_long(&load->refs) != 0)
+		return;
 
 	obs_enter_graphics();
-	gs_image_file4_free(&context->if4);
+	gs_image_file4_free(&load->if4);
 	obs_leave_graphics();
 
-	if (file && *file) {
-		debug("loading texture '%s'", file);
-		context->file_timestamp = get_modified_timestamp(file);
-		gs_image_file4_init(&context->if4, file,
-				    context->linear_alpha
-					    ? GS_IMAGE_ALPHA_PREMULTIPLY_SRGB
-					    : GS_IMAGE_ALPHA_PREMULTIPLY);
-		context->update_time_elapsed = 0;
+	bfree(load->file);
+	bfree(load);
+}
 
-		obs_enter_graphics();
-		gs_image_file4_init_texture(&context->if4);
-		obs_leave_graphics();
+static void image_load_task(void *param)
+{
+	struct image_load *load = param;
 
-		if (!context->if4.image3.image2.image.loaded)
-			warn("failed to load texture '%s'", file);
+	/* skip the decode if the source dropped the load in the meantime */
+	if (os_atomic_load_long(&load->refs) > 1) {
+		load->timestamp = get_modified_timestamp(load->file);
+		gs_image_file4_init(&load->if4, load->file, load->alpha_mode);
 	}
+
+	os_atomic_set_bool(&load->ready, true);
+	image_load_release(load);
+}
+
+static void image_source_cancel_load(struct image_source *context)
+{
+	image_load_release(context->load);
+	context->load = NULL;
 }
 
 static void image_source_unload(struct image_source *context)
 {
+	image_source_cancel_load(context);
+
 	obs_enter_graphics();
 	gs_image_file4_free(&context->if4);
 	obs_leave_graphics();
 }
 
+/* queues the image on the decode threads, the current image stays until the
+ * new one is ready */
+static void image_source_load(struct image_source *context)
+{
+	const char *file = context->file;
+	struct image_load *load;
+
+	image_source_cancel_load(context);
+
+	if (!file || !*file) {
+		image_source_unload(context);
+		context->evicted = false;
+		context->cx = 0;
+		context->cy = 0;
+		return;
+	}
+
+	debug("loading texture '%s'", file);
+
+	load = bzalloc(sizeof(*load));
+	load->refs = 2;
+	load->file = bstrdup(file);
+	load->alpha_mode = context->linear_alpha
+				   ? GS_IMAGE_ALPHA_PREMULTIPLY_SRGB
+				   : GS_IMAGE_ALPHA_PREMULTIPLY;
+	context->load = load;
+
+	if (num_decode_queues) {
+		long idx = os_atomic_inc_long(&next_decode_queue);
+		os_task_queue_t *queue =
+			decode_queues[(size_t)idx % num_decode_queues];
+
+		if (os_task_queue_queue_task(queue, image_load_task, load))
+			return;
+	}
+
+	image_load_task(load);
+}
+
+static void image_source_finish_load(struct image_source *context)
+{
+	struct image_load *load = context->load;
+	struct gs_image_file *image = &context->if4.image3.image2.image;
+
+	context->load = NULL;
+
+	obs_enter_graphics();
+	gs_image_file4_free(&context->if4);
+	context->if4 = load->if4;
+	gs_image_file4_init_texture(&context->if4);
+	obs_leave_graphics();
+
+	memset(&load->if4, 0, sizeof(load->if4));
+
+	context->file_timestamp = load->timestamp;
+	context->update_time_elapsed = 0;
+	context->evicted = false;
+	context->cx = image->cx;
+	context->cy = image->cy;
+
+	if (!image->loaded)
+		warn("failed to load texture '%s'", load->file);
+
+	image_load_release(load);
+}
+
+/* for the slideshow, which loads its images ahead of showing them */
+bool image_source_loading(void *data)
+{
+	struct image_source *context = data;
+	return context->load != NULL;
+}
+
+void image_source_preload(void *data)
+{
+	struct image_source *context = data;
+
+	if (context->evicted && !context->load)
+		image_source_load(context);
+}
+
 static void image_source_update(void *data, obs_data_t *settings)
 {
 	struct image_source *context = data;
@@ -104,7 +223,7 @@ static void image_source_show(void *data)
 {
 	struct image_source *context = data;
 
-	if (!context->persistent)
+	if (!context->persistent || (context->evicted && !context->load))
 		image_source_load(context);
 }
 
@@ -162,13 +281,13 @@ static void image_source_destroy(void *data)
 static uint32_t image_source_getwidth(void *data)
 {
 	struct image_source *context = data;
-	return context->if4.image3.image2.image.cx;
+	return context->cx;
 }
 
 static uint32_t image_source_getheight(void *data)
 {
 	struct image_source *context = data;
-	return context->if4.image3.image2.image.cy;
+	return context->cy;
 }
 
 static void image_source_render(void *data, gs_effect_t *effect)
@@ -201,9 +320,12 @@ static void image_source_tick(void *data, float seconds)
 	struct image_source *context = data;
 	uint64_t frame_time = obs_get_video_frame_time();
 
+	if (context->load && os_atomic_load_bool(&context->load->ready))
+		image_source_finish_load(context);
+
 	context->update_time_elapsed += seconds;
 
-	if (obs_source_showing(context->source)) {
+	if (obs_source_showing(context->source) && !context->load) {
 		if (context->update_time_elapsed >= 1.0f) {
 			time_t t = get_modified_timestamp(context->file);
 			context->update_time_elapsed = 0.0f;
@@ -300,6 +422,19 @@ uint64_t image_source_get_memory_usage(void *data)
 	return s->if4.image3.image2.mem_usage;
 }
 
+void image_source_evict(void *data)
+{
+	struct image_source *context = data;
+
+	if (context->evicted || obs_source_showing(context->source))
+		return;
+
+	debug("evicting texture '%s'", context->file);
+
+	image_source_unload(context);
+	context->evicted = true;
+}
+
 static void missing_file_callback(void *src, const char *new_path, void *data)
 {
 	struct image_source *s = src;
@@ -363,6 +498,8 @@ static struct obs_source_info image_source_info = {
 	.icon_type = OBS_ICON_TYPE_IMAGE,
 	.activate = image_source_activate,
 	.video_get_color_space = image_source_get_color_space,
+	.get_memory_usage = image_source_get_memory_usage,
+	.evict = image_source_evict,
 };
 
 OBS_DECLARE_MODULE()
@@ -379,6 +516,19 @@ extern struct obs_source_info color_source_info_v3;
 
 bool obs_module_load(void)
 {
+	int threads = os_get_logical_cores() - 1;
+	if (threads > MAX_DECODE_THREADS)
+		threads = MAX_DECODE_THREADS;
+	if (threads < 1)
+		threads = 1;
+
+	for (int i = 0; i < threads; i++) {
+		os_task_queue_t *queue = os_task_queue_create();
+		if (!queue)
+			break;
+		decode_queues[num_decode_queues++] = queue;
+	}
+
 	obs_register_source(&image_source_info);
 	obs_register_source(&color_source_info_v1);
 	obs_register_source(&color_source_info_v2);
@@ -386,3 +536,10 @@ bool obs_module_load(void)
 	obs_register_source(&slideshow_info);
 	return true;
 }
+
+void obs_module_unload(void)
+{
+	for (size_t i = 0; i < num_decode_queues; i++)
+		os_task_queue_destroy(decode_queues[i]);
+	num_decode_queues = 0;
+}
@@ -62,13 +62,24 @@
 /* ------------------------------------------------------------------------- */
 
 extern uint64_t image_source_get_memory_usage(void *data);
+extern bool image_source_loading(void *data);
+extern void image_source_preload(void *data);
 
 #define BYTES_TO_MBYTES (1024 * 1024)
 #define MAX_MEM_USAGE (400 * BYTES_TO_MBYTES)
 
+/* number of slides after the current one that are decoded ahead of time */
+#define PRELOAD_COUNT 2
+
+/* image sources are only created for the current and upcoming slides, and
+ * released again once the cache goes over MAX_MEM_USAGE.  the size is kept
+ * so that the automatic slideshow size does not depend on what is loaded */
 struct image_file_data {
 	char *path;
 	obs_source_t *source;
+	uint32_t cx;
+	uint32_t cy;
+	uint64_t last_used;
 };
 
 enum behavior {
@@ -98,10 +109,16 @@ struct slideshow {
 
 	float elapsed;
 	size_t cur_item;
+	size_t next_random;
 
 	uint32_t cx;
 	uint32_t cy;
-	uint64_t mem_usage;
+	uint32_t max_cx;
+	uint32_t max_cy;
+	bool use_auto;
+	bool aspect_only;
+	int cx_in;
+	int cy_in;
 
 	pthread_mutex_t mutex;
 	DARRAY(struct image_file_data) files;
@@ -140,23 +157,19 @@ static obs_source_t *get_transition(struct slideshow *ss)
 	return tr;
 }
 
-static obs_source_t *get_source(struct darray *array, const char *path)
+static struct image_file_data *find_file(struct darray *array,
+					 const char *path)
 {
 	DARRAY(struct image_file_data) files;
-	obs_source_t *source = NULL;
 
 	files.da = *array;
 
 	for (size_t i = 0; i < files.num; i++) {
-		const char *cur_path = files.array[i].path;
-
-		if (strcmp(path, cur_path) == 0) {
-			source = obs_source_get_ref(files.array[i].source);
-			break;
-		}
+		if (strcmp(path, files.array[i].path) == 0)
+			return &files.array[i];
 	}
 
-	return source;
+	return NULL;
 }
 
 static obs_source_t *create_source_from_file(const char *file)
@@ -197,6 +210,179 @@ static inline size_t random_file(struct slideshow *ss)
 	return next;
 }
 
+/* returns a new reference to the image source of a slide, creating it if
+ * needed, and marks the slide as recently used */
+static obs_source_t *get_item_source(struct slideshow *ss, size_t idx)
+{
+	struct image_file_data *file;
+	obs_source_t *source = NULL;
+
+	pthread_mutex_lock(&ss->mutex);
+	if (idx < ss->files.num) {
+		file = &ss->files.array[idx];
+		if (!file->source)
+			file->source = create_source_from_file(file->path);
+
+		file->last_used = os_gettime_ns();
+		source = obs_source_get_ref(file->source);
+	}
+	pthread_mutex_unlock(&ss->mutex);
+
+	return source;
+}
+
+static inline bool in_preload_window(struct slideshow *ss, size_t idx)
+{
+	size_t num = ss->files.num;
+
+	if (idx == ss->cur_item)
+		return true;
+	if (ss->randomize)
+		return idx == ss->next_random;
+
+	return (idx + num - ss->cur_item) % num <= PRELOAD_COUNT;
+}
+
+static void preload_items(struct slideshow *ss)
+{
+	size_t count = ss->randomize ? 1 : PRELOAD_COUNT;
+
+	if (!ss->files.num)
+		return;
+	if (count >= ss->files.num)
+		count = ss->files.num - 1;
+
+	for (size_t i = 1; i <= count; i++) {
+		size_t idx = ss->randomize ? ss->next_random
+					   : (ss->cur_item + i) % ss->files.num;
+		obs_source_t *source = get_item_source(ss, idx);
+
+		if (source) {
+			image_source_preload(obs_obj_get_data(source));
+			obs_source_release(source);
+		}
+	}
+}
+
+static bool next_item_ready(struct slideshow *ss)
+{
+	size_t idx = ss->randomize ? ss->next_random : ss->cur_item + 1;
+	bool ready = true;
+
+	pthread_mutex_lock(&ss->mutex);
+	if (ss->files.num) {
+		struct image_file_data *file =
+			&ss->files.array[idx % ss->files.num];
+		obs_source_t *source = file->source;
+
+		if (source)
+			ready = !image_source_loading(obs_obj_get_data(source));
+	}
+	pthread_mutex_unlock(&ss->mutex);
+
+	return ready;
+}
+
+static void update_size(struct slideshow *ss)
+{
+	uint32_t cx = ss->max_cx;
+	uint32_t cy = ss->max_cy;
+
+	if (!ss->use_auto) {
+		double cx_f = (double)cx;
+		double cy_f = (double)cy;
+
+		double old_aspect = cx_f / cy_f;
+		double new_aspect = (double)ss->cx_in / (double)ss->cy_in;
+
+		if (ss->aspect_only) {
+			if (fabs(old_aspect - new_aspect) > EPSILON) {
+				if (new_aspect > old_aspect)
+					cx = (uint32_t)(cy_f * new_aspect);
+				else
+					cy = (uint32_t)(cx_f / new_aspect);
+			}
+		} else {
+			cx = (uint32_t)ss->cx_in;
+			cy = (uint32_t)ss->cy_in;
+		}
+	}
+
+	ss->cx = cx;
+	ss->cy = cy;
+	obs_transition_set_size(ss->transition, cx, cy);
+}
+
+/* picks up the sizes of newly loaded images and releases the least recently
+ * used image sources outside of the preload window while over budget */
+static void update_cache(struct slideshow *ss)
+{
+	DARRAY(obs_source_t *) released;
+	uint64_t mem_usage = 0;
+	bool resized = false;
+
+	da_init(released);
+
+	pthread_mutex_lock(&ss->mutex);
+
+	for (size_t i = 0; i < ss->files.num; i++) {
+		struct image_file_data *file = &ss->files.array[i];
+		uint32_t cx, cy;
+
+		if (!file->source)
+			continue;
+
+		cx = obs_source_get_width(file->source);
+		cy = obs_source_get_height(file->source);
+		if (cx && cy) {
+			file->cx = cx;
+			file->cy = cy;
+		}
+
+		if (file->cx > ss->max_cx) {
+			ss->max_cx = file->cx;
+			resized = true;
+		}
+		if (file->cy > ss->max_cy) {
+			ss->max_cy = file->cy;
+			resized = true;
+		}
+
+		mem_usage += image_source_get_memory_usage(
+			obs_obj_get_data(file->source));
+	}
+
+	while (mem_usage > MAX_MEM_USAGE) {
+		struct image_file_data *lru = NULL;
+
+		for (size_t i = 0; i < ss->files.num; i++) {
+			struct image_file_data *file = &ss->files.array[i];
+
+			if (!file->source || in_preload_window(ss, i))
+				continue;
+			if (!lru || file->last_used < lru->last_used)
+				lru = file;
+		}
+
+		if (!lru)
+			break;
+
+		mem_usage -= image_source_get_memory_usage(
+			obs_obj_get_data(lru->source));
+		da_push_back(released, &lru->source);
+		lru->source = NULL;
+	}
+
+	pthread_mutex_unlock(&ss->mutex);
+
+	for (size_t i = 0; i < released.num; i++)
+		obs_source_release(released.array[i]);
+	da_free(released);
+
+	if (resized)
+		update_size(ss);
+}
+
 /* ------------------------------------------------------------------------- */
 
 static const char *ss_getname(void *unused)
@@ -209,36 +395,36 @@ static void add_file(struct slideshow *ss, struct darray *array,
 		     const char *path, uint32_t *cx, uint32_t *cy)
 {
 	DARRAY(struct image_file_data) new_files;
-	struct image_file_data data;
-	obs_source_t *new_source;
+	struct image_file_data data = {0};
+	struct image_file_data *old;
 
 	new_files.da = *array;
 
+	/* image sources are created once the slide is about to be shown, but
+	 * existing ones and known sizes are carried over */
 	pthread_mutex_lock(&ss->mutex);
-	new_source = get_source(&ss->files.da, path);
+	old = find_file(&ss->files.da, path);
+	if (old) {
+		data = *old;
+		data.source = obs_source_get_ref(old->source);
+	}
 	pthread_mutex_unlock(&ss->mutex);
 
-	if (!new_source)
-		new_source = get_source(&new_files.da, path);
-	if (!new_source)
-		new_source = create_source_from_file(path);
-
-	if (new_source) {
-		uint32_t new_cx = obs_source_get_width(new_source);
-		uint32_t new_cy = obs_source_get_height(new_source);
-
-		data.path = bstrdup(path);
-		data.source = new_source;
-		da_push_back(new_files, &data);
+	if (!old) {
+		old = find_file(&new_files.da, path);
+		if (old) {
+			data = *old;
+			data.source = obs_source_get_ref(old->source);
+		}
+	}
 
-		if (new_cx > *cx)
-			*cx = new_cx;
-		if (new_cy > *cy)
-			*cy = new_cy;
+	data.path = bstrdup(path);
+	da_push_back(new_files, &data);
 
-		void *source_data = obs_obj_get_data(new_source);
-		ss->mem_usage += image_source_get_memory_usage(source_data);
-	}
+	if (data.cx > *cx)
+		*cx = data.cx;
+	if (data.cy > *cy)
+		*cy = data.cy;
 
 	*array = new_files.da;
 }
@@ -265,15 +451,17 @@ static void do_transition(void *data, bool to_null)
 {
 	struct slideshow *ss = data;
 	bool valid = item_valid(ss);
+	obs_source_t *source = valid ? get_item_source(ss, ss->cur_item) : NULL;
+
+	if (valid)
+		ss->next_random = random_file(ss);
 
 	if (valid && ss->use_cut) {
-		obs_transition_set(ss->transition,
-				   ss->files.array[ss->cur_item].source);
+		obs_transition_set(ss->transition, source);
 
 	} else if (valid && !to_null) {
 		obs_transition_start(ss->transition, OBS_TRANSITION_MODE_AUTO,
-				     ss->tr_speed,
-				     ss->files.array[ss->cur_item].source);
+				     ss->tr_speed, source);
 
 	} else {
 		obs_transition_start(ss->transition, OBS_TRANSITION_MODE_AUTO,
@@ -291,6 +479,8 @@ static void do_transition(void *data, bool to_null)
 			obs_source_get_signal_handler(ss->source);
 		signal_handler_signal(sh, "slide_changed", &ss->cd);
 	}
+
+	obs_source_release(source);
 }
 
 static void ss_update(void *data, obs_data_t *settings)
@@ -352,9 +542,7 @@ static void ss_update(void *data, obs_data_t *settings)
 	count = obs_data_array_count(array);
 
 	/* ------------------------------------- */
-	/* create new list of sources */
-
-	ss->mem_usage = 0;
+	/* create new list of files */
 
 	for (size_t i = 0; i < count; i++) {
 		obs_data_t *item = obs_data_array_item(array, i);
@@ -388,9 +576,6 @@ static void ss_update(void *data, obs_data_t *settings)
 				dstr_cat(&dir_path, ent->d_name);
 				add_file(ss, &new_files.da, dir_path.array, &cx,
 					 &cy);
-
-				if (ss->mem_usage >= MAX_MEM_USAGE)
-					break;
 			}
 
 			dstr_free(&dir_path);
@@ -400,9 +585,6 @@ static void ss_update(void *data, obs_data_t *settings)
 		}
 
 		obs_data_release(item);
-
-		if (ss->mem_usage >= MAX_MEM_USAGE)
-			break;
 	}
 
 	/* ------------------------------------- */
@@ -460,33 +642,17 @@ static void ss_update(void *data, obs_data_t *settings)
 		}
 	}
 
-	if (!use_auto) {
-		double cx_f = (double)cx;
-		double cy_f = (double)cy;
-
-		double old_aspect = cx_f / cy_f;
-		double new_aspect = (double)cx_in / (double)cy_in;
-
-		if (aspect_only) {
-			if (fabs(old_aspect - new_aspect) > EPSILON) {
-				if (new_aspect > old_aspect)
-					cx = (uint32_t)(cy_f * new_aspect);
-				else
-					cy = (uint32_t)(cx_f / new_aspect);
-			}
-		} else {
-			cx = (uint32_t)cx_in;
-			cy = (uint32_t)cy_in;
-		}
-	}
-
 	/* ------------------------- */
 
-	ss->cx = cx;
-	ss->cy = cy;
+	ss->use_auto = use_auto;
+	ss->aspect_only = aspect_only;
+	ss->cx_in = cx_in;
+	ss->cy_in = cy_in;
+	ss->max_cx = cx;
+	ss->max_cy = cy;
 	ss->cur_item = 0;
 	ss->elapsed = 0.0f;
-	obs_transition_set_size(ss->transition, cx, cy);
+	update_size(ss);
 	obs_transition_set_alignment(ss->transition, OBS_ALIGN_CENTER);
 	obs_transition_set_scale_type(ss->transition,
 				      OBS_TRANSITION_SCALE_ASPECT);
@@ -563,7 +729,7 @@ static void ss_next_slide(void *data)
 		return;
 
 	if (ss->randomize)
-		ss->cur_item = random_file(ss);
+		ss->cur_item = ss->next_random;
 	else if (++ss->cur_item >= ss->files.num)
 		ss->cur_item = 0;
 
@@ -748,6 +914,10 @@ static void ss_video_tick(void *data, float seconds)
 	if (!ss->transition || !ss->slide_time)
 		return;
 
+	if (obs_source_showing(ss->source))
+		preload_items(ss);
+	update_cache(ss);
+
 	if (ss->restart_on_activate && ss->use_cut) {
 		ss->elapsed = 0.0f;
 		ss->cur_item = ss->randomize ? random_file(ss) : 0;
@@ -789,6 +959,12 @@ static void ss_video_tick(void *data, float seconds)
 			return;
 		}
 
+		/* hold the current slide until the next one is decoded */
+		if (!next_item_ready(ss)) {
+			ss->elapsed = ss->slide_time;
+			return;
+		}
+
 		obs_source_media_next(ss->source);
 	}
 }
@@ -24,6 +24,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
 #include "ffmpeg-mux.h"
 
 #include <util/threading.h>
@@ -129,6 +130,27 @@ struct io_header {
 	size_t data_length;
 };
 
+/* Number of power-of-two millisecond buckets in the write latency histogram,
+ * the last bucket collects everything from ~1 second up */
+#define IO_LATENCY_BUCKETS 12
+
+struct io_chunk {
+	unsigned char *data;
+	size_t used;
+	bool want_seek;
+	uint64_t seek_offset;
+	bool last;
+};
+
+struct io_stats {
+	uint64_t writes;
+	uint64_t bytes;
+	uint64_t total_ns;
+	uint64_t max_ns;
+	uint64_t latency[IO_LATENCY_BUCKETS];
+	uint64_t queue_full_waits;
+};
+
 struct io_buffer {
 	bool active;
 	bool shutdown_requested;
@@ -140,6 +162,17 @@ struct io_buffer {
 	FILE *output_file;
 	struct circlebuf data;
 	uint64_t next_pos;
+
+	/* chunks are filled by the I/O thread and written to disk by the
+	 * write thread, so a stalled write doesn't stop the I/O thread from
+	 * draining the buffer until all chunks are in flight */
+	size_t chunk_size;
+	size_t queue_depth;
+	struct io_chunk *chunks;
+	os_sem_t *chunks_free;
+	os_sem_t *chunks_ready;
+	pthread_t write_thread;
+	struct io_stats stats;
 };
 
 struct ffmpeg_mux {
@@ -177,6 +210,16 @@ static void header_free(struct header *header)
 	free(header->data);
 }
 
+static void free_io_chunks(struct ffmpeg_mux *ffm)
+{
+	if (ffm->io.chunks) {
+		for (size_t i = 0; i < ffm->io.queue_depth; i++)
+			free(ffm->io.chunks[i].data);
+		free(ffm->io.chunks);
+		ffm->io.chunks = NULL;
+	}
+}
+
 static void free_avformat(struct ffmpeg_mux *ffm)
 {
 	if (ffm->output) {
@@ -231,6 +274,11 @@ static void ffmpeg_mux_free(struct ffmpeg_mux *ffm)
 		pthread_mutex_destroy(&ffm->io.data_mutex);
 
 		circlebuf_free(&ffm->io.data);
+
+		free_io_chunks(ffm);
+
+		os_sem_destroy(ffm->io.chunks_free);
+		os_sem_destroy(ffm->io.chunks_ready);
 	}
 
 	free_avformat(ffm);
@@ -702,22 +750,132 @@ static inline bool ffmpeg_mux_get_extra_data(struct ffmpeg_mux *ffm)
 #pragma warning(disable : 4996)
 #endif
 
-#define CHUNK_SIZE 1048576
+#define DEFAULT_CHUNK_SIZE 1048576
+#define MIN_CHUNK_SIZE 65536
+#define MAX_CHUNK_SIZE (64 * 1048576)
+#define DEFAULT_QUEUE_DEPTH 2
+#define MAX_QUEUE_DEPTH 16
 
-static void *ffmpeg_mux_io_thread(void *data)
+static inline size_t get_latency_bucket(uint64_t ns)
+{
+	uint64_t ms = ns / 1000000;
+	size_t bucket = 0;
+
+	while (ms && bucket < IO_LATENCY_BUCKETS - 1) {
+		ms >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+static void log_io_stats(struct ffmpeg_mux *ffm)
+{
+	struct io_stats *stats = &ffm->io.stats;
+
+	if (!stats->writes)
+		return;
+
+	printf("Disk writes: %" PRIu64 " (%.1f MB, chunk size %zu, "
+	       "queue depth %zu), avg %.2f ms, max %.2f ms, "
+	       "waited for a free chunk %" PRIu64 " time(s)\n",
+	       stats->writes, (double)stats->bytes / 1048576.0,
+	       ffm->io.chunk_size, ffm->io.queue_depth,
+	       (double)stats->total_ns / (double)stats->writes / 1000000.0,
+	       (double)stats->max_ns / 1000000.0, stats->queue_full_waits);
+
+	printf("Disk write latency:");
+	for (size_t i = 0; i < IO_LATENCY_BUCKETS; i++) {
+		if (!stats->latency[i])
+			continue;
+		if (i == IO_LATENCY_BUCKETS - 1)
+			printf("\n\t>= %d ms: %" PRIu64, 1 << (i - 1),
+			       stats->latency[i]);
+		else
+			printf("\n\t< %d ms: %" PRIu64, 1 << i,
+			       stats->latency[i]);
+	}
+	printf("\n");
+}
+
+static void *ffmpeg_mux_write_thread(void *data)
 {
 	struct ffmpeg_mux *ffm = data;
+	struct io_stats *stats = &ffm->io.stats;
+	size_t idx = 0;
 
-	// Chunk collects the writes into a larger batch
-	size_t chunk_used = 0;
+	for (;;) {
+		os_sem_wait(ffm->io.chunks_ready);
+
+		struct io_chunk *chunk = &ffm->io.chunks[idx];
+		idx = (idx + 1) % ffm->io.queue_depth;
+
+		if (chunk->last)
+			break;
+
+		// After an error, keep returning chunks so the I/O thread
+		// doesn't get stuck waiting for a free one
+		if (os_atomic_load_bool(&ffm->io.output_error)) {
+			os_sem_post(ffm->io.chunks_free);
+			continue;
+		}
+
+		uint64_t start = os_gettime_ns();
+
+		if (chunk->want_seek)
+			os_fseeki64(ffm->io.output_file, chunk->seek_offset,
+				    SEEK_SET);
+
+		if (fwrite(chunk->data, chunk->used, 1, ffm->io.output_file) !=
+		    1) {
+			os_atomic_set_bool(&ffm->io.output_error, true);
+			fprintf(stderr, "Error writing to '%s', %s\n",
+				ffm->params.printable_file.array,
+				strerror(errno));
+		}
+
+		uint64_t elapsed = os_gettime_ns() - start;
 
-	unsigned char *chunk = malloc(CHUNK_SIZE);
-	if (!chunk) {
-		os_atomic_set_bool(&ffm->io.output_error, true);
-		fprintf(stderr, "Error allocating memory for output\n");
-		goto error;
+		stats->writes++;
+		stats->bytes += chunk->used;
+		stats->total_ns += elapsed;
+		if (elapsed > stats->max_ns)
+			stats->max_ns = elapsed;
+		stats->latency[get_latency_bucket(elapsed)]++;
+
+		os_sem_post(ffm->io.chunks_free);
 	}
 
+	fclose(ffm->io.output_file);
+	return NULL;
+}
+
+static struct io_chunk *acquire_chunk(struct ffmpeg_mux *ffm, size_t *idx)
+{
+	struct io_chunk *chunk = &ffm->io.chunks[*idx];
+	*idx = (*idx + 1) % ffm->io.queue_depth;
+
+	// If no chunk is free, every chunk is waiting on the disk
+	uint64_t start = os_gettime_ns();
+	os_sem_wait(ffm->io.chunks_free);
+	if (os_gettime_ns() - start >= 1000000)
+		ffm->io.stats.queue_full_waits++;
+
+	chunk->used = 0;
+	chunk->want_seek = false;
+	chunk->last = false;
+	return chunk;
+}
+
+static void *ffmpeg_mux_io_thread(void *data)
+{
+	struct ffmpeg_mux *ffm = data;
+	size_t chunk_size = ffm->io.chunk_size;
+	size_t chunk_idx = 0;
+
+	// Chunk collects the writes into a larger batch
+	struct io_chunk *chunk = acquire_chunk(ffm, &chunk_idx);
+
 	bool shutting_down;
 	bool want_seek = false;
 	bool force_flush_chunk = false;
@@ -763,7 +921,7 @@ static void *ffmpeg_mux_io_thread(void *data)
 					// If there's already part of a chunk pending,
 					// flush it at the current offset. Similarly,
 					// if we already plan to seek, then seek.
-					if (chunk_used || want_seek) {
+					if (chunk->used || want_seek) {
 						force_flush_chunk = true;
 						break;
 					}
@@ -779,8 +937,8 @@ static void *ffmpeg_mux_io_thread(void *data)
 
 				// Make sure there's enough room for the data, if
 				// not then force a flush
-				if (header.data_length + chunk_used >
-				    CHUNK_SIZE) {
+				if (header.data_length + chunk->used >
+				    chunk_size) {
 					force_flush_chunk = true;
 					break;
 				}
@@ -791,11 +949,11 @@ static void *ffmpeg_mux_io_thread(void *data)
 
 				// Copy from the buffer to our local chunk
 				circlebuf_pop_front(&ffm->io.data,
-						    chunk + chunk_used,
+						    chunk->data + chunk->used,
 						    header.data_length);
 
 				// Update offsets
-				chunk_used += header.data_length;
+				chunk->used += header.data_length;
 				current_seek_position += header.data_length;
 			}
 
@@ -806,8 +964,8 @@ static void *ffmpeg_mux_io_thread(void *data)
 			// data left in the buffer. The buffer might be entirely empty
 			// if we were woken up to exit.
 			if (!force_flush_chunk &&
-			    (!chunk_used ||
-			     (chunk_used < 65536 && !shutting_down))) {
+			    (!chunk->used ||
+			     (chunk->used < 65536 && !shutting_down))) {
 				os_event_reset(
 					ffm->io.new_data_available_event);
 				pthread_mutex_unlock(&ffm->io.data_mutex);
@@ -818,28 +976,24 @@ static void *ffmpeg_mux_io_thread(void *data)
 
 			// Seek if we need to
 			if (want_seek) {
-				os_fseeki64(ffm->io.output_file,
-					    next_seek_position, SEEK_SET);
+				chunk->want_seek = true;
+				chunk->seek_offset = next_seek_position;
 
 				// Update the next virtual position, making sure to take
 				// into account the size of the chunk we're about to write.
 				current_seek_position =
-					next_seek_position + chunk_used;
+					next_seek_position + chunk->used;
 
 				want_seek = false;
 			}
 
-			// Write the current chunk to the output file
-			if (fwrite(chunk, chunk_used, 1, ffm->io.output_file) !=
-			    1) {
-				os_atomic_set_bool(&ffm->io.output_error, true);
-				fprintf(stderr, "Error writing to '%s', %s\n",
-					ffm->params.printable_file.array,
-					strerror(errno));
+			// Hand the current chunk off to the write thread
+			os_sem_post(ffm->io.chunks_ready);
+
+			if (os_atomic_load_bool(&ffm->io.output_error))
 				goto error;
-			}
 
-			chunk_used = 0;
+			chunk = acquire_chunk(ffm, &chunk_idx);
 			force_flush_chunk = false;
 		}
 
@@ -848,11 +1002,20 @@ static void *ffmpeg_mux_io_thread(void *data)
 			break;
 	}
 
+	chunk->last = true;
+	os_sem_post(ffm->io.chunks_ready);
+
+	pthread_join(ffm->io.write_thread, NULL);
+	log_io_stats(ffm);
+	return NULL;
+
 error:
-	if (chunk)
-		free(chunk);
+	// Tell the write thread to stop once it's dropped everything queued
+	chunk = acquire_chunk(ffm, &chunk_idx);
+	chunk->last = true;
+	os_sem_post(ffm->io.chunks_ready);
 
-	fclose(ffm->io.output_file);
+	pthread_join(ffm->io.write_thread, NULL);
 	return NULL;
 }
 
@@ -920,6 +1083,57 @@ static int ffmpeg_mux_write_av_buffer(void *opaque, uint8_t *buf, int buf_size)
 	return buf_size;
 }
 
+static size_t get_io_option(AVDictionary **dict, const char *name,
+			    size_t def, size_t min, size_t max)
+{
+	AVDictionaryEntry *entry = av_dict_get(*dict, name, NULL, 0);
+	size_t val = def;
+
+	if (entry) {
+		long long parsed = strtoll(entry->value, NULL, 10);
+		if (parsed > 0)
+			val = (size_t)parsed;
+		if (val < min)
+			val = min;
+		else if (val > max)
+			val = max;
+
+		// Not an ffmpeg option, don't pass it on to the muxer
+		av_dict_set(dict, name, NULL, 0);
+	}
+
+	return val;
+}
+
+// The buffered I/O options only apply when writing to a file
+static void remove_io_options(AVDictionary **dict)
+{
+	av_dict_set(dict, "io_chunk_size", NULL, 0);
+	av_dict_set(dict, "io_queue_depth", NULL, 0);
+}
+
+static bool init_io_chunks(struct ffmpeg_mux *ffm, AVDictionary **dict)
+{
+	ffm->io.chunk_size = get_io_option(dict, "io_chunk_size",
+					   DEFAULT_CHUNK_SIZE, MIN_CHUNK_SIZE,
+					   MAX_CHUNK_SIZE);
+	ffm->io.queue_depth = get_io_option(dict, "io_queue_depth",
+					    DEFAULT_QUEUE_DEPTH, 2,
+					    MAX_QUEUE_DEPTH);
+
+	ffm->io.chunks = calloc(ffm->io.queue_depth, sizeof(struct io_chunk));
+	if (!ffm->io.chunks)
+		return false;
+
+	for (size_t i = 0; i < ffm->io.queue_depth; i++) {
+		ffm->io.chunks[i].data = malloc(ffm->io.chunk_size);
+		if (!ffm->io.chunks[i].data)
+			return false;
+	}
+
+	return true;
+}
+
 static inline int open_output_file(struct ffmpeg_mux *ffm)
 {
 #if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(59, 0, 100)
@@ -929,6 +1143,18 @@ static inline int open_output_file(struct ffmpeg_mux *ffm)
 #endif
 	int ret;
 
+	AVDictionary *dict = NULL;
+	if ((ret = av_dict_parse_string(&dict, ffm->params.muxer_settings, "=",
+					" ", 0))) {
+		fprintf(stderr, "Failed to parse muxer settings: %s\n%s\n",
+			av_err2str(ret), ffm->params.muxer_settings);
+
+		av_dict_free(&dict);
+	}
+
+	if ((format->flags & AVFMT_NOFILE) != 0 || ffmpeg_mux_is_network(ffm))
+		remove_io_options(&dict);
+
 	if ((format->flags & AVFMT_NOFILE) == 0) {
 		if (!ffmpeg_mux_is_network(ffm)) {
 			// If not outputting to a network, write to a circlebuf
@@ -942,6 +1168,16 @@ static inline int open_output_file(struct ffmpeg_mux *ffm)
 				fprintf(stderr, "Couldn't open '%s', %s\n",
 					ffm->params.printable_file.array,
 					strerror(errno));
+				av_dict_free(&dict);
+				return FFM_ERROR;
+			}
+
+			if (!init_io_chunks(ffm, &dict)) {
+				fprintf(stderr,
+					"Error allocating memory for output\n");
+				free_io_chunks(ffm);
+				fclose(ffm->io.output_file);
+				av_dict_free(&dict);
 				return FFM_ERROR;
 			}
 
@@ -957,6 +1193,12 @@ static inline int open_output_file(struct ffmpeg_mux *ffm)
 			os_event_init(&ffm->io.new_data_available_event,
 				      OS_EVENT_TYPE_AUTO);
 
+			os_sem_init(&ffm->io.chunks_free,
+				    (int)ffm->io.queue_depth);
+			os_sem_init(&ffm->io.chunks_ready, 0);
+
+			pthread_create(&ffm->io.write_thread, NULL,
+				       ffmpeg_mux_write_thread, ffm);
 			pthread_create(&ffm->io.io_thread, NULL,
 				       ffmpeg_mux_io_thread, ffm);
 
@@ -976,20 +1218,12 @@ static inline int open_output_file(struct ffmpeg_mux *ffm)
 				fprintf(stderr, "Couldn't open '%s', %s\n",
 					ffm->params.printable_file.array,
 					av_err2str(ret));
+				av_dict_free(&dict);
 				return FFM_ERROR;
 			}
 		}
 	}
 
-	AVDictionary *dict = NULL;
-	if ((ret = av_dict_parse_string(&dict, ffm->params.muxer_settings, "=",
-					" ", 0))) {
-		fprintf(stderr, "Failed to parse muxer settings: %s\n%s\n",
-			av_err2str(ret), ffm->params.muxer_settings);
-
-		av_dict_free(&dict);
-	}
-
 	if (av_dict_count(dict) > 0) {
 		printf("Using muxer settings:");
 
@@ -48,12 +48,17 @@ struct ffmpeg_source {
 	bool is_local_file;
 	bool is_hw_decoding;
 	bool full_decode;
+	bool compressed_cache;
 	bool is_clear_on_media_end;
 	bool restart_on_activate;
 	bool close_when_inactive;
 	bool seekable;
 	bool is_stinger;
 
+	/* guards s->media being created and destroyed against readers on
+	 * other threads */
+	pthread_mutex_t media_mutex;
+
 	pthread_t reconnect_thread;
 	pthread_mutex_t reconnect_mutex;
 	bool reconnect_thread_valid;
@@ -102,6 +107,8 @@ static bool is_local_file_modified(obs_properties_t *props,
 	obs_property_t *looping = obs_properties_get(props, "looping");
 	obs_property_t *buffering = obs_properties_get(props, "buffering_mb");
 	obs_property_t *seekable = obs_properties_get(props, "seekable");
+	obs_property_t *compressed_cache =
+		obs_properties_get(props, "compressed_cache");
 	obs_property_t *speed = obs_properties_get(props, "speed_percent");
 	obs_property_t *reconnect_delay_sec =
 		obs_properties_get(props, "reconnect_delay_sec");
@@ -112,6 +119,7 @@ static bool is_local_file_modified(obs_properties_t *props,
 	obs_property_set_visible(looping, enabled);
 	obs_property_set_visible(speed, enabled);
 	obs_property_set_visible(seekable, !enabled);
+	obs_property_set_visible(compressed_cache, enabled);
 	obs_property_set_visible(reconnect_delay_sec, !enabled);
 
 	return true;
@@ -212,6 +220,11 @@ static obs_properties_t *ffmpeg_source_getproperties(void *data)
 	obs_property_set_long_description(
 		prop, obs_module_text("CloseFileWhenInactive.ToolTip"));
 
+	prop = obs_properties_add_bool(props, "compressed_cache",
+				       obs_module_text("CompressedCache"));
+	obs_property_set_long_description(
+		prop, obs_module_text("CompressedCache.ToolTip"));
+
 	prop = obs_properties_add_int_slider(props, "speed_percent",
 					     obs_module_text("SpeedPercentage"),
 					     1, 200, 1);
@@ -257,6 +270,7 @@ static void dump_source_info(struct ffmpeg_source *s, const char *input,
 		"\trestart_on_activate:     %s\n"
 		"\tclose_when_inactive:     %s\n"
 		"\tfull_decode:             %s\n"
+		"\tcompressed_cache:        %s\n"
 		"\tffmpeg_options:          %s",
 		input ? input : "(null)",
 		input_format ? input_format : "(null)", s->speed_percent,
@@ -265,7 +279,8 @@ static void dump_source_info(struct ffmpeg_source *s, const char *input,
 		s->is_clear_on_media_end ? "yes" : "no",
 		s->restart_on_activate ? "yes" : "no",
 		s->close_when_inactive ? "yes" : "no",
-		s->full_decode ? "yes" : "no", s->ffmpeg_options);
+		s->full_decode ? "yes" : "no",
+		s->compressed_cache ? "yes" : "no", s->ffmpeg_options);
 }
 
 static void get_frame(void *opaque, struct obs_source_frame *f)
@@ -319,6 +334,10 @@ static void media_stopped(void *opaque)
 static void ffmpeg_source_open(struct ffmpeg_source *s)
 {
 	if (s->input && *s->input) {
+		char *index_dir = s->is_local_file
+					  ? obs_module_config_path("seek-index")
+					  : NULL;
+
 		struct mp_media_info info = {
 			.opaque = s,
 			.v_cb = get_frame,
@@ -338,12 +357,34 @@ static void ffmpeg_source_open(struct ffmpeg_source *s)
 			.reconnecting = s->reconnecting,
 			.request_preload = s->is_stinger,
 			.full_decode = s->full_decode,
+			.compressed_cache = s->compressed_cache,
+			.index_cache_dir = index_dir,
 		};
 
-		s->media = media_playback_create(&info);
+		media_playback_t *media = media_playback_create(&info);
+		bfree(index_dir);
+
+		pthread_mutex_lock(&s->media_mutex);
+		s->media = media;
+		pthread_mutex_unlock(&s->media_mutex);
 	}
 }
 
+/* destroyed outside of the lock, the media threads being joined can call
+ * back into the source */
+static void ffmpeg_source_close(struct ffmpeg_source *s)
+{
+	media_playback_t *media;
+
+	pthread_mutex_lock(&s->media_mutex);
+	media = s->media;
+	s->media = NULL;
+	pthread_mutex_unlock(&s->media_mutex);
+
+	if (media)
+		media_playback_destroy(media);
+}
+
 static void ffmpeg_source_start(struct ffmpeg_source *s)
 {
 	if (!s->media)
@@ -387,11 +428,7 @@ static void ffmpeg_source_tick(void *data, float seconds)
 
 	struct ffmpeg_source *s = data;
 	if (s->destroy_media) {
-		if (s->media) {
-			media_playback_destroy(s->media);
-			s->media = NULL;
-		}
-
+		ffmpeg_source_close(s);
 		s->destroy_media = false;
 
 		if (!s->is_local_file) {
@@ -472,6 +509,7 @@ static void ffmpeg_source_update(void *data, obs_data_t *settings)
 	s->input_format = input_format ? bstrdup(input_format) : NULL;
 	s->is_hw_decoding = obs_data_get_bool(settings, "hw_decode");
 	s->full_decode = obs_data_get_bool(settings, "full_decode");
+	s->compressed_cache = obs_data_get_bool(settings, "compressed_cache");
 	s->is_clear_on_media_end =
 		obs_data_get_bool(settings, "clear_on_media_end");
 	s->restart_on_activate =
@@ -491,10 +529,7 @@ static void ffmpeg_source_update(void *data, obs_data_t *settings)
 	if (s->speed_percent < 1 || s->speed_percent > 200)
 		s->speed_percent = 100;
 
-	if (s->media) {
-		media_playback_destroy(s->media);
-		s->media = NULL;
-	}
+	ffmpeg_source_close(s);
 
 	bool active = obs_source_active(s->source);
 	if (!s->close_when_inactive || active)
@@ -557,6 +592,22 @@ static void get_nb_frames(void *data, calldata_t *cd)
 	calldata_set_int(cd, "num_frames", frames);
 }
 
+static void get_decode_stats(void *data, calldata_t *cd)
+{
+	struct ffmpeg_source *s = data;
+	struct media_playback_stats stats;
+
+	pthread_mutex_lock(&s->media_mutex);
+	media_playback_get_stats(s->media, &stats);
+	pthread_mutex_unlock(&s->media_mutex);
+
+	calldata_set_int(cd, "video_frames_queued",
+			 (long long)stats.video_frames_queued);
+	calldata_set_int(cd, "audio_frames_queued",
+			 (long long)stats.audio_frames_queued);
+	calldata_set_int(cd, "packets_queued", (long long)stats.packets_queued);
+}
+
 static bool ffmpeg_source_play_hotkey(void *data, obs_hotkey_pair_id id,
 				      obs_hotkey_t *hotkey, bool pressed)
 {
@@ -629,6 +680,14 @@ static void *ffmpeg_source_create(obs_data_t *settings, obs_source_t *source)
 		return NULL;
 	}
 
+	if (pthread_mutex_init(&s->media_mutex, NULL)) {
+		FF_BLOG(LOG_ERROR, "Failed to initialize media mutex");
+		pthread_mutex_destroy(&s->reconnect_mutex);
+		os_event_destroy(s->reconnect_stop_event);
+		bfree(s);
+		return NULL;
+	}
+
 	s->hotkey = obs_hotkey_register_source(source, "MediaSource.Restart",
 					       obs_module_text("RestartMedia"),
 					       restart_hotkey, s);
@@ -651,6 +710,10 @@ static void *ffmpeg_source_create(obs_data_t *settings, obs_source_t *source)
 			 get_duration, s);
 	proc_handler_add(ph, "void get_nb_frames(out int num_frames)",
 			 get_nb_frames, s);
+	proc_handler_add(ph,
+			 "void get_decode_stats(out int video_frames_queued, "
+			 "out int audio_frames_queued, out int packets_queued)",
+			 get_decode_stats, s);
 
 	ffmpeg_source_update(s, settings);
 	return s;
@@ -664,9 +727,9 @@ static void ffmpeg_source_destroy(void *data)
 
 	if (s->hotkey)
 		obs_hotkey_unregister(s->hotkey);
-	if (s->media)
-		media_playback_destroy(s->media);
+	ffmpeg_source_close(s);
 
+	pthread_mutex_destroy(&s->media_mutex);
 	pthread_mutex_destroy(&s->reconnect_mutex);
 	os_event_destroy(s->reconnect_stop_event);
 	bfree(s->input);
@@ -811,7 +874,8 @@ struct obs_source_info ffmpeg_source = {
 	.type = OBS_SOURCE_TYPE_INPUT,
 	.output_flags = OBS_SOURCE_ASYNC_VIDEO | OBS_SOURCE_AUDIO |
 			OBS_SOURCE_DO_NOT_DUPLICATE |
-			OBS_SOURCE_CONTROLLABLE_MEDIA,
+			OBS_SOURCE_CONTROLLABLE_MEDIA |
+			OBS_SOURCE_PARALLEL_TICK,
 	.get_name = ffmpeg_source_getname,
 	.create = ffmpeg_source_create,
 	.destroy = ffmpeg_source_destroy,
@@ -4,6 +4,7 @@
 #include <libavutil/avutil.h>
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
+#include <media-playback/media-playback.h>
 
 #ifdef _WIN32
 #include <dxgi.h>
@@ -471,6 +472,8 @@ bool obs_module_load(void)
 
 void obs_module_unload(void)
 {
+	media_playback_free_unused_cache();
+
 #if ENABLE_FFMPEG_LOGGING
 	obs_ffmpeg_unload_logging();
 #endif
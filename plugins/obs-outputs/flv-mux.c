@@ -296,30 +296,35 @@ static void flv_audio(struct serializer *s, int32_t dts_offset,
 	s_wb32(s, (uint32_t)serializer_get_pos(s) - 1);
 }
 
-void flv_packet_mux(struct encoder_packet *packet, int32_t dts_offset,
-		    uint8_t **output, size_t *size, bool is_header)
+/* enough for the tag header, extended video header and tag size, as well as
+ * the AMF wrapping of additional audio packets */
+#define FLV_TAG_OVERHEAD 128
+
+static struct serializer *flv_mux_begin(struct flv_mux_context *mux,
+					size_t packet_size)
 {
-	struct array_output_data data;
-	struct serializer s;
+	array_output_serializer_reset(&mux->data);
+	da_reserve(mux->data.bytes, packet_size + FLV_TAG_OVERHEAD);
+	return &mux->s;
+}
 
-	array_output_serializer_init(&s, &data);
+void flv_packet_mux(struct encoder_packet *packet, int32_t dts_offset,
+		    struct flv_mux_context *mux, bool is_header)
+{
+	struct serializer *s = flv_mux_begin(mux, packet->size);
 
 	if (packet->type == OBS_ENCODER_VIDEO)
-		flv_video(&s, dts_offset, packet, is_header);
+		flv_video(s, dts_offset, packet, is_header);
 	else
-		flv_audio(&s, dts_offset, packet, is_header);
-
-	*output = data.bytes.array;
-	*size = data.bytes.num;
+		flv_audio(s, dts_offset, packet, is_header);
 }
 
 // Y2023 spec
-void flv_packet_ex(struct encoder_packet *packet, enum video_id_t codec_id,
-		   int32_t dts_offset, uint8_t **output, size_t *size, int type)
+static void flv_packet_ex(struct encoder_packet *packet,
+			  enum video_id_t codec_id, int32_t dts_offset,
+			  struct flv_mux_context *mux, int type)
 {
-	struct array_output_data data;
-	struct serializer s;
-	array_output_serializer_init(&s, &data);
+	struct serializer *s = flv_mux_begin(mux, packet->size);
 
 	assert(packet->type == OBS_ENCODER_VIDEO);
 
@@ -333,41 +338,37 @@ void flv_packet_ex(struct encoder_packet *packet, enum video_id_t codec_id,
 		header_metadata_size = 8;
 	}
 #endif
-	s_w8(&s, RTMP_PACKET_TYPE_VIDEO);
-	s_wb24(&s, (uint32_t)packet->size + header_metadata_size);
-	s_wtimestamp(&s, time_ms);
-	s_wb24(&s, 0); // always 0
+	s_w8(s, RTMP_PACKET_TYPE_VIDEO);
+	s_wb24(s, (uint32_t)packet->size + header_metadata_size);
+	s_wtimestamp(s, time_ms);
+	s_wb24(s, 0); // always 0
 
 	// packet ext header
-	s_w8(&s, FRAME_HEADER_EX | type | (packet->keyframe ? FT_KEY : 0));
-	s_w4cc(&s, codec_id);
+	s_w8(s, FRAME_HEADER_EX | type | (packet->keyframe ? FT_KEY : 0));
+	s_w4cc(s, codec_id);
 
 #ifdef ENABLE_HEVC
 	// hevc composition time offset
 	if (codec_id == CODEC_HEVC && type == PACKETTYPE_FRAMES) {
-		s_wb24(&s, get_ms_time(packet, packet->pts - packet->dts));
+		s_wb24(s, get_ms_time(packet, packet->pts - packet->dts));
 	}
 #endif
 
 	// packet data
-	s_write(&s, packet->data, packet->size);
+	s_write(s, packet->data, packet->size);
 
 	// packet tail
-	s_wb32(&s, (uint32_t)serializer_get_pos(&s) - 1);
-
-	*output = data.bytes.array;
-	*size = data.bytes.num;
+	s_wb32(s, (uint32_t)serializer_get_pos(s) - 1);
 }
 
 void flv_packet_start(struct encoder_packet *packet, enum video_id_t codec,
-		      int32_t dts_offset, uint8_t **output, size_t *size)
+		      int32_t dts_offset, struct flv_mux_context *mux)
 {
-	flv_packet_ex(packet, codec, dts_offset, output, size,
-		      PACKETTYPE_SEQ_START);
+	flv_packet_ex(packet, codec, dts_offset, mux, PACKETTYPE_SEQ_START);
 }
 
 void flv_packet_frames(struct encoder_packet *packet, enum video_id_t codec,
-		       int32_t dts_offset, uint8_t **output, size_t *size)
+		       int32_t dts_offset, struct flv_mux_context *mux)
 {
 	int packet_type = PACKETTYPE_FRAMES;
 #ifdef ENABLE_HEVC
@@ -376,14 +377,13 @@ void flv_packet_frames(struct encoder_packet *packet, enum video_id_t codec,
 	if (codec == CODEC_HEVC && packet->dts == packet->pts)
 		packet_type = PACKETTYPE_FRAMESX;
 #endif
-	flv_packet_ex(packet, codec, dts_offset, output, size, packet_type);
+	flv_packet_ex(packet, codec, dts_offset, mux, packet_type);
 }
 
 void flv_packet_end(struct encoder_packet *packet, enum video_id_t codec,
-		    int32_t dts_offset, uint8_t **output, size_t *size)
+		    int32_t dts_offset, struct flv_mux_context *mux)
 {
-	flv_packet_ex(packet, codec, dts_offset, output, size,
-		      PACKETTYPE_SEQ_END);
+	flv_packet_ex(packet, codec, dts_offset, mux, PACKETTYPE_SEQ_END);
 }
 
 void flv_packet_metadata(enum video_id_t codec_id, uint8_t **output,
@@ -630,56 +630,50 @@ static inline void s_u29b_value(struct serializer *s, uint32_t val)
 	s_u29(s, 1 | ((val & 0xFFFFFFF) << 1));
 }
 
-static void flv_build_additional_audio(uint8_t **data, size_t *size,
-				       struct encoder_packet *packet,
-				       bool is_header, size_t index)
+static void flv_additional_audio_body(struct serializer *s,
+				      struct encoder_packet *packet,
+				      bool is_header, size_t index)
 {
 	UNUSED_PARAMETER(index);
-	struct array_output_data out;
-	struct serializer s;
 
-	array_output_serializer_init(&s, &out);
+	s_w8(s, AMF_STRING);
+	s_amf_conststring(s, "additionalMedia");
 
-	s_w8(&s, AMF_STRING);
-	s_amf_conststring(&s, "additionalMedia");
-
-	s_w8(&s, AMF_OBJECT);
+	s_w8(s, AMF_OBJECT);
 	{
-		s_amf_conststring(&s, "id");
+		s_amf_conststring(s, "id");
 
-		s_w8(&s, AMF_STRING);
-		s_amf_conststring(&s, "stream0");
+		s_w8(s, AMF_STRING);
+		s_amf_conststring(s, "stream0");
 
 		/* ----- */
 
-		s_amf_conststring(&s, "media");
+		s_amf_conststring(s, "media");
 
-		s_w8(&s, AMF_AVMPLUS);
-		s_w8(&s, AMF3_BYTE_ARRAY);
-		s_u29b_value(&s, (uint32_t)packet->size + 2);
-		s_w8(&s, 0xaf);
-		s_w8(&s, is_header ? 0 : 1);
-		s_write(&s, packet->data, packet->size);
+		s_w8(s, AMF_AVMPLUS);
+		s_w8(s, AMF3_BYTE_ARRAY);
+		s_u29b_value(s, (uint32_t)packet->size + 2);
+		s_w8(s, 0xaf);
+		s_w8(s, is_header ? 0 : 1);
+		s_write(s, packet->data, packet->size);
 	}
-	s_wb24(&s, AMF_OBJECT_END);
-
-	*data = out.bytes.array;
-	*size = out.bytes.num;
+	s_wb24(s, AMF_OBJECT_END);
 }
 
-static void flv_additional_audio(struct serializer *s, int32_t dts_offset,
+static void flv_additional_audio(struct flv_mux_context *mux,
+				 int32_t dts_offset,
 				 struct encoder_packet *packet, bool is_header,
 				 size_t index)
 {
+	struct serializer *s = &mux->s;
 	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
-	uint8_t *data;
-	size_t size;
+	size_t size_pos;
+	size_t data_pos;
+	uint32_t size;
 
 	if (!packet->data || !packet->size)
 		return;
 
-	flv_build_additional_audio(&data, &size, packet, is_header, index);
-
 	s_w8(s, RTMP_PACKET_TYPE_INFO); //18
 
 #ifdef DEBUG_TIMESTAMPS
@@ -691,33 +685,35 @@ static void flv_additional_audio(struct serializer *s, int32_t dts_offset,
 	last_time = time_ms;
 #endif
 
-	s_wb24(s, (uint32_t)size);
+	/* the data size is written in place once the body is serialized */
+	size_pos = (size_t)serializer_get_pos(s);
+	s_wb24(s, 0);
 	s_wb24(s, (uint32_t)time_ms);
 	s_w8(s, (time_ms >> 24) & 0x7F);
 	s_wb24(s, 0);
 
-	serialize(s, data, size);
-	bfree(data);
+	data_pos = (size_t)serializer_get_pos(s);
+	flv_additional_audio_body(s, packet, is_header, index);
+	size = (uint32_t)(serializer_get_pos(s) - data_pos);
+
+	uint8_t *size_data = mux->data.bytes.array + size_pos;
+	size_data[0] = (uint8_t)(size >> 16);
+	size_data[1] = (uint8_t)(size >> 8);
+	size_data[2] = (uint8_t)size;
 
 	s_wb32(s, (uint32_t)serializer_get_pos(s) - 1);
 }
 
 void flv_additional_packet_mux(struct encoder_packet *packet,
-			       int32_t dts_offset, uint8_t **data, size_t *size,
+			       int32_t dts_offset, struct flv_mux_context *mux,
 			       bool is_header, size_t index)
 {
-	struct array_output_data out;
-	struct serializer s;
-
-	array_output_serializer_init(&s, &out);
+	flv_mux_begin(mux, packet->size);
 
 	if (packet->type == OBS_ENCODER_VIDEO) {
 		//currently unsupported
 		bcrash("who said you could output an additional video packet?");
 	} else {
-		flv_additional_audio(&s, dts_offset, packet, is_header, index);
+		flv_additional_audio(mux, dts_offset, packet, is_header, index);
 	}
-
-	*data = out.bytes.array;
-	*size = out.bytes.num;
 }
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <obs.h>
+#include <util/array-serializer.h>
 
 #define MILLISECOND_DEN 1000
 
@@ -47,6 +48,34 @@ static int32_t get_ms_time(struct encoder_packet *packet, int64_t val)
 	return (int32_t)(val * MILLISECOND_DEN / packet->timebase_den);
 }
 
+/* Per-stream muxing context.  The output buffer is kept between packets, so
+ * once it has grown to the stream's largest packet, muxing no longer
+ * allocates.  Muxed data is only valid until the next mux call. */
+struct flv_mux_context {
+	struct array_output_data data;
+	struct serializer s;
+};
+
+static inline void flv_mux_context_init(struct flv_mux_context *mux)
+{
+	array_output_serializer_init(&mux->s, &mux->data);
+}
+
+static inline void flv_mux_context_free(struct flv_mux_context *mux)
+{
+	array_output_serializer_free(&mux->data);
+}
+
+static inline uint8_t *flv_mux_data(struct flv_mux_context *mux)
+{
+	return mux->data.bytes.array;
+}
+
+static inline size_t flv_mux_size(struct flv_mux_context *mux)
+{
+	return mux->data.bytes.num;
+}
+
 extern void write_file_info(FILE *file, int64_t duration_ms, int64_t size);
 
 extern void flv_meta_data(obs_output_t *context, uint8_t **output, size_t *size,
@@ -54,20 +83,20 @@ extern void flv_meta_data(obs_output_t *context, uint8_t **output, size_t *size,
 extern void flv_additional_meta_data(obs_output_t *context, uint8_t **output,
 				     size_t *size);
 extern void flv_packet_mux(struct encoder_packet *packet, int32_t dts_offset,
-			   uint8_t **output, size_t *size, bool is_header);
+			   struct flv_mux_context *mux, bool is_header);
 extern void flv_additional_packet_mux(struct encoder_packet *packet,
-				      int32_t dts_offset, uint8_t **output,
-				      size_t *size, bool is_header,
-				      size_t index);
+				      int32_t dts_offset,
+				      struct flv_mux_context *mux,
+				      bool is_header, size_t index);
 // Y2023 spec
 extern void flv_packet_start(struct encoder_packet *packet,
 			     enum video_id_t codec, int32_t dts_offset,
-			     uint8_t **output, size_t *size);
+			     struct flv_mux_context *mux);
 extern void flv_packet_frames(struct encoder_packet *packet,
 			      enum video_id_t codec, int32_t dts_offset,
-			      uint8_t **output, size_t *size);
+			      struct flv_mux_context *mux);
 extern void flv_packet_end(struct encoder_packet *packet, enum video_id_t codec,
-			   int32_t dts_offset, uint8_t **output, size_t *size);
+			   int32_t dts_offset, struct flv_mux_context *mux);
 extern void flv_packet_metadata(enum video_id_t codec, uint8_t **output,
 				size_t *size, int bits_per_raw_sample,
 				uint8_t color_primaries, int color_trc,
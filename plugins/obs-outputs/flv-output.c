@@ -45,6 +45,8 @@ struct flv_output {
 
 	bool got_first_video;
 	int32_t start_dts_offset;
+
+	struct flv_mux_context mux;
 };
 
 static inline bool stopping(struct flv_output *stream)
@@ -70,6 +72,7 @@ static void flv_output_destroy(void *data)
 	struct flv_output *stream = data;
 
 	pthread_mutex_destroy(&stream->mutex);
+	flv_mux_context_free(&stream->mux);
 	dstr_free(&stream->path);
 	bfree(stream);
 }
@@ -79,6 +82,7 @@ static void *flv_output_create(obs_data_t *settings, obs_output_t *output)
 	struct flv_output *stream = bzalloc(sizeof(struct flv_output));
 	stream->output = output;
 	pthread_mutex_init(&stream->mutex, NULL);
+	flv_mux_context_init(&stream->mux);
 
 	UNUSED_PARAMETER(settings);
 	return stream;
@@ -87,16 +91,14 @@ static void *flv_output_create(obs_data_t *settings, obs_output_t *output)
 static int write_packet(struct flv_output *stream,
 			struct encoder_packet *packet, bool is_header)
 {
-	uint8_t *data;
-	size_t size;
 	int ret = 0;
 
 	stream->last_packet_ts = get_ms_time(packet, packet->dts);
 
-	flv_packet_mux(packet, is_header ? 0 : stream->start_dts_offset, &data,
-		       &size, is_header);
-	fwrite(data, 1, size, stream->file);
-	bfree(data);
+	flv_packet_mux(packet, is_header ? 0 : stream->start_dts_offset,
+		       &stream->mux, is_header);
+	fwrite(flv_mux_data(&stream->mux), 1, flv_mux_size(&stream->mux),
+	       stream->file);
 
 	return ret;
 }
@@ -147,6 +147,7 @@ static void rtmp_stream_destroy(void *data)
 	os_event_destroy(stream->socket_available_event);
 	os_event_destroy(stream->send_thread_signaled_exit);
 	pthread_mutex_destroy(&stream->write_buf_mutex);
+	flv_mux_context_free(&stream->mux);
 
 	if (stream->write_buf)
 		bfree(stream->write_buf);
@@ -158,6 +159,7 @@ static void *rtmp_stream_create(obs_data_t *settings, obs_output_t *output)
 	struct rtmp_stream *stream = bzalloc(sizeof(struct rtmp_stream));
 	stream->output = output;
 	pthread_mutex_init_value(&stream->packets_mutex);
+	flv_mux_context_init(&stream->mux);
 
 	RTMP_LogSetCallback(log_rtmp);
 	RTMP_LogSetLevel(RTMP_LOGWARNING);
@@ -445,7 +447,6 @@ static int send_packet(struct rtmp_stream *stream,
 		       struct encoder_packet *packet, bool is_header,
 		       size_t idx)
 {
-	uint8_t *data;
 	size_t size;
 	int ret = 0;
 
@@ -455,19 +456,21 @@ static int send_packet(struct rtmp_stream *stream,
 
 	if (idx > 0) {
 		flv_additional_packet_mux(
-			packet, is_header ? 0 : stream->start_dts_offset, &data,
-			&size, is_header, idx);
+			packet, is_header ? 0 : stream->start_dts_offset,
+			&stream->mux, is_header, idx);
 	} else {
 		flv_packet_mux(packet, is_header ? 0 : stream->start_dts_offset,
-			       &data, &size, is_header);
+			       &stream->mux, is_header);
 	}
 
+	size = flv_mux_size(&stream->mux);
+
 #ifdef TEST_FRAMEDROPS
 	droptest_cap_data_rate(stream, size);
 #endif
 
-	ret = RTMP_Write(&stream->rtmp, (char *)data, (int)size, 0);
-	bfree(data);
+	ret = RTMP_Write(&stream->rtmp, (char *)flv_mux_data(&stream->mux),
+			 (int)size, 0);
 
 	if (is_header)
 		bfree(packet->data);
@@ -482,8 +485,7 @@ static int send_packet_ex(struct rtmp_stream *stream,
 			  struct encoder_packet *packet, bool is_header,
 			  bool is_footer)
 {
-	uint8_t *data;
-	size_t size = 0;
+	size_t size;
 	int ret = 0;
 
 	if (handle_socket_read(stream))
@@ -491,21 +493,23 @@ static int send_packet_ex(struct rtmp_stream *stream,
 
 	if (is_header) {
 		flv_packet_start(packet, stream->video_codec,
-				 stream->start_dts_offset, &data, &size);
+				 stream->start_dts_offset, &stream->mux);
 	} else if (is_footer) {
 		flv_packet_end(packet, stream->video_codec,
-			       stream->start_dts_offset, &data, &size);
+			       stream->start_dts_offset, &stream->mux);
 	} else {
 		flv_packet_frames(packet, stream->video_codec,
-				  stream->start_dts_offset, &data, &size);
+				  stream->start_dts_offset, &stream->mux);
 	}
 
+	size = flv_mux_size(&stream->mux);
+
 #ifdef TEST_FRAMEDROPS
 	droptest_cap_data_rate(stream, size);
 #endif
 
-	ret = RTMP_Write(&stream->rtmp, (char *)data, (int)size, 0);
-	bfree(data);
+	ret = RTMP_Write(&stream->rtmp, (char *)flv_mux_data(&stream->mux),
+			 (int)size, 0);
 
 	if (is_header || is_footer) // manually created packets
 		bfree(packet->data);
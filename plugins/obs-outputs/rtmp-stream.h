@@ -114,6 +114,7 @@ struct rtmp_stream {
 	bool dbr_enabled;
 
 	enum video_id_t video_codec;
+	struct flv_mux_context mux;
 
 	RTMP rtmp;
 
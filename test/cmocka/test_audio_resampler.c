@@ -0,0 +1,209 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <math.h>
+
+#include <util/platform.h>
+#include <media-io/audio-resampler.h>
+
+#define BLOCK_FRAMES 480
+#define NUM_BLOCKS 200
+#define SKIP_FRAMES 200
+#define TONE_FREQ 1000.0
+#define TONE_AMP 0.5
+#define TONE_PI 3.14159265358979323846
+
+static const uint32_t rates[][2] = {
+	{44100, 48000}, {48000, 44100}, {96000, 48000},
+	{32000, 48000}, {22050, 48000}, {48000, 16000},
+};
+
+#define NUM_RATES (sizeof(rates) / sizeof(rates[0]))
+
+static inline double tone(uint64_t frame, uint32_t rate)
+{
+	return TONE_AMP * sin(2.0 * TONE_PI * TONE_FREQ * (double)frame / rate);
+}
+
+/* resamples a sine tone and returns the signal to noise ratio in dB of the
+ * output against the ideal tone at the output rate, also checking that the
+ * returned timestamp offsets line up with the output */
+static double resample_tone(uint32_t in_rate, uint32_t out_rate,
+			    enum audio_resampler_quality quality)
+{
+	struct resample_info src = {in_rate, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_STEREO};
+	struct resample_info dst = {out_rate, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_STEREO};
+	audio_resampler_t *rs = audio_resampler_create2(&dst, &src, quality);
+	float left[BLOCK_FRAMES];
+	float right[BLOCK_FRAMES];
+	const uint8_t *input[] = {(uint8_t *)left, (uint8_t *)right};
+	uint64_t in_pos = 0;
+	uint64_t out_pos = 0;
+	double signal = 0.0;
+	double noise = 0.0;
+
+	assert_non_null(rs);
+
+	for (int block = 0; block < NUM_BLOCKS; block++) {
+		uint8_t *output[MAX_AV_PLANES] = {0};
+		uint32_t frames = 0;
+		uint64_t offset = 0;
+		int64_t in_ts;
+		int64_t out_ts;
+
+		for (size_t i = 0; i < BLOCK_FRAMES; i++)
+			left[i] = right[i] = (float)tone(in_pos + i, in_rate);
+
+		assert_true(audio_resampler_resample(rs, output, &frames,
+						     &offset, input,
+						     BLOCK_FRAMES));
+
+		in_ts = (int64_t)audio_frames_to_ns(in_rate, in_pos);
+		out_ts = (int64_t)audio_frames_to_ns(out_rate, out_pos);
+		assert_true(llabs(in_ts - (int64_t)offset - out_ts) < 1000);
+
+		for (uint32_t i = 0; i < frames; i++, out_pos++) {
+			double expected = tone(out_pos, out_rate);
+			double diff = ((float *)output[1])[i] - expected;
+
+			if (out_pos < SKIP_FRAMES)
+				continue;
+
+			signal += expected * expected;
+			noise += diff * diff;
+		}
+
+		in_pos += BLOCK_FRAMES;
+	}
+
+	audio_resampler_destroy(rs);
+	return 10.0 * log10(signal / noise);
+}
+
+static void resample_accuracy_test(void **state)
+{
+	static const double min_snr[] = {55.0, 80.0, 100.0};
+
+	UNUSED_PARAMETER(state);
+
+	for (int q = AUDIO_RESAMPLER_QUALITY_LOW;
+	     q <= AUDIO_RESAMPLER_QUALITY_HIGH; q++) {
+		for (size_t i = 0; i < NUM_RATES; i++) {
+			double snr = resample_tone(rates[i][0], rates[i][1],
+						   q);
+			print_message("quality %d, %u -> %u: %.1f dB\n", q,
+				      rates[i][0], rates[i][1], snr);
+			assert_true(snr >= min_snr[q]);
+		}
+	}
+}
+
+static void convert_format_test(void **state)
+{
+	struct resample_info src = {48000, AUDIO_FORMAT_16BIT,
+				    SPEAKERS_STEREO};
+	struct resample_info dst = {48000, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_STEREO};
+	int16_t samples[] = {0, -32768, 16384, 32767, -16384, 1};
+	const uint8_t *input[] = {(uint8_t *)samples};
+	uint8_t *output[MAX_AV_PLANES] = {0};
+	uint32_t frames = 0;
+	uint64_t offset = 1;
+	audio_resampler_t *rs;
+
+	UNUSED_PARAMETER(state);
+
+	rs = audio_resampler_create(&dst, &src);
+	assert_non_null(rs);
+	assert_true(audio_resampler_resample(rs, output, &frames, &offset,
+					     input, 3));
+	assert_int_equal(frames, 3);
+	assert_int_equal(offset, 0);
+
+	for (uint32_t i = 0; i < frames; i++) {
+		float left = ((float *)output[0])[i];
+		float right = ((float *)output[1])[i];
+
+		assert_true(left == samples[i * 2] / 32768.0f);
+		assert_true(right == samples[i * 2 + 1] / 32768.0f);
+	}
+
+	audio_resampler_destroy(rs);
+}
+
+#define THROUGHPUT_FRAMES 1024
+#define THROUGHPUT_CALLS 2000
+
+/* times resampling in blocks, then checks that each block produced as many
+ * frames as the timestamp offset of the next one expects */
+static void resample_throughput_test(void **state)
+{
+	struct resample_info src = {44100, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_STEREO};
+	struct resample_info dst = {48000, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_STEREO};
+	static float data[2][THROUGHPUT_FRAMES];
+	static uint32_t frames[THROUGHPUT_CALLS + 1];
+	static uint64_t offsets[THROUGHPUT_CALLS + 1];
+	const uint8_t *input[] = {(uint8_t *)data[0], (uint8_t *)data[1]};
+
+	UNUSED_PARAMETER(state);
+
+	for (int q = AUDIO_RESAMPLER_QUALITY_LOW;
+	     q <= AUDIO_RESAMPLER_QUALITY_HIGH; q++) {
+		audio_resampler_t *rs = audio_resampler_create2(&dst, &src, q);
+		uint64_t out_pos = 0;
+		uint64_t start;
+		double seconds;
+		bool success = true;
+
+		assert_non_null(rs);
+
+		start = os_gettime_ns();
+		for (int i = 0; i <= THROUGHPUT_CALLS; i++) {
+			uint8_t *output[MAX_AV_PLANES];
+
+			success &= audio_resampler_resample(
+				rs, output, &frames[i], &offsets[i], input,
+				THROUGHPUT_FRAMES);
+		}
+		seconds = (double)(os_gettime_ns() - start) / 1000000000.0;
+
+		assert_true(success);
+
+		for (int i = 0; i <= THROUGHPUT_CALLS; i++) {
+			uint64_t in_pos = (uint64_t)i * THROUGHPUT_FRAMES;
+			int64_t in_ts;
+			int64_t out_ts;
+
+			in_ts = (int64_t)audio_frames_to_ns(44100, in_pos);
+			out_ts = (int64_t)audio_frames_to_ns(48000, out_pos);
+			assert_true(llabs(in_ts - (int64_t)offsets[i] - out_ts) <
+				    1000);
+
+			out_pos += frames[i];
+		}
+
+		print_message("quality %d, 44100 -> 48000 stereo: %.0fx "
+			      "realtime\n",
+			      q,
+			      (THROUGHPUT_CALLS + 1) * THROUGHPUT_FRAMES /
+				      44100.0 / seconds);
+
+		audio_resampler_destroy(rs);
+	}
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(resample_accuracy_test),
+		cmocka_unit_test(convert_format_test),
+		cmocka_unit_test(resample_throughput_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,130 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/platform.h>
+#include <util/cf-parser.h>
+
+#define PARSE_ITERATIONS 50
+
+static const char *effect_globs[] = {
+	OBS_SOURCE_DIR "/libobs/data/*.effect",
+	OBS_SOURCE_DIR "/plugins/*/data/*.effect",
+};
+
+#define NUM_GLOBS (sizeof(effect_globs) / sizeof(effect_globs[0]))
+
+/* checks the non-whitespace tokens after preprocessing */
+static void expect_tokens(const char *text, const char *const *expected)
+{
+	struct cf_parser parser;
+	struct cf_token *token;
+	size_t i = 0;
+
+	cf_parser_init(&parser);
+	assert_true(cf_parser_parse(&parser, text, "test"));
+
+	for (token = parser.cur_token; token->type != CFTOKEN_NONE; token++) {
+		if (token->type == CFTOKEN_SPACETAB ||
+		    token->type == CFTOKEN_NEWLINE)
+			continue;
+
+		assert_non_null(expected[i]);
+		assert_int_equal(strref_cmp(&token->str, expected[i]), 0);
+		i++;
+	}
+
+	assert_null(expected[i]);
+	assert_int_equal(parser.error_list.errors.num, 0);
+	cf_parser_free(&parser);
+}
+
+static void lex_test(void **state)
+{
+	static const char *const splices[] = {"float", "abcdef", "=", ".5f",
+					      ";", NULL};
+	static const char *const numbers[] = {"1.0e", "+", "3", "x_1", NULL};
+	static const char *const macros[] = {"(", "2", "*", "(", "y", ")",
+					     ")", "ok", NULL};
+
+	UNUSED_PARAMETER(state);
+
+	expect_tokens("float abc\\\ndef /* comment */ = .\\\n5f; // end",
+		      splices);
+	expect_tokens("1.0e+3 x_1", numbers);
+	expect_tokens("#define TWICE(a) (2 * (a))\n"
+		      "#ifdef TWICE\nTWICE(y)\n#else\nbad\n#endif\n"
+		      "#undef TWICE\n#ifndef TWICE\nok\n#endif\n",
+		      macros);
+}
+
+static void parse_effects_test(void **state)
+{
+	DARRAY(char *) files;
+	DARRAY(char *) data;
+	size_t tokens = 0;
+	uint64_t start;
+	double ms;
+
+	UNUSED_PARAMETER(state);
+
+	da_init(files);
+	da_init(data);
+
+	for (size_t i = 0; i < NUM_GLOBS; i++) {
+		os_glob_t *glob;
+
+		if (os_glob(effect_globs[i], 0, &glob) != 0)
+			continue;
+
+		for (size_t j = 0; j < glob->gl_pathc; j++) {
+			char *path = bstrdup(glob->gl_pathv[j].path);
+			char *text = os_quick_read_utf8_file(path);
+
+			assert_non_null(text);
+			da_push_back(files, &path);
+			da_push_back(data, &text);
+		}
+
+		os_globfree(glob);
+	}
+
+	assert_true(files.num > 0);
+
+	start = os_gettime_ns();
+	for (int it = 0; it < PARSE_ITERATIONS; it++) {
+		for (size_t i = 0; i < files.num; i++) {
+			struct cf_parser parser;
+
+			cf_parser_init(&parser);
+			assert_true(cf_parser_parse(&parser, data.array[i],
+						    files.array[i]));
+			assert_int_equal(parser.error_list.errors.num, 0);
+
+			tokens += parser.pp.tokens.num;
+			cf_parser_free(&parser);
+		}
+	}
+	ms = (double)(os_gettime_ns() - start) / 1000000.0 / PARSE_ITERATIONS;
+
+	print_message("%zu effect files, %zu tokens: %.3f ms per pass\n",
+		      files.num, tokens / PARSE_ITERATIONS, ms);
+
+	for (size_t i = 0; i < files.num; i++) {
+		bfree(files.array[i]);
+		bfree(data.array[i]);
+	}
+	da_free(files);
+	da_free(data);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(lex_test),
+		cmocka_unit_test(parse_effects_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,306 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/platform.h>
+#include <util/darray.h>
+#include <graphics/image-file.h>
+
+#define GIF_WIDTH 256
+#define GIF_HEIGHT 256
+#define GIF_FRAMES 60
+#define GIF_DELAY 4 /* hundredths of a second */
+#define GIF_FILE "test_image_file.gif"
+
+#define FRAME_TIME_NS (GIF_DELAY * 10000000ULL)
+#define FRAME_SIZE ((size_t)GIF_WIDTH * GIF_HEIGHT * 4)
+#define FULL_SIZE ((uint64_t)FRAME_SIZE * GIF_FRAMES)
+#define PLAY_LOOPS 3
+#define RANDOM_JUMPS 300
+
+/* textures are updated through the null graphics module */
+static graphics_t *graphics = NULL;
+
+/* every frame of the gif as decoded up front, which is what a streamed frame
+ * has to match */
+static uint8_t *reference = NULL;
+
+/* ------------------------------------------------------------------------- */
+/* writes an uncompressed gif: every pixel is a literal 9-bit code, with a    */
+/* clear code often enough that the code size never grows                    */
+
+struct bit_writer {
+	DARRAY(uint8_t) data;
+	uint32_t bits;
+	int num_bits;
+};
+
+static void write_code(struct bit_writer *bw, uint32_t code)
+{
+	bw->bits |= code << bw->num_bits;
+	bw->num_bits += 9;
+
+	while (bw->num_bits >= 8) {
+		uint8_t byte = (uint8_t)bw->bits;
+		da_push_back(bw->data, &byte);
+		bw->bits >>= 8;
+		bw->num_bits -= 8;
+	}
+}
+
+static void write_u16(FILE *f, int val)
+{
+	fputc(val & 0xFF, f);
+	fputc((val >> 8) & 0xFF, f);
+}
+
+/* frames are drawn over the previous one with transparent holes, so a frame
+ * decoded without the ones before it doesn't match its reference */
+static uint8_t get_pixel(int x, int y, int frame)
+{
+	if (((x ^ y ^ frame) & 7) == 0)
+		return 0;
+	return (uint8_t)(1 + (x + y * 3 + frame * 7) % 255);
+}
+
+static void write_gif(const char *path)
+{
+	FILE *f = os_fopen(path, "wb");
+	assert_non_null(f);
+
+	fwrite("GIF89a", 1, 6, f);
+	write_u16(f, GIF_WIDTH);
+	write_u16(f, GIF_HEIGHT);
+	fputc(0xF7, f); /* 256 entry global colour table */
+	fputc(0, f);
+	fputc(0, f);
+
+	for (int i = 0; i < 256; i++) {
+		fputc(i, f);
+		fputc(255 - i, f);
+		fputc((i * 5) & 0xFF, f);
+	}
+
+	fwrite("\x21\xFF\x0BNETSCAPE2.0\x03\x01\x00\x00\x00", 1, 19, f);
+
+	for (int frame = 0; frame < GIF_FRAMES; frame++) {
+		struct bit_writer bw = {0};
+		size_t literals = 0;
+
+		/* graphic control: keep previous, transparent index 0 */
+		fwrite("\x21\xF9\x04\x05", 1, 4, f);
+		write_u16(f, GIF_DELAY);
+		fputc(0, f);
+		fputc(0, f);
+
+		fputc(0x2C, f);
+		write_u16(f, 0);
+		write_u16(f, 0);
+		write_u16(f, GIF_WIDTH);
+		write_u16(f, GIF_HEIGHT);
+		fputc(0, f);
+		fputc(8, f);
+
+		write_code(&bw, 256);
+		for (int y = 0; y < GIF_HEIGHT; y++) {
+			for (int x = 0; x < GIF_WIDTH; x++) {
+				if (++literals == 250) {
+					write_code(&bw, 256);
+					literals = 1;
+				}
+				write_code(&bw, get_pixel(x, y, frame));
+			}
+		}
+		write_code(&bw, 257);
+		if (bw.num_bits)
+			write_code(&bw, 0);
+
+		for (size_t pos = 0; pos < bw.data.num; pos += 255) {
+			size_t size = bw.data.num - pos;
+			if (size > 255)
+				size = 255;
+
+			fputc((int)size, f);
+			fwrite(bw.data.array + pos, 1, size, f);
+		}
+		fputc(0, f);
+
+		da_free(bw.data);
+	}
+
+	fputc(0x3B, f);
+	fclose(f);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* a stream decodes frames on its own thread, wait until it caught up */
+static size_t wait_for_frame(gs_image_file2_t *image)
+{
+	size_t late = 0;
+
+	while (gs_image_file2_tick(image, 0)) {
+		assert_true(late < 1000);
+		gs_image_file2_update_texture(image);
+		late++;
+		os_sleep_ms(1);
+	}
+
+	return late;
+}
+
+static void check_frame(gs_image_file2_t *image)
+{
+	const uint8_t *expected;
+	uint8_t *data;
+	uint32_t linesize;
+
+	expected = reference + FRAME_SIZE * image->image.cur_frame;
+
+	assert_true(gs_texture_map(image->image.texture, &data, &linesize));
+
+	for (int y = 0; y < GIF_HEIGHT; y++)
+		assert_memory_equal(data + linesize * y,
+				    expected + GIF_WIDTH * 4 * y,
+				    GIF_WIDTH * 4);
+
+	gs_texture_unmap(image->image.texture);
+}
+
+/* plays the gif in order for a few loops, then jumps to random frames ahead
+ * of and behind the current one, checking the texture after every tick */
+static void play_gif(const char *name, uint64_t budget)
+{
+	gs_image_file2_t image = {0};
+	uint64_t start, init_ns, tick_ns = 0;
+	size_t ticks = 0, late = 0;
+
+	gs_image_file_set_gif_cache_budget(budget);
+
+	start = os_gettime_ns();
+	gs_image_file2_init(&image, GIF_FILE);
+	init_ns = os_gettime_ns() - start;
+
+	gs_image_file2_init_texture(&image);
+
+	assert_true(image.image.loaded);
+	assert_true(image.image.is_animated_gif);
+	assert_int_equal(image.image.cx, GIF_WIDTH);
+	assert_int_equal(image.image.cy, GIF_HEIGHT);
+
+	if (budget < FULL_SIZE)
+		assert_true(image.mem_usage < FULL_SIZE);
+	else
+		assert_true(image.mem_usage >= FULL_SIZE);
+
+	check_frame(&image);
+
+	for (int i = 0; i < GIF_FRAMES * PLAY_LOOPS; i++) {
+		int prev_frame = image.image.cur_frame;
+
+		start = os_gettime_ns();
+		if (gs_image_file2_tick(&image, FRAME_TIME_NS + 1))
+			gs_image_file2_update_texture(&image);
+		tick_ns += os_gettime_ns() - start;
+		ticks++;
+
+		late += wait_for_frame(&image);
+
+		assert_int_equal(image.image.cur_frame,
+				 (prev_frame + 1) % GIF_FRAMES);
+		check_frame(&image);
+	}
+
+	srand(1);
+
+	for (int i = 0; i < RANDOM_JUMPS; i++) {
+		int prev_frame = image.image.cur_frame;
+		int frames = 1 + rand() % (GIF_FRAMES * 2 - 1);
+
+		if (gs_image_file2_tick(&image, FRAME_TIME_NS * frames + 1))
+			gs_image_file2_update_texture(&image);
+		wait_for_frame(&image);
+
+		assert_int_equal(image.image.cur_frame,
+				 (prev_frame + frames) % GIF_FRAMES);
+		check_frame(&image);
+	}
+
+	print_message("%s: %.2f MB, init %.3f ms, %.4f ms per tick, "
+		      "%zu late ticks\n",
+		      name, (double)image.mem_usage / (1024.0 * 1024.0),
+		      (double)init_ns / 1000000.0,
+		      (double)tick_ns / 1000000.0 / (double)ticks, late);
+
+	gs_image_file2_free(&image);
+}
+
+static void cached_gif_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+	play_gif("fully cached", FULL_SIZE);
+}
+
+static void streamed_gif_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+	play_gif("streamed", 2ULL * 1024ULL * 1024ULL);
+}
+
+static void ring_only_gif_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+	play_gif("streamed, ring only", 1);
+}
+
+static int setup(void **state)
+{
+	gs_image_file2_t image = {0};
+
+	UNUSED_PARAMETER(state);
+
+	if (gs_create(&graphics, DL_NULL, 0) != GS_SUCCESS)
+		return -1;
+
+	gs_enter_context(graphics);
+	write_gif(GIF_FILE);
+
+	gs_image_file_set_gif_cache_budget(FULL_SIZE);
+	gs_image_file2_init(&image, GIF_FILE);
+	if (!image.image.loaded || !image.image.animation_frame_cache)
+		return -1;
+
+	reference = bmalloc(FULL_SIZE);
+	for (int i = 0; i < GIF_FRAMES; i++)
+		memcpy(reference + FRAME_SIZE * i,
+		       image.image.animation_frame_cache[i], FRAME_SIZE);
+
+	gs_image_file2_free(&image);
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	gs_image_file_set_gif_cache_budget(128ULL * 1024ULL * 1024ULL);
+	os_unlink(GIF_FILE);
+	bfree(reference);
+
+	gs_leave_context();
+	gs_destroy(graphics);
+	return 0;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(cached_gif_test),
+		cmocka_unit_test(streamed_gif_test),
+		cmocka_unit_test(ring_only_gif_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
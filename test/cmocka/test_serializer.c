@@ -22,10 +22,38 @@ static void serialize_test(void **state)
 	assert_memory_equal(output.bytes.array, expected, 3);
 }
 
+static void serialize_reset_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+	struct array_output_data output;
+	struct serializer s;
+
+	array_output_serializer_init(&s, &output);
+
+	s_wb32(&s, 0xdeadbeef);
+	uint8_t *array = output.bytes.array;
+	size_t capacity = output.bytes.capacity;
+
+	array_output_serializer_reset(&output);
+	assert_int_equal(output.bytes.num, 0);
+
+	s_w8(&s, 0x01);
+	s_w8(&s, 0xff);
+
+	assert_int_equal(output.bytes.num, 2);
+	assert_ptr_equal(output.bytes.array, array);
+	assert_int_equal(output.bytes.capacity, capacity);
+	uint8_t expected[2] = {0x01, 0xff};
+	assert_memory_equal(output.bytes.array, expected, 2);
+
+	array_output_serializer_free(&output);
+}
+
 int main()
 {
 	const struct CMUnitTest tests[] = {
 		cmocka_unit_test(serialize_test),
+		cmocka_unit_test(serialize_reset_test),
 	};
 
 	return cmocka_run_group_tests(tests, NULL, NULL);
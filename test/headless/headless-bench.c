@@ -0,0 +1,698 @@
+/*
+ * Headless pipeline benchmark
+ *
+ *   Runs the full pipeline (tick, render, output_frames, audio mix, encoders
+ * and null outputs) on the null graphics module with test-input sources, and
+ * reports how many of the expected video ticks made it through each stage,
+ * along with per-stage timings taken from the profiler.
+ *
+ *   Presets keep runs reproducible between builds, and -j writes the report
+ * as JSON so it can be compared by scripts.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <util/base.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <obs.h>
+
+#define MAX_OUTPUTS 8
+
+struct bench_args {
+	const char *preset;
+	int video_sources;
+	int audio_sources;
+	int filters;
+	int outputs;
+	int seconds;
+	uint32_t fps;
+	uint32_t cx;
+	uint32_t cy;
+	const char *video_encoder;
+	const char *audio_encoder;
+	const char *plugin_bin;
+	const char *plugin_data;
+	const char *json_file;
+	bool verbose;
+};
+
+struct bench_preset {
+	const char *name;
+	int video_sources;
+	int audio_sources;
+	int filters;
+	int outputs;
+};
+
+static const struct bench_preset presets[] = {
+	{"light", 2, 1, 0, 0},
+	{"default", 4, 2, 1, 1},
+	{"heavy", 16, 8, 2, 2},
+};
+
+/* profiler names of the stages that get reported, see obs-video.c,
+ * obs-audio.c, obs-encoder.c and obs-output.c */
+struct bench_stage {
+	const char *key;
+	const char *profile_name;
+};
+
+static const struct bench_stage stages[] = {
+	{"tick", "tick_sources"},
+	{"render", "render_video"},
+	{"output_frame", "output_frame"},
+	{"audio_mix", "audio_callback"},
+	{"encode", "do_encode"},
+	{"interleave", "interleave_packets"},
+};
+
+#define NUM_STAGES (sizeof(stages) / sizeof(stages[0]))
+
+struct stage_times {
+	DARRAY(profiler_time_entry_t) times;
+	uint64_t calls;
+};
+
+struct bench_stats {
+	long frames;
+	uint64_t last_ts;
+	uint64_t max_interval;
+	uint64_t late_ticks;
+	long audio_packets;
+};
+
+static struct bench_stats stats = {0};
+static uint64_t frame_interval = 0;
+
+static void raw_video(void *param, struct video_data *frame)
+{
+	uint64_t ts = frame->timestamp;
+
+	if (stats.frames++ > 0) {
+		uint64_t interval = ts - stats.last_ts;
+		uint64_t ticks;
+
+		if (interval > stats.max_interval)
+			stats.max_interval = interval;
+
+		/* frames are timestamped on the video clock, so any gap of
+		 * more than one interval is a tick that never arrived */
+		ticks = (interval + frame_interval / 2) / frame_interval;
+		if (ticks > 1)
+			stats.late_ticks += ticks - 1;
+	}
+
+	stats.last_ts = ts;
+	UNUSED_PARAMETER(param);
+}
+
+static void raw_audio(void *param, size_t mix_idx, struct audio_data *data)
+{
+	stats.audio_packets++;
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(mix_idx);
+	UNUSED_PARAMETER(data);
+}
+
+static void quiet_log(int log_level, const char *format, va_list args,
+		      void *param)
+{
+	if (log_level <= LOG_WARNING) {
+		vfprintf(stderr, format, args);
+		fputc('\n', stderr);
+	}
+	UNUSED_PARAMETER(param);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -P <preset>    light, default or heavy (applied first)\n"
+		"  -n <count>     number of async video sources (random)\n"
+		"  -m <count>     number of audio sources (test_sinewave)\n"
+		"  -F <count>     filters per video source (test_filter)\n"
+		"  -o <count>     number of null outputs, each with encoders\n"
+		"  -t <seconds>   duration (default 10)\n"
+		"  -f <fps>       frame rate (default 60)\n"
+		"  -s <cx>x<cy>   canvas size (default 1920x1080)\n"
+		"  -e <id>        video encoder (default obs_x264)\n"
+		"  -a <id>        audio encoder (default ffmpeg_aac)\n"
+		"  -p <bin> <data> additional plugin search path\n"
+		"  -j <file>      write the report as JSON, - for stdout\n"
+		"  -v             print all log messages\n",
+		name);
+}
+
+static bool apply_preset(struct bench_args *args, const char *name)
+{
+	for (size_t i = 0; i < sizeof(presets) / sizeof(presets[0]); i++) {
+		const struct bench_preset *preset = &presets[i];
+
+		if (strcmp(preset->name, name) == 0) {
+			args->preset = preset->name;
+			args->video_sources = preset->video_sources;
+			args->audio_sources = preset->audio_sources;
+			args->filters = preset->filters;
+			args->outputs = preset->outputs;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool parse_args(struct bench_args *args, int argc, char *argv[])
+{
+	/* the preset goes first so other options can override it */
+	for (int i = 1; i + 1 < argc; i++) {
+		if (strcmp(argv[i], "-P") == 0 &&
+		    !apply_preset(args, argv[i + 1]))
+			return false;
+	}
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		bool has_val = i + 1 < argc;
+
+		if (strcmp(arg, "-P") == 0 && has_val) {
+			i++;
+		} else if (strcmp(arg, "-n") == 0 && has_val) {
+			args->video_sources = atoi(argv[++i]);
+		} else if (strcmp(arg, "-m") == 0 && has_val) {
+			args->audio_sources = atoi(argv[++i]);
+		} else if (strcmp(arg, "-F") == 0 && has_val) {
+			args->filters = atoi(argv[++i]);
+		} else if (strcmp(arg, "-o") == 0 && has_val) {
+			args->outputs = atoi(argv[++i]);
+		} else if (strcmp(arg, "-t") == 0 && has_val) {
+			args->seconds = atoi(argv[++i]);
+		} else if (strcmp(arg, "-f") == 0 && has_val) {
+			args->fps = (uint32_t)atoi(argv[++i]);
+		} else if (strcmp(arg, "-s") == 0 && has_val) {
+			if (sscanf(argv[++i], "%ux%u", &args->cx, &args->cy) !=
+			    2)
+				return false;
+		} else if (strcmp(arg, "-e") == 0 && has_val) {
+			args->video_encoder = argv[++i];
+		} else if (strcmp(arg, "-a") == 0 && has_val) {
+			args->audio_encoder = argv[++i];
+		} else if (strcmp(arg, "-p") == 0 && i + 2 < argc) {
+			args->plugin_bin = argv[++i];
+			args->plugin_data = argv[++i];
+		} else if (strcmp(arg, "-j") == 0 && has_val) {
+			args->json_file = argv[++i];
+		} else if (strcmp(arg, "-v") == 0) {
+			args->verbose = true;
+		} else {
+			return false;
+		}
+	}
+
+	return args->video_sources >= 0 && args->audio_sources >= 0 &&
+	       args->filters >= 0 && args->outputs >= 0 &&
+	       args->outputs <= MAX_OUTPUTS && args->seconds > 0 &&
+	       args->fps > 0 && args->cx > 0 && args->cy > 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool reset_video(const struct bench_args *args)
+{
+	struct obs_video_info ovi = {0};
+	ovi.graphics_module = DL_NULL;
+	ovi.fps_num = args->fps;
+	ovi.fps_den = 1;
+	ovi.base_width = args->cx;
+	ovi.base_height = args->cy;
+	ovi.output_width = args->cx;
+	ovi.output_height = args->cy;
+	ovi.output_format = VIDEO_FORMAT_NV12;
+	ovi.gpu_conversion = true;
+	ovi.colorspace = VIDEO_CS_709;
+	ovi.range = VIDEO_RANGE_PARTIAL;
+	ovi.scale_type = OBS_SCALE_BICUBIC;
+
+	return obs_reset_video(&ovi) == OBS_VIDEO_SUCCESS;
+}
+
+static bool reset_audio(void)
+{
+	struct obs_audio_info oai = {0};
+	oai.samples_per_sec = 48000;
+	oai.speakers = SPEAKERS_STEREO;
+
+	return obs_reset_audio(&oai);
+}
+
+static bool add_source(obs_scene_t *scene, const char *id, const char *name,
+		       int filters)
+{
+	obs_source_t *source = obs_source_create(id, name, NULL, NULL);
+	if (!source)
+		return false;
+
+	for (int i = 0; i < filters; i++) {
+		char filter_name[64];
+		obs_source_t *filter;
+
+		snprintf(filter_name, sizeof(filter_name), "%s filter %d", name,
+			 i);
+		filter = obs_source_create("test_filter", filter_name, NULL,
+					   NULL);
+		if (!filter) {
+			obs_source_release(source);
+			return false;
+		}
+
+		obs_source_filter_add(source, filter);
+		obs_source_release(filter);
+	}
+
+	obs_scene_add(scene, source);
+	obs_source_release(source);
+	return true;
+}
+
+static obs_scene_t *create_scene(const struct bench_args *args)
+{
+	obs_scene_t *scene = obs_scene_create("headless-bench");
+	char name[32];
+
+	for (int i = 0; i < args->video_sources; i++) {
+		snprintf(name, sizeof(name), "random %d", i);
+		if (!add_source(scene, "random", name, args->filters))
+			goto fail;
+	}
+
+	for (int i = 0; i < args->audio_sources; i++) {
+		snprintf(name, sizeof(name), "sine %d", i);
+		if (!add_source(scene, "test_sinewave", name, 0))
+			goto fail;
+	}
+
+	return scene;
+
+fail:
+	obs_scene_release(scene);
+	return NULL;
+}
+
+static obs_output_t *start_output(const struct bench_args *args, int idx)
+{
+	const char *venc_id = args->video_encoder ? args->video_encoder
+						  : "obs_x264";
+	const char *aenc_id = args->audio_encoder ? args->audio_encoder
+						  : "ffmpeg_aac";
+	obs_encoder_t *venc;
+	obs_encoder_t *aenc;
+	obs_output_t *output;
+	char name[32];
+
+	snprintf(name, sizeof(name), "bench video %d", idx);
+	venc = obs_video_encoder_create(venc_id, name, NULL, NULL);
+	snprintf(name, sizeof(name), "bench audio %d", idx);
+	aenc = obs_audio_encoder_create(aenc_id, name, NULL, 0, NULL);
+	snprintf(name, sizeof(name), "bench output %d", idx);
+	output = obs_output_create("null_output", name, NULL, NULL);
+
+	if (!venc || !aenc || !output) {
+		fprintf(stderr, "failed to create encoders or null output\n");
+		goto fail;
+	}
+
+	obs_encoder_set_video(venc, obs_get_video());
+	obs_encoder_set_audio(aenc, obs_get_audio());
+	obs_output_set_video_encoder(output, venc);
+	obs_output_set_audio_encoder(output, aenc, 0);
+
+	if (!obs_output_start(output)) {
+		fprintf(stderr, "failed to start output: %s\n",
+			obs_output_get_last_error(output));
+		goto fail;
+	}
+
+	obs_encoder_release(venc);
+	obs_encoder_release(aenc);
+	return output;
+
+fail:
+	obs_output_release(output);
+	obs_encoder_release(venc);
+	obs_encoder_release(aenc);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void merge_times(struct stage_times *st, profiler_time_entries_t *times)
+{
+	for (size_t i = 0; i < times->num; i++) {
+		profiler_time_entry_t *entry = times->array + i;
+		bool found = false;
+
+		for (size_t j = 0; j < st->times.num; j++) {
+			profiler_time_entry_t *cur = st->times.array + j;
+
+			if (cur->time_delta == entry->time_delta) {
+				cur->count += entry->count;
+				found = true;
+				break;
+			}
+		}
+
+		if (!found)
+			da_push_back(st->times, entry);
+
+		st->calls += entry->count;
+	}
+}
+
+static bool collect_stage_times(void *context,
+				profiler_snapshot_entry_t *entry)
+{
+	struct stage_times *st = context;
+	const char *name = profiler_snapshot_entry_name(entry);
+
+	for (size_t i = 0; i < NUM_STAGES; i++) {
+		if (strcmp(name, stages[i].profile_name) == 0)
+			merge_times(&st[i],
+				    profiler_snapshot_entry_times(entry));
+	}
+
+	profiler_snapshot_enumerate_children(entry, collect_stage_times,
+					     context);
+	return true;
+}
+
+static int cmp_time_entry(const void *a, const void *b)
+{
+	const profiler_time_entry_t *ea = a;
+	const profiler_time_entry_t *eb = b;
+
+	if (ea->time_delta == eb->time_delta)
+		return 0;
+	return ea->time_delta < eb->time_delta ? -1 : 1;
+}
+
+/* times are in microseconds, as stored by the profiler */
+static uint64_t stage_percentile(const struct stage_times *st, double pct)
+{
+	uint64_t target = (uint64_t)((double)st->calls * pct);
+	uint64_t accum = 0;
+
+	for (size_t i = 0; i < st->times.num; i++) {
+		accum += st->times.array[i].count;
+		if (accum > target)
+			return st->times.array[i].time_delta;
+	}
+
+	return st->times.num ? st->times.array[st->times.num - 1].time_delta
+			     : 0;
+}
+
+static double stage_mean(const struct stage_times *st)
+{
+	uint64_t total = 0;
+
+	if (!st->calls)
+		return 0.0;
+
+	for (size_t i = 0; i < st->times.num; i++)
+		total += st->times.array[i].time_delta *
+			 st->times.array[i].count;
+
+	return (double)total / (double)st->calls;
+}
+
+static obs_data_t *stage_to_data(struct stage_times *st)
+{
+	obs_data_t *data = obs_data_create();
+
+	qsort(st->times.array, st->times.num, sizeof(profiler_time_entry_t),
+	      cmp_time_entry);
+
+	obs_data_set_int(data, "calls", (long long)st->calls);
+	obs_data_set_double(data, "mean_us", stage_mean(st));
+	obs_data_set_int(data, "median_us",
+			 (long long)stage_percentile(st, 0.5));
+	obs_data_set_int(data, "p99_us", (long long)stage_percentile(st, 0.99));
+	obs_data_set_int(data, "max_us", (long long)stage_percentile(st, 1.0));
+	return data;
+}
+
+static obs_data_t *build_report(const struct bench_args *args,
+				uint64_t elapsed_ns, obs_output_t **outputs)
+{
+	struct stage_times st[NUM_STAGES] = {0};
+	video_t *video = obs_get_video();
+	obs_data_t *report = obs_data_create();
+	obs_data_t *config = obs_data_create();
+	obs_data_t *frames = obs_data_create();
+	obs_data_t *stage_data = obs_data_create();
+	obs_data_array_t *output_data = obs_data_array_create();
+	profiler_snapshot_t *snap;
+
+	obs_data_set_string(config, "preset",
+			    args->preset ? args->preset : "custom");
+	obs_data_set_int(config, "video_sources", args->video_sources);
+	obs_data_set_int(config, "audio_sources", args->audio_sources);
+	obs_data_set_int(config, "filters", args->filters);
+	obs_data_set_int(config, "outputs", args->outputs);
+	obs_data_set_int(config, "width", args->cx);
+	obs_data_set_int(config, "height", args->cy);
+	obs_data_set_int(config, "fps", args->fps);
+	obs_data_set_obj(report, "config", config);
+
+	obs_data_set_double(report, "duration_s",
+			    (double)elapsed_ns / 1000000000.0);
+
+	obs_data_set_int(frames, "expected", elapsed_ns / frame_interval);
+	obs_data_set_int(frames, "rendered", obs_get_total_frames());
+	obs_data_set_int(frames, "lagged", obs_get_lagged_frames());
+	obs_data_set_int(frames, "output",
+			 video_output_get_total_frames(video));
+	obs_data_set_int(frames, "skipped",
+			 video_output_get_skipped_frames(video));
+	obs_data_set_int(frames, "delivered", stats.frames);
+	obs_data_set_int(frames, "late_ticks", stats.late_ticks);
+	obs_data_set_double(frames, "max_interval_ms",
+			    (double)stats.max_interval / 1000000.0);
+	obs_data_set_int(frames, "audio_packets", stats.audio_packets);
+	obs_data_set_obj(report, "frames", frames);
+
+	obs_data_set_int(report, "audio_buffering_ms",
+			 obs_get_audio_buffering_ms());
+
+	snap = profile_snapshot_create();
+	profiler_snapshot_enumerate_roots(snap, collect_stage_times, st);
+	for (size_t i = 0; i < NUM_STAGES; i++) {
+		obs_data_t *data = stage_to_data(&st[i]);
+		obs_data_set_obj(stage_data, stages[i].key, data);
+		obs_data_release(data);
+		da_free(st[i].times);
+	}
+	profile_snapshot_free(snap);
+	obs_data_set_obj(report, "stages", stage_data);
+
+	for (int i = 0; i < args->outputs; i++) {
+		obs_data_t *data = obs_data_create();
+		obs_data_set_string(data, "name",
+				    obs_output_get_name(outputs[i]));
+		obs_data_set_int(data, "frames",
+				 obs_output_get_total_frames(outputs[i]));
+		obs_data_set_int(data, "dropped",
+				 obs_output_get_frames_dropped(outputs[i]));
+		obs_data_array_push_back(output_data, data);
+		obs_data_release(data);
+	}
+	obs_data_set_array(report, "outputs", output_data);
+
+	obs_data_array_release(output_data);
+	obs_data_release(stage_data);
+	obs_data_release(frames);
+	obs_data_release(config);
+	return report;
+}
+
+static void print_report(obs_data_t *report)
+{
+	obs_data_t *frames = obs_data_get_obj(report, "frames");
+	obs_data_t *stage_data = obs_data_get_obj(report, "stages");
+	obs_data_array_t *output_data = obs_data_get_array(report, "outputs");
+
+	printf("duration:         %.3f s\n",
+	       obs_data_get_double(report, "duration_s"));
+	printf("expected ticks:   %lld\n",
+	       obs_data_get_int(frames, "expected"));
+	printf("rendered:         %lld\n",
+	       obs_data_get_int(frames, "rendered"));
+	printf("lagged:           %lld\n", obs_data_get_int(frames, "lagged"));
+	printf("output frames:    %lld\n", obs_data_get_int(frames, "output"));
+	printf("output skipped:   %lld\n",
+	       obs_data_get_int(frames, "skipped"));
+	printf("delivered:        %lld\n",
+	       obs_data_get_int(frames, "delivered"));
+	printf("late ticks:       %lld\n",
+	       obs_data_get_int(frames, "late_ticks"));
+	printf("max interval:     %.3f ms\n",
+	       obs_data_get_double(frames, "max_interval_ms"));
+	printf("audio packets:    %lld\n",
+	       obs_data_get_int(frames, "audio_packets"));
+	printf("audio buffering:  %lld ms\n",
+	       obs_data_get_int(report, "audio_buffering_ms"));
+
+	printf("\n%-14s %8s %10s %10s %10s %10s\n", "stage", "calls", "mean",
+	       "median", "p99", "max");
+	for (size_t i = 0; i < NUM_STAGES; i++) {
+		obs_data_t *data = obs_data_get_obj(stage_data, stages[i].key);
+		printf("%-14s %8lld %8.1fus %8lldus %8lldus %8lldus\n",
+		       stages[i].key, obs_data_get_int(data, "calls"),
+		       obs_data_get_double(data, "mean_us"),
+		       obs_data_get_int(data, "median_us"),
+		       obs_data_get_int(data, "p99_us"),
+		       obs_data_get_int(data, "max_us"));
+		obs_data_release(data);
+	}
+
+	for (size_t i = 0; i < obs_data_array_count(output_data); i++) {
+		obs_data_t *data = obs_data_array_item(output_data, i);
+		if (i == 0)
+			printf("\n");
+		printf("%s: %lld frames, %lld dropped\n",
+		       obs_data_get_string(data, "name"),
+		       obs_data_get_int(data, "frames"),
+		       obs_data_get_int(data, "dropped"));
+		obs_data_release(data);
+	}
+
+	obs_data_array_release(output_data);
+	obs_data_release(stage_data);
+	obs_data_release(frames);
+}
+
+static bool write_report(obs_data_t *report, const char *file)
+{
+	if (strcmp(file, "-") == 0) {
+		printf("%s\n", obs_data_get_json_pretty(report));
+		return true;
+	}
+
+	if (!obs_data_save_json_pretty_safe(report, file, "tmp", NULL)) {
+		fprintf(stderr, "failed to write '%s'\n", file);
+		return false;
+	}
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+	struct bench_args args = {
+		.video_sources = 4,
+		.audio_sources = 1,
+		.seconds = 10,
+		.fps = 60,
+		.cx = 1920,
+		.cy = 1080,
+	};
+	obs_output_t *outputs[MAX_OUTPUTS] = {0};
+	obs_scene_t *scene = NULL;
+	obs_data_t *report;
+	uint64_t start, elapsed;
+	int ret = EXIT_FAILURE;
+
+	if (!parse_args(&args, argc, argv)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (!args.verbose)
+		base_set_log_handler(quiet_log, NULL);
+
+	profiler_start();
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		fprintf(stderr, "failed to start up libobs\n");
+		goto free_profiler;
+	}
+
+	if (!reset_video(&args)) {
+		fprintf(stderr, "failed to initialize null video\n");
+		goto shutdown;
+	}
+	if (!reset_audio()) {
+		fprintf(stderr, "failed to initialize audio\n");
+		goto shutdown;
+	}
+
+	if (args.plugin_bin)
+		obs_add_module_path(args.plugin_bin, args.plugin_data);
+	obs_load_all_modules();
+	obs_post_load_modules();
+
+	scene = create_scene(&args);
+	if (!scene) {
+		fprintf(stderr, "failed to create sources, is the test-input "
+				"module in the plugin path?\n");
+		goto shutdown;
+	}
+
+	frame_interval = obs_get_frame_interval_ns();
+	obs_set_output_source(0, obs_scene_get_source(scene));
+	obs_add_raw_video_callback(NULL, raw_video, NULL);
+	obs_add_raw_audio_callback(0, NULL, raw_audio, NULL);
+
+	for (int i = 0; i < args.outputs; i++) {
+		outputs[i] = start_output(&args, i);
+		if (!outputs[i])
+			goto cleanup;
+	}
+
+	start = os_gettime_ns();
+	os_sleep_ms((uint32_t)args.seconds * 1000);
+	elapsed = os_gettime_ns() - start;
+
+	report = build_report(&args, elapsed, outputs);
+	if (args.json_file) {
+		if (write_report(report, args.json_file))
+			ret = EXIT_SUCCESS;
+		if (strcmp(args.json_file, "-") != 0)
+			print_report(report);
+	} else {
+		print_report(report);
+		ret = EXIT_SUCCESS;
+	}
+	obs_data_release(report);
+
+cleanup:
+	for (int i = 0; i < args.outputs; i++) {
+		if (outputs[i])
+			obs_output_stop(outputs[i]);
+		obs_output_release(outputs[i]);
+	}
+
+	obs_remove_raw_audio_callback(0, raw_audio, NULL);
+	obs_remove_raw_video_callback(raw_video, NULL);
+	obs_set_output_source(0, NULL);
+	obs_scene_release(scene);
+
+shutdown:
+	obs_shutdown();
+
+free_profiler:
+	profiler_stop();
+	profiler_free();
+
+	blog(LOG_INFO, "Number of memory leaks: %ld", bnum_allocs());
+	return ret;
+}